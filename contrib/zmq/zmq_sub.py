@@ -10,11 +10,17 @@ port = 28332
 zmqContext = zmq.Context()
 zmqSubSocket = zmqContext.socket(zmq.SUB)
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashblock")
+zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashgovernanceobject")
+zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashgovernancevote")
+zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashpaymentvote")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtx")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtxlock")
+zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"txlocktiming")
+zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"masternodestate")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawblock")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawtx")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawtxlock")
+lastSequence = {}
 zmqSubSocket.connect("tcp://127.0.0.1:%i" % port)
 
 try:
@@ -27,6 +33,10 @@ try:
         if len(msg[-1]) == 4:
           msgSequence = struct.unpack('<I', msg[-1])[-1]
           sequence = str(msgSequence)
+          # sequence numbers are counted per topic
+          if topic in lastSequence and msgSequence != (lastSequence[topic] + 1) & 0xffffffff:
+              print('! %s: %d messages lost' % (topic, (msgSequence - lastSequence[topic] - 1) & 0xffffffff))
+          lastSequence[topic] = msgSequence
 
         if topic == "hashblock":
             print('- HASH BLOCK ('+sequence+') -')
@@ -37,6 +47,24 @@ try:
         elif topic == "hashtxlock":
             print('- HASH TX LOCK ('+sequence+') -')
             print(binascii.hexlify(body).decode("utf-8"))
+        elif topic == "txlocktiming":
+            print('- TX LOCK TIMING ('+sequence+') -')
+            print(binascii.hexlify(body[:32]).decode("utf-8"))
+            total, firstvote, quorum, finalize, votes, orphans = struct.unpack('<6I', body[32:56])
+            print('total %dms, first vote %dms, quorum %dms, finalize %dms, votes %d (%d orphan)' % (total, firstvote, quorum, finalize, votes, orphans))
+        elif topic == "hashgovernanceobject":
+            print('- HASH GOVERNANCE OBJECT ('+sequence+') -')
+            print(binascii.hexlify(body).decode("utf-8"))
+        elif topic == "hashgovernancevote":
+            print('- HASH GOVERNANCE VOTE ('+sequence+') -')
+            print(binascii.hexlify(body).decode("utf-8"))
+        elif topic == "hashpaymentvote":
+            print('- HASH PAYMENT VOTE ('+sequence+') -')
+            print(binascii.hexlify(body).decode("utf-8"))
+        elif topic == "masternodestate":
+            print('- MASTERNODE STATE ('+sequence+') -')
+            n, state = struct.unpack('<Ii', body[32:40])
+            print('%s-%d state %d' % (binascii.hexlify(body[:32]).decode("utf-8"), n, state))
         elif topic == "rawblock":
             print('- RAW BLOCK HEADER ('+sequence+') -')
             print(binascii.hexlify(body[:80]).decode("utf-8"))
@@ -31,6 +31,21 @@ def deser_uint256(f):
         r += t << (i * 32)
     return r
 
+def ser_compact_size(n):
+    if n < 253:
+        return pack("B", n)
+    if n < 0x10000:
+        return pack("<BH", 253, n)
+    return pack("<BI", 254, n)
+
+def deser_compact_size(f):
+    n = unpack("B", f.read(1))[0]
+    if n == 253:
+        n = unpack("<H", f.read(2))[0]
+    elif n == 254:
+        n = unpack("<I", f.read(4))[0]
+    return n
+
 #allows simple http get calls
 def http_get_call(host, port, path, response_object = 0):
     conn = httplib.HTTPConnection(host, port)
@@ -330,6 +345,88 @@ class RESTTest (BitcoinTestFramework):
         for tx in txs:
             assert_equal(tx in json_obj['tx'], True)
 
+        ##############
+        # /rest/bulk #
+        ##############
+
+        # the bulk endpoints take their request in the body, so they only accept POST
+        for endpoint in ['getutxos', 'tx', 'headers']:
+            response = http_get_call(url.hostname, url.port, '/rest/bulk/'+endpoint+self.FORMAT_SEPARATOR+'json', True)
+            assert_equal(response.status, 405)
+            response = http_post_call(url.hostname, url.port, '/rest/bulk/'+endpoint+self.FORMAT_SEPARATOR+'json', '[', True)
+            assert_equal(response.status, 400)
+            response = http_post_call(url.hostname, url.port, '/rest/bulk/'+endpoint+self.FORMAT_SEPARATOR+'bin', '', True)
+            assert_equal(response.status, 400)
+
+        # getutxos: the unspent 0.1 output and the spent one, in all three formats
+        json_request = json.dumps({"checkmempool": True, "outpoints": [txid+'-'+str(n), vintx+'-0']})
+        json_string = http_post_call(url.hostname, url.port, '/rest/bulk/getutxos'+self.FORMAT_SEPARATOR+'json', json_request)
+        json_obj = json.loads(json_string.decode('utf-8'))
+        assert_equal(json_obj['chaintipHash'], self.nodes[0].getbestblockhash())
+        assert_equal(json_obj['bitmap'], "10")
+        assert_equal(len(json_obj['utxos']), 1)
+        assert_equal(json_obj['utxos'][0]['value'], 0.1)
+
+        binaryRequest = b'\x01' + ser_compact_size(2)
+        binaryRequest += hex_str_to_bytes(txid)[::-1] + pack("<I", n)
+        binaryRequest += hex_str_to_bytes(vintx)[::-1] + pack("<I", 0)
+        bin_response = http_post_call(url.hostname, url.port, '/rest/bulk/getutxos'+self.FORMAT_SEPARATOR+'bin', binaryRequest)
+        output = BytesIO(bin_response)
+        assert_equal(unpack("<i", output.read(4))[0], json_obj['chainHeight'])
+        assert_equal(hex(deser_uint256(output))[2:].zfill(65).rstrip("L"), json_obj['chaintipHash'])
+        assert_equal(deser_compact_size(output), 1)
+        assert_equal(output.read(1), b'\x01') #bitmap
+        assert_equal(deser_compact_size(output), 1) #utxos
+
+        hex_response = http_post_call(url.hostname, url.port, '/rest/bulk/getutxos'+self.FORMAT_SEPARATOR+'hex', binascii.hexlify(binaryRequest))
+        assert_equal(hex_response.strip(), binascii.hexlify(bin_response))
+
+        # tx: found transactions in request order, null for unknown ones
+        unknown_hash = '00'*32
+        json_string = http_post_call(url.hostname, url.port, '/rest/bulk/tx'+self.FORMAT_SEPARATOR+'json', json.dumps(txs + [unknown_hash]))
+        json_obj = json.loads(json_string.decode('utf-8'))
+        assert_equal(len(json_obj), 4)
+        for i in range(3):
+            assert_equal(json_obj[i]['txid'], txs[i])
+        assert_equal(json_obj[3], None)
+
+        binaryRequest = ser_compact_size(4)
+        for tx in txs + [unknown_hash]:
+            binaryRequest += hex_str_to_bytes(tx)[::-1]
+        bin_response = http_post_call(url.hostname, url.port, '/rest/bulk/tx'+self.FORMAT_SEPARATOR+'bin', binaryRequest)
+        expected = ser_compact_size(4)
+        for tx in txs:
+            expected += b'\x01' + hex_str_to_bytes(self.nodes[0].getrawtransaction(tx))
+        expected += b'\x00'
+        assert_equal(bin_response, expected)
+
+        hex_response = http_post_call(url.hostname, url.port, '/rest/bulk/tx'+self.FORMAT_SEPARATOR+'hex', binascii.hexlify(binaryRequest))
+        assert_equal(hex_response.strip(), binascii.hexlify(expected))
+
+        # headers: large replies are streamed in chunks
+        bb_hash = self.nodes[0].getbestblockhash()
+        header_bin = http_get_call(url.hostname, url.port, '/rest/headers/1/'+bb_hash+self.FORMAT_SEPARATOR+"bin", True).read()
+        response = http_post_call(url.hostname, url.port, '/rest/bulk/headers'+self.FORMAT_SEPARATOR+'json', json.dumps([bb_hash]*2000 + [unknown_hash]), True)
+        assert_equal(response.status, 400) #must be a 400 because we exceed the limit
+
+        response = http_post_call(url.hostname, url.port, '/rest/bulk/headers'+self.FORMAT_SEPARATOR+'json', json.dumps([bb_hash]*2000), True)
+        assert_equal(response.status, 200)
+        assert_equal(response.getheader('transfer-encoding'), 'chunked')
+        json_obj = json.loads(response.read().decode('utf-8'))
+        assert_equal(len(json_obj), 2000)
+        for header in json_obj:
+            assert_equal(header['hash'], bb_hash)
+
+        binaryRequest = ser_compact_size(2) + hex_str_to_bytes(bb_hash)[::-1] + hex_str_to_bytes(unknown_hash)
+        bin_response = http_post_call(url.hostname, url.port, '/rest/bulk/headers'+self.FORMAT_SEPARATOR+'bin', binaryRequest)
+        assert_equal(bin_response, ser_compact_size(2) + b'\x01' + header_bin + b'\x00')
+
+        binaryRequest = ser_compact_size(2000) + hex_str_to_bytes(bb_hash)[::-1]*2000
+        response = http_post_call(url.hostname, url.port, '/rest/bulk/headers'+self.FORMAT_SEPARATOR+'hex', binascii.hexlify(binaryRequest), True)
+        assert_equal(response.status, 200)
+        assert_equal(response.getheader('transfer-encoding'), 'chunked')
+        assert_equal(response.read().strip(), binascii.hexlify(ser_compact_size(2000) + (b'\x01' + header_bin)*2000))
+
         #test rest bestblock
         bb_hash = self.nodes[0].getbestblockhash()
 
@@ -9,8 +9,11 @@
 
 from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import *
+from test_framework.authproxy import JSONRPCException
+from struct import unpack
 import zmq
 import binascii
+import time
 
 try:
     import http.client as httplib
@@ -30,14 +33,27 @@ class ZMQTest (BitcoinTestFramework):
         self.zmqSubSocket = self.zmqContext.socket(zmq.SUB)
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashblock")
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtx")
+        self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashgovernanceobject")
         self.zmqSubSocket.connect("tcp://127.0.0.1:%i" % self.port)
+        self.sequences = {}
         return start_nodes(4, self.options.tmpdir, extra_args=[
-            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port)],
+            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port),
+             '-zmqpubhashgovernanceobject=tcp://127.0.0.1:'+str(self.port)],
             [],
             [],
             []
             ])
 
+    def receive(self):
+        msg = self.zmqSubSocket.recv_multipart()
+        topic = msg[0]
+        body = msg[1]
+        # each topic is numbered on its own, from 0 and without gaps
+        sequence = unpack('<I', msg[2])[0]
+        assert_equal(sequence, self.sequences.get(topic, -1) + 1)
+        self.sequences[topic] = sequence
+        return topic, body
+
     def run_test(self):
         self.sync_all()
 
@@ -45,13 +61,9 @@ class ZMQTest (BitcoinTestFramework):
         self.sync_all()
 
         print "listen..."
-        msg = self.zmqSubSocket.recv_multipart()
-        topic = msg[0]
-        body = msg[1]
+        topic, body = self.receive()
 
-        msg = self.zmqSubSocket.recv_multipart()
-        topic = msg[0]
-        body = msg[1]
+        topic, body = self.receive()
         blkhash = bytes_to_hex_str(body)
 
         assert_equal(genhashes[0], blkhash) #blockhash from generate must be equal to the hash received over zmq
@@ -62,9 +74,7 @@ class ZMQTest (BitcoinTestFramework):
 
         zmqHashes = []
         for x in range(0,n*2):
-            msg = self.zmqSubSocket.recv_multipart()
-            topic = msg[0]
-            body = msg[1]
+            topic, body = self.receive()
             if topic == b"hashblock":
                 zmqHashes.append(bytes_to_hex_str(body))
 
@@ -76,15 +86,41 @@ class ZMQTest (BitcoinTestFramework):
         self.sync_all()
 
         # now we should receive a zmq msg because the tx was broadcast
-        msg = self.zmqSubSocket.recv_multipart()
-        topic = msg[0]
-        body = msg[1]
+        topic, body = self.receive()
         hashZMQ = ""
         if topic == b"hashtx":
             hashZMQ = bytes_to_hex_str(body)
 
         assert_equal(hashRPC, hashZMQ) #blockhash from generate must be equal to the hash received over zmq
 
+        #test a governance object: its collateral needs confirmations before it can be submitted
+        now = int(time.time())
+        proposal = [["proposal", {"name": "zmq_test", "url": "http://example.com/zmq_test",
+                                  "payment_address": self.nodes[0].getnewaddress(), "payment_amount": 1,
+                                  "start_epoch": now, "end_epoch": now + 3600, "type": 1}]]
+        data_hex = binascii.hexlify(json.dumps(proposal))
+        fee_txid = self.nodes[0].gobject("prepare", "0", "1", str(now), data_hex)
+        self.sync_all()
+        self.nodes[1].generate(6)
+        self.sync_all()
+
+        # the node only takes objects once it considers itself synced
+        gobject_hash = None
+        for x in range(0, 60):
+            try:
+                gobject_hash = self.nodes[0].gobject("submit", "0", "1", str(now), data_hex, fee_txid)
+                break
+            except JSONRPCException as exp:
+                assert_equal(exp.error["code"], -10) #RPC_CLIENT_IN_INITIAL_DOWNLOAD
+                time.sleep(1)
+        assert(gobject_hash is not None)
+
+        # skip the tx and block messages before it, checking their sequence numbers on the way
+        topic = b""
+        while topic != b"hashgovernanceobject":
+            topic, body = self.receive()
+        assert_equal(gobject_hash, bytes_to_hex_str(body))
+
 
 if __name__ == '__main__':
     ZMQTest ().main ()
@@ -8,12 +8,20 @@
 #include "clientversion.h"
 #include "rpcclient.h"
 #include "rpcprotocol.h"
+#include "streams.h"
+#include "uint256.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "version.h"
 
 #include <boost/filesystem/operations.hpp>
 #include <stdio.h>
 
+#ifndef WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
 #include <event2/event.h>
 #include <event2/http.h>
 #include <event2/buffer.h>
@@ -40,6 +48,7 @@ std::string HelpMessageCli()
     strUsage += HelpMessageOpt("-rpcwait", _("Wait for RPC server to start"));
     strUsage += HelpMessageOpt("-rpcuser=<user>", _("Username for JSON-RPC connections"));
     strUsage += HelpMessageOpt("-rpcpassword=<pw>", _("Password for JSON-RPC connections"));
+    strUsage += HelpMessageOpt("-rpcsocket[=<path>]", _("Send commands to the binary RPC socket of the node instead of over HTTP, relative paths are in the data directory (default path: rpc.sock)"));
     strUsage += HelpMessageOpt("-rpcclienttimeout=<n>", strprintf(_("Timeout during HTTP requests (default: %d)"), DEFAULT_HTTP_CLIENT_TIMEOUT));
 
     return strUsage;
@@ -150,8 +159,99 @@ static void http_request_done(struct evhttp_request *req, void *ctx)
     }
 }
 
+#ifndef WIN32
+/** Connect to the binary RPC socket of the node */
+static SOCKET ConnectBinaryRPC()
+{
+    const std::string strPath = GetBinaryRPCSocketPath().string();
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strPath.size() >= sizeof(addr.sun_path))
+        throw runtime_error(strprintf("binary RPC socket path %s is too long", strPath));
+    strncpy(addr.sun_path, strPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    SOCKET hSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (hSocket == INVALID_SOCKET)
+        throw runtime_error("cannot create socket");
+    if (connect(hSocket, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        close(hSocket);
+        throw CConnectionFailed("couldn't connect to server");
+    }
+    return hSocket;
+}
+#endif
+
+static uint256 ParseHashParam(const UniValue& param)
+{
+    if (!param.isStr() || param.get_str().size() != 64 || !IsHex(param.get_str()))
+        throw runtime_error("expected a 64 character hex hash");
+    return uint256S(param.get_str());
+}
+
+/**
+ * Call a method over the binary RPC socket. Non-verbose getblock and getrawtransaction
+ * calls are sent as binary requests, anything else as JSON-RPC. Returns a JSON-RPC reply.
+ */
+static UniValue CallBinaryRPC(const string& strMethod, const UniValue& params)
+{
+#ifdef WIN32
+    throw runtime_error("-rpcsocket is not supported on Windows");
+#else
+    CDataStream ssRequest(SER_NETWORK, PROTOCOL_VERSION);
+    bool fBinary = false;
+    if (strMethod == "getblock" && params.size() == 2 && params[1].isBool() && !params[1].get_bool()) {
+        ssRequest << (unsigned char)BINARY_RPC_GETBLOCK << ParseHashParam(params[0]);
+        fBinary = true;
+    } else if (strMethod == "getrawtransaction" && params.size() >= 1 &&
+               (params.size() == 1 || (params[1].isNum() && params[1].get_int() == 0))) {
+        ssRequest << (unsigned char)BINARY_RPC_GETRAWTRANSACTION << ParseHashParam(params[0]);
+        fBinary = true;
+    } else {
+        const std::string strJSON = JSONRPCRequest(strMethod, params, 1);
+        ssRequest << (unsigned char)BINARY_RPC_JSON;
+        ssRequest.write(strJSON.data(), strJSON.size());
+    }
+
+    SOCKET hSocket = ConnectBinaryRPC();
+    std::string strReply;
+    bool fOk = WriteBinaryRPCFrame(hSocket, ssRequest.str()) &&
+               ReadBinaryRPCFrame(hSocket, strReply, MAX_BINARY_RPC_REPLY_SIZE);
+    close(hSocket);
+    if (!fOk || strReply.empty())
+        throw runtime_error("no response from server");
+
+    if ((unsigned char)strReply[0] != BINARY_RPC_OK) {
+        CDataStream ssError(strReply.data() + 1, strReply.data() + strReply.size(), SER_NETWORK, PROTOCOL_VERSION);
+        int nCode;
+        std::string strMessage;
+        ssError >> nCode >> strMessage;
+        return JSONRPCReplyObj(NullUniValue, JSONRPCError(nCode, strMessage), 1);
+    }
+
+    if (!fBinary) {
+        UniValue valReply(UniValue::VSTR);
+        if (!valReply.read(strReply.substr(1)) || !valReply.isObject())
+            throw runtime_error("couldn't parse reply from server");
+        return valReply;
+    }
+
+    // a transaction is followed by the hash of its block, which the hex output leaves out
+    size_t nSize = strReply.size() - 1;
+    if (strMethod == "getrawtransaction") {
+        if (nSize < 32)
+            throw runtime_error("couldn't parse reply from server");
+        nSize -= 32;
+    }
+    return JSONRPCReplyObj(HexStr(strReply.begin() + 1, strReply.begin() + 1 + nSize), NullUniValue, 1);
+#endif
+}
+
 UniValue CallRPC(const string& strMethod, const UniValue& params)
 {
+    if (mapArgs.count("-rpcsocket") && mapArgs["-rpcsocket"] != "0")
+        return CallBinaryRPC(strMethod, params);
+
     std::string host = GetArg("-rpcconnect", DEFAULT_RPCCONNECT);
     int port = GetArg("-rpcport", BaseParams().RPCPort());
 
@@ -0,0 +1,92 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "coins.h"
+#include "policy/policy.h"
+#include "txmempool.h"
+
+#include <list>
+#include <vector>
+
+// Number of mempool transactions and distinct addresses they pay to
+static const int NUM_TXS = 1000;
+static const int NUM_ADDRESSES = 50;
+
+static CScript AddressScript(int n)
+{
+    return CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, (unsigned char)n) << OP_EQUALVERIFY << OP_CHECKSIG;
+}
+
+// Fill a mempool with transactions spending a single funding transaction,
+// each paying to two of NUM_ADDRESSES addresses.
+static void BuildPool(CTxMemPool& pool, CCoinsViewCache& view, std::vector<CTransaction>& vtx)
+{
+    CMutableTransaction txFund;
+    txFund.vin.resize(1);
+    txFund.vout.resize(NUM_TXS);
+    for (int i = 0; i < NUM_TXS; i++) {
+        txFund.vout[i].scriptPubKey = AddressScript(i % NUM_ADDRESSES);
+        txFund.vout[i].nValue = 2 * COIN;
+    }
+    CTransaction fund(txFund);
+    view.ModifyCoins(fund.GetHash())->FromTx(fund, 1);
+
+    for (int i = 0; i < NUM_TXS; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(fund.GetHash(), i);
+        tx.vout.resize(2);
+        tx.vout[0].scriptPubKey = AddressScript((i + 1) % NUM_ADDRESSES);
+        tx.vout[0].nValue = COIN;
+        tx.vout[1].scriptPubKey = AddressScript((i + 2) % NUM_ADDRESSES);
+        tx.vout[1].nValue = COIN - 1000;
+        vtx.push_back(CTransaction(tx));
+        const CTransaction& txRef = vtx.back();
+        CTxMemPoolEntry entry(txRef, 1000, 0, 0.0, 1, true, 2 * COIN, false, 1, LockPoints());
+        pool.addUnchecked(txRef.GetHash(), entry);
+        pool.addAddressIndex(entry, view);
+        pool.addSpentIndex(entry, view);
+    }
+}
+
+// Adding and removing transactions with the address and spent indexes enabled
+static void MempoolAddressIndexAddRemove(benchmark::State& state)
+{
+    CCoinsView dummy;
+    CCoinsViewCache view(&dummy);
+    while (state.KeepRunning()) {
+        CTxMemPool pool(CFeeRate(1000));
+        std::vector<CTransaction> vtx;
+        vtx.reserve(NUM_TXS);
+        BuildPool(pool, view, vtx);
+        std::list<CTransaction> removed;
+        for (unsigned int i = 0; i < vtx.size(); i++)
+            pool.remove(vtx[i], removed, false);
+    }
+}
+
+// Querying the deltas of a few addresses, as getaddressmempool does
+static void MempoolAddressIndexQuery(benchmark::State& state)
+{
+    CCoinsView dummy;
+    CCoinsViewCache view(&dummy);
+    CTxMemPool pool(CFeeRate(1000));
+    std::vector<CTransaction> vtx;
+    vtx.reserve(NUM_TXS);
+    BuildPool(pool, view, vtx);
+
+    std::vector<std::pair<uint160, int> > addresses;
+    for (int i = 0; i < 3; i++)
+        addresses.push_back(std::make_pair(uint160(std::vector<unsigned char>(20, (unsigned char)i)), 1));
+
+    while (state.KeepRunning()) {
+        std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > results;
+        pool.getAddressIndex(addresses, results);
+        assert(results.size() == 3 * 3 * NUM_TXS / NUM_ADDRESSES);
+    }
+}
+
+BENCHMARK(MempoolAddressIndexAddRemove);
+BENCHMARK(MempoolAddressIndexQuery);
@@ -0,0 +1,95 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "darksend.h"
+#include "key.h"
+#include "wallet/wallet.h"
+
+#include <vector>
+
+// Synthetic mixing wallet: NUM_ROUNDS layers of mixing transactions,
+// each spending NUM_INPUTS of our denominated outputs from the previous layer
+static const int NUM_ROUNDS = 8;
+static const int NUM_TXS_PER_ROUND = 500;
+static const int NUM_INPUTS = 3;
+
+static void BuildMixingWallet(CWallet& wallet, std::vector<COutPoint>& vOutpointsRet)
+{
+    darkSendPool.InitDenominations();
+    CAmount nDenom = vecPrivateSendDenominations[1];
+
+    CKey key;
+    key.MakeNewKey(true);
+    wallet.LoadKey(key, key.GetPubKey());
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    LOCK(wallet.cs_wallet);
+
+    // funding transaction with non-denominated (foreign) input
+    CMutableTransaction txFund;
+    txFund.vin.resize(1);
+    txFund.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    txFund.vout.resize(NUM_TXS_PER_ROUND * NUM_INPUTS, CTxOut(nDenom, scriptPubKey));
+    CWalletTx wtxFund(&wallet, txFund);
+    wallet.AddToWallet(wtxFund, true, NULL);
+
+    std::vector<COutPoint> vPrev;
+    for (unsigned int i = 0; i < txFund.vout.size(); i++)
+        vPrev.push_back(COutPoint(txFund.GetHash(), i));
+
+    for (int nRound = 0; nRound < NUM_ROUNDS; nRound++) {
+        std::vector<COutPoint> vNext;
+        for (int nTx = 0; nTx < NUM_TXS_PER_ROUND; nTx++) {
+            CMutableTransaction tx;
+            for (int i = 0; i < NUM_INPUTS; i++) {
+                // shuffle a bit so chains of different transactions intertwine
+                tx.vin.push_back(CTxIn(vPrev[(nTx * NUM_INPUTS + i * 7) % vPrev.size()]));
+                // other participants' inputs
+                tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i)));
+            }
+            tx.vout.resize(NUM_INPUTS * 2, CTxOut(nDenom, scriptPubKey));
+            // other participants' outputs
+            for (int i = NUM_INPUTS; i < NUM_INPUTS * 2; i++)
+                tx.vout[i].scriptPubKey = CScript() << OP_TRUE;
+            CWalletTx wtx(&wallet, tx);
+            wallet.AddToWallet(wtx, true, NULL);
+            for (int i = 0; i < NUM_INPUTS; i++)
+                vNext.push_back(COutPoint(tx.GetHash(), i));
+        }
+        vPrev.swap(vNext);
+    }
+
+    vOutpointsRet = vPrev;
+}
+
+// Calculating rounds of every output of a mixing wallet from scratch
+static void PrivateSendRoundsCold(benchmark::State& state)
+{
+    CWallet wallet;
+    std::vector<COutPoint> vOutpoints;
+    BuildMixingWallet(wallet, vOutpoints);
+
+    while (state.KeepRunning()) {
+        wallet.ClearPrivateSendRoundsCache();
+        for (unsigned int i = 0; i < vOutpoints.size(); i++)
+            assert(wallet.GetRealInputPrivateSendRounds(CTxIn(vOutpoints[i]), 0) == NUM_ROUNDS);
+    }
+}
+
+// Repeated lookups, as done by coin selection and the mixing loop
+static void PrivateSendRoundsCached(benchmark::State& state)
+{
+    CWallet wallet;
+    std::vector<COutPoint> vOutpoints;
+    BuildMixingWallet(wallet, vOutpoints);
+
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < vOutpoints.size(); i++)
+            assert(wallet.GetRealInputPrivateSendRounds(CTxIn(vOutpoints[i]), 0) == NUM_ROUNDS);
+    }
+}
+
+BENCHMARK(PrivateSendRoundsCold);
+BENCHMARK(PrivateSendRoundsCached);
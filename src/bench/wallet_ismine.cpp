@@ -0,0 +1,84 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "wallet/wallet.h"
+
+#include <vector>
+
+// Watch-only wallet with NUM_WATCH_ONLY addresses, matched against a block of
+// NUM_TXS transactions with two outputs each, one in NUM_MATCH_EVERY paying to us
+static const int NUM_WATCH_ONLY = 20000;
+static const int NUM_TXS = 2000;
+static const int NUM_MATCH_EVERY = 100;
+
+static CScript RandomP2PKH()
+{
+    uint256 hash = GetRandHash();
+    return GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(hash.begin(), hash.begin() + 20))));
+}
+
+static void BuildWatchOnlyWallet(CWallet& wallet, CBlock& block)
+{
+    LOCK(wallet.cs_wallet);
+    std::vector<CScript> vWatch;
+    for (int i = 0; i < NUM_WATCH_ONLY; i++) {
+        vWatch.push_back(RandomP2PKH());
+        wallet.LoadWatchOnly(vWatch.back());
+    }
+
+    for (int i = 0; i < NUM_TXS; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+        tx.vout.resize(2);
+        tx.vout[0].scriptPubKey = i % NUM_MATCH_EVERY == 0 ? vWatch[i % NUM_WATCH_ONLY] : RandomP2PKH();
+        tx.vout[0].nValue = COIN;
+        tx.vout[1].scriptPubKey = RandomP2PKH();
+        tx.vout[1].nValue = COIN;
+        block.vtx.push_back(CTransaction(tx));
+    }
+}
+
+// What every output went through during a rescan before the prefilter
+static void WalletIsMineSolver(benchmark::State& state)
+{
+    CWallet wallet;
+    CBlock block;
+    BuildWatchOnlyWallet(wallet, block);
+
+    while (state.KeepRunning()) {
+        int nMatches = 0;
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            for (unsigned int j = 0; j < block.vtx[i].vout.size(); j++) {
+                if (::IsMine(wallet, block.vtx[i].vout[j].scriptPubKey) != ISMINE_NO) {
+                    nMatches++;
+                    break;
+                }
+            }
+        }
+        assert(nMatches == NUM_TXS / NUM_MATCH_EVERY);
+    }
+}
+
+// Matching a block as rescans and block connection do
+static void WalletIsMinePrefilter(benchmark::State& state)
+{
+    CWallet wallet;
+    CBlock block;
+    BuildWatchOnlyWallet(wallet, block);
+
+    while (state.KeepRunning()) {
+        int nMatches = 0;
+        for (unsigned int i = 0; i < block.vtx.size(); i++)
+            if (wallet.IsMine(block.vtx[i]))
+                nMatches++;
+        assert(nMatches == NUM_TXS / NUM_MATCH_EVERY);
+    }
+}
+
+BENCHMARK(WalletIsMineSolver);
+BENCHMARK(WalletIsMinePrefilter);
@@ -0,0 +1,329 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "binaryrpc.h"
+
+#include "chainparams.h"
+#include "main.h"
+#include "netbase.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "responsecache.h"
+#include "rpcprotocol.h"
+#include "rpcserver.h"
+#include "streams.h"
+#include "sync.h"
+#include "util.h"
+#include "version.h"
+
+#ifndef WIN32
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+/** Execute a JSON-RPC request or batch, errors are returned as JSON-RPC error replies */
+static std::string ExecBinaryRPCJSON(const std::string& strJSON)
+{
+    JSONRequest jreq;
+    try {
+        UniValue valRequest;
+        if (!valRequest.read(strJSON))
+            throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
+
+        if (valRequest.isObject()) {
+            jreq.parse(valRequest);
+            UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
+            return JSONRPCReply(result, NullUniValue, jreq.id);
+        }
+        if (valRequest.isArray())
+            return JSONRPCExecBatch(valRequest.get_array());
+        throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
+    } catch (const UniValue& objError) {
+        return JSONRPCReply(NullUniValue, objError, jreq.id);
+    } catch (const std::exception& e) {
+        return JSONRPCReply(NullUniValue, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
+    }
+}
+
+static const CBlockIndex* LookupBlockIndex(const uint256& hash)
+{
+    LOCK(cs_main);
+    BlockMap::const_iterator it = mapBlockIndex.find(hash);
+    if (it == mapBlockIndex.end())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    return it->second;
+}
+
+std::string ExecBinaryRPCRequest(const std::string& strRequest)
+{
+    CDataStream ssReply(SER_NETWORK, PROTOCOL_VERSION);
+    try {
+        if (strRequest.empty())
+            throw JSONRPCError(RPC_INVALID_REQUEST, "Empty request");
+        const unsigned char nType = strRequest[0];
+
+        if (nType == BINARY_RPC_JSON) {
+            // the JSON-RPC reply carries its own errors
+            const std::string strReply = ExecBinaryRPCJSON(strRequest.substr(1));
+            ssReply << (unsigned char)BINARY_RPC_OK;
+            ssReply.write(strReply.data(), strReply.size());
+            return ssReply.str();
+        }
+
+        std::string strWarmupStatus;
+        if (RPCIsInWarmup(&strWarmupStatus))
+            throw JSONRPCError(RPC_IN_WARMUP, strWarmupStatus);
+
+        CDataStream ssRequest(strRequest.data() + 1, strRequest.data() + strRequest.size(), SER_NETWORK, PROTOCOL_VERSION);
+        ssReply << (unsigned char)BINARY_RPC_OK;
+        switch (nType) {
+        case BINARY_RPC_GETBESTBLOCK: {
+            boost::shared_ptr<const CChainTipSnapshot> tip = GetChainTipSnapshot();
+            ssReply << tip->nHeight << tip->hashBlock;
+            break;
+        }
+        case BINARY_RPC_GETBLOCKHASH: {
+            int nHeight;
+            ssRequest >> nHeight;
+            const CBlockIndex* pindex = GetChainTipSnapshot()->GetAncestor(nHeight);
+            if (!pindex)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+            ssReply << pindex->GetBlockHash();
+            break;
+        }
+        case BINARY_RPC_GETBLOCKHEADER: {
+            uint256 hash;
+            ssRequest >> hash;
+            const CBlockIndex* pindex = LookupBlockIndex(hash);
+            ssReply << pindex->GetBlockHeader() << pindex->nHeight;
+            break;
+        }
+        case BINARY_RPC_GETBLOCK: {
+            uint256 hash;
+            ssRequest >> hash;
+            const CBlockIndex* pindex = LookupBlockIndex(hash);
+            {
+                LOCK(cs_main);
+                if (fHavePruned && !(pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nTx > 0)
+                    throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+            }
+            // the serialized block goes out as is, shared with the REST cache
+            std::string strBlock;
+            if (!GetSerializedBlock(pindex, IsBlockBuried(pindex), true, strBlock))
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+            ssReply.write(strBlock.data(), strBlock.size());
+            break;
+        }
+        case BINARY_RPC_GETRAWTRANSACTION: {
+            uint256 hash;
+            ssRequest >> hash;
+            CTransaction tx;
+            uint256 hashBlock;
+            if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true))
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available about transaction");
+            ssReply << tx << hashBlock;
+            break;
+        }
+        default:
+            throw JSONRPCError(RPC_METHOD_NOT_FOUND, strprintf("Unknown request type %d", nType));
+        }
+        return ssReply.str();
+    } catch (const UniValue& objError) {
+        ssReply.clear();
+        ssReply << (unsigned char)BINARY_RPC_ERROR << find_value(objError, "code").get_int()
+                << find_value(objError, "message").get_str();
+    } catch (const std::ios_base::failure&) {
+        ssReply.clear();
+        ssReply << (unsigned char)BINARY_RPC_ERROR << (int)RPC_DESERIALIZATION_ERROR << std::string("Malformed request");
+    } catch (const std::exception& e) {
+        ssReply.clear();
+        ssReply << (unsigned char)BINARY_RPC_ERROR << (int)RPC_MISC_ERROR << std::string(e.what());
+    }
+    return ssReply.str();
+}
+
+bool IsBinaryRPCEnabled()
+{
+    return mapArgs.count("-rpcsocket") && mapArgs["-rpcsocket"] != "0";
+}
+
+#ifndef WIN32
+
+static SOCKET hListenSocket = INVALID_SOCKET;
+static boost::filesystem::path pathSocket;
+static boost::thread threadBinaryRPC;
+
+/** Open connections, guarded by cs_connections like fInterrupted */
+static CWaitableCriticalSection cs_connections;
+static CConditionVariable condConnections;
+static std::set<SOCKET> setConnections;
+static bool fInterrupted = false;
+
+static void ThreadBinaryRPCConnection(SOCKET hSocket)
+{
+    RenameThread("3dcoin-binrpcconn");
+    std::string strRequest;
+    while (ReadBinaryRPCFrame(hSocket, strRequest, MAX_BINARY_RPC_REQUEST_SIZE)) {
+        if (!WriteBinaryRPCFrame(hSocket, ExecBinaryRPCRequest(strRequest)))
+            break;
+    }
+
+    boost::unique_lock<boost::mutex> lock(cs_connections);
+    setConnections.erase(hSocket);
+    CloseSocket(hSocket);
+    condConnections.notify_all();
+}
+
+static void ThreadBinaryRPC()
+{
+    RenameThread("3dcoin-binrpc");
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(cs_connections);
+            if (fInterrupted)
+                break;
+        }
+        // wake up now and then to notice an interruption
+        struct pollfd pfd;
+        pfd.fd = hListenSocket;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 200) <= 0)
+            continue;
+        SOCKET hSocket = accept(hListenSocket, NULL, NULL);
+        if (hSocket == INVALID_SOCKET)
+            continue;
+
+        boost::unique_lock<boost::mutex> lock(cs_connections);
+        if (fInterrupted || setConnections.size() >= (size_t)MAX_BINARY_RPC_CONNECTIONS) {
+            LogPrint("rpc", "Binary RPC: rejecting connection, %d connections open\n", setConnections.size());
+            CloseSocket(hSocket);
+            continue;
+        }
+        setConnections.insert(hSocket);
+        boost::thread(boost::bind(&ThreadBinaryRPCConnection, hSocket));
+    }
+}
+
+/** Whether the socket path lies directly or indirectly below the data directory */
+static bool IsInDataDir(const boost::filesystem::path& path)
+{
+    try {
+        boost::filesystem::path pathDataDir = boost::filesystem::canonical(GetDataDir());
+        boost::filesystem::path pathDir = boost::filesystem::canonical(path.parent_path());
+        for (; !pathDir.empty(); pathDir = pathDir.parent_path())
+            if (pathDir == pathDataDir)
+                return true;
+    } catch (const boost::filesystem::filesystem_error& e) {
+        LogPrintf("Binary RPC: cannot resolve %s: %s\n", path.string(), e.what());
+    }
+    return false;
+}
+
+bool StartBinaryRPC()
+{
+    pathSocket = GetBinaryRPCSocketPath();
+    const std::string strPath = pathSocket.string();
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strPath.size() >= sizeof(addr.sun_path)) {
+        LogPrintf("Binary RPC: socket path %s is too long\n", strPath);
+        return false;
+    }
+    strncpy(addr.sun_path, strPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    // a socket left behind by a previous run would make bind fail, but only
+    // our own datadir is safe to clean up: elsewhere the socket may belong to
+    // another process
+    struct stat st;
+    if (stat(strPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        if (!IsInDataDir(pathSocket)) {
+            LogPrintf("Binary RPC: %s already exists outside the data directory, not removing it\n", strPath);
+            return false;
+        }
+        unlink(strPath.c_str());
+    }
+
+    hListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (hListenSocket == INVALID_SOCKET) {
+        LogPrintf("Binary RPC: cannot create socket: %s\n", NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    if (bind(hListenSocket, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(hListenSocket, SOMAXCONN) == SOCKET_ERROR) {
+        LogPrintf("Binary RPC: cannot listen on %s: %s\n", strPath, NetworkErrorString(WSAGetLastError()));
+        CloseSocket(hListenSocket);
+        return false;
+    }
+    // anyone who can connect has full RPC access
+    if (chmod(strPath.c_str(), S_IRUSR | S_IWUSR) != 0) {
+        LogPrintf("Binary RPC: cannot restrict permissions of %s: %s\n", strPath, strerror(errno));
+        CloseSocket(hListenSocket);
+        unlink(strPath.c_str());
+        return false;
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(cs_connections);
+        fInterrupted = false;
+    }
+    threadBinaryRPC = boost::thread(&ThreadBinaryRPC);
+    LogPrintf("Binary RPC: listening on %s\n", strPath);
+    return true;
+}
+
+void InterruptBinaryRPC()
+{
+    boost::unique_lock<boost::mutex> lock(cs_connections);
+    fInterrupted = true;
+    // wakes connections waiting for their next request
+    BOOST_FOREACH(SOCKET hSocket, setConnections)
+        shutdown(hSocket, SHUT_RDWR);
+}
+
+void StopBinaryRPC()
+{
+    if (hListenSocket == INVALID_SOCKET)
+        return;
+    InterruptBinaryRPC();
+    threadBinaryRPC.join();
+    {
+        boost::unique_lock<boost::mutex> lock(cs_connections);
+        while (!setConnections.empty())
+            condConnections.wait(lock);
+    }
+    CloseSocket(hListenSocket);
+    unlink(pathSocket.string().c_str());
+    LogPrint("rpc", "Binary RPC: stopped\n");
+}
+
+#else // WIN32
+
+bool StartBinaryRPC()
+{
+    LogPrintf("Binary RPC: -rpcsocket is not supported on Windows\n");
+    return false;
+}
+
+void InterruptBinaryRPC()
+{
+}
+
+void StopBinaryRPC()
+{
+}
+
+#endif // WIN32
@@ -0,0 +1,31 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BINARYRPC_H
+#define BITCOIN_BINARYRPC_H
+
+#include <string>
+
+/** Maximum number of connections to the binary RPC socket */
+static const int MAX_BINARY_RPC_CONNECTIONS = 16;
+
+/** Whether the binary RPC socket is enabled with -rpcsocket */
+bool IsBinaryRPCEnabled();
+
+/** Start binary RPC subsystem, listening on a local UNIX socket.
+ * Precondition; RPC has been started.
+ */
+bool StartBinaryRPC();
+/** Interrupt binary RPC subsystem.
+ */
+void InterruptBinaryRPC();
+/** Stop binary RPC subsystem.
+ * Precondition; RPC has not been stopped yet.
+ */
+void StopBinaryRPC();
+
+/** Execute one binary RPC request payload and return the reply payload */
+std::string ExecBinaryRPCRequest(const std::string& strRequest);
+
+#endif // BITCOIN_BINARYRPC_H
@@ -43,6 +43,13 @@ bool CCoins::Spend(uint32_t nPos)
 
 bool CCoinsView::GetCoins(const uint256 &txid, CCoins &coins) const { return false; }
 bool CCoinsView::HaveCoins(const uint256 &txid) const { return false; }
+void CCoinsView::GetCoinsBatch(const std::vector<uint256> &vTxid, std::vector<CCoins> &vCoins, std::vector<bool> &vFound) const
+{
+    vCoins.assign(vTxid.size(), CCoins());
+    vFound.assign(vTxid.size(), false);
+    for (size_t i = 0; i < vTxid.size(); i++)
+        vFound[i] = GetCoins(vTxid[i], vCoins[i]);
+}
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
 bool CCoinsView::GetStats(CCoinsStats &stats) const { return false; }
@@ -51,6 +58,7 @@ bool CCoinsView::GetStats(CCoinsStats &stats) const { return false; }
 CCoinsViewBacked::CCoinsViewBacked(CCoinsView *viewIn) : base(viewIn) { }
 bool CCoinsViewBacked::GetCoins(const uint256 &txid, CCoins &coins) const { return base->GetCoins(txid, coins); }
 bool CCoinsViewBacked::HaveCoins(const uint256 &txid) const { return base->HaveCoins(txid); }
+void CCoinsViewBacked::GetCoinsBatch(const std::vector<uint256> &vTxid, std::vector<CCoins> &vCoins, std::vector<bool> &vFound) const { base->GetCoinsBatch(vTxid, vCoins, vFound); }
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
@@ -96,6 +104,37 @@ bool CCoinsViewCache::GetCoins(const uint256 &txid, CCoins &coins) const {
     return false;
 }
 
+void CCoinsViewCache::GetCoinsBatch(const std::vector<uint256> &vTxid, std::vector<CCoins> &vCoins, std::vector<bool> &vFound) const {
+    vCoins.assign(vTxid.size(), CCoins());
+    vFound.assign(vTxid.size(), false);
+
+    // answer what we can from the cache, and ask the parent for the rest in one go
+    std::vector<uint256> vMissing;
+    std::vector<size_t> vMissingPos;
+    for (size_t i = 0; i < vTxid.size(); i++) {
+        CCoinsMap::const_iterator it = cacheCoins.find(vTxid[i]);
+        if (it != cacheCoins.end()) {
+            vCoins[i] = it->second.coins;
+            vFound[i] = true;
+        } else {
+            vMissing.push_back(vTxid[i]);
+            vMissingPos.push_back(i);
+        }
+    }
+    if (vMissing.empty())
+        return;
+
+    std::vector<CCoins> vBaseCoins;
+    std::vector<bool> vBaseFound;
+    base->GetCoinsBatch(vMissing, vBaseCoins, vBaseFound);
+    for (size_t i = 0; i < vMissing.size(); i++) {
+        if (vBaseFound[i]) {
+            vCoins[vMissingPos[i]].swap(vBaseCoins[i]);
+            vFound[vMissingPos[i]] = true;
+        }
+    }
+}
+
 CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
     assert(!hasModifier);
     std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry()));
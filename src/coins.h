@@ -322,6 +322,11 @@ public:
     //! This may (but cannot always) return true for fully spent transactions
     virtual bool HaveCoins(const uint256 &txid) const;
 
+    //! Retrieve the CCoins for many transactions at once. vTxid must be sorted so that
+    //! backends can read them in key order. vFound[i] is set where GetCoins would succeed.
+    //! Unlike GetCoins on a cache, entries read from the parent view are not cached.
+    virtual void GetCoinsBatch(const std::vector<uint256> &vTxid, std::vector<CCoins> &vCoins, std::vector<bool> &vFound) const;
+
     //! Retrieve the block hash whose state this CCoinsView currently represents
     virtual uint256 GetBestBlock() const;
 
@@ -347,6 +352,7 @@ public:
     CCoinsViewBacked(CCoinsView *viewIn);
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
     bool HaveCoins(const uint256 &txid) const;
+    void GetCoinsBatch(const std::vector<uint256> &vTxid, std::vector<CCoins> &vCoins, std::vector<bool> &vFound) const;
     uint256 GetBestBlock() const;
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
@@ -401,6 +407,7 @@ public:
     // Standard CCoinsView methods
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
     bool HaveCoins(const uint256 &txid) const;
+    void GetCoinsBatch(const std::vector<uint256> &vTxid, std::vector<CCoins> &vCoins, std::vector<bool> &vFound) const;
     uint256 GetBestBlock() const;
     void SetBestBlock(const uint256 &hashBlock);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
@@ -99,6 +99,8 @@ public:
 
     void Next();
 
+    void Prev();
+
     template<typename K> bool GetKey(K& key) {
         leveldb::Slice slKey = piter->key();
         try {
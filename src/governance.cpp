@@ -13,6 +13,7 @@
 #include "masternodeman.h"
 #include "netfulfilledman.h"
 #include "util.h"
+#include "validationinterface.h"
 
 CGovernanceManager governance;
 
@@ -385,6 +386,8 @@ bool CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, bool& fA
 
     DBG( cout << "CGovernanceManager::AddGovernanceObject END" << endl; );
 
+    GetMainSignals().NotifyGovernanceObject(govobj);
+
     return true;
 }
 
@@ -985,6 +988,8 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
         if(govobj.GetObjectType() == GOVERNANCE_OBJECT_WATCHDOG) {
             mnodeman.UpdateWatchdogVoteTime(vote.GetVinMasternode());
         }
+
+        GetMainSignals().NotifyGovernanceVote(vote);
     }
     return fOk;
 }
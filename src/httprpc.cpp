@@ -5,6 +5,7 @@
 #include "httpserver.h"
 #include "rpcprotocol.h"
 #include "rpcserver.h"
+#include "rpcstream.h"
 #include "random.h"
 #include "sync.h"
 #include "util.h"
@@ -15,10 +16,13 @@
 #include "utilstrencodings.h"
 
 #include <boost/algorithm/string.hpp> // boost::trim
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp> //BOOST_FOREACH
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
+/** Requests with larger bodies are not parsed to classify them, they are queued with low priority */
+static const size_t MAX_CLASSIFY_BODY_SIZE = 64 * 1024;
 
 /** Simple one-shot callback timer to be used by the RPC mechanism to e.g.
  * re-lock the wellet.
@@ -79,6 +83,68 @@ static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const Uni
     req->WriteReply(nStatus, strReply);
 }
 
+/** Sink of a streamed JSON-RPC reply, the first chunk starts a chunked HTTP reply */
+class HTTPRPCReplyStream
+{
+public:
+    HTTPRPCReplyStream(HTTPRequest* reqIn) : req(reqIn), fStarted(false) {}
+
+    void Write(const std::string& strChunk)
+    {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReplyStart(HTTP_OK);
+            fStarted = true;
+        }
+        req->WriteReplyChunk(strChunk);
+    }
+
+private:
+    HTTPRequest* req;
+    bool fStarted;
+};
+
+/**
+ * Execute a request for a method that can stream its result. Results that fit in one
+ * chunk are sent as a plain reply, larger ones as a chunked reply while they are produced.
+ * Returns false, without replying, if the method can't stream.
+ */
+static bool JSONRPCExecStream(HTTPRequest* req, const JSONRequest& jreq)
+{
+    HTTPRPCReplyStream stream(req);
+    CJSONStreamWriter writer(boost::bind(&HTTPRPCReplyStream::Write, &stream, _1));
+
+    // Same layout as JSONRPCReply
+    writer.BeginObject();
+    writer.Key("result");
+    try {
+        if (!tableRPC.executeStream(jreq.strMethod, jreq.params, writer))
+            return false;
+    } catch (...) {
+        if (!writer.HasFlushed())
+            throw;
+        // The status line is out already, all that is left is to cut the reply short
+        LogPrintf("%s: %s failed while streaming its result\n", __func__, jreq.strMethod);
+        req->WriteReplyEnd();
+        return true;
+    }
+    writer.Key("error");
+    writer.Value(NullUniValue);
+    writer.Key("id");
+    writer.Value(jreq.id);
+    writer.EndObject();
+
+    std::string strRest = writer.Release() + "\n";
+    if (writer.HasFlushed()) {
+        req->WriteReplyChunk(strRest);
+        req->WriteReplyEnd();
+    } else {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strRest);
+    }
+    return true;
+}
+
 //This function checks username and password against -rpcauth
 //entries from config file.
 static bool multiUserAuthorized(std::string strUserPass)
@@ -140,6 +206,46 @@ static bool RPCAuthorized(const std::string& strAuth)
     return multiUserAuthorized(strUserPass);
 }
 
+/** Work class of one JSON-RPC call: known methods are their own endpoint */
+static HTTPWorkClass JSONRPCCallWorkClass(const UniValue& valRequest)
+{
+    if (!valRequest.isObject())
+        return HTTPWorkClass();
+    const UniValue& method = find_value(valRequest.get_obj(), "method");
+    if (!method.isStr() || !tableRPC[method.get_str()])
+        return HTTPWorkClass();
+    const std::string& strMethod = method.get_str();
+    if (tableRPC.isCheap(strMethod))
+        return HTTPWorkClass(HTTP_PRIORITY_HIGH, strMethod);
+    if (tableRPC.isExpensive(strMethod))
+        return HTTPWorkClass(HTTP_PRIORITY_LOW, strMethod);
+    return HTTPWorkClass(HTTP_PRIORITY_NORMAL, strMethod);
+}
+
+/** A batch is scheduled like its most expensive call */
+static HTTPWorkClass JSONRPCBatchWorkClass(const UniValue& valRequest)
+{
+    HTTPWorkClass workClass(HTTP_PRIORITY_HIGH);
+    for (unsigned int i = 0; i < valRequest.size(); i++) {
+        HTTPWorkClass callClass = JSONRPCCallWorkClass(valRequest[i]);
+        if (i == 0 || callClass.priority > workClass.priority)
+            workClass = callClass;
+    }
+    return workClass;
+}
+
+/** Schedule a JSON-RPC request by its method */
+static HTTPWorkClass HTTPReq_JSONRPCWorkClass(HTTPRequest* req, const std::string &)
+{
+    std::string strBody = req->PeekBody(MAX_CLASSIFY_BODY_SIZE);
+    UniValue valRequest;
+    if (strBody.empty() || !valRequest.read(strBody))
+        return HTTPWorkClass(strBody.empty() ? HTTP_PRIORITY_LOW : HTTP_PRIORITY_NORMAL);
+    if (!valRequest.isArray())
+        return JSONRPCCallWorkClass(valRequest);
+    return JSONRPCBatchWorkClass(valRequest);
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -180,6 +286,9 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            if (JSONRPCExecStream(req, jreq))
+                return true;
+
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
             // Send reply
@@ -187,7 +296,8 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
+            // helpers run calls of the batch, so they are scheduled like it
+            strReply = JSONRPCExecBatch(valRequest.get_array(), boost::bind(&EnqueueHTTPWork, _1, JSONRPCBatchWorkClass(valRequest)));
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
@@ -227,7 +337,7 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, HTTPReq_JSONRPCWorkClass);
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
@@ -6,11 +6,13 @@
 
 #include "chainparamsbase.h"
 #include "compat.h"
+#include "httpworkqueue.h"
 #include "util.h"
 #include "netbase.h"
 #include "rpcprotocol.h" // For HTTP status codes
 #include "sync.h"
 #include "ui_interface.h"
+#include "utilstrencodings.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -24,6 +26,7 @@
 #include <event2/http.h>
 #include <event2/thread.h>
 #include <event2/buffer.h>
+#include <event2/bufferevent.h>
 #include <event2/util.h>
 #include <event2/keyvalq_struct.h>
 
@@ -35,11 +38,16 @@
 #endif
 
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
 
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
+/** Maximum number of bytes of a chunked reply that may wait to be sent to the client */
+static const size_t MAX_HTTP_REPLY_BACKLOG = 4 * 1024 * 1024;
 
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
@@ -61,120 +69,33 @@ private:
     HTTPRequestHandler func;
 };
 
-/** Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
- */
-template <typename WorkItem>
-class WorkQueue
+/** Work item that runs a function unrelated to any request */
+class HTTPFunctionWorkItem : public HTTPClosure
 {
-private:
-    /** Mutex protects entire object */
-    CWaitableCriticalSection cs;
-    CConditionVariable cond;
-    /* XXX in C++11 we can use std::unique_ptr here and avoid manual cleanup */
-    std::deque<WorkItem*> queue;
-    bool running;
-    size_t maxDepth;
-    int numThreads;
-
-    /** RAII object to keep track of number of running worker threads */
-    class ThreadCounter
-    {
-    public:
-        WorkQueue &wq;
-        ThreadCounter(WorkQueue &w): wq(w)
-        {
-            boost::lock_guard<boost::mutex> lock(wq.cs);
-            wq.numThreads += 1;
-        }
-        ~ThreadCounter()
-        {
-            boost::lock_guard<boost::mutex> lock(wq.cs);
-            wq.numThreads -= 1;
-            wq.cond.notify_all();
-        }
-    };
-
 public:
-    WorkQueue(size_t maxDepth) : running(true),
-                                 maxDepth(maxDepth),
-                                 numThreads(0)
+    HTTPFunctionWorkItem(const boost::function<void(void)>& func): func(func)
     {
     }
-    /*( Precondition: worker threads have all stopped
-     * (call WaitExit)
-     */
-    ~WorkQueue()
-    {
-        while (!queue.empty()) {
-            delete queue.front();
-            queue.pop_front();
-        }
-    }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
-    {
-        boost::unique_lock<boost::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
-            return false;
-        }
-        queue.push_back(item);
-        cond.notify_one();
-        return true;
-    }
-    /** Thread function */
-    void Run()
-    {
-        ThreadCounter count(*this);
-        while (running) {
-            WorkItem* i = 0;
-            {
-                boost::unique_lock<boost::mutex> lock(cs);
-                while (running && queue.empty())
-                    cond.wait(lock);
-                if (!running)
-                    break;
-                i = queue.front();
-                queue.pop_front();
-            }
-            (*i)();
-            delete i;
-        }
-    }
-    /** Interrupt and exit loops */
-    void Interrupt()
-    {
-        boost::unique_lock<boost::mutex> lock(cs);
-        running = false;
-        cond.notify_all();
-    }
-    /** Wait for worker threads to exit */
-    void WaitExit()
+    void operator()()
     {
-        boost::unique_lock<boost::mutex> lock(cs);
-        while (numThreads > 0){
-            cond.wait(lock);
-        }
+        func();
     }
 
-    /** Return current depth of queue */
-    size_t Depth()
-    {
-        boost::unique_lock<boost::mutex> lock(cs);
-        return queue.size();
-    }
+private:
+    boost::function<void(void)> func;
 };
 
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler):
-        prefix(prefix), exactMatch(exactMatch), handler(handler)
+    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler, HTTPRequestClassifier classifier):
+        prefix(prefix), exactMatch(exactMatch), handler(handler), classifier(classifier)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPRequestClassifier classifier;
 };
 
 /** HTTP module state */
@@ -289,12 +210,18 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        HTTPWorkClass workClass(HTTP_PRIORITY_NORMAL, i->prefix);
+        if (i->classifier)
+            workClass = i->classifier(hreq.get(), path);
         std::auto_ptr<HTTPWorkItem> item(new HTTPWorkItem(hreq.release(), path, i->handler));
         assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        if (workQueue->Enqueue(item.get(), workClass.priority, workClass.strEndpoint)) {
             item.release(); /* if true, queue took ownership */
-        else
-            item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
+        } else {
+            LogPrint("http", "Work queue of %s priority is full, rejecting request for %s\n",
+                     HTTPPriorityName(workClass.priority), strURI);
+            item->req->WriteReply(HTTP_SERVUNAVAIL, "Work queue depth exceeded");
+        }
     } else {
         hreq->WriteReply(HTTP_NOTFOUND);
     }
@@ -435,9 +362,27 @@ bool InitHTTPServer()
 
     LogPrint("http", "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
-
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    int workQueueDepthHigh = std::max((long)GetArg("-rpchighworkqueue", DEFAULT_HTTP_HIGH_PRIORITY_WORKQUEUE), 1L);
+    LogPrintf("HTTP: creating work queue of depth %d (%d for high priority calls)\n", workQueueDepth, workQueueDepthHigh);
+
+    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth, workQueueDepthHigh);
+    if (mapMultiArgs.count("-rpcendpointlimit")) {
+        BOOST_FOREACH(const std::string& strLimit, mapMultiArgs["-rpcendpointlimit"]) {
+            size_t nSep = strLimit.rfind(':');
+            int32_t nLimit = 0;
+            if (nSep == std::string::npos || nSep == 0 || !ParseInt32(strLimit.substr(nSep + 1), &nLimit) || nLimit < 0) {
+                uiInterface.ThreadSafeMessageBox(
+                    strprintf("Invalid -rpcendpointlimit specification: %s. Use <endpoint>:<n>, e.g. getaddressdeltas:2 or /rest/bulk/tx:1.", strLimit),
+                    "", CClientUIInterface::MSG_ERROR);
+                delete workQueue;
+                workQueue = 0;
+                evhttp_free(http);
+                event_base_free(base);
+                return false;
+            }
+            workQueue->SetEndpointLimit(strLimit.substr(0, nSep), nLimit);
+        }
+    }
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -515,6 +460,56 @@ void StopHTTPServer()
     LogPrint("http", "Stopped HTTP server\n");
 }
 
+bool EnqueueHTTPWork(const boost::function<void(void)>& func, const HTTPWorkClass& workClass)
+{
+    if (!workQueue)
+        return false;
+    std::auto_ptr<HTTPFunctionWorkItem> item(new HTTPFunctionWorkItem(func));
+    if (!workQueue->Enqueue(item.get(), workClass.priority, workClass.strEndpoint))
+        return false;
+    item.release(); /* queue took ownership */
+    return true;
+}
+
+bool GetHTTPWorkQueueStats(HTTPWorkQueueStats& stats)
+{
+    if (!workQueue)
+        return false;
+    workQueue->GetStats(stats);
+    return true;
+}
+
+const char* HTTPPriorityName(HTTPPriority priority)
+{
+    switch (priority) {
+    case HTTP_PRIORITY_HIGH:
+        return "high";
+    case HTTP_PRIORITY_NORMAL:
+        return "normal";
+    case HTTP_PRIORITY_LOW:
+        return "low";
+    }
+    return "unknown";
+}
+
+bool HTTPETagMatches(const std::string& strIfNoneMatch, const std::string& strETag)
+{
+    // If-None-Match compares weakly, so a W/ prefix on either side does not matter
+    const std::string strOpaque = strETag.compare(0, 2, "W/") == 0 ? strETag.substr(2) : strETag;
+    std::vector<std::string> vTags;
+    boost::split(vTags, strIfNoneMatch, boost::is_any_of(","));
+    BOOST_FOREACH(std::string& strTag, vTags) {
+        boost::trim(strTag);
+        if (strTag == "*")
+            return true;
+        if (strTag.compare(0, 2, "W/") == 0)
+            strTag.erase(0, 2);
+        if (strTag == strOpaque)
+            return true;
+    }
+    return false;
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
@@ -546,8 +541,24 @@ void HTTPEvent::trigger(struct timeval* tv)
     else
         evtimer_add(ev, tv); // trigger after timeval passed
 }
+/** Reply bytes of a chunked reply on their way to the client, shared with the main http thread */
+struct HTTPReplyBacklog
+{
+    boost::mutex cs;
+    boost::condition_variable cond;
+    //! In chunks that were not handed to evhttp yet
+    size_t nQueued;
+    //! In the connection's output buffer, as of the last look from the main http thread
+    size_t nUnsent;
+    //! Set from the main http thread when the connection went away before the reply ended
+    bool fClosed;
+
+    HTTPReplyBacklog() : nQueued(0), nUnsent(0), fClosed(false) {}
+};
+
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
@@ -555,7 +566,10 @@ HTTPRequest::~HTTPRequest()
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
-        WriteReply(HTTP_INTERNAL, "Unhandled request");
+        if (replyStarted)
+            WriteReplyEnd();
+        else
+            WriteReply(HTTP_INTERNAL, "Unhandled request");
     }
     // evhttpd cleans up the request, as long as a reply was sent.
 }
@@ -571,6 +585,12 @@ std::pair<bool, std::string> HTTPRequest::GetHeader(const std::string& hdr)
         return std::make_pair(false, "");
 }
 
+bool HTTPRequest::MatchesETag(const std::string& strETag)
+{
+    std::pair<bool, std::string> header = GetHeader("If-None-Match");
+    return header.first && HTTPETagMatches(header.second, strETag);
+}
+
 std::string HTTPRequest::ReadBody()
 {
     struct evbuffer* buf = evhttp_request_get_input_buffer(req);
@@ -591,6 +611,20 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody(size_t nMaxSize)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    size_t size = evbuffer_get_length(buf);
+    if (size == 0 || size > nMaxSize)
+        return "";
+    std::string rv(size, '\0');
+    if (evbuffer_copyout(buf, &rv[0], size) != (ev_ssize_t)size)
+        return "";
+    return rv;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -605,7 +639,7 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && !replyStarted && req);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -617,6 +651,120 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/** The connection of a chunked reply went away. evhttp keeps the request, but its connection is freed. */
+static void http_reply_closed(struct evhttp_connection* evcon, void* arg)
+{
+    HTTPReplyBacklog* backlog = (HTTPReplyBacklog*)arg;
+    boost::unique_lock<boost::mutex> lock(backlog->cs);
+    backlog->fClosed = true;
+    backlog->cond.notify_all();
+}
+
+/** Whether the connection of a chunked reply went away, only changes in the main http thread */
+static bool http_reply_is_closed(const boost::shared_ptr<HTTPReplyBacklog>& backlog)
+{
+    boost::unique_lock<boost::mutex> lock(backlog->cs);
+    return backlog->fClosed;
+}
+
+/**
+ * Start a chunked reply from the main http thread. The end of the reply is queued after
+ * this and holds on to the backlog, which keeps it alive for the close callback until
+ * http_send_reply_end removes the callback again.
+ */
+static void http_send_reply_start(struct evhttp_request* req, int nStatus, boost::shared_ptr<HTTPReplyBacklog> backlog)
+{
+    evhttp_send_reply_start(req, nStatus, (const char*)NULL);
+    struct evhttp_connection* evcon = evhttp_request_get_connection(req);
+    if (evcon)
+        evhttp_connection_set_closecb(evcon, http_reply_closed, backlog.get());
+}
+
+void HTTPRequest::WriteReplyStart(int nStatus)
+{
+    assert(!replySent && !replyStarted && req);
+    replyBacklog.reset(new HTTPReplyBacklog());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_send_reply_start, req, nStatus, replyBacklog));
+    ev->trigger(0);
+    replyStarted = true;
+}
+
+/** Look at the connection's output buffer after nSent queued bytes were handed to evhttp */
+static void http_update_reply_backlog(struct evhttp_request* req, boost::shared_ptr<HTTPReplyBacklog> backlog, size_t nSent)
+{
+    size_t nUnsent = 0;
+    if (!http_reply_is_closed(backlog)) {
+        struct evhttp_connection* evcon = evhttp_request_get_connection(req);
+        if (evcon)
+            nUnsent = evbuffer_get_length(bufferevent_get_output(evhttp_connection_get_bufferevent(evcon)));
+    }
+
+    boost::unique_lock<boost::mutex> lock(backlog->cs);
+    backlog->nQueued -= nSent;
+    backlog->nUnsent = nUnsent;
+    backlog->cond.notify_all();
+}
+
+/** Send a chunk from the main http thread. evhttp moves the data out of evb, which is ours to free. */
+static void http_send_reply_chunk(struct evhttp_request* req, struct evbuffer* evb, boost::shared_ptr<HTTPReplyBacklog> backlog)
+{
+    size_t nSize = evbuffer_get_length(evb);
+    if (!http_reply_is_closed(backlog))
+        evhttp_send_reply_chunk(req, evb);
+    evbuffer_free(evb);
+    http_update_reply_backlog(req, backlog, nSize);
+}
+
+/** End a chunked reply from the main http thread */
+static void http_send_reply_end(struct evhttp_request* req, boost::shared_ptr<HTTPReplyBacklog> backlog)
+{
+    if (!http_reply_is_closed(backlog)) {
+        struct evhttp_connection* evcon = evhttp_request_get_connection(req);
+        if (evcon)
+            evhttp_connection_set_closecb(evcon, NULL, NULL);
+    }
+    // Without a connection evhttp leaves the request to us, this frees it
+    evhttp_send_reply_end(req);
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(replyStarted && req);
+    {
+        boost::unique_lock<boost::mutex> lock(replyBacklog->cs);
+        // nobody is listening anymore, let the handler run to its end quickly
+        if (replyBacklog->fClosed)
+            return;
+        replyBacklog->nQueued += strChunk.size();
+    }
+    // Events are run in the order they were triggered, so chunks arrive in order
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_send_reply_chunk, req, evb, replyBacklog));
+    ev->trigger(0);
+
+    // Wait for a slow client to catch up. evhttp drops connections that make no
+    // progress for -rpcservertimeout seconds, so don't wait longer than that.
+    int64_t nDeadline = GetTime() + GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT);
+    boost::unique_lock<boost::mutex> lock(replyBacklog->cs);
+    while (!replyBacklog->fClosed && replyBacklog->nQueued + replyBacklog->nUnsent > MAX_HTTP_REPLY_BACKLOG && GetTime() < nDeadline) {
+        // the output buffer drains without telling us, look at it again shortly
+        HTTPEvent* evUpdate = new HTTPEvent(eventBase, true, boost::bind(http_update_reply_backlog, req, replyBacklog, 0));
+        evUpdate->trigger(0);
+        replyBacklog->cond.timed_wait(lock, boost::posix_time::milliseconds(100));
+    }
+}
+
+void HTTPRequest::WriteReplyEnd()
+{
+    assert(replyStarted && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_send_reply_end, req, replyBacklog));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -657,10 +805,11 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         const HTTPRequestClassifier &classifier)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, classifier));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -5,20 +5,24 @@
 #ifndef BITCOIN_HTTPSERVER_H
 #define BITCOIN_HTTPSERVER_H
 
+#include <map>
 #include <string>
 #include <stdint.h>
 #include <boost/thread.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+static const int DEFAULT_HTTP_HIGH_PRIORITY_WORKQUEUE=16;
 
 struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPReplyBacklog;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -34,16 +38,84 @@ void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
 
+/** Priority classes of HTTP work. Workers take queued work in this order. */
+enum HTTPPriority {
+    HTTP_PRIORITY_HIGH,   //!< cheap status and control calls, always have a worker to themselves
+    HTTP_PRIORITY_NORMAL,
+    HTTP_PRIORITY_LOW,    //!< expensive queries
+};
+static const int HTTP_PRIORITY_COUNT = 3;
+
+/** How a request is scheduled on the work queue */
+struct HTTPWorkClass
+{
+    HTTPPriority priority;
+    //! Endpoint whose concurrency limit applies, empty for none
+    std::string strEndpoint;
+
+    HTTPWorkClass(HTTPPriority priorityIn = HTTP_PRIORITY_NORMAL, const std::string& strEndpointIn = ""):
+        priority(priorityIn), strEndpoint(strEndpointIn) {}
+};
+
 /** Handler for requests to a certain HTTP path */
 typedef boost::function<void(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Classifier for requests to a certain HTTP path. It runs on the event thread, keep it cheap. */
+typedef boost::function<HTTPWorkClass(HTTPRequest* req, const std::string &)> HTTPRequestClassifier;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. Requests are queued with the class returned by classifier,
+ * or with normal priority and the prefix as endpoint if there is none.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         const HTTPRequestClassifier &classifier = HTTPRequestClassifier());
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Run func on one of the HTTP worker threads, scheduled like a request of workClass.
+ * Returns false if the work queue is full or not running, in which case func is not run.
+ */
+bool EnqueueHTTPWork(const boost::function<void(void)>& func, const HTTPWorkClass& workClass = HTTPWorkClass());
+
+/** Counters of one priority class of the HTTP work queue */
+struct HTTPWorkClassStats
+{
+    size_t nDepth;          //!< items waiting
+    size_t nMaxDepth;       //!< items that may wait before new ones are rejected
+    int nRunning;           //!< items being run
+    uint64_t nProcessed;    //!< items taken from the queue
+    uint64_t nRejected;     //!< items rejected because the queue was full
+    int64_t nWaitTimeTotal; //!< total time processed items waited, in microseconds
+    int64_t nWaitTimeMax;   //!< longest time an item waited, in microseconds
+
+    HTTPWorkClassStats(): nDepth(0), nMaxDepth(0), nRunning(0), nProcessed(0), nRejected(0), nWaitTimeTotal(0), nWaitTimeMax(0) {}
+};
+
+/** Counters of one endpoint of the HTTP work queue */
+struct HTTPEndpointStats
+{
+    size_t nQueued;      //!< items waiting
+    int nRunning;        //!< items being run
+    int nLimit;          //!< maximum number of items run at once, 0 for no limit
+    uint64_t nProcessed; //!< items taken from the queue
+
+    HTTPEndpointStats(): nQueued(0), nRunning(0), nLimit(0), nProcessed(0) {}
+};
+
+struct HTTPWorkQueueStats
+{
+    int nThreads;
+    HTTPWorkClassStats classes[HTTP_PRIORITY_COUNT];
+    std::map<std::string, HTTPEndpointStats> mapEndpoints;
+
+    HTTPWorkQueueStats(): nThreads(0) {}
+};
+
+/** Get queue depth and wait time counters of the HTTP work queue. Returns false if the server is not running. */
+bool GetHTTPWorkQueueStats(HTTPWorkQueueStats& stats);
+
+/** Name of a priority class as shown to users */
+const char* HTTPPriorityName(HTTPPriority priority);
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -57,6 +129,9 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
+    //! Bytes of a chunked reply the client has not received yet
+    boost::shared_ptr<HTTPReplyBacklog> replyBacklog;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -88,6 +163,12 @@ public:
      */
     std::pair<bool, std::string> GetHeader(const std::string& hdr);
 
+    /**
+     * Whether the client already has the response with entity tag strETag,
+     * according to its If-None-Match header.
+     */
+    bool MatchesETag(const std::string& strETag);
+
     /**
      * Read request body.
      *
@@ -96,6 +177,12 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Copy the request body without consuming it, or return an empty string
+     * if it is larger than nMaxSize.
+     */
+    std::string PeekBody(size_t nMaxSize);
+
     /**
      * Write output header.
      *
@@ -112,8 +199,32 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for bodies that are sent while they are produced.
+     * Write the body with WriteReplyChunk and finish with WriteReplyEnd.
+     *
+     * @note Call this instead of WriteReply, after any WriteHeader.
+     */
+    void WriteReplyStart(int nStatus);
+
+    /**
+     * Send the next piece of a chunked reply. Waits while more than
+     * MAX_HTTP_REPLY_BACKLOG bytes are queued or unsent, so a slow client
+     * slows down the writer instead of filling memory.
+     */
+    void WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a chunked reply. Like WriteReply, this gives the request back to
+     * the main thread, do not call any other HTTPRequest methods after it.
+     */
+    void WriteReplyEnd();
 };
 
+/** Whether an If-None-Match header value lists strETag, using weak comparison */
+bool HTTPETagMatches(const std::string& strIfNoneMatch, const std::string& strETag);
+
 /** Event handler closure.
  */
 class HTTPClosure
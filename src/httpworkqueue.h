@@ -0,0 +1,219 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_HTTPWORKQUEUE_H
+#define BITCOIN_HTTPWORKQUEUE_H
+
+#include "httpserver.h"
+#include "sync.h"
+#include "utiltime.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+
+/** Work queue for distributing work over multiple threads.
+ * Work items are simply callable objects. Every priority class has its own
+ * queue and depth limit, so a backlog of expensive queries does not cause cheap
+ * calls to be rejected. Workers take the oldest runnable item of the most urgent
+ * class. An item is runnable if its endpoint is below its concurrency limit and,
+ * unless it has high priority, if one worker stays free for high priority work.
+ */
+template <typename WorkItem>
+class WorkQueue
+{
+private:
+    struct QueuedItem
+    {
+        WorkItem* item;
+        std::string strEndpoint;
+        int64_t nTimeQueued;
+    };
+
+    /** Mutex protects entire object */
+    CWaitableCriticalSection cs;
+    CConditionVariable cond;
+    /* XXX in C++11 we can use std::unique_ptr here and avoid manual cleanup */
+    std::deque<QueuedItem> queue[HTTP_PRIORITY_COUNT];
+    HTTPWorkClassStats classStats[HTTP_PRIORITY_COUNT];
+    std::map<std::string, HTTPEndpointStats> mapEndpoints;
+    //! Configured endpoint limits, endpoints of low priority default to half the workers
+    std::map<std::string, int> mapEndpointLimits;
+    bool running;
+    int numThreads;
+
+    /** RAII object to keep track of number of running worker threads */
+    class ThreadCounter
+    {
+    public:
+        WorkQueue &wq;
+        ThreadCounter(WorkQueue &w): wq(w)
+        {
+            boost::lock_guard<boost::mutex> lock(wq.cs);
+            wq.numThreads += 1;
+        }
+        ~ThreadCounter()
+        {
+            boost::lock_guard<boost::mutex> lock(wq.cs);
+            wq.numThreads -= 1;
+            wq.cond.notify_all();
+        }
+    };
+
+    int EndpointLimit(int nPriority, const std::string& strEndpoint) const
+    {
+        std::map<std::string, int>::const_iterator it = mapEndpointLimits.find(strEndpoint);
+        if (it != mapEndpointLimits.end())
+            return it->second;
+        if (nPriority == HTTP_PRIORITY_LOW)
+            return std::max(1, numThreads / 2);
+        return 0;
+    }
+
+    /** Take the next runnable item off the queues. cs must be held. */
+    bool Next(QueuedItem& next, int& nPriority)
+    {
+        int nRunningOther = 0;
+        for (int p = HTTP_PRIORITY_NORMAL; p < HTTP_PRIORITY_COUNT; p++)
+            nRunningOther += classStats[p].nRunning;
+        for (int p = 0; p < HTTP_PRIORITY_COUNT; p++) {
+            if (p != HTTP_PRIORITY_HIGH && numThreads > 1 && nRunningOther >= numThreads - 1)
+                break;
+            for (typename std::deque<QueuedItem>::iterator it = queue[p].begin(); it != queue[p].end(); ++it) {
+                if (!it->strEndpoint.empty()) {
+                    HTTPEndpointStats& endpoint = mapEndpoints[it->strEndpoint];
+                    if (endpoint.nLimit > 0 && endpoint.nRunning >= endpoint.nLimit)
+                        continue;
+                    endpoint.nQueued--;
+                    endpoint.nRunning++;
+                    endpoint.nProcessed++;
+                }
+                int64_t nWaitTime = GetTimeMicros() - it->nTimeQueued;
+                HTTPWorkClassStats& stats = classStats[p];
+                stats.nRunning++;
+                stats.nProcessed++;
+                stats.nWaitTimeTotal += nWaitTime;
+                stats.nWaitTimeMax = std::max(stats.nWaitTimeMax, nWaitTime);
+                next = *it;
+                nPriority = p;
+                queue[p].erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    WorkQueue(size_t maxDepth, size_t maxDepthHigh) : running(true),
+                                                      numThreads(0)
+    {
+        for (int p = 0; p < HTTP_PRIORITY_COUNT; p++)
+            classStats[p].nMaxDepth = (p == HTTP_PRIORITY_HIGH ? maxDepthHigh : maxDepth);
+    }
+    /*( Precondition: worker threads have all stopped
+     * (call WaitExit)
+     */
+    ~WorkQueue()
+    {
+        for (int p = 0; p < HTTP_PRIORITY_COUNT; p++) {
+            while (!queue[p].empty()) {
+                delete queue[p].front().item;
+                queue[p].pop_front();
+            }
+        }
+    }
+    /** Limit the number of items of an endpoint that run at once, 0 for no limit */
+    void SetEndpointLimit(const std::string& strEndpoint, int nLimit)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        mapEndpointLimits[strEndpoint] = nLimit;
+    }
+    /** Enqueue a work item */
+    bool Enqueue(WorkItem* item, HTTPPriority priority = HTTP_PRIORITY_NORMAL, const std::string& strEndpoint = "")
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        HTTPWorkClassStats& stats = classStats[priority];
+        if (queue[priority].size() >= stats.nMaxDepth) {
+            stats.nRejected++;
+            return false;
+        }
+        QueuedItem queued;
+        queued.item = item;
+        queued.strEndpoint = strEndpoint;
+        queued.nTimeQueued = GetTimeMicros();
+        queue[priority].push_back(queued);
+        if (!strEndpoint.empty()) {
+            HTTPEndpointStats& endpoint = mapEndpoints[strEndpoint];
+            endpoint.nQueued++;
+            endpoint.nLimit = EndpointLimit(priority, strEndpoint);
+        }
+        cond.notify_one();
+        return true;
+    }
+    /** Thread function */
+    void Run()
+    {
+        ThreadCounter count(*this);
+        while (running) {
+            QueuedItem i;
+            int nPriority;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (running && !Next(i, nPriority))
+                    cond.wait(lock);
+                if (!running)
+                    break;
+            }
+            (*i.item)();
+            delete i.item;
+            {
+                // Whatever this frees up is picked up by this thread on its next round
+                boost::unique_lock<boost::mutex> lock(cs);
+                classStats[nPriority].nRunning--;
+                if (!i.strEndpoint.empty())
+                    mapEndpoints[i.strEndpoint].nRunning--;
+            }
+        }
+    }
+    /** Interrupt and exit loops */
+    void Interrupt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        running = false;
+        cond.notify_all();
+    }
+    /** Wait for worker threads to exit */
+    void WaitExit()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (numThreads > 0){
+            cond.wait(lock);
+        }
+    }
+
+    /** Return current depth of queue */
+    size_t Depth()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        size_t nDepth = 0;
+        for (int p = 0; p < HTTP_PRIORITY_COUNT; p++)
+            nDepth += queue[p].size();
+        return nDepth;
+    }
+
+    /** Copy out the queue counters */
+    void GetStats(HTTPWorkQueueStats& stats)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        stats.nThreads = numThreads;
+        for (int p = 0; p < HTTP_PRIORITY_COUNT; p++) {
+            stats.classes[p] = classStats[p];
+            stats.classes[p].nDepth = queue[p].size();
+        }
+        stats.mapEndpoints = mapEndpoints;
+    }
+};
+
+#endif // BITCOIN_HTTPWORKQUEUE_H
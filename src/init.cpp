@@ -12,6 +12,7 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "binaryrpc.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -25,6 +26,7 @@
 #include "net.h"
 #include "netfulfilledman.h"
 #include "policy/policy.h"
+#include "responsecache.h"
 #include "rpcserver.h"
 #include "script/standard.h"
 #include "script/sigcache.h"
@@ -79,6 +81,7 @@
 
 #if ENABLE_ZMQ
 #include "zmq/zmqnotificationinterface.h"
+#include "zmq/zmqpublishnotifier.h"
 #endif
 
 using namespace std;
@@ -179,6 +182,16 @@ public:
             abort();
         }
     }
+    void GetCoinsBatch(const std::vector<uint256> &vTxid, std::vector<CCoins> &vCoins, std::vector<bool> &vFound) const {
+        try {
+            CCoinsViewBacked::GetCoinsBatch(vTxid, vCoins, vFound);
+        } catch(const std::runtime_error& e) {
+            uiInterface.ThreadSafeMessageBox(_("Error reading from database, shutting down."), "", CClientUIInterface::MSG_ERROR);
+            LogPrintf("Error reading from database: %s\n", e.what());
+            // Same as above, a missing entry must not be mistaken for a read error
+            abort();
+        }
+    }
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
@@ -190,6 +203,7 @@ void Interrupt(boost::thread_group& threadGroup)
 {
     InterruptHTTPServer();
     InterruptHTTPRPC();
+    InterruptBinaryRPC();
     InterruptRPC();
     InterruptREST();
     InterruptTorControl();
@@ -215,6 +229,7 @@ void PrepareShutdown()
     mempool.AddTransactionsUpdated(1);
     StopHTTPRPC();
     StopREST();
+    StopBinaryRPC();
     StopRPC();
     StopHTTPServer();
 #ifdef ENABLE_WALLET
@@ -494,12 +509,22 @@ std::string HelpMessage(HelpMessageMode mode)
 
 #if ENABLE_ZMQ
     strUsage += HelpMessageGroup(_("ZeroMQ notification options:"));
+    strUsage += HelpMessageOpt("-zmqpubblocktemplateraw=<address>", _("Enable publish raw block template (requires -precomputetemplate) in <address>"));
     strUsage += HelpMessageOpt("-zmqpubhashblock=<address>", _("Enable publish hash block in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashgovernanceobject=<address>", _("Enable publish hash of governance objects in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashgovernancevote=<address>", _("Enable publish hash of governance votes in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashpaymentvote=<address>", _("Enable publish hash of masternode payment votes in <address>"));
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubhashtxlock=<address>", _("Enable publish hash transaction (locked via InstantSend) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubmasternodestate=<address>", _("Enable publish masternode list changes in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawgovernanceobject=<address>", _("Enable publish raw governance objects in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawgovernancevote=<address>", _("Enable publish raw governance votes in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawpaymentvote=<address>", _("Enable publish raw masternode payment votes in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via InstantSend) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubtxlocktiming=<address>", _("Enable publish hash and lock latency of transaction (locked via InstantSend) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubqueuesize=<n>", strprintf(_("Maximum number of notifications waiting to be published, more are dropped (default: %u)"), DEFAULT_ZMQ_PUB_QUEUE_SIZE));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -595,10 +620,12 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blockprioritysize=<n>", strprintf(_("Set maximum size of high-priority/low-fee transactions in bytes (default: %d)"), DEFAULT_BLOCK_PRIORITY_SIZE));
     if (showDebug)
         strUsage += HelpMessageOpt("-blockversion=<n>", "Override block version to test forking scenarios");
+    strUsage += HelpMessageOpt("-precomputetemplate", strprintf(_("Keep a block template for the current tip ready and push an empty-block template to getblocktemplate long-poll waiters as soon as a new block arrives (default: %u)"), DEFAULT_PRECOMPUTE_TEMPLATE));
 
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
     strUsage += HelpMessageOpt("-rest", strprintf(_("Accept public REST requests (default: %u)"), DEFAULT_REST_ENABLE));
+    strUsage += HelpMessageOpt("-restcachesize=<n>", strprintf(_("Maximum size of the cache for REST and RPC responses about blocks at least %d deep in the chain in megabytes, 0 to disable (default: %u)"), REST_CACHE_MIN_DEPTH, DEFAULT_REST_CACHE_SIZE));
     strUsage += HelpMessageOpt("-rpcbind=<addr>", _("Bind to given address to listen for JSON-RPC connections. Use [host]:port notation for IPv6. This option can be specified multiple times (default: bind to all interfaces)"));
     strUsage += HelpMessageOpt("-rpccookiefile=<loc>", _("Location of the auth cookie (default: data dir)"));
     strUsage += HelpMessageOpt("-rpcuser=<user>", _("Username for JSON-RPC connections"));
@@ -606,9 +633,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcauth=<userpw>", _("Username and hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcuser. This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), BaseParams(CBaseChainParams::MAIN).RPCPort(), BaseParams(CBaseChainParams::TESTNET).RPCPort()));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
+    strUsage += HelpMessageOpt("-rpcendpointlimit=<endpoint>:<n>", _("Serve at most <n> requests for an RPC method or REST path at the same time, 0 for no limit (default: half of -rpcthreads for expensive queries, no limit otherwise). This option can be specified multiple times"));
+    strUsage += HelpMessageOpt("-rpcbatchconcurrency=<n>", strprintf(_("Run up to <n> read-only calls of a JSON-RPC batch request at the same time (default: %d)"), DEFAULT_RPC_BATCH_CONCURRENCY));
+    strUsage += HelpMessageOpt("-rpcmaxaddressresults=<n>", strprintf(_("Maximum number of entries returned by one address index RPC call, larger results must be paged with \"limit\" and \"cursor\" (default: %u)"), DEFAULT_RPC_MAX_ADDRESS_RESULTS));
+    strUsage += HelpMessageOpt("-rpcsocket[=<path>]", strprintf(_("Also accept RPC calls in binary frames on a local UNIX socket, relative paths are in the data directory (default path: %s)"), "rpc.sock"));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
     if (showDebug) {
-        strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
+        strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls, per priority class (default: %d)", DEFAULT_HTTP_WORKQUEUE));
+        strUsage += HelpMessageOpt("-rpchighworkqueue=<n>", strprintf("Set the depth of the work queue for cheap status and control calls (default: %d)", DEFAULT_HTTP_HIGH_PRIORITY_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
     }
 
@@ -780,12 +812,15 @@ bool AppInitServers(boost::thread_group& threadGroup)
     RPCServer::OnPreCommand(&OnRPCPreCommand);
     if (!InitHTTPServer())
         return false;
+    responseCache.SetMaxBytes(std::max(GetArg("-restcachesize", DEFAULT_REST_CACHE_SIZE), (int64_t)0) << 20);
     if (!StartRPC())
         return false;
     if (!StartHTTPRPC())
         return false;
     if (GetBoolArg("-rest", DEFAULT_REST_ENABLE) && !StartREST())
         return false;
+    if (IsBinaryRPCEnabled() && !StartBinaryRPC())
+        return false;
     if (!StartHTTPServer())
         return false;
     return true;
@@ -1953,6 +1988,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     //scheduler.scheduleEvery(f, nPowTargetSpacing);
     // --- end disabled ---
 
+    // Keep getblocktemplate results ready in the background
+    if (GetBoolArg("-precomputetemplate", DEFAULT_PRECOMPUTE_TEMPLATE)) {
+        blockTemplateCache.SetEnabled(true);
+        RegisterValidationInterface(&blockTemplateCache);
+        threadGroup.create_thread(boost::bind(&ThreadBlockTemplateCache, boost::cref(chainparams)));
+    }
+
     // Generate coins in the background
     GenerateBitcoins(GetBoolArg("-gen", DEFAULT_GENERATE), GetArg("-genproclimit", DEFAULT_GENERATE_THREADS), chainparams);
 
@@ -57,12 +57,21 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
         CTxLockVote vote;
         vRecv >> vote;
 
-        LOCK2(cs_main, cs_instantsend);
-
         uint256 nVoteHash = vote.GetHash();
 
-        if(mapTxLockVotes.count(nVoteHash)) return;
-        mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        {
+            LOCK(cs_instantsend);
+            if(mapTxLockVotes.count(nVoteHash)) return;
+            mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        }
+
+        // Masternode rank lookup and signature verification are the expensive part,
+        // do them without holding cs_main or cs_instantsend
+        if(!vote.IsValid(pfrom)) {
+            // could be because of missing MN
+            LogPrint("instantsend", "CInstantSend::ProcessMessage -- Vote is invalid, txid=%s\n", vote.GetTxHash().ToString());
+            return;
+        }
 
         ProcessTxLockVote(pfrom, vote);
 
@@ -72,53 +81,56 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
 
 bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest)
 {
-    LOCK2(cs_main, cs_instantsend);
-
     uint256 txHash = txLockRequest.GetHash();
 
-    // Check to see if we conflict with existing completed lock,
-    // fail if so, there can't be 2 completed locks for the same outpoint
-    BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(txin.prevout);
-        if(it != mapLockedOutpoints.end()) {
-            // Conflicting with complete lock, ignore this one
-            // (this could be the one we have but we don't want to try to lock it twice anyway)
-            LogPrintf("CInstantSend::ProcessTxLockRequest -- WARNING: Found conflicting completed Transaction Lock, skipping current one, txid=%s, completed lock txid=%s\n",
-                    txLockRequest.GetHash().ToString(), it->second.ToString());
-            return false;
+    {
+        LOCK2(cs_main, cs_instantsend);
+
+        // Check to see if we conflict with existing completed lock,
+        // fail if so, there can't be 2 completed locks for the same outpoint
+        BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
+            std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(txin.prevout);
+            if(it != mapLockedOutpoints.end()) {
+                // Conflicting with complete lock, ignore this one
+                // (this could be the one we have but we don't want to try to lock it twice anyway)
+                LogPrintf("CInstantSend::ProcessTxLockRequest -- WARNING: Found conflicting completed Transaction Lock, skipping current one, txid=%s, completed lock txid=%s\n",
+                        txLockRequest.GetHash().ToString(), it->second.ToString());
+                return false;
+            }
         }
-    }
 
-    // Check to see if there are votes for conflicting request,
-    // if so - do not fail, just warn user
-    BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        std::map<COutPoint, std::set<uint256> >::iterator it = mapVotedOutpoints.find(txin.prevout);
-        if(it != mapVotedOutpoints.end()) {
-            BOOST_FOREACH(const uint256& hash, it->second) {
-                if(hash != txLockRequest.GetHash()) {
-                    LogPrint("instantsend", "CInstantSend::ProcessTxLockRequest -- Double spend attempt! %s\n", txin.prevout.ToStringShort());
-                    // do not fail here, let it go and see which one will get the votes to be locked
+        // Check to see if there are votes for conflicting request,
+        // if so - do not fail, just warn user
+        BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
+            std::map<COutPoint, std::set<uint256> >::iterator it = mapVotedOutpoints.find(txin.prevout);
+            if(it != mapVotedOutpoints.end()) {
+                BOOST_FOREACH(const uint256& hash, it->second) {
+                    if(hash != txLockRequest.GetHash()) {
+                        LogPrint("instantsend", "CInstantSend::ProcessTxLockRequest -- Double spend attempt! %s\n", txin.prevout.ToStringShort());
+                        // do not fail here, let it go and see which one will get the votes to be locked
+                    }
                 }
             }
         }
-    }
 
-    if(!CreateTxLockCandidate(txLockRequest)) {
-        // smth is not right
-        LogPrintf("CInstantSend::ProcessTxLockRequest -- CreateTxLockCandidate failed, txid=%s\n", txHash.ToString());
-        return false;
+        if(!CreateTxLockCandidate(txLockRequest)) {
+            // smth is not right
+            LogPrintf("CInstantSend::ProcessTxLockRequest -- CreateTxLockCandidate failed, txid=%s\n", txHash.ToString());
+            return false;
+        }
+        LogPrintf("CInstantSend::ProcessTxLockRequest -- accepted, txid=%s\n", txHash.ToString());
     }
-    LogPrintf("CInstantSend::ProcessTxLockRequest -- accepted, txid=%s\n", txHash.ToString());
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-    CTxLockCandidate& txLockCandidate = itLockCandidate->second;
-    Vote(txLockCandidate);
-    ProcessOrphanTxLockVotes();
+    // Signing our own votes doesn't need cs_main
+    Vote(txHash);
+
+    LOCK2(cs_main, cs_instantsend);
+    ProcessOrphanTxLockVotes(txHash);
 
     // Masternodes will sometimes propagate votes before the transaction is known to the client.
     // If this just happened - lock inputs, resolve conflicting locks, update transaction status
     // forcing external script notification.
-    TryToFinalizeLockCandidate(txLockCandidate);
+    TryToFinalizeLockCandidate(txHash);
 
     return true;
 }
@@ -149,21 +161,45 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
     return true;
 }
 
-void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
+bool CInstantSend::HasVotedForOutpoint(const COutPoint& outpoint, const COutPoint& outpointMasternode)
+{
+    AssertLockHeld(cs_instantsend);
+    std::map<COutPoint, std::set<uint256> >::iterator itVoted = mapVotedOutpoints.find(outpoint);
+    if(itVoted == mapVotedOutpoints.end()) return false;
+    BOOST_FOREACH(const uint256& hash, itVoted->second) {
+        std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(hash);
+        if(it != mapTxLockCandidates.end() && it->second.HasMasternodeVoted(outpoint, outpointMasternode)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CInstantSend::Vote(const uint256& txHash)
 {
     if(!fMasterNode) return;
 
-    LOCK2(cs_main, cs_instantsend);
+    // Rank lookups and signing are done without holding any lock, only the
+    // outpoints are read and the votes are stored under cs_instantsend
+    std::vector<COutPoint> vOutpoints;
+    {
+        LOCK(cs_instantsend);
+        std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+        if(itLockCandidate == mapTxLockCandidates.end()) return;
+        std::map<COutPoint, COutPointLock>::iterator itOutpointLock = itLockCandidate->second.mapOutPointLocks.begin();
+        while(itOutpointLock != itLockCandidate->second.mapOutPointLocks.end()) {
+            vOutpoints.push_back(itOutpointLock->first);
+            ++itOutpointLock;
+        }
+    }
 
-    uint256 txHash = txLockCandidate.GetHash();
     // check if we need to vote on this candidate's outpoints,
     // it's possible that we need to vote for several of them
-    std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
-    while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
+    BOOST_FOREACH(const COutPoint& outpoint, vOutpoints) {
 
-        int nPrevoutHeight = GetUTXOHeight(itOutpointLock->first);
+        int nPrevoutHeight = GetUTXOHeight(outpoint);
         if(nPrevoutHeight == -1) {
-            LogPrint("instantsend", "CInstantSend::Vote -- Failed to find UTXO %s\n", itOutpointLock->first.ToStringShort());
+            LogPrint("instantsend", "CInstantSend::Vote -- Failed to find UTXO %s\n", outpoint.ToStringShort());
             return;
         }
 
@@ -173,44 +209,32 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
 
         if(n == -1) {
             LogPrint("instantsend", "CInstantSend::Vote -- Unknown Masternode %s\n", activeMasternode.vin.prevout.ToStringShort());
-            ++itOutpointLock;
             continue;
         }
 
         int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
         if(n > nSignaturesTotal) {
             LogPrint("instantsend", "CInstantSend::Vote -- Masternode not in the top %d (%d)\n", nSignaturesTotal, n);
-            ++itOutpointLock;
             continue;
         }
 
         LogPrint("instantsend", "CInstantSend::Vote -- In the top %d (%d)\n", nSignaturesTotal, n);
 
-        std::map<COutPoint, std::set<uint256> >::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
-
         // Check to see if we already voted for this outpoint,
         // refuse to vote twice or to include the same outpoint in another tx
-        bool fAlreadyVoted = false;
-        if(itVoted != mapVotedOutpoints.end()) {
-            BOOST_FOREACH(const uint256& hash, itVoted->second) {
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
-                if(it2->second.HasMasternodeVoted(itOutpointLock->first, activeMasternode.vin.prevout)) {
-                    // we already voted for this outpoint to be included either in the same tx or in a competing one,
-                    // skip it anyway
-                    fAlreadyVoted = true;
-                    LogPrintf("CInstantSend::Vote -- WARNING: We already voted for this outpoint, skipping: txHash=%s, outpoint=%s\n",
-                            txHash.ToString(), itOutpointLock->first.ToStringShort());
-                    break;
-                }
+        {
+            LOCK(cs_instantsend);
+            if(HasVotedForOutpoint(outpoint, activeMasternode.vin.prevout)) {
+                // we already voted for this outpoint to be included either in the same tx or in a competing one,
+                // skip it anyway
+                LogPrintf("CInstantSend::Vote -- WARNING: We already voted for this outpoint, skipping: txHash=%s, outpoint=%s\n",
+                        txHash.ToString(), outpoint.ToStringShort());
+                continue; // skip to the next outpoint
             }
         }
-        if(fAlreadyVoted) {
-            ++itOutpointLock;
-            continue; // skip to the next outpoint
-        }
 
         // we haven't voted for this outpoint yet, let's try to do this now
-        CTxLockVote vote(txHash, itOutpointLock->first, activeMasternode.vin.prevout);
+        CTxLockVote vote(txHash, outpoint, activeMasternode.vin.prevout);
 
         if(!vote.Sign()) {
             LogPrintf("CInstantSend::Vote -- Failed to sign consensus vote\n");
@@ -222,157 +246,234 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
         }
 
         // vote constructed sucessfully, let's store and relay it
+        LOCK(cs_instantsend);
+        std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+        if(itLockCandidate == mapTxLockCandidates.end()) return; // removed while we were signing
+        // a vote for a competing request could have been created while we were signing
+        if(HasVotedForOutpoint(outpoint, activeMasternode.vin.prevout)) {
+            LogPrintf("CInstantSend::Vote -- WARNING: We already voted for this outpoint, skipping: txHash=%s, outpoint=%s\n",
+                    txHash.ToString(), outpoint.ToStringShort());
+            continue;
+        }
+        std::map<COutPoint, COutPointLock>::iterator itOutpointLock = itLockCandidate->second.mapOutPointLocks.find(outpoint);
+        if(itOutpointLock == itLockCandidate->second.mapOutPointLocks.end()) continue;
+
         uint256 nVoteHash = vote.GetHash();
         mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
         if(itOutpointLock->second.AddVote(vote)) {
+            // our own vote counts for the lock latency like any other
+            itLockCandidate->second.RecordVoteTime(vote, false);
             LogPrintf("CInstantSend::Vote -- Vote created successfully, relaying: txHash=%s, outpoint=%s, vote=%s\n",
-                    txHash.ToString(), itOutpointLock->first.ToStringShort(), nVoteHash.ToString());
-
-            if(itVoted == mapVotedOutpoints.end()) {
-                std::set<uint256> setHashes;
-                setHashes.insert(txHash);
-                mapVotedOutpoints.insert(std::make_pair(itOutpointLock->first, setHashes));
-            } else {
-                mapVotedOutpoints[itOutpointLock->first].insert(txHash);
-                if(mapVotedOutpoints[itOutpointLock->first].size() > 1) {
-                    // it's ok to continue, just warn user
-                    LogPrintf("CInstantSend::Vote -- WARNING: Vote conflicts with some existing votes: txHash=%s, outpoint=%s, vote=%s\n",
-                            txHash.ToString(), itOutpointLock->first.ToStringShort(), nVoteHash.ToString());
-                }
+                    txHash.ToString(), outpoint.ToStringShort(), nVoteHash.ToString());
+
+            std::set<uint256>& setHashes = mapVotedOutpoints[outpoint];
+            setHashes.insert(txHash);
+            if(setHashes.size() > 1) {
+                // it's ok to continue, just warn user
+                LogPrintf("CInstantSend::Vote -- WARNING: Vote conflicts with some existing votes: txHash=%s, outpoint=%s, vote=%s\n",
+                        txHash.ToString(), outpoint.ToStringShort(), nVoteHash.ToString());
             }
 
             vote.Relay();
         }
-
-        ++itOutpointLock;
     }
 }
 
-//received a consensus vote
+//received a consensus vote, already validated by the caller
 bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
 {
-    LOCK2(cs_main, cs_instantsend);
-
     uint256 txHash = vote.GetTxHash();
+    bool fReady = false;
+    bool fReprocessRequest = false;
+    CTxLockRequest txLockRequestToReprocess;
 
-    if(!vote.IsValid(pfrom)) {
-        // could be because of missing MN
-        LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Vote is invalid, txid=%s\n", txHash.ToString());
-        return false;
-    }
+    {
+        LOCK(cs_instantsend);
 
-    // Masternodes will sometimes propagate votes before the transaction is known to the client,
-    // will actually process only after the lock request itself has arrived
+        // Masternodes will sometimes propagate votes before the transaction is known to the client,
+        // will actually process only after the lock request itself has arrived
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
-    if(it == mapTxLockCandidates.end()) {
-        if(!mapTxLockVotesOrphan.count(vote.GetHash())) {
-            mapTxLockVotesOrphan[vote.GetHash()] = vote;
-            LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  masternode=%s new\n",
-                    txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
-            bool fReprocess = true;
-            std::map<uint256, CTxLockRequest>::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
-            if(itLockRequest == mapLockRequestAccepted.end()) {
-                itLockRequest = mapLockRequestRejected.find(txHash);
-                if(itLockRequest == mapLockRequestRejected.end()) {
-                    // still too early, wait for tx lock request
-                    fReprocess = false;
+        std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+        if(it == mapTxLockCandidates.end()) {
+            if(!mapTxLockVotesOrphan.count(vote.GetHash())) {
+                AddOrphanVote(vote);
+                LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  masternode=%s new\n",
+                        txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
+                bool fReprocess = true;
+                std::map<uint256, CTxLockRequest>::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
+                if(itLockRequest == mapLockRequestAccepted.end()) {
+                    itLockRequest = mapLockRequestRejected.find(txHash);
+                    if(itLockRequest == mapLockRequestRejected.end()) {
+                        // still too early, wait for tx lock request
+                        fReprocess = false;
+                    }
                 }
+                if(fReprocess && IsEnoughOrphanVotesForTx(itLockRequest->second)) {
+                    // We have enough votes for corresponding lock to complete,
+                    // tx lock request should already be received at this stage.
+                    LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Found enough orphan votes, reprocessing Transaction Lock Request: txid=%s\n", txHash.ToString());
+                    fReprocessRequest = true;
+                    txLockRequestToReprocess = itLockRequest->second;
+                }
+            } else {
+                LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  masternode=%s seen\n",
+                        txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
             }
-            if(fReprocess && IsEnoughOrphanVotesForTx(itLockRequest->second)) {
-                // We have enough votes for corresponding lock to complete,
-                // tx lock request should already be received at this stage.
-                LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Found enough orphan votes, reprocessing Transaction Lock Request: txid=%s\n", txHash.ToString());
-                ProcessTxLockRequest(itLockRequest->second);
-                return true;
-            }
-        } else {
-            LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  masternode=%s seen\n",
-                    txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
-        }
 
-        // This tracks those messages and allows only the same rate as of the rest of the network
-        // TODO: make sure this works good enough for multi-quorum
+            // This tracks those messages and allows only the same rate as of the rest of the network
+            // TODO: make sure this works good enough for multi-quorum
 
-        int nMasternodeOrphanExpireTime = GetTime() + 60*10; // keep time data for 10 minutes
-        if(!mapMasternodeOrphanVotes.count(vote.GetMasternodeOutpoint())) {
-            mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
-        } else {
-            int64_t nPrevOrphanVote = mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()];
-            if(nPrevOrphanVote > GetTime() && nPrevOrphanVote > GetAverageMasternodeOrphanVoteTime()) {
-                LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- masternode is spamming orphan Transaction Lock Votes: txid=%s  masternode=%s\n",
-                        txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
-                // Misbehaving(pfrom->id, 1);
-                return false;
+            int nMasternodeOrphanExpireTime = GetTime() + 60*10; // keep time data for 10 minutes
+            if(!mapMasternodeOrphanVotes.count(vote.GetMasternodeOutpoint())) {
+                mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
+            } else {
+                int64_t nPrevOrphanVote = mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()];
+                if(nPrevOrphanVote > GetTime() && nPrevOrphanVote > GetAverageMasternodeOrphanVoteTime()) {
+                    LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- masternode is spamming orphan Transaction Lock Votes: txid=%s  masternode=%s\n",
+                            txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
+                    // Misbehaving(pfrom->id, 1);
+                    return false;
+                }
+                // not spamming, refresh
+                mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
             }
-            // not spamming, refresh
-            mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
+
+            if(!fReprocessRequest) return true;
         }
+    }
 
+    if(fReprocessRequest) {
+        ProcessTxLockRequest(txLockRequestToReprocess);
         return true;
     }
 
-    LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Transaction Lock Vote, txid=%s\n", txHash.ToString());
-
-    std::map<COutPoint, std::set<uint256> >::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
-    if(it1 != mapVotedOutpoints.end()) {
-        BOOST_FOREACH(const uint256& hash, it1->second) {
-            if(hash != txHash) {
-                // same outpoint was already voted to be locked by another tx lock request,
-                // find out if the same mn voted on this outpoint before
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
-                if(it2->second.HasMasternodeVoted(vote.GetOutpoint(), vote.GetMasternodeOutpoint())) {
-                    // yes, it did, refuse to accept a vote to include the same outpoint in another tx
-                    // from the same masternode.
-                    // TODO: apply pose ban score to this masternode?
-                    // NOTE: if we decide to apply pose ban score here, this vote must be relayed further
-                    // to let all other nodes know about this node's misbehaviour and let them apply
-                    // pose ban score too.
-                    LogPrintf("CInstantSend::ProcessTxLockVote -- masternode sent conflicting votes! %s\n", vote.GetMasternodeOutpoint().ToStringShort());
-                    return false;
+    {
+        LOCK(cs_instantsend);
+
+        std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+        if(it == mapTxLockCandidates.end()) return false;
+
+        LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Transaction Lock Vote, txid=%s\n", txHash.ToString());
+
+        std::map<COutPoint, std::set<uint256> >::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
+        if(it1 != mapVotedOutpoints.end()) {
+            BOOST_FOREACH(const uint256& hash, it1->second) {
+                if(hash != txHash) {
+                    // same outpoint was already voted to be locked by another tx lock request,
+                    // find out if the same mn voted on this outpoint before
+                    std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                    if(it2->second.HasMasternodeVoted(vote.GetOutpoint(), vote.GetMasternodeOutpoint())) {
+                        // yes, it did, refuse to accept a vote to include the same outpoint in another tx
+                        // from the same masternode.
+                        // TODO: apply pose ban score to this masternode?
+                        // NOTE: if we decide to apply pose ban score here, this vote must be relayed further
+                        // to let all other nodes know about this node's misbehaviour and let them apply
+                        // pose ban score too.
+                        LogPrintf("CInstantSend::ProcessTxLockVote -- masternode sent conflicting votes! %s\n", vote.GetMasternodeOutpoint().ToStringShort());
+                        return false;
+                    }
                 }
             }
+            // we have votes by other masternodes only (so far), let's continue and see who will win
+            it1->second.insert(txHash);
+        } else {
+            std::set<uint256> setHashes;
+            setHashes.insert(txHash);
+            mapVotedOutpoints.insert(std::make_pair(vote.GetOutpoint(), setHashes));
         }
-        // we have votes by other masternodes only (so far), let's continue and see who will win
-        it1->second.insert(txHash);
-    } else {
-        std::set<uint256> setHashes;
-        setHashes.insert(txHash);
-        mapVotedOutpoints.insert(std::make_pair(vote.GetOutpoint(), setHashes));
-    }
 
-    CTxLockCandidate& txLockCandidate = it->second;
+        CTxLockCandidate& txLockCandidate = it->second;
 
-    if(!txLockCandidate.AddVote(vote)) {
-        // this should never happen
-        return false;
-    }
+        if(!txLockCandidate.AddVote(vote)) {
+            // this should never happen
+            return false;
+        }
 
-    int nSignatures = txLockCandidate.CountVotes();
-    int nSignaturesMax = txLockCandidate.txLockRequest.GetMaxSignatures();
-    LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Transaction Lock signatures count: %d/%d, vote hash=%s\n",
-            nSignatures, nSignaturesMax, vote.GetHash().ToString());
+        // orphan votes are still in mapTxLockVotesOrphan while ProcessOrphanTxLockVotes processes them
+        bool fOrphan = mapTxLockVotesOrphan.count(vote.GetHash());
+        txLockCandidate.RecordVoteTime(vote, fOrphan);
+        if(fOrphan) latencyStats.nOrphanVotes++;
 
-    TryToFinalizeLockCandidate(txLockCandidate);
+        int nSignatures = txLockCandidate.CountVotes();
+        int nSignaturesMax = txLockCandidate.txLockRequest.GetMaxSignatures();
+        LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Transaction Lock signatures count: %d/%d, vote hash=%s\n",
+                nSignatures, nSignaturesMax, vote.GetHash().ToString());
+
+        fReady = txLockCandidate.IsAllOutPointsReady();
+        if(fReady) txLockCandidate.SetTimeReady(GetTimeMicros());
+    }
+
+    // Only the lock commit needs cs_main
+    if(fReady) {
+        TryToFinalizeLockCandidate(txHash);
+    }
 
     vote.Relay();
 
     return true;
 }
 
-void CInstantSend::ProcessOrphanTxLockVotes()
+void CInstantSend::ProcessOrphanTxLockVotes(const uint256& txHash)
 {
     LOCK2(cs_main, cs_instantsend);
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
+
+    std::map<uint256, std::map<COutPoint, std::set<uint256> > >::iterator itByTx = mapTxLockVotesOrphanByTx.find(txHash);
+    if(itByTx == mapTxLockVotesOrphanByTx.end()) return;
+
+    // processing votes can modify the index, collect vote hashes first
+    std::vector<uint256> vecVoteHashes;
+    std::map<COutPoint, std::set<uint256> >::iterator itOutpoint = itByTx->second.begin();
+    while(itOutpoint != itByTx->second.end()) {
+        vecVoteHashes.insert(vecVoteHashes.end(), itOutpoint->second.begin(), itOutpoint->second.end());
+        ++itOutpoint;
+    }
+
+    BOOST_FOREACH(const uint256& hashVote, vecVoteHashes) {
+        std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.find(hashVote);
+        if(it == mapTxLockVotesOrphan.end()) continue;
         if(ProcessTxLockVote(NULL, it->second)) {
-            mapTxLockVotesOrphan.erase(it++);
-        } else {
-            ++it;
+            RemoveOrphanVote(hashVote);
         }
     }
 }
 
+void CInstantSend::AddOrphanVote(const CTxLockVote& vote)
+{
+    AssertLockHeld(cs_instantsend);
+
+    uint256 hashVote = vote.GetHash();
+    if(!mapTxLockVotesOrphan.insert(std::make_pair(hashVote, vote)).second) return;
+    mapTxLockVotesOrphanByTx[vote.GetTxHash()][vote.GetOutpoint()].insert(hashVote);
+    mapTxLockVotesOrphanExpiry[vote.GetTimeCreated() + ORPHAN_VOTE_SECONDS].insert(hashVote);
+}
+
+void CInstantSend::RemoveOrphanVote(const uint256& hashVote)
+{
+    AssertLockHeld(cs_instantsend);
+
+    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.find(hashVote);
+    if(it == mapTxLockVotesOrphan.end()) return;
+    const CTxLockVote& vote = it->second;
+
+    std::map<uint256, std::map<COutPoint, std::set<uint256> > >::iterator itByTx = mapTxLockVotesOrphanByTx.find(vote.GetTxHash());
+    if(itByTx != mapTxLockVotesOrphanByTx.end()) {
+        std::map<COutPoint, std::set<uint256> >::iterator itOutpoint = itByTx->second.find(vote.GetOutpoint());
+        if(itOutpoint != itByTx->second.end()) {
+            itOutpoint->second.erase(hashVote);
+            if(itOutpoint->second.empty()) itByTx->second.erase(itOutpoint);
+        }
+        if(itByTx->second.empty()) mapTxLockVotesOrphanByTx.erase(itByTx);
+    }
+
+    std::map<int64_t, std::set<uint256> >::iterator itExpiry = mapTxLockVotesOrphanExpiry.find(vote.GetTimeCreated() + ORPHAN_VOTE_SECONDS);
+    if(itExpiry != mapTxLockVotesOrphanExpiry.end()) {
+        itExpiry->second.erase(hashVote);
+        if(itExpiry->second.empty()) mapTxLockVotesOrphanExpiry.erase(itExpiry);
+    }
+
+    mapTxLockVotesOrphan.erase(it);
+}
+
 bool CInstantSend::IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest)
 {
     // There could be a situation when we already have quite a lot of votes
@@ -388,32 +489,37 @@ bool CInstantSend::IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest)
 
 bool CInstantSend::IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, const COutPoint& outpoint)
 {
-    // Scan orphan votes to check if this outpoint has enough orphan votes to be locked in some tx.
-    LOCK2(cs_main, cs_instantsend);
-    int nCountVotes = 0;
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(it->second.GetTxHash() == txHash && it->second.GetOutpoint() == outpoint) {
-            nCountVotes++;
-            if(nCountVotes >= COutPointLock::SIGNATURES_REQUIRED) {
-                return true;
-            }
-        }
-        ++it;
-    }
-    return false;
+    // Check if this outpoint has enough orphan votes to be locked in some tx.
+    LOCK(cs_instantsend);
+    std::map<uint256, std::map<COutPoint, std::set<uint256> > >::iterator itByTx = mapTxLockVotesOrphanByTx.find(txHash);
+    if(itByTx == mapTxLockVotesOrphanByTx.end()) return false;
+    std::map<COutPoint, std::set<uint256> >::iterator itOutpoint = itByTx->second.find(outpoint);
+    return itOutpoint != itByTx->second.end() && (int)itOutpoint->second.size() >= COutPointLock::SIGNATURES_REQUIRED;
 }
 
-void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate)
+void CInstantSend::TryToFinalizeLockCandidate(const uint256& txHash)
 {
     LOCK2(cs_main, cs_instantsend);
 
-    uint256 txHash = txLockCandidate.txLockRequest.GetHash();
+    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    if(itLockCandidate == mapTxLockCandidates.end()) return;
+    CTxLockCandidate& txLockCandidate = itLockCandidate->second;
+
     if(txLockCandidate.IsAllOutPointsReady() && !IsLockedInstantSendTransaction(txHash)) {
         // we have enough votes now
         LogPrint("instantsend", "CInstantSend::TryToFinalizeLockCandidate -- Transaction Lock is ready to complete, txid=%s\n", txHash.ToString());
         if(ResolveConflicts(txLockCandidate, Params().GetConsensus().nInstantSendKeepLock)) {
             LockTransactionInputs(txLockCandidate);
+            txLockCandidate.SetTimeLocked(GetTimeMicros());
+            CTxLockTimes times = txLockCandidate.GetTimes();
+            latencyStats.firstVote.Add(times.GetFirstVoteLatency());
+            latencyStats.quorum.Add(times.GetQuorumLatency());
+            latencyStats.finalize.Add(times.GetFinalizeLatency());
+            latencyStats.total.Add(times.GetTotalLatency());
+            LogPrint("instantsend", "CInstantSend::TryToFinalizeLockCandidate -- locked in %.2fms (first vote %.2fms, quorum %.2fms, finalize %.2fms, orphan votes %d), txid=%s\n",
+                    times.GetTotalLatency() * 0.001, times.GetFirstVoteLatency() * 0.001,
+                    times.GetQuorumLatency() * 0.001, times.GetFinalizeLatency() * 0.001,
+                    times.nOrphanVotes, txHash.ToString());
             UpdateLockedTransaction(txLockCandidate);
         }
     }
@@ -617,17 +723,22 @@ void CInstantSend::CheckAndRemove()
         }
     }
 
-    // remove expired orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(GetTime() - itOrphanVote->second.GetTimeCreated() > ORPHAN_VOTE_SECONDS) {
-            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan vote: txid=%s  masternode=%s\n",
-                    itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
-        } else {
-            ++itOrphanVote;
+    // remove expired orphan votes, oldest expiration buckets first
+    int64_t nNow = GetTime();
+    while(!mapTxLockVotesOrphanExpiry.empty() && mapTxLockVotesOrphanExpiry.begin()->first < nNow) {
+        // RemoveOrphanVote erases the bucket once it is empty
+        std::set<uint256> setExpired = mapTxLockVotesOrphanExpiry.begin()->second;
+        BOOST_FOREACH(const uint256& hashVote, setExpired) {
+            std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.find(hashVote);
+            if(itOrphanVote != mapTxLockVotesOrphan.end()) {
+                LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan vote: txid=%s  masternode=%s\n",
+                        itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
+            }
+            mapTxLockVotes.erase(hashVote);
+            RemoveOrphanVote(hashVote);
         }
+        // should be gone already, make sure we never loop forever on a stale bucket
+        mapTxLockVotesOrphanExpiry.erase(mapTxLockVotesOrphanExpiry.begin()->first);
     }
 
     // remove expired masternode orphan votes (DOS protection)
@@ -680,6 +791,29 @@ bool CInstantSend::GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLoc
     return true;
 }
 
+bool CInstantSend::GetTxLockTimes(const uint256& txHash, CTxLockTimes& timesRet)
+{
+    LOCK(cs_instantsend);
+
+    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    if(it == mapTxLockCandidates.end()) return false;
+    timesRet = it->second.GetTimes();
+
+    return true;
+}
+
+CInstantSendLatencyStats CInstantSend::GetLatencyStats()
+{
+    LOCK(cs_instantsend);
+    return latencyStats;
+}
+
+int CInstantSend::GetOrphanVoteCount()
+{
+    LOCK(cs_instantsend);
+    return mapTxLockVotesOrphan.size();
+}
+
 bool CInstantSend::GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet)
 {
     LOCK(cs_instantsend);
@@ -819,14 +953,17 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 
     // check orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.GetTxHash() == txHash) {
-            LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
-                    txHash.ToString(), nHeightNew, itOrphanVote->first.ToString());
-            mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
+    std::map<uint256, std::map<COutPoint, std::set<uint256> > >::iterator itByTx = mapTxLockVotesOrphanByTx.find(txHash);
+    if(itByTx != mapTxLockVotesOrphanByTx.end()) {
+        std::map<COutPoint, std::set<uint256> >::iterator itOutpoint = itByTx->second.begin();
+        while(itOutpoint != itByTx->second.end()) {
+            BOOST_FOREACH(const uint256& hashVote, itOutpoint->second) {
+                LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
+                        txHash.ToString(), nHeightNew, hashVote.ToString());
+                mapTxLockVotes[hashVote].SetConfirmedHeight(nHeightNew);
+            }
+            ++itOutpoint;
         }
-        ++itOrphanVote;
     }
 }
 
@@ -1096,6 +1233,55 @@ void COutPointLock::Relay() const
     }
 }
 
+//
+// CLockLatencyWindow
+//
+
+void CLockLatencyWindow::Add(int64_t nLatency)
+{
+    dequeSamples.push_back(nLatency);
+    if(dequeSamples.size() > MAX_SAMPLES) dequeSamples.pop_front();
+    nTotalSamples++;
+}
+
+int64_t CLockLatencyWindow::GetPercentile(double nPercentile) const
+{
+    if(dequeSamples.empty()) return 0;
+
+    std::vector<int64_t> vecSamples(dequeSamples.begin(), dequeSamples.end());
+    // nearest-rank method
+    size_t nRank = (size_t)ceil(nPercentile / 100 * vecSamples.size());
+    size_t nIndex = nRank > 0 ? std::min(nRank, vecSamples.size()) - 1 : 0;
+    std::nth_element(vecSamples.begin(), vecSamples.begin() + nIndex, vecSamples.end());
+    return vecSamples[nIndex];
+}
+
+int64_t CLockLatencyWindow::GetMax() const
+{
+    if(dequeSamples.empty()) return 0;
+    return *std::max_element(dequeSamples.begin(), dequeSamples.end());
+}
+
+//
+// CTxLockTimes
+//
+
+int64_t CTxLockTimes::GetFirstVoteLatency() const
+{
+    return std::max(nTimeFirstVote, nTimeReceived) - nTimeReceived;
+}
+
+int64_t CTxLockTimes::GetQuorumLatency() const
+{
+    int64_t nTimeFirstVoteAfterRequest = std::max(nTimeFirstVote, nTimeReceived);
+    return std::max(nTimeReady, nTimeFirstVoteAfterRequest) - nTimeFirstVoteAfterRequest;
+}
+
+int64_t CTxLockTimes::GetFinalizeLatency() const
+{
+    return nTimeLocked - std::max(nTimeReady, std::max(nTimeFirstVote, nTimeReceived));
+}
+
 //
 // CTxLockCandidate
 //
@@ -1113,6 +1299,26 @@ bool CTxLockCandidate::AddVote(const CTxLockVote& vote)
     return it->second.AddVote(vote);
 }
 
+void CTxLockCandidate::RecordVoteTime(const CTxLockVote& vote, bool fOrphan)
+{
+    if(nTimeFirstVote == 0 || vote.GetTimeReceived() < nTimeFirstVote) {
+        nTimeFirstVote = vote.GetTimeReceived();
+    }
+    if(fOrphan) nOrphanVotes++;
+}
+
+CTxLockTimes CTxLockCandidate::GetTimes() const
+{
+    CTxLockTimes times;
+    times.nTimeReceived = nTimeReceived;
+    times.nTimeFirstVote = nTimeFirstVote;
+    times.nTimeReady = nTimeReady;
+    times.nTimeLocked = nTimeLocked;
+    times.nVotes = CountVotes();
+    times.nOrphanVotes = nOrphanVotes;
+    return times;
+}
+
 bool CTxLockCandidate::IsAllOutPointsReady() const
 {
     if(mapOutPointLocks.empty()) return false;
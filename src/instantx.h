@@ -7,6 +7,8 @@
 #include "net.h"
 #include "primitives/transaction.h"
 
+class CBlock;
+class CBlockIndex;
 class CTxLockVote;
 class COutPointLock;
 class CTxLockRequest;
@@ -33,6 +35,77 @@ extern bool fEnableInstantSend;
 extern int nInstantSendDepth;
 extern int nCompleteTXLocks;
 
+/**
+ * Rolling window of the most recent lock latencies (in microseconds)
+ * for one phase of the InstantSend lock, used to report percentiles.
+ */
+class CLockLatencyWindow
+{
+private:
+    static const size_t MAX_SAMPLES = 1000;
+
+    std::deque<int64_t> dequeSamples;
+    uint64_t nTotalSamples;
+
+public:
+    CLockLatencyWindow() :
+        dequeSamples(),
+        nTotalSamples(0)
+        {}
+
+    void Add(int64_t nLatency);
+    // nPercentile is in range 0..100, returns 0 when there are no samples
+    int64_t GetPercentile(double nPercentile) const;
+    int64_t GetMax() const;
+    size_t GetSize() const { return dequeSamples.size(); }
+    uint64_t GetTotal() const { return nTotalSamples; }
+};
+
+/**
+ * Latency statistics of completed locks, split into phases:
+ * request received -> first vote -> all outpoints have enough votes -> inputs locked.
+ */
+struct CInstantSendLatencyStats
+{
+    CLockLatencyWindow firstVote;
+    CLockLatencyWindow quorum;
+    CLockLatencyWindow finalize;
+    CLockLatencyWindow total;
+    // votes which arrived before their lock request
+    uint64_t nOrphanVotes;
+
+    CInstantSendLatencyStats() : nOrphanVotes(0) {}
+};
+
+/**
+ * Per-phase timestamps (in microseconds, 0 if not reached yet) of a single lock
+ */
+struct CTxLockTimes
+{
+    int64_t nTimeReceived;
+    int64_t nTimeFirstVote;
+    int64_t nTimeReady;
+    int64_t nTimeLocked;
+    int nVotes;
+    int nOrphanVotes;
+
+    CTxLockTimes() :
+        nTimeReceived(0),
+        nTimeFirstVote(0),
+        nTimeReady(0),
+        nTimeLocked(0),
+        nVotes(0),
+        nOrphanVotes(0)
+        {}
+
+    // Phase latencies in microseconds, only meaningful once locked.
+    // Votes can arrive before the request, phases never go back in time.
+    int64_t GetFirstVoteLatency() const;
+    int64_t GetQuorumLatency() const;
+    int64_t GetFinalizeLatency() const;
+    int64_t GetTotalLatency() const { return nTimeLocked - nTimeReceived; }
+};
+
 class CInstantSend
 {
 private:
@@ -46,6 +119,9 @@ private:
     std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
     std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
     std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    // indexes of mapTxLockVotesOrphan, kept in sync by AddOrphanVote/RemoveOrphanVote
+    std::map<uint256, std::map<COutPoint, std::set<uint256> > > mapTxLockVotesOrphanByTx; // tx hash - (utxo - vote hash set)
+    std::map<int64_t, std::set<uint256> > mapTxLockVotesOrphanExpiry; // expiration time - vote hash set
 
     std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
 
@@ -55,17 +131,23 @@ private:
     //track masternodes who voted with no txreq (for DOS protection)
     std::map<COutPoint, int64_t> mapMasternodeOrphanVotes; // mn outpoint - time
 
+    CInstantSendLatencyStats latencyStats;
+
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
-    void Vote(CTxLockCandidate& txLockCandidate);
+    void Vote(const uint256& txHash);
+    bool HasVotedForOutpoint(const COutPoint& outpoint, const COutPoint& outpointMasternode);
 
-    //process consensus vote message
+    //process consensus vote message, the vote must be validated already
     bool ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote);
-    void ProcessOrphanTxLockVotes();
+    void ProcessOrphanTxLockVotes(const uint256& txHash);
+    void AddOrphanVote(const CTxLockVote& vote);
+    void RemoveOrphanVote(const uint256& hashVote);
     bool IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest);
     bool IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, const COutPoint& outpoint);
     int64_t GetAverageMasternodeOrphanVoteTime();
 
-    void TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate);
+    // the only step that needs cs_main: resolve conflicts and commit the outpoint locks
+    void TryToFinalizeLockCandidate(const uint256& txHash);
     void LockTransactionInputs(const CTxLockCandidate& txLockCandidate);
     //update UI and notify external script if any
     void UpdateLockedTransaction(const CTxLockCandidate& txLockCandidate);
@@ -89,6 +171,11 @@ public:
 
     bool GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet);
 
+    // get per-phase timestamps of the lock
+    bool GetTxLockTimes(const uint256& txHash, CTxLockTimes& timesRet);
+    CInstantSendLatencyStats GetLatencyStats();
+    int GetOrphanVoteCount();
+
     bool GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet);
 
     // verify if transaction is currently locked
@@ -143,6 +230,7 @@ private:
     // local memory only
     int nConfirmedHeight; // when corresponding tx is 0-confirmed or conflicted, nConfirmedHeight is -1
     int64_t nTimeCreated;
+    int64_t nTimeReceived; // in microseconds
 
 public:
     CTxLockVote() :
@@ -151,7 +239,8 @@ public:
         outpointMasternode(),
         vchMasternodeSignature(),
         nConfirmedHeight(-1),
-        nTimeCreated(GetTime())
+        nTimeCreated(GetTime()),
+        nTimeReceived(GetTimeMicros())
         {}
 
     CTxLockVote(const uint256& txHashIn, const COutPoint& outpointIn, const COutPoint& outpointMasternodeIn) :
@@ -160,7 +249,8 @@ public:
         outpointMasternode(outpointMasternodeIn),
         vchMasternodeSignature(),
         nConfirmedHeight(-1),
-        nTimeCreated(GetTime())
+        nTimeCreated(GetTime()),
+        nTimeReceived(GetTimeMicros())
         {}
 
     ADD_SERIALIZE_METHODS;
@@ -179,6 +269,7 @@ public:
     COutPoint GetOutpoint() const { return outpoint; }
     COutPoint GetMasternodeOutpoint() const { return outpointMasternode; }
     int64_t GetTimeCreated() const { return nTimeCreated; }
+    int64_t GetTimeReceived() const { return nTimeReceived; }
 
     bool IsValid(CNode* pnode) const;
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
@@ -220,10 +311,21 @@ class CTxLockCandidate
 {
 private:
     int nConfirmedHeight; // when corresponding tx is 0-confirmed or conflicted, nConfirmedHeight is -1
+    // phase timestamps in microseconds, 0 until reached
+    int64_t nTimeReceived;
+    int64_t nTimeFirstVote;
+    int64_t nTimeReady; // all outpoints have enough votes
+    int64_t nTimeLocked; // all outpoints are locked
+    int nOrphanVotes; // votes which arrived before the lock request
 
 public:
     CTxLockCandidate(const CTxLockRequest& txLockRequestIn) :
         nConfirmedHeight(-1),
+        nTimeReceived(GetTimeMicros()),
+        nTimeFirstVote(0),
+        nTimeReady(0),
+        nTimeLocked(0),
+        nOrphanVotes(0),
         txLockRequest(txLockRequestIn),
         mapOutPointLocks()
         {}
@@ -243,6 +345,13 @@ public:
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
     bool IsExpired(int nHeight) const;
 
+    void RecordVoteTime(const CTxLockVote& vote, bool fOrphan);
+    void SetTimeReady(int64_t nTimeReadyIn) { if(nTimeReady == 0) nTimeReady = nTimeReadyIn; }
+    void SetTimeLocked(int64_t nTimeLockedIn) { nTimeLocked = nTimeLockedIn; }
+    int64_t GetTimeReceived() const { return nTimeReceived; }
+    int64_t GetTimeLocked() const { return nTimeLocked; }
+    CTxLockTimes GetTimes() const;
+
     void Relay() const;
 };
 
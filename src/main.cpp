@@ -12,6 +12,7 @@
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "core_memusage.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
@@ -45,6 +46,7 @@
 #include "masternode-sync.h"
 #include "masternodeman.h"
 
+#include <deque>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -77,6 +79,8 @@ bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
 bool fAddressIndex = false;
+/** Whether the per-address summaries were maintained since the address index was created */
+bool fAddressSummary = false;
 bool fTimestampIndex = false;
 bool fSpentIndex = false;
 bool fHavePruned = false;
@@ -1061,6 +1065,30 @@ std::string FormatStateMessage(const CValidationState &state)
         state.GetRejectCode());
 }
 
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
+/**
+ * Script checks for a transaction entering the mempool. Transactions with at
+ * least MEMPOOL_PARALLEL_SCRIPT_CHECK_MIN_INPUTS inputs have their inputs
+ * verified on the script check threads. If that fails the checks are redone
+ * serially (hitting the signature cache for the inputs that passed), so state
+ * gets the same reject reason and DoS score as before.
+ */
+static bool CheckInputsForMempool(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &view, unsigned int flags)
+{
+    AssertLockHeld(cs_main);
+    if (nScriptCheckThreads && tx.vin.size() >= MEMPOOL_PARALLEL_SCRIPT_CHECK_MIN_INPUTS) {
+        std::vector<CScriptCheck> vChecks;
+        if (!CheckInputs(tx, state, view, true, flags, true, &vChecks))
+            return false;
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        control.Add(vChecks);
+        if (control.Wait())
+            return true;
+    }
+    return CheckInputs(tx, state, view, true, flags, true);
+}
+
 bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
                               bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectAbsurdFee,
                               std::vector<uint256>& vHashTxnToUncache, bool fDryRun)
@@ -1470,7 +1498,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true))
+        if (!CheckInputsForMempool(tx, state, view, STANDARD_SCRIPT_VERIFY_FLAGS))
             return false;
 
         // Check again against just the consensus-critical mandatory script
@@ -1482,7 +1510,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
         // There is a similar check in CreateNewBlock() to prevent creating
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
-        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
+        if (!CheckInputsForMempool(tx, state, view, MANDATORY_SCRIPT_VERIFY_FLAGS))
         {
             return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
                 __func__, hash.ToString(), FormatStateMessage(state));
@@ -1564,24 +1592,39 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 }
 
 bool GetAddressIndex(uint160 addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     const CAddressIndexKey* pkeyAfter, size_t nLimit)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, pkeyAfter, nLimit))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool GetAddressSummary(uint160 addressHash, int type, CAddressSummary &summary)
+{
+    // Callers fall back to the address index, so don't flood the log when summaries are missing
+    if (!fAddressIndex || !fAddressSummary)
+        return false;
+
+    // Addresses without history have no record
+    if (!pblocktree->ReadAddressSummary(addressHash, type, summary))
+        summary.SetNull();
+
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CAddressUnspentKey* pkeyAfter, size_t nLimit)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, pkeyAfter, nLimit))
         return error("unable to get txids for address");
 
     return true;
@@ -1648,6 +1691,112 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::P
     return false;
 }
 
+namespace {
+    /** Orders indexes into a vector of transaction positions by block file and offset */
+    struct CompareDiskTxPos
+    {
+        const std::vector<CDiskTxPos>& vPos;
+        CompareDiskTxPos(const std::vector<CDiskTxPos>& vPosIn) : vPos(vPosIn) {}
+        bool operator()(size_t a, size_t b) const
+        {
+            if (vPos[a].nFile != vPos[b].nFile)
+                return vPos[a].nFile < vPos[b].nFile;
+            if (vPos[a].nPos != vPos[b].nPos)
+                return vPos[a].nPos < vPos[b].nPos;
+            return vPos[a].nTxOffset < vPos[b].nTxOffset;
+        }
+    };
+}
+
+void GetTransactions(const std::vector<uint256> &vHash, std::vector<CTransaction> &vTx, std::vector<uint256> &vHashBlock, std::vector<bool> &vFound, const Consensus::Params& consensusParams)
+{
+    vTx.assign(vHash.size(), CTransaction());
+    vHashBlock.assign(vHash.size(), uint256());
+    vFound.assign(vHash.size(), false);
+
+    if (!fTxIndex) {
+        for (size_t i = 0; i < vHash.size(); i++)
+            vFound[i] = GetTransaction(vHash[i], vTx[i], consensusParams, vHashBlock[i], true);
+        return;
+    }
+
+    std::vector<uint256> vLookup;
+    std::vector<CDiskTxPos> vPos;
+    std::vector<bool> vPosFound;
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < vHash.size(); i++) {
+            if (mempool.lookup(vHash[i], vTx[i]))
+                vFound[i] = true;
+            else
+                vLookup.push_back(vHash[i]);
+        }
+        std::sort(vLookup.begin(), vLookup.end());
+        vLookup.erase(std::unique(vLookup.begin(), vLookup.end()), vLookup.end());
+        pblocktree->ReadTxIndexBatch(vLookup, vPos, vPosFound);
+    }
+
+    // Read the block files front to back, keeping the current one open. Pruning can't be
+    // combined with -txindex, so the files stay in place without holding cs_main.
+    std::vector<size_t> vOrder;
+    for (size_t j = 0; j < vLookup.size(); j++)
+        if (vPosFound[j])
+            vOrder.push_back(j);
+    std::sort(vOrder.begin(), vOrder.end(), CompareDiskTxPos(vPos));
+
+    std::vector<CTransaction> vLookupTx(vLookup.size());
+    std::vector<uint256> vLookupBlock(vLookup.size());
+    std::vector<bool> vLookupFound(vLookup.size(), false);
+    boost::scoped_ptr<CAutoFile> pfile;
+    int nFileOpen = -1;
+    CDiskBlockPos posHashed;
+    uint256 hashBlock;
+    BOOST_FOREACH(size_t j, vOrder) {
+        const CDiskTxPos& postx = vPos[j];
+        if (!pfile || postx.nFile != nFileOpen) {
+            pfile.reset(new CAutoFile(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION));
+            nFileOpen = postx.nFile;
+        }
+        if (pfile->IsNull()) {
+            error("%s: OpenBlockFile failed", __func__);
+            continue;
+        }
+        try {
+            if (fseek(pfile->Get(), postx.nPos, SEEK_SET))
+                throw std::runtime_error("fseek failed");
+            CBlockHeader header;
+            *pfile >> header;
+            // transactions of the same block are next to each other, hash its header only once
+            if (!(posHashed == postx)) {
+                hashBlock = header.GetHash();
+                posHashed = postx;
+            }
+            fseek(pfile->Get(), postx.nTxOffset, SEEK_CUR);
+            *pfile >> vLookupTx[j];
+        } catch (const std::exception& e) {
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            continue;
+        }
+        if (vLookupTx[j].GetHash() != vLookup[j]) {
+            error("%s: txid mismatch", __func__);
+            continue;
+        }
+        vLookupBlock[j] = hashBlock;
+        vLookupFound[j] = true;
+    }
+
+    for (size_t i = 0; i < vHash.size(); i++) {
+        if (vFound[i])
+            continue;
+        size_t j = std::lower_bound(vLookup.begin(), vLookup.end(), vHash[i]) - vLookup.begin();
+        if (j < vLookup.size() && vLookup[j] == vHash[i] && vLookupFound[j]) {
+            vTx[i] = vLookupTx[j];
+            vHashBlock[i] = vLookupBlock[j];
+            vFound[i] = true;
+        }
+    }
+}
+
 
 
 
@@ -2260,6 +2409,72 @@ static bool ApplyTxInUndo(const CTxInUndo& undo, CCoinsViewCache& view, const CO
     return fClean;
 }
 
+/**
+ * Apply the address index entries of a connected or disconnected block to the summaries
+ * of the addresses involved. The index writes themselves are idempotent and get replayed
+ * when the node restarts before flushing the chainstate, so blocks a summary has already
+ * seen (or, when disconnecting, has not seen) are skipped using its last height.
+ */
+static bool UpdateAddressSummaries(const std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int nHeight, bool fConnect)
+{
+    typedef std::pair<uint160, int> AddressId;
+    std::map<AddressId, CAddressSummary> mapSummaries;
+    std::set<AddressId> setSkipped;
+    std::set<std::pair<AddressId, uint256> > setTxs;
+
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++) {
+        AddressId address(it->first.hashBytes, it->first.type);
+        if (setSkipped.count(address))
+            continue;
+
+        std::map<AddressId, CAddressSummary>::iterator mi = mapSummaries.find(address);
+        if (mi == mapSummaries.end()) {
+            CAddressSummary summary;
+            if (!pblocktree->ReadAddressSummary(address.first, address.second, summary))
+                summary.SetNull();
+            if (fConnect ? summary.lastHeight >= nHeight : summary.lastHeight < nHeight) {
+                setSkipped.insert(address);
+                continue;
+            }
+            mi = mapSummaries.insert(std::make_pair(address, summary)).first;
+        }
+
+        CAddressSummary &summary = mi->second;
+        CAmount nDelta = fConnect ? it->second : -it->second;
+        summary.balance += nDelta;
+        if (it->first.spending) {
+            summary.sent -= nDelta;
+        } else {
+            summary.received += nDelta;
+        }
+        if (setTxs.insert(std::make_pair(address, it->first.txhash)).second) {
+            if (fConnect) {
+                summary.txCount++;
+            } else {
+                summary.txCount--;
+            }
+        }
+    }
+
+    std::vector<std::pair<AddressId, CAddressSummary> > vSummaries;
+    vSummaries.reserve(mapSummaries.size());
+    for (std::map<AddressId, CAddressSummary>::iterator mi = mapSummaries.begin(); mi != mapSummaries.end(); mi++) {
+        CAddressSummary &summary = mi->second;
+        if (fConnect) {
+            if (summary.firstHeight < 0)
+                summary.firstHeight = nHeight;
+            summary.lastHeight = nHeight;
+        } else if (summary.IsNull()) {
+            summary.SetNull();
+        } else if (!pblocktree->ReadAddressLastHeight(mi->first.first, mi->first.second, nHeight, summary.lastHeight)) {
+            return error("%s: no earlier history for address %s with %u transactions left", __func__, mi->first.first.ToString(), summary.txCount);
+        }
+        vSummaries.push_back(*mi);
+    }
+
+    return pblocktree->UpdateAddressSummaries(vSummaries);
+}
+
 bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
@@ -2402,6 +2617,9 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
         if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
             return AbortNode(state, "Failed to write address unspent index");
         }
+        if (fAddressSummary && !UpdateAddressSummaries(addressIndex, pindex->nHeight, false)) {
+            return AbortNode(state, "Failed to update address summaries");
+        }
     }
 
     return fClean;
@@ -2432,8 +2650,6 @@ void static FlushBlockFile(bool fFinalize = false)
 
 bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
-
 void ThreadScriptCheck() {
     RenameThread("3dcoin-scriptch");
     scriptcheckqueue.Thread();
@@ -2867,6 +3083,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
             return AbortNode(state, "Failed to write address unspent index");
         }
+
+        if (fAddressSummary && !UpdateAddressSummaries(addressIndex, pindex->nHeight, true)) {
+            return AbortNode(state, "Failed to update address summaries");
+        }
     }
 
     if (fSpentIndex)
@@ -3015,10 +3235,55 @@ void PruneAndFlush() {
     FlushStateToDisk(state, FLUSH_STATE_NONE);
 }
 
+/** Copy the tip fields that are read most, pindexIn is NULL before a chain is loaded */
+CChainTipSnapshot::CChainTipSnapshot(const CBlockIndex* pindexIn) :
+    pindex(pindexIn),
+    nHeight(pindexIn ? pindexIn->nHeight : -1),
+    hashBlock(pindexIn ? pindexIn->GetBlockHash() : uint256()),
+    nChainWork(pindexIn ? pindexIn->nChainWork : arith_uint256()),
+    nTime(pindexIn ? pindexIn->GetBlockTime() : 0),
+    nMedianTimePast(pindexIn ? pindexIn->GetMedianTimePast() : 0)
+{
+}
+
+bool CChainTipSnapshot::Contains(const CBlockIndex* pindexIn) const
+{
+    return pindexIn && GetAncestor(pindexIn->nHeight) == pindexIn;
+}
+
+const CBlockIndex* CChainTipSnapshot::GetAncestor(int nHeightIn) const
+{
+    // pprev and pskip of an indexed block never change, so this is safe without cs_main
+    if (!pindex || nHeightIn < 0 || nHeightIn > nHeight)
+        return NULL;
+    return pindex->GetAncestor(nHeightIn);
+}
+
+namespace {
+    CCriticalSection cs_tipSnapshot;
+    boost::shared_ptr<const CChainTipSnapshot> tipSnapshot(new CChainTipSnapshot(NULL));
+}
+
+/** Replace the chain tip snapshot after chainActive changed */
+static void PublishChainTipSnapshot()
+{
+    AssertLockHeld(cs_main);
+    boost::shared_ptr<const CChainTipSnapshot> snapshot(new CChainTipSnapshot(chainActive.Tip()));
+    LOCK(cs_tipSnapshot);
+    tipSnapshot = snapshot;
+}
+
+boost::shared_ptr<const CChainTipSnapshot> GetChainTipSnapshot()
+{
+    LOCK(cs_tipSnapshot);
+    return tipSnapshot;
+}
+
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex *pindexNew) {
     const CChainParams& chainParams = Params();
     chainActive.SetTip(pindexNew);
+    PublishChainTipSnapshot();
 
     // New best block
     nTimeBestReceived = GetTime();
@@ -3073,8 +3338,121 @@ void static UpdateTip(CBlockIndex *pindexNew) {
     }
 }
 
-/** Disconnect chainActive's tip. You probably want to call mempool.removeForReorg and manually re-limit mempool size after this, with cs_main held. */
-bool static DisconnectTip(CValidationState& state, const Consensus::Params& consensusParams)
+/**
+ * Transactions of the blocks disconnected by a reorg, waiting to be re-added
+ * to the mempool in one batch. Blocks are disconnected from the tip backwards;
+ * their transactions are appended per block and walked in reverse block order
+ * when they are re-added, so the oldest block comes first. Like the mempool
+ * the batch is limited in memory: beyond MAX_DISCONNECTED_TX_POOL_SIZE the
+ * most recent blocks are dropped, their transactions can only depend on the
+ * older ones and not the other way round.
+ */
+struct CDisconnectedBlockTransactions
+{
+    // transactions per block, in the order the blocks were disconnected
+    std::deque<std::vector<CTransaction> > queuedBlocks;
+    size_t nUsage;
+    unsigned int nBlocksDropped;
+
+    CDisconnectedBlockTransactions() : nUsage(0), nBlocksDropped(0) {}
+
+    static size_t DynamicUsage(const std::vector<CTransaction>& vtx)
+    {
+        size_t nUsage = memusage::DynamicUsage(vtx);
+        BOOST_FOREACH(const CTransaction &tx, vtx)
+            nUsage += RecursiveDynamicUsage(tx);
+        return nUsage;
+    }
+
+    void AddBlock(const std::vector<CTransaction>& vtx)
+    {
+        queuedBlocks.push_back(vtx);
+        nUsage += DynamicUsage(vtx);
+        while (nUsage > MAX_DISCONNECTED_TX_POOL_SIZE * 1000 && queuedBlocks.size() > 1) {
+            nUsage -= DynamicUsage(queuedBlocks.front());
+            queuedBlocks.pop_front();
+            nBlocksDropped++;
+        }
+    }
+};
+
+/**
+ * Re-add the transactions of disconnected blocks to the mempool in one batch,
+ * those of the oldest disconnected block first. When script check threads are
+ * available, the scripts of all of them are verified in parallel on the
+ * script check queue first; this fills the signature cache, so the serial
+ * AcceptToMemoryPool pass only has to do the cheap checks. Descendant state is
+ * then recomputed with a single UpdateTransactionsFromBlock call for the
+ * whole batch.
+ */
+static void ResurrectDisconnectedTransactions(const CDisconnectedBlockTransactions& disconnected)
+{
+    AssertLockHeld(cs_main);
+    if (disconnected.queuedBlocks.empty())
+        return;
+
+    typedef std::deque<std::vector<CTransaction> >::const_reverse_iterator block_rit;
+    int64_t nStart = GetTimeMicros();
+    if (nScriptCheckThreads) {
+        LOCK(mempool.cs);
+        CCoinsViewMemPool viewMemPool(pcoinsTip, mempool);
+        CCoinsViewCache view(&viewMemPool);
+        const int nSpendHeight = chainActive.Height() + 1;
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        for (block_rit it = disconnected.queuedBlocks.rbegin(); it != disconnected.queuedBlocks.rend(); ++it) {
+            BOOST_FOREACH(const CTransaction &tx, *it) {
+                if (tx.IsCoinBase() || !view.HaveInputs(tx))
+                    continue;
+                CValidationState stateDummy;
+                std::vector<CScriptCheck> vChecks;
+                if (CheckInputs(tx, stateDummy, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, &vChecks))
+                    control.Add(vChecks);
+                // Make the outputs visible to transactions later in the batch
+                UpdateCoins(tx, stateDummy, view, nSpendHeight);
+            }
+        }
+        // Failures are reported again by AcceptToMemoryPool below, only the
+        // signatures left in the cache matter here
+        control.Wait();
+    }
+    int64_t nScripts = GetTimeMicros();
+
+    std::vector<uint256> vHashUpdate;
+    unsigned int nTx = 0;
+    for (block_rit it = disconnected.queuedBlocks.rbegin(); it != disconnected.queuedBlocks.rend(); ++it) {
+        BOOST_FOREACH(const CTransaction &tx, *it) {
+            // ignore validation errors in resurrected transactions
+            list<CTransaction> removed;
+            CValidationState stateDummy;
+            if (tx.IsCoinBase() || !AcceptToMemoryPool(mempool, stateDummy, tx, false, NULL, true)) {
+                mempool.remove(tx, removed, true);
+            } else if (mempool.exists(tx.GetHash())) {
+                vHashUpdate.push_back(tx.GetHash());
+            }
+            nTx++;
+        }
+    }
+    // AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
+    // no in-mempool children, which is generally not true when adding
+    // previously-confirmed transactions back to the mempool.
+    // UpdateTransactionsFromBlock finds descendants of any transactions in
+    // these blocks that were added back and cleans up the mempool state.
+    mempool.UpdateTransactionsFromBlock(vHashUpdate);
+    if (disconnected.nBlocksDropped)
+        LogPrint("mempool", "ResurrectDisconnectedTransactions: transactions of the last %u disconnected blocks dropped to stay within %u kB\n",
+            disconnected.nBlocksDropped, MAX_DISCONNECTED_TX_POOL_SIZE);
+    LogPrint("bench", "- Resurrect %u txs: %.2fms (scripts %.2fms)\n", nTx,
+        (GetTimeMicros() - nStart) * 0.001, (nScripts - nStart) * 0.001);
+}
+
+/**
+ * Disconnect chainActive's tip. The transactions of the disconnected block are
+ * added to disconnected; pass them to ResurrectDisconnectedTransactions
+ * once all blocks are disconnected. You probably want to call
+ * mempool.removeForReorg and manually re-limit mempool size after that, with
+ * cs_main held.
+ */
+bool static DisconnectTip(CValidationState& state, const Consensus::Params& consensusParams, CDisconnectedBlockTransactions& disconnected)
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
@@ -3094,24 +3472,8 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED))
         return false;
-    // Resurrect mempool transactions from the disconnected block.
-    std::vector<uint256> vHashUpdate;
-    BOOST_FOREACH(const CTransaction &tx, block.vtx) {
-        // ignore validation errors in resurrected transactions
-        list<CTransaction> removed;
-        CValidationState stateDummy;
-        if (tx.IsCoinBase() || !AcceptToMemoryPool(mempool, stateDummy, tx, false, NULL, true)) {
-            mempool.remove(tx, removed, true);
-        } else if (mempool.exists(tx.GetHash())) {
-            vHashUpdate.push_back(tx.GetHash());
-        }
-    }
-    // AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
-    // no in-mempool children, which is generally not true when adding
-    // previously-confirmed transactions back to the mempool.
-    // UpdateTransactionsFromBlock finds descendants of any transactions in this
-    // block that were added back and cleans up the mempool state.
-    mempool.UpdateTransactionsFromBlock(vHashUpdate);
+    // Queue the transactions for resurrection
+    disconnected.AddBlock(block.vtx);
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev);
     // Let wallets know transactions went from 1-confirmed to
@@ -3197,11 +3559,14 @@ bool DisconnectBlocks(int blocks)
     const CChainParams& chainparams = Params();
 
     LogPrintf("DisconnectBlocks -- Got command to replay %d blocks\n", blocks);
+    CDisconnectedBlockTransactions disconnected;
     for(int i = 0; i < blocks; i++) {
-        if(!DisconnectTip(state, chainparams.GetConsensus()) || !state.IsValid()) {
+        if(!DisconnectTip(state, chainparams.GetConsensus(), disconnected) || !state.IsValid()) {
+            ResurrectDisconnectedTransactions(disconnected);
             return false;
         }
     }
+    ResurrectDisconnectedTransactions(disconnected);
 
     return true;
 }
@@ -3316,11 +3681,15 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
 
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
+    CDisconnectedBlockTransactions disconnected;
     while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams.GetConsensus()))
+        if (!DisconnectTip(state, chainparams.GetConsensus(), disconnected)) {
+            ResurrectDisconnectedTransactions(disconnected);
             return false;
+        }
         fBlocksDisconnected = true;
     }
+    ResurrectDisconnectedTransactions(disconnected);
 
     // Build list of new blocks to connect.
     std::vector<CBlockIndex*> vpindexToConnect;
@@ -3471,6 +3840,7 @@ bool InvalidateBlock(CValidationState& state, const Consensus::Params& consensus
     setDirtyBlockIndex.insert(pindex);
     setBlockIndexCandidates.erase(pindex);
 
+    CDisconnectedBlockTransactions disconnected;
     while (chainActive.Contains(pindex)) {
         CBlockIndex *pindexWalk = chainActive.Tip();
         pindexWalk->nStatus |= BLOCK_FAILED_CHILD;
@@ -3478,11 +3848,13 @@ bool InvalidateBlock(CValidationState& state, const Consensus::Params& consensus
         setBlockIndexCandidates.erase(pindexWalk);
         // ActivateBestChain considers blocks already in chainActive
         // unconditionally valid already, so force disconnect away from it.
-        if (!DisconnectTip(state, consensusParams)) {
+        if (!DisconnectTip(state, consensusParams, disconnected)) {
+            ResurrectDisconnectedTransactions(disconnected);
             mempool.removeForReorg(pcoinsTip, chainActive.Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
             return false;
         }
     }
+    ResurrectDisconnectedTransactions(disconnected);
 
     LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
 
@@ -4365,6 +4737,10 @@ bool static LoadBlockIndexDB()
     // Check whether we have an address index
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("addresssummary", fAddressSummary);
+    fAddressSummary &= fAddressIndex;
+    if (fAddressIndex)
+        LogPrintf("%s: address summaries %s\n", __func__, fAddressSummary ? "enabled" : "disabled (reindex to build them)");
 
     // Check whether we have a timestamp index
     pblocktree->ReadFlag("timestampindex", fTimestampIndex);
@@ -4379,6 +4755,7 @@ bool static LoadBlockIndexDB()
     if (it == mapBlockIndex.end())
         return true;
     chainActive.SetTip(it->second);
+    PublishChainTipSnapshot();
 
     PruneBlockIndexCandidates();
 
@@ -4483,6 +4860,7 @@ void UnloadBlockIndex()
     LOCK(cs_main);
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
+    PublishChainTipSnapshot();
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
     mempool.clear();
@@ -4538,6 +4916,9 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    // Summaries are only correct when kept from the first block on
+    fAddressSummary = fAddressIndex;
+    pblocktree->WriteFlag("addresssummary", fAddressSummary);
 
     // Use the provided setting for -timestampindex in the new database
     fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
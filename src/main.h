@@ -29,6 +29,7 @@
 #include <utility>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
 
 class CBlockIndex;
@@ -67,6 +68,8 @@ static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
+/** Maximum kilobytes of transactions from disconnected blocks waiting to be re-added to the mempool */
+static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -78,6 +81,8 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Minimum number of inputs for a mempool candidate to have its scripts checked on the script-checking threads */
+static const unsigned int MEMPOOL_PARALLEL_SCRIPT_CHECK_MIN_INPUTS = 4;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -119,6 +124,8 @@ static const bool DEFAULT_TXINDEX = true;
 static const bool DEFAULT_ADDRESSINDEX = false;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
+/** Default for -rpcmaxaddressresults, the most address index entries one address RPC call may return */
+static const unsigned int DEFAULT_RPC_MAX_ADDRESS_RESULTS = 100000;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 static const bool DEFAULT_TESTSAFEMODE = false;
@@ -247,6 +254,11 @@ bool IsInitialBlockDownload();
 std::string GetWarnings(const std::string& strFor);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256 &hash, CTransaction &tx, const Consensus::Params& params, uint256 &hashBlock, bool fAllowSlow = false);
+/**
+ * Retrieve many transactions at once. With -txindex the index is read in key order and the
+ * block files in disk order, otherwise this falls back to GetTransaction for each of them.
+ */
+void GetTransactions(const std::vector<uint256> &vHash, std::vector<CTransaction> &vTx, std::vector<uint256> &vHashBlock, std::vector<bool> &vFound, const Consensus::Params& params);
 /** Find the best known block, and make it the tip of the block chain */
 bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams, const CBlock* pblock = NULL);
 
@@ -582,6 +594,45 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/** Running totals of the address index entries of one address */
+struct CAddressSummary {
+    CAmount balance;
+    CAmount received;
+    CAmount sent;
+    unsigned int txCount;
+    int firstHeight;
+    int lastHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(sent);
+        READWRITE(txCount);
+        READWRITE(firstHeight);
+        READWRITE(lastHeight);
+    }
+
+    CAddressSummary() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        sent = 0;
+        txCount = 0;
+        firstHeight = -1;
+        lastHeight = -1;
+    }
+
+    bool IsNull() const {
+        return (txCount == 0);
+    }
+};
+
 struct CDiskTxPos : public CDiskBlockPos
 {
     unsigned int nTxOffset; // after header
@@ -716,9 +767,13 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::v
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                     int start = 0, int end = 0);
+                     int start = 0, int end = 0,
+                     const CAddressIndexKey* pkeyAfter = NULL, size_t nLimit = 0);
+/** Look up the running totals of an address, fails when the address index was built without them */
+bool GetAddressSummary(uint160 addressHash, int type, CAddressSummary &summary);
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CAddressUnspentKey* pkeyAfter = NULL, size_t nLimit = 0);
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
@@ -826,6 +881,31 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex *pindex);
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain chainActive;
 
+/**
+ * The tip of chainActive as of its last change. Snapshots are immutable and can be read
+ * without cs_main, so monitoring RPCs don't have to wait for block validation.
+ */
+struct CChainTipSnapshot
+{
+    //! The tip, NULL while no chain is loaded (block index entries stay valid while running)
+    const CBlockIndex* pindex;
+    int nHeight;
+    uint256 hashBlock;
+    arith_uint256 nChainWork;
+    int64_t nTime;
+    int64_t nMedianTimePast;
+
+    CChainTipSnapshot(const CBlockIndex* pindexIn);
+
+    /** Whether a block is part of the chain ending at this tip */
+    bool Contains(const CBlockIndex* pindexIn) const;
+    /** The block at a height of the chain ending at this tip, NULL if out of range */
+    const CBlockIndex* GetAncestor(int nHeightIn) const;
+};
+
+/** The latest chain tip snapshot, does not need cs_main */
+boost::shared_ptr<const CChainTipSnapshot> GetChainTipSnapshot();
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
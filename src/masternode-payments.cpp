@@ -11,6 +11,7 @@
 #include "netfulfilledman.h"
 #include "spork.h"
 #include "util.h"
+#include "validationinterface.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -483,6 +484,8 @@ bool CMasternodePayments::AddPaymentVote(const CMasternodePaymentVote& vote)
 
     mapMasternodeBlocks[vote.nBlockHeight].AddPayee(vote);
 
+    GetMainSignals().NotifyPaymentVote(vote);
+
     return true;
 }
 
@@ -11,6 +11,7 @@
 #include "masternodeman.h"
 #include "netfulfilledman.h"
 #include "util.h"
+#include "validationinterface.h"
 
 /** Masternode manager */
 CMasternodeMan mnodeman;
@@ -114,6 +115,8 @@ CMasternodeMan::CMasternodeMan()
   fMasternodesRemoved(false),
   vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  cs_counts(),
+  lastCounts(),
   mapSeenMasternodeBroadcast(),
   mapSeenMasternodePing(),
   nDsqCount(0)
@@ -172,6 +175,12 @@ void CMasternodeMan::Check()
 
     BOOST_FOREACH(CMasternode& mn, vMasternodes) {
         mn.Check();
+        // announce masternodes which are new to the list or changed their state
+        std::map<COutPoint, int>::iterator it = mapNotifiedStates.find(mn.vin.prevout);
+        if(it == mapNotifiedStates.end() || it->second != mn.nActiveState) {
+            mapNotifiedStates[mn.vin.prevout] = mn.nActiveState;
+            GetMainSignals().NotifyMasternodeState(mn.vin.prevout, mn.nActiveState);
+        }
     }
 }
 
@@ -206,6 +215,9 @@ void CMasternodeMan::CheckAndRemove()
 
                 // and finally remove it from the list
                 it->FlagGovernanceItemsAsDirty();
+                if(mapNotifiedStates.erase((*it).vin.prevout)) {
+                    GetMainSignals().NotifyMasternodeState((*it).vin.prevout, -1);
+                }
                 it = vMasternodes.erase(it);
                 fMasternodesRemoved = true;
             } else {
@@ -372,6 +384,10 @@ void CMasternodeMan::Clear()
     mWeAskedForMasternodeListEntry.clear();
     mapSeenMasternodeBroadcast.clear();
     mapSeenMasternodePing.clear();
+    // subscribers were told about these masternodes, tell them they are gone
+    for (std::map<COutPoint, int>::iterator it = mapNotifiedStates.begin(); it != mapNotifiedStates.end(); ++it)
+        GetMainSignals().NotifyMasternodeState(it->first, -1);
+    mapNotifiedStates.clear();
     nDsqCount = 0;
     nLastWatchdogVoteTime = 0;
     indexMasternodes.Clear();
@@ -1652,6 +1668,28 @@ void CMasternodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
         // normal wallet does not need to update this every block, doing update on rpc call should be enough
         UpdateLastPaid();
     }
+
+    // ranking an incomplete list would only produce misleading numbers
+    if(!masternodeSync.IsMasternodeListSynced()) return;
+
+    CMasternodeCounts counts;
+    counts.nHeight = pindex->nHeight;
+    GetNextMasternodeInQueueForPayment(pindex->nHeight, true, counts.nQualify);
+    {
+        LOCK(cs);
+        counts.nTotal = vMasternodes.size();
+    }
+    counts.nEnabled = CountEnabled();
+    counts.nEnabledPS = CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION);
+
+    LOCK(cs_counts);
+    lastCounts = counts;
+}
+
+CMasternodeCounts CMasternodeMan::GetLastCounts() const
+{
+    LOCK(cs_counts);
+    return lastCounts;
 }
 
 void CMasternodeMan::NotifyMasternodeUpdates()
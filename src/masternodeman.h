@@ -78,6 +78,22 @@ private:
 
 };
 
+/**
+ * Masternode list counts as of a block, refreshed on every new tip so that
+ * "masternode count" does not have to rank the whole list on each call.
+ */
+struct CMasternodeCounts
+{
+    /// Height the counts were taken at, -1 until the list is synced
+    int nHeight;
+    int nTotal;
+    int nEnabled;
+    int nEnabledPS;
+    int nQualify;
+
+    CMasternodeCounts() : nHeight(-1), nTotal(0), nEnabled(0), nEnabledPS(0), nQualify(0) {}
+};
+
 class CMasternodeMan
 {
 public:
@@ -152,6 +168,13 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // last state of each masternode announced through NotifyMasternodeState, not serialized
+    std::map<COutPoint, int> mapNotifiedStates;
+
+    // protects lastCounts only, never held while taking another lock
+    mutable CCriticalSection cs_counts;
+    CMasternodeCounts lastCounts;
+
     friend class CMasternodeSync;
 
 public:
@@ -355,6 +378,9 @@ public:
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
 
+    /// Counts taken at the last block tip, nHeight is -1 if there are none yet
+    CMasternodeCounts GetLastCounts() const;
+
     /**
      * Called to notify CGovernanceManager that the masternode index has been updated.
      * Must be called while not holding the CMasternodeMan::cs mutex
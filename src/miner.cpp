@@ -30,6 +30,9 @@
 
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <queue>
 
 using namespace std;
@@ -42,23 +45,172 @@ using namespace std;
 //
 // Unconfirmed transactions in the memory pool often depend on other
 // transactions in the memory pool. When we select transactions from the
-// pool, we select by highest priority or fee rate, so we might consider
-// transactions that depend on transactions that aren't yet in the block.
+// pool, we select by highest priority first and then by ancestor fee rate,
+// so that a transaction is considered together with all the in-mempool
+// transactions it depends on ("child pays for parent").
 
 uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockSize = 0;
 
-class ScoreCompare
+// Container for tracking updates to ancestor feerate as we include (parent)
+// transactions in a block
+struct CTxMemPoolModifiedEntry {
+    CTxMemPoolModifiedEntry(CTxMemPool::txiter entry)
+    {
+        iter = entry;
+        nSizeWithAncestors = entry->GetSizeWithAncestors();
+        nModFeesWithAncestors = entry->GetModFeesWithAncestors();
+        nSigOpCountWithAncestors = entry->GetSigOpCountWithAncestors();
+    }
+
+    CTxMemPool::txiter iter;
+    uint64_t nSizeWithAncestors;
+    CAmount nModFeesWithAncestors;
+    unsigned int nSigOpCountWithAncestors;
+};
+
+/** Comparator for CTxMemPool::txiter objects.
+ *  It simply compares the internal memory address of the CTxMemPoolEntry object
+ *  pointed to. This means it has no meaning, and is only useful for using them
+ *  as key in other indexes.
+ */
+struct CompareCTxMemPoolIter {
+    bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) const
+    {
+        return &(*a) < &(*b);
+    }
+};
+
+struct modifiedentry_iter {
+    typedef CTxMemPool::txiter result_type;
+    result_type operator() (const CTxMemPoolModifiedEntry &entry) const
+    {
+        return entry.iter;
+    }
+};
+
+// This matches the calculation in CompareTxMemPoolEntryByAncestorFee,
+// except operating on CTxMemPoolModifiedEntry.
+struct CompareModifiedEntry {
+    bool operator()(const CTxMemPoolModifiedEntry &a, const CTxMemPoolModifiedEntry &b) const
+    {
+        double f1 = (double)a.nModFeesWithAncestors * b.nSizeWithAncestors;
+        double f2 = (double)b.nModFeesWithAncestors * a.nSizeWithAncestors;
+        if (f1 == f2) {
+            return CTxMemPool::CompareIteratorByHash()(a.iter, b.iter);
+        }
+        return f1 > f2;
+    }
+};
+
+// A comparator that sorts transactions based on number of ancestors.
+// This is sufficient to sort an ancestor package in an order that is valid
+// to appear in a block.
+struct CompareTxIterByAncestorCount {
+    bool operator()(const CTxMemPool::txiter &a, const CTxMemPool::txiter &b) const
+    {
+        if (a->GetCountWithAncestors() != b->GetCountWithAncestors())
+            return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+        return CTxMemPool::CompareIteratorByHash()(a, b);
+    }
+};
+
+typedef boost::multi_index_container<
+    CTxMemPoolModifiedEntry,
+    boost::multi_index::indexed_by<
+        // sorted by mempool entry
+        boost::multi_index::ordered_unique<
+            modifiedentry_iter,
+            CompareCTxMemPoolIter
+        >,
+        // sorted by modified ancestor fee rate
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::identity<CTxMemPoolModifiedEntry>,
+            CompareModifiedEntry
+        >
+    >
+> indexed_modified_transaction_set;
+
+typedef indexed_modified_transaction_set::nth_index<0>::type::iterator modtxiter;
+typedef indexed_modified_transaction_set::nth_index<1>::type::iterator modtxscoreiter;
+
+struct update_for_parent_inclusion
 {
-public:
-    ScoreCompare() {}
+    update_for_parent_inclusion(CTxMemPool::txiter it) : iter(it) {}
 
-    bool operator()(const CTxMemPool::txiter a, const CTxMemPool::txiter b)
+    void operator() (CTxMemPoolModifiedEntry &e)
     {
-        return CompareTxMemPoolEntryByScore()(*b,*a); // Convert to less than
+        e.nModFeesWithAncestors -= iter->GetModifiedFee();
+        e.nSizeWithAncestors -= iter->GetTxSize();
+        e.nSigOpCountWithAncestors -= iter->GetSigOpCount();
     }
+
+    CTxMemPool::txiter iter;
 };
 
+// Add descendants of the given transactions to mapModifiedTx with ancestor
+// state updated assuming the given transactions are in the block.
+static void UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded,
+        indexed_modified_transaction_set &mapModifiedTx)
+{
+    BOOST_FOREACH(const CTxMemPool::txiter it, alreadyAdded) {
+        CTxMemPool::setEntries descendants;
+        mempool.CalculateDescendants(it, descendants);
+        // Insert all descendants (not yet in block) into the modified set
+        BOOST_FOREACH(CTxMemPool::txiter desc, descendants) {
+            if (alreadyAdded.count(desc))
+                continue;
+            modtxiter mit = mapModifiedTx.find(desc);
+            if (mit == mapModifiedTx.end()) {
+                CTxMemPoolModifiedEntry modEntry(desc);
+                modEntry.nSizeWithAncestors -= it->GetTxSize();
+                modEntry.nModFeesWithAncestors -= it->GetModifiedFee();
+                modEntry.nSigOpCountWithAncestors -= it->GetSigOpCount();
+                mapModifiedTx.insert(modEntry);
+            } else {
+                mapModifiedTx.modify(mit, update_for_parent_inclusion(it));
+            }
+        }
+    }
+}
+
+// Skip entries in mapTx that are already in a block or are present
+// in mapModifiedTx (which implies that the mapTx ancestor state is
+// stale due to ancestor inclusion in the block).
+// Also skip transactions that we've already failed to add.
+static bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx,
+        CTxMemPool::setEntries &failedTx, const CTxMemPool::setEntries &inBlock)
+{
+    assert (it != mempool.mapTx.end());
+    if (mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it))
+        return true;
+    return false;
+}
+
+static void AddToBlock(CBlockTemplate* pblocktemplate, CTxMemPool::txiter iter, CTxMemPool::setEntries& inBlock,
+        uint64_t& nBlockSize, uint64_t& nBlockTx, unsigned int& nBlockSigOps, CAmount& nFees,
+        bool fPrintPriority, int nHeight)
+{
+    const CTransaction& tx = iter->GetTx();
+    pblocktemplate->block.vtx.push_back(tx);
+    pblocktemplate->vTxFees.push_back(iter->GetFee());
+    pblocktemplate->vTxSigOps.push_back(iter->GetSigOpCount());
+    nBlockSize += iter->GetTxSize();
+    ++nBlockTx;
+    nBlockSigOps += iter->GetSigOpCount();
+    nFees += iter->GetFee();
+    inBlock.insert(iter);
+
+    if (fPrintPriority)
+    {
+        double dPriority = iter->GetPriority(nHeight);
+        CAmount dummy;
+        mempool.ApplyDeltas(tx.GetHash(), dPriority, dummy);
+        LogPrintf("priority %.1f fee %s txid %s\n",
+                  dPriority, CFeeRate(iter->GetModifiedFee(), iter->GetTxSize()).ToString(), tx.GetHash().ToString());
+    }
+}
+
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev)
 {
     int64_t nOldTime = pblock->nTime;
@@ -74,7 +226,7 @@ int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParam
     return nNewTime - nOldTime;
 }
 
-CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& scriptPubKeyIn)
+CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& scriptPubKeyIn, bool fIncludeMempool)
 {
     // Create new block
     auto_ptr<CBlockTemplate> pblocktemplate(new CBlockTemplate());
@@ -106,7 +258,6 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
 
     // Collect memory pool transactions into the block
     CTxMemPool::setEntries inBlock;
-    CTxMemPool::setEntries waitSet;
 
     // This vector will be sorted into a priority queue:
     vector<TxCoinAgePriority> vecPriority;
@@ -115,7 +266,6 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
     typedef std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash>::iterator waitPriIter;
     double actualPriority = -1;
 
-    std::priority_queue<CTxMemPool::txiter, std::vector<CTxMemPool::txiter>, ScoreCompare> clearedTxs;
     bool fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
     uint64_t nBlockSize = 1000;
     uint64_t nBlockTx = 0;
@@ -144,8 +294,11 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
                                 ? nMedianTimePast
                                 : pblock->GetBlockTime();
 
+        CTxMemPool::txiter iter;
 
-        bool fPriorityBlock = nBlockPrioritySize > 0;
+        // First fill the priority area with the highest coin age priority
+        // transactions, regardless of the fees they pay
+        bool fPriorityBlock = fIncludeMempool && nBlockPrioritySize > 0;
         if (fPriorityBlock) {
             vecPriority.reserve(mempool.mapTx.size());
             for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
@@ -159,30 +312,15 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
             std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
         }
 
-        CTxMemPool::indexed_transaction_set::nth_index<3>::type::iterator mi = mempool.mapTx.get<3>().begin();
-        CTxMemPool::txiter iter;
-
-        while (mi != mempool.mapTx.get<3>().end() || !clearedTxs.empty())
+        while (fPriorityBlock && !vecPriority.empty())
         {
-            bool priorityTx = false;
-            if (fPriorityBlock && !vecPriority.empty()) { // add a tx from priority queue to fill the blockprioritysize
-                priorityTx = true;
-                iter = vecPriority.front().second;
-                actualPriority = vecPriority.front().first;
-                std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-                vecPriority.pop_back();
-            }
-            else if (clearedTxs.empty()) { // add tx with next highest score
-                iter = mempool.mapTx.project<0>(mi);
-                mi++;
-            }
-            else {  // try to add a previously postponed child tx
-                iter = clearedTxs.top();
-                clearedTxs.pop();
-            }
+            iter = vecPriority.front().second;
+            actualPriority = vecPriority.front().first;
+            std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+            vecPriority.pop_back();
 
             if (inBlock.count(iter))
-                continue; // could have been added to the priorityBlock
+                continue;
 
             const CTransaction& tx = iter->GetTx();
 
@@ -195,87 +333,168 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
                 }
             }
             if (fOrphan) {
-                if (priorityTx)
-                    waitPriMap.insert(std::make_pair(iter,actualPriority));
-                else
-                    waitSet.insert(iter);
+                waitPriMap.insert(std::make_pair(iter,actualPriority));
                 continue;
             }
 
+            // Once the priority area is full the rest of the block is filled by fee rate below
             unsigned int nTxSize = iter->GetTxSize();
-            if (fPriorityBlock &&
-                (nBlockSize + nTxSize >= nBlockPrioritySize || !AllowFree(actualPriority))) {
-                fPriorityBlock = false;
-                waitPriMap.clear();
+            if (nBlockSize + nTxSize >= nBlockPrioritySize || !AllowFree(actualPriority))
+                break;
+
+            if (!IsFinalTx(tx, nHeight, nLockTimeCutoff))
+                continue;
+
+            unsigned int nTxSigOps = iter->GetSigOpCount();
+            if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
+                continue;
+
+            AddToBlock(pblocktemplate.get(), iter, inBlock, nBlockSize, nBlockTx, nBlockSigOps, nFees, fPrintPriority, nHeight);
+
+            // Add transactions that depend on this one to the priority queue
+            BOOST_FOREACH(CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter))
+            {
+                waitPriIter wpiter = waitPriMap.find(child);
+                if (wpiter != waitPriMap.end()) {
+                    vecPriority.push_back(TxCoinAgePriority(wpiter->second,child));
+                    std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+                    waitPriMap.erase(wpiter);
+                }
             }
-            if (!priorityTx &&
-                (iter->GetModifiedFee() < ::minRelayTxFee.GetFee(nTxSize) && nBlockSize >= nBlockMinSize)) {
+        }
+
+        // Then fill the rest of the block by ancestor fee rate: each candidate
+        // is evaluated as a package together with its not yet included mempool
+        // ancestors, so a child can pay for its parents.
+
+        // mapModifiedTx holds packages whose ancestor state changed because
+        // some of their ancestors are already in the block
+        indexed_modified_transaction_set mapModifiedTx;
+        // Keep track of entries that failed inclusion, to avoid duplicate work
+        CTxMemPool::setEntries failedTx;
+
+        // Start by adding all descendants of the priority transactions to
+        // mapModifiedTx, adjusted for their already included ancestors
+        UpdatePackagesForAdded(inBlock, mapModifiedTx);
+
+        CTxMemPool::indexed_transaction_set::nth_index<4>::type::iterator mi = mempool.mapTx.get<4>().begin();
+
+        while (fIncludeMempool && (mi != mempool.mapTx.get<4>().end() || !mapModifiedTx.empty()))
+        {
+            // First try to find a new transaction in mapTx to evaluate.
+            if (mi != mempool.mapTx.get<4>().end() &&
+                    SkipMapTxEntry(mempool.mapTx.project<0>(mi), mapModifiedTx, failedTx, inBlock)) {
+                ++mi;
+                continue;
+            }
+
+            // Now that mi is not stale, determine which transaction to evaluate:
+            // the next entry from mapTx, or the best from mapModifiedTx?
+            bool fUsingModified = false;
+
+            modtxscoreiter modit = mapModifiedTx.get<1>().begin();
+            if (mi == mempool.mapTx.get<4>().end()) {
+                // We're out of entries in mapTx; use the entry from mapModifiedTx
+                iter = modit->iter;
+                fUsingModified = true;
+            } else {
+                // Try to compare the mapTx entry to the mapModifiedTx entry
+                iter = mempool.mapTx.project<0>(mi);
+                if (modit != mapModifiedTx.get<1>().end() &&
+                        CompareModifiedEntry()(*modit, CTxMemPoolModifiedEntry(iter))) {
+                    // The best entry in mapModifiedTx has higher score
+                    // than the one from mapTx.
+                    // Switch which transaction (package) to consider
+                    iter = modit->iter;
+                    fUsingModified = true;
+                } else {
+                    // Either no entry in mapModifiedTx, or it's worse than mapTx.
+                    // Increment mi for the next loop iteration.
+                    ++mi;
+                }
+            }
+
+            // We skip mapTx entries that are inBlock, and mapModifiedTx shouldn't
+            // contain anything that is inBlock.
+            assert(!inBlock.count(iter));
+
+            uint64_t packageSize = iter->GetSizeWithAncestors();
+            CAmount packageFees = iter->GetModFeesWithAncestors();
+            unsigned int packageSigOps = iter->GetSigOpCountWithAncestors();
+            if (fUsingModified) {
+                packageSize = modit->nSizeWithAncestors;
+                packageFees = modit->nModFeesWithAncestors;
+                packageSigOps = modit->nSigOpCountWithAncestors;
+            }
+
+            if (packageFees < ::minRelayTxFee.GetFee(packageSize) && nBlockSize >= nBlockMinSize) {
+                // Everything else we might consider has a lower fee rate
                 break;
             }
-            if (nBlockSize + nTxSize >= nBlockMaxSize) {
-                if (nBlockSize >  nBlockMaxSize - 100 || lastFewTxs > 50) {
+
+            if (nBlockSize + packageSize >= nBlockMaxSize || nBlockSigOps + packageSigOps >= MAX_BLOCK_SIGOPS) {
+                if (nBlockSize > nBlockMaxSize - 100 || nBlockSigOps > MAX_BLOCK_SIGOPS - 2 || lastFewTxs > 50) {
                     break;
                 }
-                // Once we're within 1000 bytes of a full block, only look at 50 more txs
+                // Once we're within 1000 bytes of a full block, only look at 50 more packages
                 // to try to fill the remaining space.
                 if (nBlockSize > nBlockMaxSize - 1000) {
                     lastFewTxs++;
                 }
+                if (fUsingModified) {
+                    // Since we always look at the best entry in mapModifiedTx,
+                    // we must erase failed entries so that we can consider the
+                    // next best entry on the next loop iteration
+                    mapModifiedTx.get<1>().erase(modit);
+                    failedTx.insert(iter);
+                }
                 continue;
             }
 
-            if (!IsFinalTx(tx, nHeight, nLockTimeCutoff))
-                continue;
+            CTxMemPool::setEntries ancestors;
+            uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+            std::string dummy;
+            mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
 
-            unsigned int nTxSigOps = iter->GetSigOpCount();
-            if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS) {
-                if (nBlockSigOps > MAX_BLOCK_SIGOPS - 2) {
+            // Only the ancestors that aren't in the block yet are part of the package
+            for (CTxMemPool::setEntries::iterator ait = ancestors.begin(); ait != ancestors.end(); ) {
+                if (inBlock.count(*ait))
+                    ancestors.erase(ait++);
+                else
+                    ++ait;
+            }
+            ancestors.insert(iter);
+
+            // Test if all tx's are final
+            bool fFinal = true;
+            BOOST_FOREACH(const CTxMemPool::txiter it, ancestors) {
+                if (!IsFinalTx(it->GetTx(), nHeight, nLockTimeCutoff)) {
+                    fFinal = false;
                     break;
                 }
-                continue;
             }
-
-            CAmount nTxFees = iter->GetFee();
-            // Added
-            pblock->vtx.push_back(tx);
-            pblocktemplate->vTxFees.push_back(nTxFees);
-            pblocktemplate->vTxSigOps.push_back(nTxSigOps);
-            nBlockSize += nTxSize;
-            ++nBlockTx;
-            nBlockSigOps += nTxSigOps;
-            nFees += nTxFees;
-
-            if (fPrintPriority)
-            {
-                double dPriority = iter->GetPriority(nHeight);
-                CAmount dummy;
-                mempool.ApplyDeltas(tx.GetHash(), dPriority, dummy);
-                LogPrintf("priority %.1f fee %s txid %s\n",
-                          dPriority , CFeeRate(iter->GetModifiedFee(), nTxSize).ToString(), tx.GetHash().ToString());
+            if (!fFinal) {
+                if (fUsingModified) {
+                    mapModifiedTx.get<1>().erase(modit);
+                    failedTx.insert(iter);
+                }
+                continue;
             }
 
-            inBlock.insert(iter);
+            // Package can be added. Sort the entries in a valid order:
+            // a transaction always has fewer ancestors than its descendants.
+            std::vector<CTxMemPool::txiter> sortedEntries(ancestors.begin(), ancestors.end());
+            std::sort(sortedEntries.begin(), sortedEntries.end(), CompareTxIterByAncestorCount());
 
-            // Add transactions that depend on this one to the priority queue
-            BOOST_FOREACH(CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter))
-            {
-                if (fPriorityBlock) {
-                    waitPriIter wpiter = waitPriMap.find(child);
-                    if (wpiter != waitPriMap.end()) {
-                        vecPriority.push_back(TxCoinAgePriority(wpiter->second,child));
-                        std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-                        waitPriMap.erase(wpiter);
-                    }
-                }
-                else {
-                    if (waitSet.count(child)) {
-                        clearedTxs.push(child);
-                        waitSet.erase(child);
-                    }
-                }
+            for (size_t i = 0; i < sortedEntries.size(); ++i) {
+                AddToBlock(pblocktemplate.get(), sortedEntries[i], inBlock, nBlockSize, nBlockTx, nBlockSigOps, nFees, fPrintPriority, nHeight);
+                // Erase from the modified set, if present
+                mapModifiedTx.erase(sortedEntries[i]);
             }
-        }
 
+            // Update transactions that depend on each of these
+            UpdatePackagesForAdded(ancestors, mapModifiedTx);
+        }
         // NOTE: unlike in bitcoin, we need to pass PREVIOUS block height here
         CAmount blockReward = nFees + GetBlockSubsidy(pindexPrev->nBits, pindexPrev->nHeight, Params().GetConsensus());
 
@@ -541,3 +760,148 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
     for (int i = 0; i < nThreads; i++)
         minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams)));
 }
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Precomputed block templates
+//
+
+CBlockTemplateCache blockTemplateCache;
+
+CBlockTemplateCache::CBlockTemplateCache() :
+    pindexPrev(NULL),
+    nTransactionsUpdated(0),
+    nTimeCreated(0),
+    nSequence(0),
+    pindexPending(NULL),
+    fEnabled(false)
+{}
+
+void CBlockTemplateCache::UpdatedBlockTip(const CBlockIndex *pindex)
+{
+    if (!fEnabled)
+        return;
+    {
+        boost::unique_lock<boost::mutex> lock(csPending);
+        pindexPending = pindex;
+    }
+    condPending.notify_one();
+}
+
+bool CBlockTemplateCache::IsStale(const CBlockIndex* pindexTip, int64_t nNow) const
+{
+    LOCK(cs);
+    return !ptemplate || pindexPrev != pindexTip ||
+           (mempool.GetTransactionsUpdated() != nTransactionsUpdated &&
+            nNow - nTimeCreated > PRECOMPUTE_TEMPLATE_REFRESH_SECONDS);
+}
+
+uint64_t CBlockTemplateCache::GetSequence() const
+{
+    LOCK(cs);
+    return nSequence;
+}
+
+CBlockTemplate* CBlockTemplateCache::GetTemplate(const CBlockIndex* pindexTip, unsigned int& nTransactionsUpdatedRet, uint64_t& nSequenceRet) const
+{
+    LOCK(cs);
+    if (!ptemplate || pindexPrev != pindexTip)
+        return NULL;
+    nTransactionsUpdatedRet = nTransactionsUpdated;
+    nSequenceRet = nSequence;
+    return new CBlockTemplate(*ptemplate);
+}
+
+void CBlockTemplateCache::Publish(CBlockTemplate* pblocktemplateIn, const CBlockIndex* pindexPrevIn, unsigned int nTransactionsUpdatedIn)
+{
+    {
+        LOCK(cs);
+        // keep what we already have for this tip if building a new template failed
+        if (pblocktemplateIn || pindexPrev != pindexPrevIn)
+            ptemplate.reset(pblocktemplateIn);
+        pindexPrev = pindexPrevIn;
+        nTransactionsUpdated = nTransactionsUpdatedIn;
+        nTimeCreated = GetTime();
+        ++nSequence;
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(csBestBlock);
+        hashPublishedTip = pindexPrevIn->GetBlockHash();
+    }
+    // wake up getblocktemplate long-poll waiters
+    cvBlockChange.notify_all();
+
+    if (pblocktemplateIn)
+        GetMainSignals().UpdatedBlockTemplate(pblocktemplateIn->block);
+}
+
+bool CBlockTemplateCache::Build(const CChainParams& chainparams, bool fIncludeMempool)
+{
+    CScript scriptDummy = CScript() << OP_TRUE;
+    CBlockTemplate* pblocktemplate = NULL;
+    const CBlockIndex* pindexPrevNew = NULL;
+    unsigned int nTransactionsUpdatedNew = 0;
+    int64_t nTimeStart = GetTimeMicros();
+    try {
+        LOCK(cs_main);
+        pindexPrevNew = chainActive.Tip();
+        nTransactionsUpdatedNew = mempool.GetTransactionsUpdated();
+        pblocktemplate = CreateNewBlock(chainparams, scriptDummy, fIncludeMempool);
+    } catch (const std::runtime_error& e) {
+        LogPrintf("CBlockTemplateCache::Build -- runtime error: %s\n", e.what());
+    }
+    if (pindexPrevNew == NULL)
+        return false;
+
+    // Publish even on failure so that long-poll waiters fall back to building their own template
+    Publish(pblocktemplate, pindexPrevNew, nTransactionsUpdatedNew);
+    LogPrint("mining", "CBlockTemplateCache::Build -- %s template for height %d ready in %.2fms\n",
+             fIncludeMempool ? "full" : "empty", pindexPrevNew->nHeight + 1, (GetTimeMicros() - nTimeStart) * 0.001);
+    return pblocktemplate != NULL;
+}
+
+void CBlockTemplateCache::Run(const CChainParams& chainparams)
+{
+    while (true)
+    {
+        const CBlockIndex* pindexNew = NULL;
+        {
+            boost::unique_lock<boost::mutex> lock(csPending);
+            if (pindexPending == NULL)
+                condPending.timed_wait(lock, boost::posix_time::seconds(1));
+            pindexNew = pindexPending;
+            pindexPending = NULL;
+        }
+        boost::this_thread::interruption_point();
+
+        if (IsInitialBlockDownload())
+            continue;
+
+        if (pindexNew) {
+            // Get miners off the old tip first, transaction selection can take a while
+            Build(chainparams, false);
+            Build(chainparams, true);
+            continue;
+        }
+
+        const CBlockIndex* pindexTip;
+        {
+            LOCK(cs_main);
+            pindexTip = chainActive.Tip();
+        }
+        if (IsStale(pindexTip, GetTime()))
+            Build(chainparams, true);
+    }
+}
+
+void ThreadBlockTemplateCache(const CChainParams& chainparams)
+{
+    RenameThread("3dcoin-gbtcache");
+    LogPrintf("%s: started\n", __func__);
+    try {
+        blockTemplateCache.Run(chainparams);
+    } catch (const boost::thread_interrupted&) {
+        LogPrintf("%s: terminated\n", __func__);
+        throw;
+    }
+}
@@ -7,9 +7,14 @@
 #define BITCOIN_MINER_H
 
 #include "primitives/block.h"
+#include "sync.h"
+#include "uint256.h"
+#include "validationinterface.h"
 
 #include <stdint.h>
 
+#include <boost/shared_ptr.hpp>
+
 class CBlockIndex;
 class CChainParams;
 class CReserveKey;
@@ -21,6 +26,10 @@ static const bool DEFAULT_GENERATE = false;
 static const int DEFAULT_GENERATE_THREADS = 1;
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -precomputetemplate */
+static const bool DEFAULT_PRECOMPUTE_TEMPLATE = false;
+/** Minimum age in seconds before a precomputed template is refreshed with new mempool transactions */
+static const int64_t PRECOMPUTE_TEMPLATE_REFRESH_SECONDS = 5;
 
 struct CBlockTemplate
 {
@@ -31,10 +40,74 @@ struct CBlockTemplate
 
 /** Run the miner threads */
 void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainparams);
-/** Generate a new block, without valid proof-of-work */
-CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& scriptPubKeyIn);
+/** Generate a new block, without valid proof-of-work (coinbase only if fIncludeMempool is false) */
+CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& scriptPubKeyIn, bool fIncludeMempool = true);
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 
+/**
+ * Keeps a getblocktemplate result ready for the current tip (-precomputetemplate).
+ *
+ * As soon as a new tip is connected the background thread publishes a
+ * coinbase-only template for the next height, so long-poll waiters can switch
+ * work without waiting for transaction selection, and then replaces it with a
+ * full template. The full template is refreshed in the background whenever the
+ * mempool changed and it is older than PRECOMPUTE_TEMPLATE_REFRESH_SECONDS.
+ */
+class CBlockTemplateCache : public CValidationInterface
+{
+private:
+    // protects the published template
+    mutable CCriticalSection cs;
+    boost::shared_ptr<const CBlockTemplate> ptemplate;
+    const CBlockIndex* pindexPrev;
+    unsigned int nTransactionsUpdated;
+    int64_t nTimeCreated;
+    // bumped every time a template is published
+    uint64_t nSequence;
+
+    // tip the template was published for, protected by csBestBlock so that
+    // long-poll waiters on cvBlockChange can't miss an update
+    uint256 hashPublishedTip;
+
+    // wakes the background thread on a new tip
+    CWaitableCriticalSection csPending;
+    CConditionVariable condPending;
+    const CBlockIndex* pindexPending;
+
+    bool fEnabled;
+
+    void Publish(CBlockTemplate* pblocktemplateIn, const CBlockIndex* pindexPrevIn, unsigned int nTransactionsUpdatedIn);
+
+protected:
+    // CValidationInterface
+    void UpdatedBlockTip(const CBlockIndex *pindex);
+
+public:
+    CBlockTemplateCache();
+
+    void SetEnabled(bool fEnabledIn) { fEnabled = fEnabledIn; }
+    bool IsEnabled() const { return fEnabled; }
+
+    /** Build a template on top of the current tip and publish it (coinbase only if fIncludeMempool is false) */
+    bool Build(const CChainParams& chainparams, bool fIncludeMempool);
+    /** Whether the published template is missing, built on another tip or outdated by mempool changes at time nNow */
+    bool IsStale(const CBlockIndex* pindexTip, int64_t nNow) const;
+
+    uint64_t GetSequence() const;
+    /** Return a copy of the template built on top of pindexTip (caller owns it) or NULL if there is none yet */
+    CBlockTemplate* GetTemplate(const CBlockIndex* pindexTip, unsigned int& nTransactionsUpdatedRet, uint64_t& nSequenceRet) const;
+    /** Tip hash of the last published template, caller must hold csBestBlock */
+    const uint256& GetPublishedTipHash() const { return hashPublishedTip; }
+
+    /** Background loop, see ThreadBlockTemplateCache */
+    void Run(const CChainParams& chainparams);
+};
+
+extern CBlockTemplateCache blockTemplateCache;
+
+/** Run the -precomputetemplate background thread */
+void ThreadBlockTemplateCache(const CChainParams& chainparams);
+
 #endif // BITCOIN_MINER_H
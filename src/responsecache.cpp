@@ -0,0 +1,162 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "responsecache.h"
+
+#include "chainparams.h"
+#include "main.h"
+#include "streams.h"
+#include "version.h"
+
+CResponseCache responseCache;
+
+CResponseCache::CResponseCache(size_t nMaxBytesIn) :
+    nMaxBytes(nMaxBytesIn), nBytesUsed(0)
+{
+}
+
+size_t CResponseCache::EntryBytes(const std::string& strKey, const std::string& strBody)
+{
+    // the key is stored twice, once in the map and once in the LRU list
+    return 2 * strKey.size() + strBody.size() + sizeof(CacheEntry) + 4 * sizeof(void*);
+}
+
+void CResponseCache::EraseEntry(std::map<std::string, CacheEntry>::iterator it)
+{
+    nBytesUsed -= EntryBytes(it->first, it->second.strBody);
+    listLru.erase(it->second.itLru);
+    mapEntries.erase(it);
+}
+
+void CResponseCache::Evict()
+{
+    while (nBytesUsed > nMaxBytes && !listLru.empty())
+        EraseEntry(mapEntries.find(listLru.back()));
+}
+
+void CResponseCache::SetMaxBytes(size_t nMaxBytesIn)
+{
+    LOCK(cs);
+    nMaxBytes = nMaxBytesIn;
+    Evict();
+}
+
+size_t CResponseCache::GetMaxBytes() const
+{
+    LOCK(cs);
+    return nMaxBytes;
+}
+
+bool CResponseCache::Get(const std::string& strKey, std::string& strBody, uint256& hashBlock)
+{
+    LOCK(cs);
+    std::map<std::string, CacheEntry>::iterator it = mapEntries.find(strKey);
+    if (it == mapEntries.end())
+        return false;
+    listLru.splice(listLru.begin(), listLru, it->second.itLru);
+    strBody = it->second.strBody;
+    hashBlock = it->second.hashBlock;
+    return true;
+}
+
+void CResponseCache::Put(const std::string& strKey, const std::string& strBody, const uint256& hashBlock)
+{
+    LOCK(cs);
+    if (EntryBytes(strKey, strBody) > nMaxBytes)
+        return;
+
+    std::map<std::string, CacheEntry>::iterator it = mapEntries.find(strKey);
+    if (it != mapEntries.end())
+        EraseEntry(it);
+
+    listLru.push_front(strKey);
+    CacheEntry& entry = mapEntries[strKey];
+    entry.strBody = strBody;
+    entry.hashBlock = hashBlock;
+    entry.itLru = listLru.begin();
+    nBytesUsed += EntryBytes(strKey, strBody);
+    Evict();
+}
+
+void CResponseCache::Erase(const std::string& strKey)
+{
+    LOCK(cs);
+    std::map<std::string, CacheEntry>::iterator it = mapEntries.find(strKey);
+    if (it != mapEntries.end())
+        EraseEntry(it);
+}
+
+void CResponseCache::Clear()
+{
+    LOCK(cs);
+    mapEntries.clear();
+    listLru.clear();
+    nBytesUsed = 0;
+}
+
+size_t CResponseCache::Size() const
+{
+    LOCK(cs);
+    return mapEntries.size();
+}
+
+size_t CResponseCache::BytesUsed() const
+{
+    LOCK(cs);
+    return nBytesUsed;
+}
+
+std::string CResponseCache::MakeKey(const std::string& strResource, const std::string& strFormat, const uint256& hash)
+{
+    return strResource + "/" + hash.GetHex() + "." + strFormat;
+}
+
+std::string CResponseCache::MakeETag(const std::string& strKey, const uint256& hashTip)
+{
+    if (hashTip.IsNull())
+        return "\"" + strKey + "\"";
+    return "W/\"" + strKey + "@" + hashTip.GetHex() + "\"";
+}
+
+bool IsBlockBuried(const CBlockIndex* pindex, int nMinDepth)
+{
+    if (!pindex)
+        return false;
+    boost::shared_ptr<const CChainTipSnapshot> tip = GetChainTipSnapshot();
+    return tip->nHeight - pindex->nHeight + 1 >= nMinDepth && tip->Contains(pindex);
+}
+
+bool IsBlockBuried(const uint256& hashBlock, int nMinDepth)
+{
+    const CBlockIndex* pindex = NULL;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hashBlock);
+        if (it != mapBlockIndex.end())
+            pindex = it->second;
+    }
+    return IsBlockBuried(pindex, nMinDepth);
+}
+
+bool GetSerializedBlock(const CBlockIndex* pblockindex, bool fBuried, bool fCache, std::string& strData)
+{
+    const uint256 hash = pblockindex->GetBlockHash();
+    const std::string strKey = CResponseCache::MakeKey("block", "bin", hash);
+    uint256 hashBlock;
+    if (fBuried && responseCache.Get(strKey, strData, hashBlock))
+        return true;
+
+    CBlock block;
+    {
+        LOCK(cs_main);
+        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+            return false;
+    }
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << block;
+    strData = ssBlock.str();
+    if (fBuried && fCache)
+        responseCache.Put(strKey, strData, hash);
+    return true;
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RESPONSECACHE_H
+#define BITCOIN_RESPONSECACHE_H
+
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <map>
+#include <string>
+
+class CBlockIndex;
+
+/** Default size of the REST/RPC response cache in MiB, 0 disables it */
+static const int64_t DEFAULT_REST_CACHE_SIZE = 32;
+/** Confirmations a block needs before responses about it are cached */
+static const int REST_CACHE_MIN_DEPTH = 10;
+
+/**
+ * Serialized REST and RPC responses about blocks and transactions that are buried too deep
+ * to be reorganized away, keyed by resource, format and hash. Each entry remembers the block
+ * it was taken from so callers can check it is still buried before serving it. The least
+ * recently used entries are dropped once the cache grows past its byte budget.
+ */
+class CResponseCache
+{
+public:
+    CResponseCache(size_t nMaxBytesIn = 0);
+
+    /** Change the byte budget, evicting entries as needed. 0 disables the cache. */
+    void SetMaxBytes(size_t nMaxBytesIn);
+    size_t GetMaxBytes() const;
+
+    /** Look up an entry, hashBlock is set to the block it was taken from */
+    bool Get(const std::string& strKey, std::string& strBody, uint256& hashBlock);
+    /** Add or replace an entry, bodies larger than the whole budget are not cached */
+    void Put(const std::string& strKey, const std::string& strBody, const uint256& hashBlock);
+    void Erase(const std::string& strKey);
+    void Clear();
+
+    size_t Size() const;
+    size_t BytesUsed() const;
+
+    /** Cache key of a resource ("block", "tx", "headers/5", ...) in a format ("bin", "hex", ...) */
+    static std::string MakeKey(const std::string& strResource, const std::string& strFormat, const uint256& hash);
+    /**
+     * Entity tag for a cached response. Responses that also depend on the chain tip
+     * (confirmations in JSON output) pass its hash and get a weak tag.
+     */
+    static std::string MakeETag(const std::string& strKey, const uint256& hashTip = uint256());
+
+private:
+    typedef std::list<std::string> LruList;
+
+    struct CacheEntry
+    {
+        std::string strBody;
+        uint256 hashBlock;
+        LruList::iterator itLru;
+    };
+
+    mutable CCriticalSection cs;
+    size_t nMaxBytes;
+    size_t nBytesUsed;
+    std::map<std::string, CacheEntry> mapEntries;
+    //! keys, most recently used first
+    LruList listLru;
+
+    static size_t EntryBytes(const std::string& strKey, const std::string& strBody);
+    void EraseEntry(std::map<std::string, CacheEntry>::iterator it);
+    void Evict();
+};
+
+extern CResponseCache responseCache;
+
+/** Whether a block is on the active chain with at least nMinDepth confirmations, does not need cs_main */
+bool IsBlockBuried(const CBlockIndex* pindex, int nMinDepth = REST_CACHE_MIN_DEPTH);
+/** Same as above for a block hash, takes cs_main for the lookup */
+bool IsBlockBuried(const uint256& hashBlock, int nMinDepth = REST_CACHE_MIN_DEPTH);
+
+/**
+ * Serialized block, served from the response cache when the block is buried deep enough.
+ * fCache controls whether a block read from disk is added to it.
+ */
+bool GetSerializedBlock(const CBlockIndex* pblockindex, bool fBuried, bool fCache, std::string& strData);
+
+#endif // BITCOIN_RESPONSECACHE_H
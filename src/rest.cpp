@@ -9,7 +9,9 @@
 #include "primitives/transaction.h"
 #include "main.h"
 #include "httpserver.h"
+#include "responsecache.h"
 #include "rpcserver.h"
+#include "rpcstream.h"
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
@@ -17,6 +19,7 @@
 #include "version.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/dynamic_bitset.hpp>
 
 #include <univalue.h>
@@ -24,6 +27,10 @@
 using namespace std;
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const size_t MAX_BULK_GETUTXOS_OUTPOINTS = 10000; //outpoints per /rest/bulk/getutxos request
+static const size_t MAX_BULK_TXS = 1000; //transactions per /rest/bulk/tx request
+static const size_t MAX_BULK_HEADERS = 2000; //headers per /rest/bulk/headers request
+static const size_t BULK_TX_BATCH_SIZE = 100; //transactions read from disk before they are written out
 
 enum RetFormat {
     RF_UNDEF,
@@ -118,6 +125,129 @@ static bool ParseHashStr(const string& strReq, uint256& v)
     return true;
 }
 
+/** Send 304 Not Modified if the client already has the response with this entity tag */
+static bool RESTNotModified(HTTPRequest* req, const std::string& strETag)
+{
+    if (strETag.empty() || !req->MatchesETag(strETag))
+        return false;
+    req->WriteHeader("ETag", strETag);
+    req->WriteReply(HTTP_NOT_MODIFIED);
+    return true;
+}
+
+/** Reply with data that may have an entity tag, or tell the client its copy is still current */
+static bool RESTReply(HTTPRequest* req, const std::string& strETag, const std::string& strContentType, const std::string& strBody)
+{
+    if (RESTNotModified(req, strETag))
+        return true;
+    if (!strETag.empty())
+        req->WriteHeader("ETag", strETag);
+    req->WriteHeader("Content-Type", strContentType);
+    req->WriteReply(HTTP_OK, strBody);
+    return true;
+}
+
+/** Entity tag of a response about data anchored to a block, empty unless the block is buried */
+static std::string RESTETag(const std::string& strKey, bool fBuried, bool fDependsOnTip)
+{
+    if (!fBuried)
+        return "";
+    return CResponseCache::MakeETag(strKey, fDependsOnTip ? GetChainTipSnapshot()->hashBlock : uint256());
+}
+
+/**
+ * Reply that is sent while it is produced. Output that fits in one chunk goes out as a
+ * plain reply, anything larger as a chunked reply. Binary output is hex encoded for RF_HEX.
+ */
+class RESTStreamReply
+{
+public:
+    RESTStreamReply(HTTPRequest* reqIn, RetFormat rfIn) : req(reqIn), rf(rfIn), fStarted(false) {}
+
+    void Write(const std::string& strChunk)
+    {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", ContentType());
+            req->WriteReplyStart(HTTP_OK);
+            fStarted = true;
+        }
+        req->WriteReplyChunk(rf == RF_HEX ? HexStr(strChunk.begin(), strChunk.end()) : strChunk);
+    }
+
+    /** Write binary output once enough of it was buffered */
+    void WriteBuffered(CDataStream& ss)
+    {
+        if (ss.size() < JSON_STREAM_CHUNK_SIZE)
+            return;
+        Write(ss.str());
+        ss.clear();
+    }
+
+    /** Finish the reply with the output that was not written yet */
+    void End(const std::string& strRest)
+    {
+        std::string strTail = rf == RF_HEX ? HexStr(strRest.begin(), strRest.end()) : strRest;
+        if (rf != RF_BINARY)
+            strTail += "\n";
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", ContentType());
+            req->WriteReply(HTTP_OK, strTail);
+            return;
+        }
+        req->WriteReplyChunk(strTail);
+        req->WriteReplyEnd();
+    }
+
+private:
+    const char* ContentType() const
+    {
+        return rf == RF_BINARY ? "application/octet-stream" : rf == RF_HEX ? "text/plain" : "application/json";
+    }
+
+    HTTPRequest* req;
+    RetFormat rf;
+    bool fStarted;
+};
+
+/** Deserialize the body of a bulk request, sent as binary for .bin and hex encoded for .hex */
+template <typename T>
+static bool ReadBulkBody(const std::string& strBody, RetFormat rf, T& obj)
+{
+    std::vector<unsigned char> vData;
+    if (rf == RF_HEX) {
+        if (!IsHex(strBody))
+            return false;
+        vData = ParseHex(strBody);
+    } else {
+        vData.assign(strBody.begin(), strBody.end());
+    }
+    try {
+        CDataStream ss(vData, SER_NETWORK, PROTOCOL_VERSION);
+        ss >> obj;
+        return ss.empty();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+/** Read the hashes of a bulk request, a JSON array of hex strings for .json */
+static bool ReadBulkHashes(const std::string& strBody, RetFormat rf, std::vector<uint256>& vHash)
+{
+    if (rf != RF_JSON)
+        return ReadBulkBody(strBody, rf, vHash);
+
+    UniValue val;
+    if (!val.read(strBody) || !val.isArray())
+        return false;
+    for (size_t i = 0; i < val.size(); i++) {
+        uint256 hash;
+        if (!val[i].isStr() || !ParseHashStr(val[i].get_str(), hash))
+            return false;
+        vHash.push_back(hash);
+    }
+    return true;
+}
+
 static bool CheckWarmup(HTTPRequest* req)
 {
     std::string statusmessage;
@@ -126,6 +256,14 @@ static bool CheckWarmup(HTTPRequest* req)
     return true;
 }
 
+/** The bulk endpoints take their request in the body, so they only accept POST */
+static bool CheckBulkMethod(HTTPRequest* req)
+{
+    if (req->GetRequestMethod() != HTTPRequest::POST)
+        return RESTERR(req, HTTP_BAD_METHOD, "Bulk requests must use POST");
+    return true;
+}
+
 static bool rest_headers(HTTPRequest* req,
                          const std::string& strURIPart)
 {
@@ -162,34 +300,40 @@ static bool rest_headers(HTTPRequest* req,
         }
     }
 
-    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
-    BOOST_FOREACH(const CBlockIndex *pindex, headers) {
-        ssHeader << pindex->GetBlockHeader();
-    }
+    // the list only stays the same once all of its headers are buried
+    const bool fBuried = headers.size() == (unsigned long)count && IsBlockBuried(headers.back());
+    const std::string strResource = strprintf("headers/%d", count);
 
     switch (rf) {
-    case RF_BINARY: {
-        string binaryHeader = ssHeader.str();
-        req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryHeader);
-        return true;
-    }
-
+    case RF_BINARY:
     case RF_HEX: {
-        string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
-        req->WriteHeader("Content-Type", "text/plain");
-        req->WriteReply(HTTP_OK, strHex);
-        return true;
+        const std::string strKey = CResponseCache::MakeKey(strResource, rf == RF_BINARY ? "bin" : "hex", hash);
+        const std::string strETag = RESTETag(strKey, fBuried, false);
+        std::string strBody;
+        uint256 hashBlock;
+        if (!fBuried || !responseCache.Get(strKey, strBody, hashBlock)) {
+            CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+            BOOST_FOREACH(const CBlockIndex *pindex, headers) {
+                ssHeader << pindex->GetBlockHeader();
+            }
+            strBody = rf == RF_BINARY ? ssHeader.str() : HexStr(ssHeader.begin(), ssHeader.end());
+            if (fBuried)
+                responseCache.Put(strKey, strBody, headers.back()->GetBlockHash());
+        }
+        if (rf == RF_BINARY)
+            return RESTReply(req, strETag, "application/octet-stream", strBody);
+        return RESTReply(req, strETag, "text/plain", strBody + "\n");
     }
     case RF_JSON: {
+        const std::string strETag = RESTETag(CResponseCache::MakeKey(strResource, "json", hash), fBuried, true);
+        if (RESTNotModified(req, strETag))
+            return true;
         UniValue jsonHeaders(UniValue::VARR);
         BOOST_FOREACH(const CBlockIndex *pindex, headers) {
             jsonHeaders.push_back(blockheaderToJSON(pindex));
         }
         string strJSON = jsonHeaders.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return RESTReply(req, strETag, "application/json", strJSON);
     }
     default: {
         return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
@@ -213,7 +357,6 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
@@ -223,35 +366,53 @@ static bool rest_block(HTTPRequest* req,
         pblockindex = mapBlockIndex[hash];
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
-
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
+    const bool fBuried = IsBlockBuried(pblockindex);
 
     switch (rf) {
     case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
-        req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryBlock);
-        return true;
+        const std::string strETag = RESTETag(CResponseCache::MakeKey("block", "bin", hash), fBuried, false);
+        if (RESTNotModified(req, strETag))
+            return true;
+        std::string strData;
+        if (!GetSerializedBlock(pblockindex, fBuried, true, strData))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        return RESTReply(req, strETag, "application/octet-stream", strData);
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
-        req->WriteHeader("Content-Type", "text/plain");
-        req->WriteReply(HTTP_OK, strHex);
-        return true;
+        const std::string strKey = CResponseCache::MakeKey("block", "hex", hash);
+        const std::string strETag = RESTETag(strKey, fBuried, false);
+        if (RESTNotModified(req, strETag))
+            return true;
+        std::string strHex;
+        uint256 hashBlock;
+        if (!fBuried || !responseCache.Get(strKey, strHex, hashBlock)) {
+            std::string strData;
+            if (!GetSerializedBlock(pblockindex, fBuried, false, strData))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+            strHex = HexStr(strData.begin(), strData.end());
+            if (fBuried)
+                responseCache.Put(strKey, strHex, hash);
+        }
+        return RESTReply(req, strETag, "text/plain", strHex + "\n");
     }
 
     case RF_JSON: {
+        const std::string strETag = RESTETag(CResponseCache::MakeKey(showTxDetails ? "block" : "block/notxdetails", "json", hash), fBuried, true);
+        if (RESTNotModified(req, strETag))
+            return true;
+        // confirmations change with every block, so only the block data itself comes from the cache
+        std::string strData;
+        if (!GetSerializedBlock(pblockindex, fBuried, true, strData))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        CBlock block;
+        CDataStream ssBlock(strData.data(), strData.data() + strData.size(), SER_NETWORK, PROTOCOL_VERSION);
+        ssBlock >> block;
         UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
         string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return RESTReply(req, strETag, "application/json", strJSON);
     }
 
     default: {
@@ -359,36 +520,51 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
+    if (rf == RF_BINARY || rf == RF_HEX) {
+        // a cached transaction is only served while its block is still buried
+        const std::string strKey = CResponseCache::MakeKey("tx", rf == RF_BINARY ? "bin" : "hex", hash);
+        std::string strBody;
+        uint256 hashBlock;
+        if (responseCache.Get(strKey, strBody, hashBlock)) {
+            if (IsBlockBuried(hashBlock)) {
+                const std::string strETag = RESTETag(strKey, true, false);
+                if (rf == RF_BINARY)
+                    return RESTReply(req, strETag, "application/octet-stream", strBody);
+                return RESTReply(req, strETag, "text/plain", strBody + "\n");
+            }
+            responseCache.Erase(strKey);
+        }
+    }
+
     CTransaction tx;
     uint256 hashBlock = uint256();
     if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true))
         return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
 
-    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
-    ssTx << tx;
+    const bool fBuried = !hashBlock.IsNull() && IsBlockBuried(hashBlock);
 
     switch (rf) {
-    case RF_BINARY: {
-        string binaryTx = ssTx.str();
-        req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryTx);
-        return true;
-    }
-
+    case RF_BINARY:
     case RF_HEX: {
-        string strHex = HexStr(ssTx.begin(), ssTx.end()) + "\n";
-        req->WriteHeader("Content-Type", "text/plain");
-        req->WriteReply(HTTP_OK, strHex);
-        return true;
+        const std::string strKey = CResponseCache::MakeKey("tx", rf == RF_BINARY ? "bin" : "hex", hash);
+        CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
+        ssTx << tx;
+        const std::string strBody = rf == RF_BINARY ? ssTx.str() : HexStr(ssTx.begin(), ssTx.end());
+        if (fBuried)
+            responseCache.Put(strKey, strBody, hashBlock);
+        if (rf == RF_BINARY)
+            return RESTReply(req, RESTETag(strKey, fBuried, false), "application/octet-stream", strBody);
+        return RESTReply(req, RESTETag(strKey, fBuried, false), "text/plain", strBody + "\n");
     }
 
     case RF_JSON: {
+        const std::string strETag = RESTETag(CResponseCache::MakeKey("tx", "json", hash), fBuried, true);
+        if (RESTNotModified(req, strETag))
+            return true;
         UniValue objTx(UniValue::VOBJ);
         TxToJSON(tx, hashBlock, objTx);
         string strJSON = objTx.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return RESTReply(req, strETag, "application/json", strJSON);
     }
 
     default: {
@@ -596,24 +772,284 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_bulk_getutxos(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckBulkMethod(req))
+        return false;
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    // same input as /rest/getutxos, for .json {"checkmempool": bool, "outpoints": ["txid-n", ...]}
+    bool fCheckMemPool = false;
+    vector<COutPoint> vOutPoints;
+    const std::string strBody = req->ReadBody();
+    if (rf == RF_JSON) {
+        UniValue val;
+        if (!val.read(strBody) || !val.isObject() || !find_value(val, "outpoints").isArray())
+            return RESTERR(req, HTTP_BAD_REQUEST, "Parse error");
+        const UniValue& checkmempool = find_value(val, "checkmempool");
+        if (checkmempool.isBool())
+            fCheckMemPool = checkmempool.get_bool();
+        const UniValue& outpoints = find_value(val, "outpoints");
+        for (size_t i = 0; i < outpoints.size(); i++) {
+            const std::string strOutPoint = outpoints[i].isStr() ? outpoints[i].get_str() : "";
+            const std::string::size_type pos = strOutPoint.find('-');
+            uint256 txid;
+            int32_t nOutput;
+            if (pos == std::string::npos || !ParseHashStr(strOutPoint.substr(0, pos), txid) ||
+                !ParseInt32(strOutPoint.substr(pos + 1), &nOutput) || nOutput < 0)
+                return RESTERR(req, HTTP_BAD_REQUEST, "Parse error");
+            vOutPoints.push_back(COutPoint(txid, (uint32_t)nOutput));
+        }
+    } else {
+        std::pair<bool, vector<COutPoint> > request;
+        if (!ReadBulkBody(strBody, rf, request))
+            return RESTERR(req, HTTP_BAD_REQUEST, "Parse error");
+        fCheckMemPool = request.first;
+        vOutPoints.swap(request.second);
+    }
+
+    if (vOutPoints.empty())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Error: empty request");
+    if (vOutPoints.size() > MAX_BULK_GETUTXOS_OUTPOINTS)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Error: max outpoints exceeded (max: %d, tried: %d)", MAX_BULK_GETUTXOS_OUTPOINTS, vOutPoints.size()));
+
+    // look every transaction up once, in key order
+    std::vector<uint256> vTxid;
+    vTxid.reserve(vOutPoints.size());
+    BOOST_FOREACH(const COutPoint& outpoint, vOutPoints)
+        vTxid.push_back(outpoint.hash);
+    std::sort(vTxid.begin(), vTxid.end());
+    vTxid.erase(std::unique(vTxid.begin(), vTxid.end()), vTxid.end());
+
+    std::vector<CCoins> vCoins;
+    std::vector<bool> vFound;
+    int nHeight;
+    uint256 hashTip;
+    {
+        LOCK2(cs_main, mempool.cs);
+        CCoinsViewMemPool viewMempool(pcoinsTip, mempool);
+        const CCoinsView& view = fCheckMemPool ? (const CCoinsView&)viewMempool : (const CCoinsView&)*pcoinsTip;
+        view.GetCoinsBatch(vTxid, vCoins, vFound);
+        for (size_t i = 0; i < vTxid.size(); i++)
+            if (vFound[i])
+                mempool.pruneSpent(vTxid[i], vCoins[i]);
+        nHeight = chainActive.Height();
+        hashTip = chainActive.Tip()->GetBlockHash();
+    }
+
+    // index of each outpoint's coins, or -1 if the output is not available
+    std::vector<int> vCoinIndex(vOutPoints.size(), -1);
+    boost::dynamic_bitset<unsigned char> hits(vOutPoints.size());
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        size_t j = std::lower_bound(vTxid.begin(), vTxid.end(), vOutPoints[i].hash) - vTxid.begin();
+        if (vFound[j] && vCoins[j].IsAvailable(vOutPoints[i].n)) {
+            hits[i] = true;
+            vCoinIndex[i] = j;
+        }
+    }
+
+    RESTStreamReply stream(req, rf);
+    if (rf == RF_JSON) {
+        CJSONStreamWriter writer(boost::bind(&RESTStreamReply::Write, &stream, _1));
+        std::string bitmapStringRepresentation;
+        for (size_t i = 0; i < vOutPoints.size(); i++)
+            bitmapStringRepresentation.append(hits[i] ? "1" : "0");
+        writer.BeginObject();
+        writer.Key("chainHeight");
+        writer.Value(nHeight);
+        writer.Key("chaintipHash");
+        writer.Value(hashTip.GetHex());
+        writer.Key("bitmap");
+        writer.Value(bitmapStringRepresentation);
+        writer.Key("utxos");
+        writer.BeginArray();
+        for (size_t i = 0; i < vOutPoints.size(); i++) {
+            if (vCoinIndex[i] < 0)
+                continue;
+            const CCoins& coins = vCoins[vCoinIndex[i]];
+            UniValue utxo(UniValue::VOBJ);
+            utxo.push_back(Pair("txvers", (int32_t)coins.nVersion));
+            utxo.push_back(Pair("height", (int32_t)coins.nHeight));
+            utxo.push_back(Pair("value", ValueFromAmount(coins.vout[vOutPoints[i].n].nValue)));
+            UniValue o(UniValue::VOBJ);
+            ScriptPubKeyToJSON(coins.vout[vOutPoints[i].n].scriptPubKey, o, true);
+            utxo.push_back(Pair("scriptPubKey", o));
+            writer.Value(utxo);
+        }
+        writer.EndArray();
+        writer.EndObject();
+        stream.End(writer.Release());
+        return true;
+    }
+
+    // same output as /rest/getutxos, with the outputs written as they are serialized
+    vector<unsigned char> bitmap;
+    boost::to_block_range(hits, std::back_inserter(bitmap));
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << nHeight << hashTip << bitmap;
+    WriteCompactSize(ss, hits.count());
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        if (vCoinIndex[i] < 0)
+            continue;
+        const CCoins& coins = vCoins[vCoinIndex[i]];
+        CCoin coin;
+        coin.nTxVer = coins.nVersion;
+        coin.nHeight = coins.nHeight;
+        coin.out = coins.vout[vOutPoints[i].n];
+        ss << coin;
+        stream.WriteBuffered(ss);
+    }
+    stream.End(ss.str());
+    return true;
+}
+
+static bool rest_bulk_tx(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckBulkMethod(req))
+        return false;
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    std::vector<uint256> vHash;
+    if (!ReadBulkHashes(req->ReadBody(), rf, vHash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Parse error");
+    if (vHash.empty())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Error: empty request");
+    if (vHash.size() > MAX_BULK_TXS)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Error: max transactions exceeded (max: %d, tried: %d)", MAX_BULK_TXS, vHash.size()));
+
+    // Output is a vector of optional transactions: a flag telling whether it was found,
+    // followed by the transaction if it was. JSON output has null for those not found.
+    RESTStreamReply stream(req, rf);
+    CJSONStreamWriter writer(boost::bind(&RESTStreamReply::Write, &stream, _1));
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    if (rf == RF_JSON)
+        writer.BeginArray();
+    else
+        WriteCompactSize(ss, vHash.size());
+
+    // transactions are read in batches to bound memory use
+    for (size_t nStart = 0; nStart < vHash.size(); nStart += BULK_TX_BATCH_SIZE) {
+        std::vector<uint256> vBatch(vHash.begin() + nStart, vHash.begin() + std::min(nStart + BULK_TX_BATCH_SIZE, vHash.size()));
+        std::vector<CTransaction> vTx;
+        std::vector<uint256> vHashBlock;
+        std::vector<bool> vFound;
+        GetTransactions(vBatch, vTx, vHashBlock, vFound, Params().GetConsensus());
+        for (size_t i = 0; i < vBatch.size(); i++) {
+            if (rf == RF_JSON) {
+                UniValue objTx(UniValue::VOBJ);
+                if (vFound[i])
+                    TxToJSON(vTx[i], vHashBlock[i], objTx);
+                writer.Value(vFound[i] ? objTx : NullUniValue);
+            } else {
+                ss << (bool)vFound[i];
+                if (vFound[i])
+                    ss << vTx[i];
+                stream.WriteBuffered(ss);
+            }
+        }
+    }
+
+    if (rf == RF_JSON) {
+        writer.EndArray();
+        stream.End(writer.Release());
+    } else {
+        stream.End(ss.str());
+    }
+    return true;
+}
+
+static bool rest_bulk_headers(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckBulkMethod(req))
+        return false;
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    std::vector<uint256> vHash;
+    if (!ReadBulkHashes(req->ReadBody(), rf, vHash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Parse error");
+    if (vHash.empty())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Error: empty request");
+    if (vHash.size() > MAX_BULK_HEADERS)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Error: max headers exceeded (max: %d, tried: %d)", MAX_BULK_HEADERS, vHash.size()));
+
+    std::vector<const CBlockIndex*> vIndex(vHash.size(), NULL);
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < vHash.size(); i++) {
+            BlockMap::const_iterator it = mapBlockIndex.find(vHash[i]);
+            if (it != mapBlockIndex.end())
+                vIndex[i] = it->second;
+        }
+    }
+
+    // same layout as /rest/bulk/tx, a flag followed by the header if it is known
+    RESTStreamReply stream(req, rf);
+    if (rf == RF_JSON) {
+        CJSONStreamWriter writer(boost::bind(&RESTStreamReply::Write, &stream, _1));
+        writer.BeginArray();
+        BOOST_FOREACH(const CBlockIndex* pindex, vIndex)
+            writer.Value(pindex ? blockheaderToJSON(pindex) : NullUniValue);
+        writer.EndArray();
+        stream.End(writer.Release());
+        return true;
+    }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, vIndex.size());
+    BOOST_FOREACH(const CBlockIndex* pindex, vIndex) {
+        ss << (bool)(pindex != NULL);
+        if (pindex)
+            ss << pindex->GetBlockHeader();
+        stream.WriteBuffered(ss);
+    }
+    stream.End(ss.str());
+    return true;
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
+    HTTPPriority priority;
 } uri_prefixes[] = {
-      {"/rest/tx/", rest_tx},
-      {"/rest/block/notxdetails/", rest_block_notxdetails},
-      {"/rest/block/", rest_block_extended},
-      {"/rest/chaininfo", rest_chaininfo},
-      {"/rest/mempool/info", rest_mempool_info},
-      {"/rest/mempool/contents", rest_mempool_contents},
-      {"/rest/headers/", rest_headers},
-      {"/rest/getutxos", rest_getutxos},
+      {"/rest/tx/", rest_tx, HTTP_PRIORITY_NORMAL},
+      {"/rest/block/notxdetails/", rest_block_notxdetails, HTTP_PRIORITY_NORMAL},
+      {"/rest/block/", rest_block_extended, HTTP_PRIORITY_LOW},
+      {"/rest/chaininfo", rest_chaininfo, HTTP_PRIORITY_HIGH},
+      {"/rest/mempool/info", rest_mempool_info, HTTP_PRIORITY_HIGH},
+      {"/rest/mempool/contents", rest_mempool_contents, HTTP_PRIORITY_LOW},
+      {"/rest/headers/", rest_headers, HTTP_PRIORITY_NORMAL},
+      {"/rest/getutxos", rest_getutxos, HTTP_PRIORITY_NORMAL},
+      {"/rest/bulk/getutxos", rest_bulk_getutxos, HTTP_PRIORITY_LOW},
+      {"/rest/bulk/tx", rest_bulk_tx, HTTP_PRIORITY_LOW},
+      {"/rest/bulk/headers", rest_bulk_headers, HTTP_PRIORITY_LOW},
 };
 
+/** REST requests are scheduled by path, every path is its own endpoint */
+static HTTPWorkClass rest_work_class(HTTPPriority priority, const char* prefix, HTTPRequest*, const std::string&)
+{
+    return HTTPWorkClass(priority, prefix);
+}
+
 bool StartREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
-        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler,
+                            boost::bind(rest_work_class, uri_prefixes[i].priority, uri_prefixes[i].prefix, _1, _2));
     return true;
 }
 
@@ -13,7 +13,9 @@
 #include "main.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "responsecache.h"
 #include "rpcserver.h"
+#include "rpcstream.h"
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
@@ -60,14 +62,15 @@ double GetDifficulty(const CBlockIndex* blockindex)
     return dDiff;
 }
 
-UniValue blockheaderToJSON(const CBlockIndex* blockindex)
+/** Header of a block relative to a chain tip snapshot, does not need cs_main */
+static UniValue blockheaderToJSON(const CBlockIndex* blockindex, const CChainTipSnapshot& tip)
 {
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    if (tip.Contains(blockindex))
+        confirmations = tip.nHeight - blockindex->nHeight + 1;
     result.push_back(Pair("confirmations", confirmations));
     result.push_back(Pair("height", blockindex->nHeight));
     result.push_back(Pair("version", blockindex->nVersion));
@@ -81,12 +84,17 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
 
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+    const CBlockIndex *pnext = confirmations > 1 ? tip.GetAncestor(blockindex->nHeight + 1) : NULL;
     if (pnext)
         result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
     return result;
 }
 
+UniValue blockheaderToJSON(const CBlockIndex* blockindex)
+{
+    return blockheaderToJSON(blockindex, *GetChainTipSnapshot());
+}
+
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
 {
     UniValue result(UniValue::VOBJ);
@@ -141,8 +149,7 @@ UniValue getblockcount(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockcount", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    return GetChainTipSnapshot()->nHeight;
 }
 
 UniValue getbestblockhash(const UniValue& params, bool fHelp)
@@ -158,8 +165,7 @@ UniValue getbestblockhash(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    return GetChainTipSnapshot()->hashBlock.GetHex();
 }
 
 UniValue getdifficulty(const UniValue& params, bool fHelp)
@@ -175,8 +181,78 @@ UniValue getdifficulty(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getdifficulty", "")
         );
 
-    LOCK(cs_main);
-    return GetDifficulty();
+    boost::shared_ptr<const CChainTipSnapshot> tip = GetChainTipSnapshot();
+    return tip->pindex ? GetDifficulty(tip->pindex) : 1.0;
+}
+
+/** What the verbose mempool output shows of an entry, copied so it can be written without locks */
+struct CMempoolEntryInfo
+{
+    uint256 hash;
+    size_t nSize;
+    CAmount nFee;
+    CAmount nModifiedFee;
+    int64_t nTime;
+    unsigned int nHeight;
+    double dStartingPriority;
+    double dCurrentPriority;
+    uint64_t nCountWithDescendants;
+    uint64_t nSizeWithDescendants;
+    CAmount nModFeesWithDescendants;
+    std::set<uint256> setDepends;
+};
+
+/** Copy the fields of an entry, mempool.cs must be held */
+static void GetMempoolEntryInfo(const CTxMemPoolEntry& e, CMempoolEntryInfo& info)
+{
+    AssertLockHeld(mempool.cs);
+    const CTransaction& tx = e.GetTx();
+    info.hash = tx.GetHash();
+    info.nSize = e.GetTxSize();
+    info.nFee = e.GetFee();
+    info.nModifiedFee = e.GetModifiedFee();
+    info.nTime = e.GetTime();
+    info.nHeight = e.GetHeight();
+    info.dStartingPriority = e.GetPriority(e.GetHeight());
+    info.dCurrentPriority = e.GetPriority(chainActive.Height());
+    info.nCountWithDescendants = e.GetCountWithDescendants();
+    info.nSizeWithDescendants = e.GetSizeWithDescendants();
+    info.nModFeesWithDescendants = e.GetModFeesWithDescendants();
+    info.setDepends.clear();
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        if (mempool.exists(txin.prevout.hash))
+            info.setDepends.insert(txin.prevout.hash);
+    }
+}
+
+static UniValue mempoolEntryToJSON(const CMempoolEntryInfo& e)
+{
+    UniValue info(UniValue::VOBJ);
+    info.push_back(Pair("size", (int)e.nSize));
+    info.push_back(Pair("fee", ValueFromAmount(e.nFee)));
+    info.push_back(Pair("modifiedfee", ValueFromAmount(e.nModifiedFee)));
+    info.push_back(Pair("time", e.nTime));
+    info.push_back(Pair("height", (int)e.nHeight));
+    info.push_back(Pair("startingpriority", e.dStartingPriority));
+    info.push_back(Pair("currentpriority", e.dCurrentPriority));
+    info.push_back(Pair("descendantcount", e.nCountWithDescendants));
+    info.push_back(Pair("descendantsize", e.nSizeWithDescendants));
+    info.push_back(Pair("descendantfees", e.nModFeesWithDescendants));
+
+    // sorted by their hex string, like before the fields were copied
+    set<string> setDepends;
+    BOOST_FOREACH(const uint256& dep, e.setDepends)
+        setDepends.insert(dep.ToString());
+
+    UniValue depends(UniValue::VARR);
+    BOOST_FOREACH(const string& dep, setDepends)
+    {
+        depends.push_back(dep);
+    }
+
+    info.push_back(Pair("depends", depends));
+    return info;
 }
 
 UniValue mempoolToJSON(bool fVerbose = false)
@@ -185,36 +261,11 @@ UniValue mempoolToJSON(bool fVerbose = false)
     {
         LOCK(mempool.cs);
         UniValue o(UniValue::VOBJ);
+        CMempoolEntryInfo info;
         BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
         {
-            const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("modifiedfee", ValueFromAmount(e.GetModifiedFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
-            info.push_back(Pair("descendantcount", e.GetCountWithDescendants()));
-            info.push_back(Pair("descendantsize", e.GetSizeWithDescendants()));
-            info.push_back(Pair("descendantfees", e.GetModFeesWithDescendants()));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            BOOST_FOREACH(const CTxIn& txin, tx.vin)
-            {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
-
-            UniValue depends(UniValue::VARR);
-            BOOST_FOREACH(const string& dep, setDepends)
-            {
-                depends.push_back(dep);
-            }
-
-            info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
+            GetMempoolEntryInfo(e, info);
+            o.push_back(Pair(info.hash.ToString(), mempoolEntryToJSON(info)));
         }
         return o;
     }
@@ -231,6 +282,43 @@ UniValue mempoolToJSON(bool fVerbose = false)
     }
 }
 
+/**
+ * Same as mempoolToJSON, without holding more than one entry as UniValue. The entries are
+ * copied first and written without locks, as writing waits for the client to read.
+ */
+void mempoolToJSON(CJSONStreamWriter& writer, bool fVerbose = false)
+{
+    if (fVerbose)
+    {
+        std::vector<CMempoolEntryInfo> vInfo;
+        {
+            LOCK2(cs_main, mempool.cs);
+            vInfo.resize(mempool.mapTx.size());
+            size_t i = 0;
+            BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
+                GetMempoolEntryInfo(e, vInfo[i++]);
+        }
+
+        writer.BeginObject();
+        BOOST_FOREACH(const CMempoolEntryInfo& info, vInfo)
+        {
+            writer.Key(info.hash.ToString());
+            writer.Value(mempoolEntryToJSON(info));
+        }
+        writer.EndObject();
+    }
+    else
+    {
+        vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+
+        writer.BeginArray();
+        BOOST_FOREACH(const uint256& hash, vtxid)
+            writer.Value(hash.ToString());
+        writer.EndArray();
+    }
+}
+
 UniValue getrawmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -276,6 +364,21 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     return mempoolToJSON(fVerbose);
 }
 
+void streamrawmempool(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() > 1) {
+        // Let getrawmempool explain the usage
+        writer.Value(getrawmempool(params, false));
+        return;
+    }
+
+    bool fVerbose = false;
+    if (params.size() > 0)
+        fVerbose = params[0].get_bool();
+
+    mempoolToJSON(writer, fVerbose);
+}
+
 UniValue getblockhashes(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 2)
@@ -325,13 +428,11 @@ UniValue getblockhash(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockhash", "1000")
         );
 
-    LOCK(cs_main);
-
     int nHeight = params[0].get_int();
-    if (nHeight < 0 || nHeight > chainActive.Height())
+    const CBlockIndex* pblockindex = GetChainTipSnapshot()->GetAncestor(nHeight);
+    if (!pblockindex)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
-    CBlockIndex* pblockindex = chainActive[nHeight];
     return pblockindex->GetBlockHash().GetHex();
 }
 
@@ -368,8 +469,6 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockheader", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -377,10 +476,16 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    boost::shared_ptr<const CChainTipSnapshot> tip = GetChainTipSnapshot();
+    const CBlockIndex* pblockindex;
+    {
+        // cs_main only guards the lookup, block index entries stay valid while running
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mi->second;
+    }
 
     if (!fVerbose)
     {
@@ -390,7 +495,7 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
         return strHex;
     }
 
-    return blockheaderToJSON(pblockindex);
+    return blockheaderToJSON(pblockindex, *tip);
 }
 
 UniValue getblockheaders(const UniValue& params, bool fHelp)
@@ -538,6 +643,14 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
 
+    // shares cache entries with /rest/block/<hash>.hex
+    const bool fBuried = !fVerbose && IsBlockBuried(pblockindex);
+    const std::string strKey = CResponseCache::MakeKey("block", "hex", hash);
+    std::string strHex;
+    uint256 hashBlock;
+    if (fBuried && responseCache.Get(strKey, strHex, hashBlock))
+        return strHex;
+
     if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 
@@ -545,7 +658,9 @@ UniValue getblock(const UniValue& params, bool fHelp)
     {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
         ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
+        strHex = HexStr(ssBlock.begin(), ssBlock.end());
+        if (fBuried)
+            responseCache.Put(strKey, strHex, hash);
         return strHex;
     }
 
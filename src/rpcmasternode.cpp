@@ -5,6 +5,7 @@
 #include "activemasternode.h"
 #include "darksend.h"
 #include "init.h"
+#include "instantx.h"
 #include "main.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
@@ -88,6 +89,109 @@ UniValue getpoolinfo(const UniValue& params, bool fHelp)
     return obj;
 }
 
+UniValue getinstantsendlock(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getinstantsendlock \"txid\"\n"
+            "Returns the state and per-phase timing of an InstantSend Transaction Lock.\n"
+            "\nArguments:\n"
+            "1. \"txid\"    (string, required) The transaction id\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\": \"xxxx\",        (string) The transaction id\n"
+            "  \"signatures\": n,       (numeric) Number of lock signatures received so far\n"
+            "  \"orphanvotes\": n,      (numeric) Number of signatures received before the lock request\n"
+            "  \"locked\": true|false,  (boolean) Whether all inputs are locked\n"
+            "  \"timereceived\": n,     (numeric) When the lock request was received, in milliseconds since epoch\n"
+            "  \"timefirstvote\": n,    (numeric) When the first signature was received, in milliseconds since epoch (if any)\n"
+            "  \"timeready\": n,        (numeric) When all inputs had enough signatures, in milliseconds since epoch (if any)\n"
+            "  \"timelocked\": n,       (numeric) When the lock completed, in milliseconds since epoch (only if locked)\n"
+            "  \"latency\": n           (numeric) Time from request to lock in milliseconds (only if locked)\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getinstantsendlock", "\"txid\"")
+            + HelpExampleRpc("getinstantsendlock", "\"txid\"")
+        );
+
+    uint256 txHash = ParseHashV(params[0], "txid");
+
+    CTxLockTimes times;
+    if (!instantsend.GetTxLockTimes(txHash, times))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No InstantSend Transaction Lock Request for this transaction");
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("txid",          txHash.GetHex()));
+    obj.push_back(Pair("signatures",    times.nVotes));
+    obj.push_back(Pair("orphanvotes",   times.nOrphanVotes));
+    obj.push_back(Pair("locked",        times.nTimeLocked != 0));
+    obj.push_back(Pair("timereceived",  times.nTimeReceived / 1000));
+    if (times.nTimeFirstVote != 0)
+        obj.push_back(Pair("timefirstvote", times.nTimeFirstVote / 1000));
+    if (times.nTimeReady != 0)
+        obj.push_back(Pair("timeready",     times.nTimeReady / 1000));
+    if (times.nTimeLocked != 0) {
+        obj.push_back(Pair("timelocked",    times.nTimeLocked / 1000));
+        obj.push_back(Pair("latency",       (times.nTimeLocked - times.nTimeReceived) / 1000));
+    }
+
+    return obj;
+}
+
+static UniValue LockLatencyToJSON(const CLockLatencyWindow& window)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("count",         (uint64_t)window.GetTotal()));
+    obj.push_back(Pair("samples",       (uint64_t)window.GetSize()));
+    obj.push_back(Pair("p50",           window.GetPercentile(50) * 0.001));
+    obj.push_back(Pair("p95",           window.GetPercentile(95) * 0.001));
+    obj.push_back(Pair("p99",           window.GetPercentile(99) * 0.001));
+    obj.push_back(Pair("max",           window.GetMax() * 0.001));
+    return obj;
+}
+
+UniValue getinstantsendstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+            "getinstantsendstats\n"
+            "Returns latency percentiles of the recently completed InstantSend Transaction Locks.\n"
+            "Each lock is split into phases: request received -> first signature -> enough signatures\n"
+            "for every input -> inputs locked. Percentiles are computed over the last 1000 locks.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"firstvote\": {...},    (object) Time from the lock request to its first signature\n"
+            "  \"quorum\": {...},       (object) Time from the first signature to enough signatures for every input\n"
+            "  \"finalize\": {...},     (object) Time to resolve conflicts and lock the inputs\n"
+            "  \"total\": {            (object) Time from the lock request to the completed lock\n"
+            "    \"count\": n,          (numeric) Number of locks completed since startup\n"
+            "    \"samples\": n,        (numeric) Number of locks the percentiles are computed over\n"
+            "    \"p50\": n,            (numeric) Median, in milliseconds\n"
+            "    \"p95\": n,            (numeric) 95th percentile, in milliseconds\n"
+            "    \"p99\": n,            (numeric) 99th percentile, in milliseconds\n"
+            "    \"max\": n             (numeric) Maximum, in milliseconds\n"
+            "  },\n"
+            "  \"orphanvotes\": n,      (numeric) Number of signatures received before their lock request since startup\n"
+            "  \"orphanvotespending\": n (numeric) Number of signatures currently waiting for their lock request\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getinstantsendstats", "")
+            + HelpExampleRpc("getinstantsendstats", "")
+        );
+
+    CInstantSendLatencyStats stats = instantsend.GetLatencyStats();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("firstvote",             LockLatencyToJSON(stats.firstVote)));
+    obj.push_back(Pair("quorum",                LockLatencyToJSON(stats.quorum)));
+    obj.push_back(Pair("finalize",              LockLatencyToJSON(stats.finalize)));
+    obj.push_back(Pair("total",                 LockLatencyToJSON(stats.total)));
+    obj.push_back(Pair("orphanvotes",           (uint64_t)stats.nOrphanVotes));
+    obj.push_back(Pair("orphanvotespending",    instantsend.GetOrphanVoteCount()));
+
+    return obj;
+}
+
 
 UniValue masternode(const UniValue& params, bool fHelp)
 {
@@ -167,16 +271,21 @@ UniValue masternode(const UniValue& params, bool fHelp)
         if (strMode == "enabled")
             return mnodeman.CountEnabled();
 
-        int nCount;
-        mnodeman.GetNextMasternodeInQueueForPayment(true, nCount);
+        // ranking the list needs cs_main, use the counts taken at the last block when there are some
+        CMasternodeCounts counts = mnodeman.GetLastCounts();
+        if (counts.nHeight < 0) {
+            counts.nTotal = mnodeman.size();
+            counts.nEnabledPS = mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION);
+            counts.nEnabled = mnodeman.CountEnabled();
+            mnodeman.GetNextMasternodeInQueueForPayment(true, counts.nQualify);
+        }
 
         if (strMode == "qualify")
-            return nCount;
+            return counts.nQualify;
 
         if (strMode == "all")
             return strprintf("Total: %d (PS Compatible: %d / Enabled: %d / Qualify: %d)",
-                mnodeman.size(), mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION),
-                mnodeman.CountEnabled(), nCount);
+                counts.nTotal, counts.nEnabledPS, counts.nEnabled, counts.nQualify);
     }
 
     if (strCommand == "current" || strCommand == "winner")
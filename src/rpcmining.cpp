@@ -496,7 +496,9 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
             checktxtime = boost::get_system_time() + boost::posix_time::minutes(1);
 
             boost::unique_lock<boost::mutex> lock(csBestBlock);
-            while (chainActive.Tip()->GetBlockHash() == hashWatchedChain && IsRPCRunning())
+            // With -precomputetemplate wait for the template of the new tip rather than the tip itself,
+            // so we can answer right away instead of building a template here
+            while ((blockTemplateCache.IsEnabled() ? blockTemplateCache.GetPublishedTipHash() : chainActive.Tip()->GetBlockHash()) == hashWatchedChain && IsRPCRunning())
             {
                 if (!cvBlockChange.timed_wait(lock, checktxtime))
                 {
@@ -518,11 +520,30 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
     static CBlockTemplate* pblocktemplate;
+    static uint64_t nTemplateSequence;
+    if (blockTemplateCache.IsEnabled() &&
+        (pindexPrev != chainActive.Tip() || nTemplateSequence != blockTemplateCache.GetSequence()))
+    {
+        // Take the template precomputed by the background thread if it has one for our tip
+        unsigned int nTransactionsUpdatedCached;
+        uint64_t nSequenceCached;
+        CBlockTemplate* pblocktemplateCached = blockTemplateCache.GetTemplate(chainActive.Tip(), nTransactionsUpdatedCached, nSequenceCached);
+        if (pblocktemplateCached)
+        {
+            delete pblocktemplate;
+            pblocktemplate = pblocktemplateCached;
+            pindexPrev = chainActive.Tip();
+            nTransactionsUpdatedLast = nTransactionsUpdatedCached;
+            nTemplateSequence = nSequenceCached;
+            nStart = GetTime();
+        }
+    }
     if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
+        (!blockTemplateCache.IsEnabled() && mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = NULL;
+        nTemplateSequence = 0;
 
         // Store the chainActive.Tip() used before CreateNewBlock, to avoid races
         nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
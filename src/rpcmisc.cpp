@@ -6,11 +6,14 @@
 
 #include "base58.h"
 #include "clientversion.h"
+#include "httpserver.h"
+#include "compat/byteswap.h"
 #include "init.h"
 #include "main.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpcserver.h"
+#include "rpcstream.h"
 #include "timedata.h"
 #include "txmempool.h"
 #include "util.h"
@@ -75,10 +78,30 @@ UniValue getinfo(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getinfo", "")
         );
 
+    // Chain fields come from the tip snapshot, so nothing here waits for cs_main
+    boost::shared_ptr<const CChainTipSnapshot> tip = GetChainTipSnapshot();
+    int nConnections;
+    {
+        LOCK(cs_vNodes);
+        nConnections = vNodes.size();
+    }
+
 #ifdef ENABLE_WALLET
-    LOCK2(cs_main, pwalletMain ? &pwalletMain->cs_wallet : NULL);
-#else
-    LOCK(cs_main);
+    UniValue objWallet(UniValue::VOBJ);
+    UniValue objKeyPool(UniValue::VOBJ);
+    if (pwalletMain) {
+        // cached, only recomputing them takes cs_main, which must not be taken under cs_wallet
+        CWalletBalances balances = pwalletMain->GetBalances();
+        LOCK(pwalletMain->cs_wallet);
+        objWallet.push_back(Pair("walletversion", pwalletMain->GetVersion()));
+        objWallet.push_back(Pair("balance",       ValueFromAmount(balances.nBalance)));
+        if(!fLiteMode)
+            objWallet.push_back(Pair("privatesend_balance",       ValueFromAmount(balances.nAnonymized)));
+        objKeyPool.push_back(Pair("keypoololdest", pwalletMain->GetOldestKeyPoolTime()));
+        objKeyPool.push_back(Pair("keypoolsize",   (int)pwalletMain->GetKeyPoolSize()));
+        if (pwalletMain->IsCrypted())
+            objKeyPool.push_back(Pair("unlocked_until", nWalletUnlockTime));
+    }
 #endif
 
     proxyType proxy;
@@ -88,26 +111,16 @@ UniValue getinfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("version", CLIENT_VERSION));
     obj.push_back(Pair("protocolversion", PROTOCOL_VERSION));
 #ifdef ENABLE_WALLET
-    if (pwalletMain) {
-        obj.push_back(Pair("walletversion", pwalletMain->GetVersion()));
-        obj.push_back(Pair("balance",       ValueFromAmount(pwalletMain->GetBalance())));
-        if(!fLiteMode)
-            obj.push_back(Pair("privatesend_balance",       ValueFromAmount(pwalletMain->GetAnonymizedBalance())));
-    }
+    obj.pushKVs(objWallet);
 #endif
-    obj.push_back(Pair("blocks",        (int)chainActive.Height()));
+    obj.push_back(Pair("blocks",        tip->nHeight));
     obj.push_back(Pair("timeoffset",    GetTimeOffset()));
-    obj.push_back(Pair("connections",   (int)vNodes.size()));
+    obj.push_back(Pair("connections",   nConnections));
     obj.push_back(Pair("proxy",         (proxy.IsValid() ? proxy.proxy.ToStringIPPort() : string())));
-    obj.push_back(Pair("difficulty",    (double)GetDifficulty()));
+    obj.push_back(Pair("difficulty",    tip->pindex ? GetDifficulty(tip->pindex) : 1.0));
     obj.push_back(Pair("testnet",       Params().TestnetToBeDeprecatedFieldRPC()));
 #ifdef ENABLE_WALLET
-    if (pwalletMain) {
-        obj.push_back(Pair("keypoololdest", pwalletMain->GetOldestKeyPoolTime()));
-        obj.push_back(Pair("keypoolsize",   (int)pwalletMain->GetKeyPoolSize()));
-    }
-    if (pwalletMain && pwalletMain->IsCrypted())
-        obj.push_back(Pair("unlocked_until", nWalletUnlockTime));
+    obj.pushKVs(objKeyPool);
     obj.push_back(Pair("paytxfee",      ValueFromAmount(payTxFee.GetFeePerK())));
 #endif
     obj.push_back(Pair("relayfee",      ValueFromAmount(::minRelayTxFee.GetFeePerK())));
@@ -139,6 +152,77 @@ UniValue debug(const UniValue& params, bool fHelp)
     return "Debug mode: " + (fDebug ? strMode : "off");
 }
 
+UniValue gethttpqueueinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "gethttpqueueinfo\n"
+            "Returns the state of the work queue of the RPC and REST server.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"threads\": n,                (numeric) number of worker threads\n"
+            "  \"classes\": {                 (json object) one entry per priority class (high, normal, low)\n"
+            "    \"high\": {\n"
+            "      \"depth\": n,              (numeric) requests waiting\n"
+            "      \"maxdepth\": n,           (numeric) requests that may wait before new ones are rejected\n"
+            "      \"running\": n,            (numeric) requests being served\n"
+            "      \"processed\": n,          (numeric) requests taken from the queue\n"
+            "      \"rejected\": n,           (numeric) requests rejected because the queue was full\n"
+            "      \"avgwaitms\": x.xxx,      (numeric) average time requests waited, in milliseconds\n"
+            "      \"maxwaitms\": x.xxx       (numeric) longest time a request waited, in milliseconds\n"
+            "    },\n"
+            "    ...\n"
+            "  },\n"
+            "  \"endpoints\": {               (json object) RPC methods and REST paths that were queued\n"
+            "    \"getaddressdeltas\": {\n"
+            "      \"queued\": n,             (numeric) requests waiting\n"
+            "      \"running\": n,            (numeric) requests being served\n"
+            "      \"limit\": n,              (numeric) requests served at once at most, 0 for no limit\n"
+            "      \"processed\": n           (numeric) requests taken from the queue\n"
+            "    },\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("gethttpqueueinfo", "")
+            + HelpExampleRpc("gethttpqueueinfo", "")
+        );
+
+    HTTPWorkQueueStats stats;
+    if (!GetHTTPWorkQueueStats(stats))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "HTTP server is not running");
+
+    UniValue classes(UniValue::VOBJ);
+    for (int p = 0; p < HTTP_PRIORITY_COUNT; p++) {
+        const HTTPWorkClassStats& classStats = stats.classes[p];
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("depth",     (uint64_t)classStats.nDepth));
+        obj.push_back(Pair("maxdepth",  (uint64_t)classStats.nMaxDepth));
+        obj.push_back(Pair("running",   classStats.nRunning));
+        obj.push_back(Pair("processed", classStats.nProcessed));
+        obj.push_back(Pair("rejected",  classStats.nRejected));
+        obj.push_back(Pair("avgwaitms", classStats.nProcessed ? 0.001 * classStats.nWaitTimeTotal / classStats.nProcessed : 0.0));
+        obj.push_back(Pair("maxwaitms", 0.001 * classStats.nWaitTimeMax));
+        classes.push_back(Pair(HTTPPriorityName((HTTPPriority)p), obj));
+    }
+
+    UniValue endpoints(UniValue::VOBJ);
+    for (std::map<std::string, HTTPEndpointStats>::const_iterator it = stats.mapEndpoints.begin(); it != stats.mapEndpoints.end(); ++it) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("queued",    (uint64_t)it->second.nQueued));
+        obj.push_back(Pair("running",   it->second.nRunning));
+        obj.push_back(Pair("limit",     it->second.nLimit));
+        obj.push_back(Pair("processed", it->second.nProcessed));
+        endpoints.push_back(Pair(it->first, obj));
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("threads",   stats.nThreads));
+    ret.push_back(Pair("classes",   classes));
+    ret.push_back(Pair("endpoints", endpoints));
+    return ret;
+}
+
 UniValue mnsync(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -569,6 +653,144 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+/** Order of address index entries when merging the histories of several addresses: the
+    order of the database keys without the address (index is stored little endian) */
+bool addressIndexPositionSort(const std::pair<CAddressIndexKey, CAmount>& a,
+                              const std::pair<CAddressIndexKey, CAmount>& b) {
+    if (a.first.blockHeight != b.first.blockHeight)
+        return a.first.blockHeight < b.first.blockHeight;
+    if (a.first.txindex != b.first.txindex)
+        return a.first.txindex < b.first.txindex;
+    if (a.first.txhash != b.first.txhash)
+        return a.first.txhash < b.first.txhash;
+    if (a.first.index != b.first.index)
+        return bswap_32(a.first.index) < bswap_32(b.first.index);
+    return a.first.spending < b.first.spending;
+}
+
+bool addressUnspentPositionSort(const std::pair<CAddressUnspentKey, CAddressUnspentValue>& a,
+                                const std::pair<CAddressUnspentKey, CAddressUnspentValue>& b) {
+    if (a.first.txhash != b.first.txhash)
+        return a.first.txhash < b.first.txhash;
+    return bswap_32(a.first.index) < bswap_32(b.first.index);
+}
+
+/** Read the optional "limit" and "cursor" of an address request, returns whether the caller asked for a page */
+bool getPageFromParams(const UniValue& params, size_t& nLimit, std::vector<std::string>& vCursor)
+{
+    size_t nMaxResults = std::max((int64_t)1, GetArg("-rpcmaxaddressresults", DEFAULT_RPC_MAX_ADDRESS_RESULTS));
+    nLimit = nMaxResults;
+    vCursor.clear();
+
+    if (!params[0].isObject())
+        return false;
+
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (limitValue.isNull()) {
+        if (!cursorValue.isNull())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "A cursor can only be used together with a limit");
+        return false;
+    }
+
+    int64_t nLimitParam = limitValue.get_int64();
+    if (nLimitParam <= 0 || (uint64_t)nLimitParam > nMaxResults)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Limit must be between 1 and %u", nMaxResults));
+    nLimit = nLimitParam;
+
+    if (!cursorValue.isNull())
+        boost::split(vCursor, cursorValue.get_str(), boost::is_any_of(":"));
+
+    return true;
+}
+
+/** Cursors are "height:blockindex:txid:index:spending" for the history of addresses... */
+std::string getAddressIndexCursor(const CAddressIndexKey& key)
+{
+    return strprintf("%d:%u:%s:%u:%d", key.blockHeight, key.txindex, key.txhash.GetHex(), key.index, key.spending);
+}
+
+/** ...and "txid:index" for their unspent outputs */
+std::string getAddressUnspentCursor(const CAddressUnspentKey& key)
+{
+    return strprintf("%s:%u", key.txhash.GetHex(), key.index);
+}
+
+bool parseCursorTxid(const std::string& str, uint256& hash)
+{
+    if (str.size() != 64 || !IsHex(str))
+        return false;
+    hash = uint256S(str);
+    return true;
+}
+
+void parseAddressIndexCursor(const std::vector<std::string>& vCursor, CAddressIndexKey& key)
+{
+    int32_t nHeight, nBlockIndex, nIndex, nSpending;
+    if (vCursor.size() != 5 || !ParseInt32(vCursor[0], &nHeight) || !ParseInt32(vCursor[1], &nBlockIndex) ||
+        !parseCursorTxid(vCursor[2], key.txhash) || !ParseInt32(vCursor[3], &nIndex) || !ParseInt32(vCursor[4], &nSpending))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    key.blockHeight = nHeight;
+    key.txindex = nBlockIndex;
+    key.index = (uint32_t)nIndex;
+    key.spending = nSpending != 0;
+}
+
+void parseAddressUnspentCursor(const std::vector<std::string>& vCursor, CAddressUnspentKey& key)
+{
+    int32_t nIndex;
+    if (vCursor.size() != 2 || !parseCursorTxid(vCursor[0], key.txhash) || !ParseInt32(vCursor[1], &nIndex))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    key.index = (uint32_t)nIndex;
+}
+
+/**
+ * Read up to nLimit entries of the merged history of the addresses that follow pkeyAfter,
+ * without reading more than nLimit + 1 entries of any single address. fMore is set when
+ * entries remain after the page.
+ */
+void getAddressIndexPage(const std::vector<std::pair<uint160, int> >& addresses, int start, int end,
+                         const CAddressIndexKey* pkeyAfter, size_t nLimit,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex, bool& fMore)
+{
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = addresses.begin(); it != addresses.end(); it++) {
+        if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end, pkeyAfter, nLimit + 1)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    }
+
+    if (addresses.size() > 1)
+        std::sort(addressIndex.begin(), addressIndex.end(), addressIndexPositionSort);
+
+    fMore = addressIndex.size() > nLimit;
+    if (fMore)
+        addressIndex.resize(nLimit);
+}
+
+void getAddressUnspentPage(const std::vector<std::pair<uint160, int> >& addresses,
+                           const CAddressUnspentKey* pkeyAfter, size_t nLimit,
+                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& unspentOutputs, bool& fMore)
+{
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = addresses.begin(); it != addresses.end(); it++) {
+        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs, pkeyAfter, nLimit + 1)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    }
+
+    if (addresses.size() > 1)
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), addressUnspentPositionSort);
+
+    fMore = unspentOutputs.size() > nLimit;
+    if (fMore)
+        unspentOutputs.resize(nLimit);
+}
+
+void throwTooManyAddressResults()
+{
+    throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("More than %d results, use \"limit\" and \"cursor\" to page through them",
+                                                       GetArg("-rpcmaxaddressresults", DEFAULT_RPC_MAX_ADDRESS_RESULTS)));
+}
+
 UniValue getaddressmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -653,6 +875,8 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            "  \"limit\"  (number, optional) Return a page of at most this many outputs, in txid order\n"
+            "  \"cursor\"  (string, optional) The cursor of the previous page\n"
             "}\n"
             "\nResult\n"
             "[\n"
@@ -665,9 +889,15 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "    \"satoshis\"  (number) The number of satoshis of the output\n"
             "  }\n"
             "]\n"
+            "\nResult (with limit):\n"
+            "{\n"
+            "  \"utxos\"  (array) The outputs, as above\n"
+            "  \"cursor\"  (string) The cursor of the next page, missing on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"]}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"]}")
+            + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"], \"limit\": 1000}'")
         );
 
     std::vector<std::pair<uint160, int> > addresses;
@@ -676,17 +906,25 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t nLimit;
+    std::vector<std::string> vCursor;
+    bool fPaged = getPageFromParams(params, nLimit, vCursor);
+
+    CAddressUnspentKey keyAfter;
+    if (!vCursor.empty())
+        parseAddressUnspentCursor(vCursor, keyAfter);
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    bool fMore = false;
+    getAddressUnspentPage(addresses, vCursor.empty() ? NULL : &keyAfter, nLimit, unspentOutputs, fMore);
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
+    if (!fPaged) {
+        if (fMore)
+            throwTooManyAddressResults();
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
     }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
-
-    UniValue result(UniValue::VARR);
+    UniValue utxos(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
         UniValue output(UniValue::VOBJ);
@@ -701,12 +939,58 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         output.push_back(Pair("script", HexStr(it->second.script.begin(), it->second.script.end())));
         output.push_back(Pair("satoshis", it->second.satoshis));
         output.push_back(Pair("height", it->second.blockHeight));
-        result.push_back(output);
+        utxos.push_back(output);
     }
 
+    if (!fPaged)
+        return utxos;
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("utxos", utxos));
+    if (fMore)
+        result.push_back(Pair("cursor", getAddressUnspentCursor(unspentOutputs.back().first)));
+
     return result;
 }
 
+void getDeltasRangeFromParams(const UniValue& params, int& start, int& end)
+{
+    UniValue startValue = find_value(params[0].get_obj(), "start");
+    UniValue endValue = find_value(params[0].get_obj(), "end");
+
+    start = 0;
+    end = 0;
+
+    if (startValue.isNum() && endValue.isNum()) {
+        start = startValue.get_int();
+        end = endValue.get_int();
+        if (end < start) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
+        }
+    }
+    if (start <= 0 || end <= 0) {
+        start = 0;
+        end = 0;
+    }
+}
+
+UniValue addressDeltaToJSON(const std::pair<CAddressIndexKey, CAmount>& entry)
+{
+    std::string address;
+    if (!getAddressFromIndex(entry.first.type, entry.first.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue delta(UniValue::VOBJ);
+    delta.push_back(Pair("satoshis", entry.second));
+    delta.push_back(Pair("txid", entry.first.txhash.GetHex()));
+    delta.push_back(Pair("index", (int)entry.first.index));
+    delta.push_back(Pair("blockindex", (int)entry.first.txindex));
+    delta.push_back(Pair("height", entry.first.blockHeight));
+    delta.push_back(Pair("address", address));
+    return delta;
+}
+
 UniValue getaddressdeltas(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1 || !params[0].isObject())
@@ -722,6 +1006,8 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\"  (number, optional) Return a page of at most this many changes\n"
+            "  \"cursor\"  (string, optional) The cursor of the previous page\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -733,65 +1019,102 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult (with limit):\n"
+            "{\n"
+            "  \"deltas\"  (array) The changes, as above\n"
+            "  \"cursor\"  (string) The cursor of the next page, missing on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"]}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"]}")
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"], \"limit\": 1000}'")
         );
 
 
-    UniValue startValue = find_value(params[0].get_obj(), "start");
-    UniValue endValue = find_value(params[0].get_obj(), "end");
+    int start, end;
+    getDeltasRangeFromParams(params, start, end);
 
-    int start = 0;
-    int end = 0;
+    std::vector<std::pair<uint160, int> > addresses;
 
-    if (startValue.isNum() && endValue.isNum()) {
-        start = startValue.get_int();
-        end = endValue.get_int();
-        if (end < start) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
-        }
+    if (!getAddressesFromParams(params, addresses)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+
+    size_t nLimit;
+    std::vector<std::string> vCursor;
+    bool fPaged = getPageFromParams(params, nLimit, vCursor);
+
+    CAddressIndexKey keyAfter;
+    if (!vCursor.empty())
+        parseAddressIndexCursor(vCursor, keyAfter);
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    bool fMore = false;
+    getAddressIndexPage(addresses, start, end, vCursor.empty() ? NULL : &keyAfter, nLimit, addressIndex, fMore);
+
+    if (!fPaged && fMore)
+        throwTooManyAddressResults();
+
+    UniValue deltas(UniValue::VARR);
+
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+        deltas.push_back(addressDeltaToJSON(*it));
+    }
+
+    if (!fPaged)
+        return deltas;
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("deltas", deltas));
+    if (fMore)
+        result.push_back(Pair("cursor", getAddressIndexCursor(addressIndex.back().first)));
+
+    return result;
+}
+
+void streamaddressdeltas(const UniValue& params, CJSONStreamWriter& writer)
+{
+    size_t nLimit;
+    std::vector<std::string> vCursor;
+    if (params.size() != 1 || !params[0].isObject() || getPageFromParams(params, nLimit, vCursor)) {
+        // Usage errors and single pages are handled by getaddressdeltas
+        writer.Value(getaddressdeltas(params, false));
+        return;
     }
 
+    int start, end;
+    getDeltasRangeFromParams(params, start, end);
+
     std::vector<std::pair<uint160, int> > addresses;
 
     if (!getAddressesFromParams(params, addresses)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    // The whole history is written a page at a time, and no faster than the client reads
+    // it (see HTTPRequest::WriteReplyChunk), so it is not capped by -rpcmaxaddressresults
+    const size_t nPageSize = 1000;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    CAddressIndexKey keyAfter;
+    bool fCursor = false;
+    bool fMore = true;
 
-    UniValue result(UniValue::VARR);
+    writer.BeginArray();
+    while (fMore) {
+        addressIndex.clear();
+        getAddressIndexPage(addresses, start, end, fCursor ? &keyAfter : NULL, nPageSize, addressIndex, fMore);
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+            writer.Value(addressDeltaToJSON(*it));
         }
 
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        result.push_back(delta);
+        if (!addressIndex.empty()) {
+            keyAfter = addressIndex.back().first;
+            fCursor = true;
+        }
     }
-
-    return result;
+    writer.EndArray();
 }
 
 UniValue getaddressbalance(const UniValue& params, bool fHelp)
@@ -824,22 +1147,43 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    // Without summaries, sum the history a page at a time so long histories don't have to fit in memory
+    const size_t nPageSize = 10000;
+
+    CAmount balance = 0;
+    CAmount received = 0;
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    addressIndex.reserve(nPageSize);
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        CAddressSummary summary;
+        if (GetAddressSummary((*it).first, (*it).second, summary)) {
+            balance += summary.balance;
+            received += summary.received;
+            continue;
         }
-    }
 
-    CAmount balance = 0;
-    CAmount received = 0;
+        CAddressIndexKey keyAfter;
+        bool fCursor = false;
+        do {
+            addressIndex.clear();
+            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, 0, 0, fCursor ? &keyAfter : NULL, nPageSize)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
-        }
-        balance += it->second;
+            for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator iti=addressIndex.begin(); iti!=addressIndex.end(); iti++) {
+                if (iti->second > 0) {
+                    received += iti->second;
+                }
+                balance += iti->second;
+            }
+
+            if (!addressIndex.empty()) {
+                keyAfter = addressIndex.back().first;
+                fCursor = true;
+            }
+        } while (addressIndex.size() == nPageSize);
     }
 
     UniValue result(UniValue::VOBJ);
@@ -850,6 +1194,71 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
 
 }
 
+UniValue getaddresssummary(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddresssummary\n"
+            "\nReturns the totals of an address(es) (requires addressindex to be enabled when the chain was indexed).\n"
+            "\nArguments:\n"
+            "{\n"
+            "  \"addresses\"\n"
+            "    [\n"
+            "      \"address\"  (string) The base58check encoded address\n"
+            "      ,...\n"
+            "    ]\n"
+            "}\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\"  (string) The base58check encoded address\n"
+            "    \"balance\"  (number) The current balance in satoshis\n"
+            "    \"received\"  (number) The total number of satoshis received (including change)\n"
+            "    \"sent\"  (number) The total number of satoshis spent\n"
+            "    \"txcount\"  (number) The number of transactions involving the address\n"
+            "    \"firstheight\"  (number) The height of the first block involving the address, -1 if none\n"
+            "    \"lastheight\"  (number) The height of the last block involving the address, -1 if none\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddresssummary", "'{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"]}'")
+            + HelpExampleRpc("getaddresssummary", "{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"]}")
+        );
+
+    std::vector<std::pair<uint160, int> > addresses;
+
+    if (!getAddressesFromParams(params, addresses)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+
+    UniValue result(UniValue::VARR);
+
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressSummary summary;
+        if (!GetAddressSummary((*it).first, (*it).second, summary)) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Address summaries are not available, reindex with -addressindex to build them");
+        }
+
+        std::string address;
+        if (!getAddressFromIndex((*it).second, (*it).first, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
+
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("address", address));
+        entry.push_back(Pair("balance", summary.balance));
+        entry.push_back(Pair("received", summary.received));
+        entry.push_back(Pair("sent", summary.sent));
+        entry.push_back(Pair("txcount", (uint64_t)summary.txCount));
+        entry.push_back(Pair("firstheight", summary.firstHeight));
+        entry.push_back(Pair("lastheight", summary.lastHeight));
+        result.push_back(entry);
+    }
+
+    return result;
+}
+
 UniValue getaddresstxids(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -865,15 +1274,25 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\"  (number, optional) Return a page of at most this many txids\n"
+            "  \"cursor\"  (string, optional) The cursor of the previous page\n"
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult (with limit):\n"
+            "{\n"
+            "  \"txids\"  (array) The transaction ids, as above\n"
+            "  \"cursor\"  (string) The cursor of the next page, missing on the last page\n"
+            "}\n"
+            "\nWithout a limit the txids of several addresses are sorted by height and txid, pages\n"
+            "list them by height and position in the block like the txids of a single address.\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"]}")
+            + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"AezjxJk8LBbtSkKcx2NpjcwQa6AJipJLnY\"], \"limit\": 1000}'")
         );
 
     std::vector<std::pair<uint160, int> > addresses;
@@ -892,43 +1311,75 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             end = endValue.get_int();
         }
     }
-
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    if (start <= 0 || end <= 0) {
+        start = 0;
+        end = 0;
     }
 
-    std::set<std::pair<int, std::string> > txids;
-    UniValue result(UniValue::VARR);
+    size_t nLimit;
+    std::vector<std::string> vCursor;
+    bool fPaged = getPageFromParams(params, nLimit, vCursor);
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
+    CAddressIndexKey keyAfter;
+    bool fCursor = !vCursor.empty();
+    if (fCursor)
+        parseAddressIndexCursor(vCursor, keyAfter);
 
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
+    // All entries of a transaction share its height and position in the block, so they are
+    // adjacent in the merged history and only the last txid is needed to drop duplicates.
+    // The cursor is the first entry of the last txid returned, the rest of it is skipped.
+    UniValue txids(UniValue::VARR);
+    std::vector<std::pair<int, std::string> > vTxidsByHeight;
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    uint256 lastTxhash = keyAfter.txhash;
+    bool fHaveLast = fCursor;
+    CAddressIndexKey keyLastTx;
+    bool fMore = true;
+    bool fMoreTxids = false;
+
+    while (fMore && !fMoreTxids) {
+        addressIndex.clear();
+        getAddressIndexPage(addresses, start, end, fCursor ? &keyAfter : NULL, nLimit, addressIndex, fMore);
+
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+            if (fHaveLast && it->first.txhash == lastTxhash)
+                continue;
+            if (txids.size() == nLimit) {
+                fMoreTxids = true;
+                break;
             }
+            txids.push_back(it->first.txhash.GetHex());
+            if (!fPaged)
+                vTxidsByHeight.push_back(std::make_pair(it->first.blockHeight, it->first.txhash.GetHex()));
+            lastTxhash = it->first.txhash;
+            fHaveLast = true;
+            keyLastTx = it->first;
+        }
+
+        if (!addressIndex.empty()) {
+            keyAfter = addressIndex.back().first;
+            fCursor = true;
         }
     }
 
-    if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
+    if (!fPaged) {
+        if (fMoreTxids)
+            throwTooManyAddressResults();
+        if (addresses.size() > 1) {
+            // unpaged calls keep the (height, txid) order of several addresses
+            std::sort(vTxidsByHeight.begin(), vTxidsByHeight.end());
+            txids = UniValue(UniValue::VARR);
+            for (std::vector<std::pair<int, std::string> >::const_iterator it = vTxidsByHeight.begin(); it != vTxidsByHeight.end(); it++)
+                txids.push_back(it->second);
         }
+        return txids;
     }
 
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("txids", txids));
+    if (fMoreTxids)
+        result.push_back(Pair("cursor", getAddressIndexCursor(keyLastTx)));
+
     return result;
 
 }
@@ -6,6 +6,7 @@
 
 #include "rpcprotocol.h"
 
+#include "crypto/common.h"
 #include "random.h"
 #include "tinyformat.h"
 #include "util.h"
@@ -126,3 +127,66 @@ void DeleteAuthCookie()
     }
 }
 
+/** Default name of the binary RPC socket */
+static const std::string BINARY_RPC_SOCKET_FILE = "rpc.sock";
+
+boost::filesystem::path GetBinaryRPCSocketPath()
+{
+    std::string strPath = GetArg("-rpcsocket", "");
+    // a bare -rpcsocket enables the socket at its default location
+    if (strPath.empty() || strPath == "1")
+        strPath = BINARY_RPC_SOCKET_FILE;
+    boost::filesystem::path path(strPath);
+    if (!path.is_complete()) path = GetDataDir() / path;
+    return path;
+}
+
+static bool RecvAll(SOCKET hSocket, char* pch, size_t nSize)
+{
+    while (nSize > 0) {
+        int nRead = recv(hSocket, pch, nSize, 0);
+        if (nRead <= 0) {
+            if (nRead < 0 && WSAGetLastError() == WSAEINTR)
+                continue;
+            return false;
+        }
+        pch += nRead;
+        nSize -= nRead;
+    }
+    return true;
+}
+
+static bool SendAll(SOCKET hSocket, const char* pch, size_t nSize)
+{
+    while (nSize > 0) {
+        int nSent = send(hSocket, pch, nSize, MSG_NOSIGNAL);
+        if (nSent <= 0) {
+            if (nSent < 0 && WSAGetLastError() == WSAEINTR)
+                continue;
+            return false;
+        }
+        pch += nSent;
+        nSize -= nSent;
+    }
+    return true;
+}
+
+bool ReadBinaryRPCFrame(SOCKET hSocket, std::string& strPayload, unsigned int nMaxSize)
+{
+    unsigned char header[4];
+    if (!RecvAll(hSocket, (char*)header, sizeof(header)))
+        return false;
+    uint32_t nSize = ReadLE32(header);
+    if (nSize > nMaxSize)
+        return false;
+    strPayload.resize(nSize);
+    return nSize == 0 || RecvAll(hSocket, &strPayload[0], nSize);
+}
+
+bool WriteBinaryRPCFrame(SOCKET hSocket, const std::string& strPayload)
+{
+    unsigned char header[4];
+    WriteLE32(header, strPayload.size());
+    return SendAll(hSocket, (const char*)header, sizeof(header)) &&
+           SendAll(hSocket, strPayload.data(), strPayload.size());
+}
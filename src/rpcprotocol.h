@@ -6,6 +6,8 @@
 #ifndef BITCOIN_RPCPROTOCOL_H
 #define BITCOIN_RPCPROTOCOL_H
 
+#include "compat.h"
+
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -18,6 +20,7 @@
 enum HTTPStatusCode
 {
     HTTP_OK                    = 200,
+    HTTP_NOT_MODIFIED          = 304,
     HTTP_BAD_REQUEST           = 400,
     HTTP_UNAUTHORIZED          = 401,
     HTTP_FORBIDDEN             = 403,
@@ -90,4 +93,40 @@ bool GetAuthCookie(std::string *cookie_out);
 /** Delete RPC authentication cookie from disk */
 void DeleteAuthCookie();
 
+/** Largest request frame the binary RPC server accepts */
+static const unsigned int MAX_BINARY_RPC_REQUEST_SIZE = 0x02000000;
+/** Largest reply frame a binary RPC client accepts */
+static const unsigned int MAX_BINARY_RPC_REPLY_SIZE = 0x10000000;
+
+/**
+ * Binary RPC request types.
+ * Every frame on the binary RPC socket is a 4 byte little endian payload length
+ * followed by the payload. A request payload starts with its type byte followed by
+ * the serialized arguments, a reply payload with a BinaryRPCStatus byte followed
+ * by the serialized result.
+ */
+enum BinaryRPCRequestType
+{
+    BINARY_RPC_JSON              = 0, //! JSON-RPC request or batch text -> JSON-RPC reply text
+    BINARY_RPC_GETBESTBLOCK      = 1, //! -> int32 height, uint256 hash
+    BINARY_RPC_GETBLOCKHASH      = 2, //! int32 height -> uint256 hash
+    BINARY_RPC_GETBLOCKHEADER    = 3, //! uint256 hash -> CBlockHeader, int32 height
+    BINARY_RPC_GETBLOCK          = 4, //! uint256 hash -> CBlock
+    BINARY_RPC_GETRAWTRANSACTION = 5, //! uint256 txid -> CTransaction, uint256 block hash (null in mempool)
+};
+
+/** Binary RPC reply status */
+enum BinaryRPCStatus
+{
+    BINARY_RPC_OK    = 0,
+    BINARY_RPC_ERROR = 1, //! followed by int32 RPCErrorCode and string message
+};
+
+/** Get name of the binary RPC socket */
+boost::filesystem::path GetBinaryRPCSocketPath();
+/** Read a binary RPC frame. Fails at end of stream and on frames larger than nMaxSize. */
+bool ReadBinaryRPCFrame(SOCKET hSocket, std::string& strPayload, unsigned int nMaxSize);
+/** Write a binary RPC frame */
+bool WriteBinaryRPCFrame(SOCKET hSocket, const std::string& strPayload);
+
 #endif // BITCOIN_RPCPROTOCOL_H
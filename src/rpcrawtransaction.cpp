@@ -16,6 +16,7 @@
 #include "net.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "responsecache.h"
 #include "rpcserver.h"
 #include "script/script.h"
 #include "script/script_error.h"
@@ -216,15 +217,27 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = (params[1].get_int() != 0);
 
-    CTransaction tx;
+    // shares cache entries with /rest/tx/<txid>.hex, served while the block stays buried
+    const std::string strKey = CResponseCache::MakeKey("tx", "hex", hash);
+    string strHex;
     uint256 hashBlock;
+    if (!fVerbose && responseCache.Get(strKey, strHex, hashBlock)) {
+        if (IsBlockBuried(hashBlock))
+            return strHex;
+        responseCache.Erase(strKey);
+    }
+
+    CTransaction tx;
     if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available about transaction");
 
-    string strHex = EncodeHexTx(tx);
+    strHex = EncodeHexTx(tx);
 
-    if (!fVerbose)
+    if (!fVerbose) {
+        if (!hashBlock.IsNull() && IsBlockBuried(hashBlock))
+            responseCache.Put(strKey, strHex, hashBlock);
         return strHex;
+    }
 
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hex", strHex));
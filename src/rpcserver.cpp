@@ -254,153 +254,197 @@ UniValue stop(const UniValue& params, bool fHelp)
  * Call Table
  */
 static const CRPCCommand vRPCCommands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
+{ //  category              name                      actor (function)         okSafeMode streamActor
+  //  --------------------- ------------------------  -----------------------  ---------- -----------
     /* Overall control/query calls */
-    { "control",            "getinfo",                &getinfo,                true  }, /* uses wallet if enabled */
-    { "control",            "debug",                  &debug,                  true  },
-    { "control",            "help",                   &help,                   true  },
-    { "control",            "stop",                   &stop,                   true  },
+    { "control",            "getinfo",                &getinfo,                true,  NULL }, /* uses wallet if enabled */
+    { "control",            "debug",                  &debug,                  true,  NULL },
+    { "control",            "gethttpqueueinfo",       &gethttpqueueinfo,       true,  NULL },
+    { "control",            "help",                   &help,                   true,  NULL },
+    { "control",            "stop",                   &stop,                   true,  NULL },
 
     /* P2P networking */
-    { "network",            "getnetworkinfo",         &getnetworkinfo,         true  },
-    { "network",            "addnode",                &addnode,                true  },
-    { "network",            "disconnectnode",         &disconnectnode,         true  },
-    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true  },
-    { "network",            "getconnectioncount",     &getconnectioncount,     true  },
-    { "network",            "getnettotals",           &getnettotals,           true  },
-    { "network",            "getpeerinfo",            &getpeerinfo,            true  },
-    { "network",            "ping",                   &ping,                   true  },
-    { "network",            "setban",                 &setban,                 true  },
-    { "network",            "listbanned",             &listbanned,             true  },
-    { "network",            "clearbanned",            &clearbanned,            true  },
+    { "network",            "getnetworkinfo",         &getnetworkinfo,         true,  NULL },
+    { "network",            "addnode",                &addnode,                true,  NULL },
+    { "network",            "disconnectnode",         &disconnectnode,         true,  NULL },
+    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true,  NULL },
+    { "network",            "getconnectioncount",     &getconnectioncount,     true,  NULL },
+    { "network",            "getnettotals",           &getnettotals,           true,  NULL },
+    { "network",            "getpeerinfo",            &getpeerinfo,            true,  NULL },
+    { "network",            "ping",                   &ping,                   true,  NULL },
+    { "network",            "setban",                 &setban,                 true,  NULL },
+    { "network",            "listbanned",             &listbanned,             true,  NULL },
+    { "network",            "clearbanned",            &clearbanned,            true,  NULL },
 
     /* Block chain and UTXO */
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true  },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true  },
-    { "blockchain",         "getblockcount",          &getblockcount,          true  },
-    { "blockchain",         "getblock",               &getblock,               true  },
-    { "blockchain",         "getblockhashes",         &getblockhashes,         true  },
-    { "blockchain",         "getblockhash",           &getblockhash,           true  },
-    { "blockchain",         "getblockheader",         &getblockheader,         true  },
-    { "blockchain",         "getblockheaders",        &getblockheaders,        true  },
-    { "blockchain",         "getchaintips",           &getchaintips,           true  },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true  },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
-    { "blockchain",         "gettxout",               &gettxout,               true  },
-    { "blockchain",         "gettxoutproof",          &gettxoutproof,          true  },
-    { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true  },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
-    { "blockchain",         "verifychain",            &verifychain,            true  },
-    { "blockchain",         "getspentinfo",           &getspentinfo,           false },
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  NULL },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  NULL },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,  NULL },
+    { "blockchain",         "getblock",               &getblock,               true,  NULL },
+    { "blockchain",         "getblockhashes",         &getblockhashes,         true,  NULL },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,  NULL },
+    { "blockchain",         "getblockheader",         &getblockheader,         true,  NULL },
+    { "blockchain",         "getblockheaders",        &getblockheaders,        true,  NULL },
+    { "blockchain",         "getchaintips",           &getchaintips,           true,  NULL },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          true,  NULL },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  NULL },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  &streamrawmempool },
+    { "blockchain",         "gettxout",               &gettxout,               true,  NULL },
+    { "blockchain",         "gettxoutproof",          &gettxoutproof,          true,  NULL },
+    { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true,  NULL },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  NULL },
+    { "blockchain",         "verifychain",            &verifychain,            true,  NULL },
+    { "blockchain",         "getspentinfo",           &getspentinfo,           false, NULL },
 
     /* Mining */
-    { "mining",             "getblocktemplate",       &getblocktemplate,       true  },
-    { "mining",             "getmininginfo",          &getmininginfo,          true  },
-    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true  },
-    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true  },
-    { "mining",             "submitblock",            &submitblock,            true  },
+    { "mining",             "getblocktemplate",       &getblocktemplate,       true,  NULL },
+    { "mining",             "getmininginfo",          &getmininginfo,          true,  NULL },
+    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true,  NULL },
+    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true,  NULL },
+    { "mining",             "submitblock",            &submitblock,            true,  NULL },
 
     /* Coin generation */
-    { "generating",         "getgenerate",            &getgenerate,            true  },
-    { "generating",         "setgenerate",            &setgenerate,            true  },
-    { "generating",         "generate",               &generate,               true  },
+    { "generating",         "getgenerate",            &getgenerate,            true,  NULL },
+    { "generating",         "setgenerate",            &setgenerate,            true,  NULL },
+    { "generating",         "generate",               &generate,               true,  NULL },
 
     /* Raw transactions */
-    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true  },
-    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true  },
-    { "rawtransactions",    "decodescript",           &decodescript,           true  },
-    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true  },
-    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false },
-    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false }, /* uses wallet if enabled */
+    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true,  NULL },
+    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,  NULL },
+    { "rawtransactions",    "decodescript",           &decodescript,           true,  NULL },
+    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,  NULL },
+    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false, NULL },
+    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false, NULL }, /* uses wallet if enabled */
 #ifdef ENABLE_WALLET
-    { "rawtransactions",    "fundrawtransaction",     &fundrawtransaction,     false },
+    { "rawtransactions",    "fundrawtransaction",     &fundrawtransaction,     false, NULL },
 #endif
 
     /* Address index */
-    { "addressindex",       "getaddressmempool",      &getaddressmempool,      true  },
-    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false },
-    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false },
-    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false },
-    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false },
+    { "addressindex",       "getaddressmempool",      &getaddressmempool,      true,  NULL },
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false, NULL },
+    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false, &streamaddressdeltas },
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false, NULL },
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false, NULL },
+    { "addressindex",       "getaddresssummary",      &getaddresssummary,      false, NULL },
 
     /* Utility functions */
-    { "util",               "createmultisig",         &createmultisig,         true  },
-    { "util",               "validateaddress",        &validateaddress,        true  }, /* uses wallet if enabled */
-    { "util",               "verifymessage",          &verifymessage,          true  },
-    { "util",               "estimatefee",            &estimatefee,            true  },
-    { "util",               "estimatepriority",       &estimatepriority,       true  },
-    { "util",               "estimatesmartfee",       &estimatesmartfee,       true  },
-    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true  },
+    { "util",               "createmultisig",         &createmultisig,         true,  NULL },
+    { "util",               "validateaddress",        &validateaddress,        true,  NULL }, /* uses wallet if enabled */
+    { "util",               "verifymessage",          &verifymessage,          true,  NULL },
+    { "util",               "estimatefee",            &estimatefee,            true,  NULL },
+    { "util",               "estimatepriority",       &estimatepriority,       true,  NULL },
+    { "util",               "estimatesmartfee",       &estimatesmartfee,       true,  NULL },
+    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true,  NULL },
 
     /* Not shown in help */
-    { "hidden",             "invalidateblock",        &invalidateblock,        true  },
-    { "hidden",             "reconsiderblock",        &reconsiderblock,        true  },
-    { "hidden",             "setmocktime",            &setmocktime,            true  },
+    { "hidden",             "invalidateblock",        &invalidateblock,        true,  NULL },
+    { "hidden",             "reconsiderblock",        &reconsiderblock,        true,  NULL },
+    { "hidden",             "setmocktime",            &setmocktime,            true,  NULL },
 #ifdef ENABLE_WALLET
-    { "hidden",             "resendwallettransactions", &resendwallettransactions, true},
+    { "hidden",             "resendwallettransactions", &resendwallettransactions, true,  NULL },
 #endif
 
     /* 3DCoin features */
-    { "3dcoin",               "masternode",             &masternode,             true  },
-    { "3dcoin",               "masternodelist",         &masternodelist,         true  },
-    { "3dcoin",               "masternodebroadcast",    &masternodebroadcast,    true  },
-    { "3dcoin",               "gobject",                &gobject,                true  },
-    { "3dcoin",               "getgovernanceinfo",      &getgovernanceinfo,      true  },
-    { "3dcoin",               "getsuperblockbudget",    &getsuperblockbudget,    true  },
-    { "3dcoin",               "voteraw",                &voteraw,                true  },
-    { "3dcoin",               "mnsync",                 &mnsync,                 true  },
-    { "3dcoin",               "spork",                  &spork,                  true  },
-    { "3dcoin",               "getpoolinfo",            &getpoolinfo,            true  },
+    { "3dcoin",               "masternode",             &masternode,             true,  NULL },
+    { "3dcoin",               "masternodelist",         &masternodelist,         true,  NULL },
+    { "3dcoin",               "masternodebroadcast",    &masternodebroadcast,    true,  NULL },
+    { "3dcoin",               "gobject",                &gobject,                true,  NULL },
+    { "3dcoin",               "getgovernanceinfo",      &getgovernanceinfo,      true,  NULL },
+    { "3dcoin",               "getsuperblockbudget",    &getsuperblockbudget,    true,  NULL },
+    { "3dcoin",               "voteraw",                &voteraw,                true,  NULL },
+    { "3dcoin",               "mnsync",                 &mnsync,                 true,  NULL },
+    { "3dcoin",               "spork",                  &spork,                  true,  NULL },
+    { "3dcoin",               "getpoolinfo",            &getpoolinfo,            true,  NULL },
+    { "3dcoin",               "getinstantsendlock",     &getinstantsendlock,     true,  NULL },
+    { "3dcoin",               "getinstantsendstats",    &getinstantsendstats,    true,  NULL },
 #ifdef ENABLE_WALLET
-    { "3dcoin",               "privatesend",            &privatesend,            false },
+    { "3dcoin",               "privatesend",            &privatesend,            false, NULL },
 
     /* Wallet */
-    { "wallet",             "keepass",                &keepass,                true },
-    { "wallet",             "instantsendtoaddress",   &instantsendtoaddress,   false },
-    { "wallet",             "addmultisigaddress",     &addmultisigaddress,     true  },
-    { "wallet",             "backupwallet",           &backupwallet,           true  },
-    { "wallet",             "dumpprivkey",            &dumpprivkey,            true  },
-    { "wallet",             "dumpwallet",             &dumpwallet,             true  },
-    { "wallet",             "encryptwallet",          &encryptwallet,          true  },
-    { "wallet",             "getaccountaddress",      &getaccountaddress,      true  },
-    { "wallet",             "getaccount",             &getaccount,             true  },
-    { "wallet",             "getaddressesbyaccount",  &getaddressesbyaccount,  true  },
-    { "wallet",             "getbalance",             &getbalance,             false },
-    { "wallet",             "getnewaddress",          &getnewaddress,          true  },
-    { "wallet",             "getrawchangeaddress",    &getrawchangeaddress,    true  },
-    { "wallet",             "getreceivedbyaccount",   &getreceivedbyaccount,   false },
-    { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false },
-    { "wallet",             "gettransaction",         &gettransaction,         false },
-    { "wallet",             "abandontransaction",     &abandontransaction,     false },
-    { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false },
-    { "wallet",             "getwalletinfo",          &getwalletinfo,          false },
-    { "wallet",             "importprivkey",          &importprivkey,          true  },
-    { "wallet",             "importwallet",           &importwallet,           true  },
-    { "wallet",             "importelectrumwallet",   &importelectrumwallet,   true  },
-    { "wallet",             "importaddress",          &importaddress,          true  },
-    { "wallet",             "importpubkey",           &importpubkey,           true  },
-    { "wallet",             "keypoolrefill",          &keypoolrefill,          true  },
-    { "wallet",             "listaccounts",           &listaccounts,           false },
-    { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false },
-    { "wallet",             "listlockunspent",        &listlockunspent,        false },
-    { "wallet",             "listreceivedbyaccount",  &listreceivedbyaccount,  false },
-    { "wallet",             "listreceivedbyaddress",  &listreceivedbyaddress,  false },
-    { "wallet",             "listsinceblock",         &listsinceblock,         false },
-    { "wallet",             "listtransactions",       &listtransactions,       false },
-    { "wallet",             "listunspent",            &listunspent,            false },
-    { "wallet",             "lockunspent",            &lockunspent,            true  },
-    { "wallet",             "move",                   &movecmd,                false },
-    { "wallet",             "sendfrom",               &sendfrom,               false },
-    { "wallet",             "sendmany",               &sendmany,               false },
-    { "wallet",             "sendtoaddress",          &sendtoaddress,          false },
-    { "wallet",             "setaccount",             &setaccount,             true  },
-    { "wallet",             "settxfee",               &settxfee,               true  },
-    { "wallet",             "signmessage",            &signmessage,            true  },
-    { "wallet",             "walletlock",             &walletlock,             true  },
-    { "wallet",             "walletpassphrasechange", &walletpassphrasechange, true  },
-    { "wallet",             "walletpassphrase",       &walletpassphrase,       true  },
+    { "wallet",             "keepass",                &keepass,                true,  NULL },
+    { "wallet",             "instantsendtoaddress",   &instantsendtoaddress,   false, NULL },
+    { "wallet",             "addmultisigaddress",     &addmultisigaddress,     true,  NULL },
+    { "wallet",             "backupwallet",           &backupwallet,           true,  NULL },
+    { "wallet",             "dumpprivkey",            &dumpprivkey,            true,  NULL },
+    { "wallet",             "dumpwallet",             &dumpwallet,             true,  NULL },
+    { "wallet",             "encryptwallet",          &encryptwallet,          true,  NULL },
+    { "wallet",             "getaccountaddress",      &getaccountaddress,      true,  NULL },
+    { "wallet",             "getaccount",             &getaccount,             true,  NULL },
+    { "wallet",             "getaddressesbyaccount",  &getaddressesbyaccount,  true,  NULL },
+    { "wallet",             "getbalance",             &getbalance,             false, NULL },
+    { "wallet",             "getnewaddress",          &getnewaddress,          true,  NULL },
+    { "wallet",             "getrawchangeaddress",    &getrawchangeaddress,    true,  NULL },
+    { "wallet",             "getreceivedbyaccount",   &getreceivedbyaccount,   false, NULL },
+    { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false, NULL },
+    { "wallet",             "gettransaction",         &gettransaction,         false, NULL },
+    { "wallet",             "abandontransaction",     &abandontransaction,     false, NULL },
+    { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false, NULL },
+    { "wallet",             "getwalletinfo",          &getwalletinfo,          false, NULL },
+    { "wallet",             "importprivkey",          &importprivkey,          true,  NULL },
+    { "wallet",             "importwallet",           &importwallet,           true,  NULL },
+    { "wallet",             "importelectrumwallet",   &importelectrumwallet,   true,  NULL },
+    { "wallet",             "importaddress",          &importaddress,          true,  NULL },
+    { "wallet",             "importpubkey",           &importpubkey,           true,  NULL },
+    { "wallet",             "keypoolrefill",          &keypoolrefill,          true,  NULL },
+    { "wallet",             "listaccounts",           &listaccounts,           false, NULL },
+    { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false, NULL },
+    { "wallet",             "listlockunspent",        &listlockunspent,        false, NULL },
+    { "wallet",             "listreceivedbyaccount",  &listreceivedbyaccount,  false, NULL },
+    { "wallet",             "listreceivedbyaddress",  &listreceivedbyaddress,  false, NULL },
+    { "wallet",             "listsinceblock",         &listsinceblock,         false, NULL },
+    { "wallet",             "listtransactions",       &listtransactions,       false, NULL },
+    { "wallet",             "listunspent",            &listunspent,            false, NULL },
+    { "wallet",             "lockunspent",            &lockunspent,            true,  NULL },
+    { "wallet",             "move",                   &movecmd,                false, NULL },
+    { "wallet",             "sendfrom",               &sendfrom,               false, NULL },
+    { "wallet",             "sendmany",               &sendmany,               false, NULL },
+    { "wallet",             "sendtoaddress",          &sendtoaddress,          false, NULL },
+    { "wallet",             "setaccount",             &setaccount,             true,  NULL },
+    { "wallet",             "settxfee",               &settxfee,               true,  NULL },
+    { "wallet",             "signmessage",            &signmessage,            true,  NULL },
+    { "wallet",             "walletlock",             &walletlock,             true,  NULL },
+    { "wallet",             "walletpassphrasechange", &walletpassphrasechange, true,  NULL },
+    { "wallet",             "walletpassphrase",       &walletpassphrase,       true,  NULL },
+#endif // ENABLE_WALLET
+};
+
+/**
+ * Commands that only read node state. Consecutive calls to them in a batch may run
+ * concurrently, any other call in a batch waits for the calls before it to finish.
+ */
+static const char* const vRPCConcurrentCommands[] =
+{
+    "getbestblockhash", "getblock", "getblockchaininfo", "getblockcount", "getblockhash",
+    "getblockhashes", "getblockheader", "getblockheaders", "getchaintips", "getconnectioncount",
+    "getdifficulty", "getmempoolinfo", "getrawmempool", "getspentinfo", "gettxout",
+    "gettxoutproof", "verifytxoutproof", "decoderawtransaction", "decodescript",
+    "getrawtransaction", "getaddressmempool", "getaddressutxos", "getaddressdeltas",
+    "getaddresstxids", "getaddressbalance", "getaddresssummary", "validateaddress",
+};
+
+/**
+ * Cheap status and control commands. They are served by the HTTP server with high
+ * priority, so health checks still get through while workers are busy.
+ */
+static const char* const vRPCCheapCommands[] =
+{
+    "getbestblockhash", "getblockcount", "getblockhash", "getconnectioncount", "getdifficulty",
+    "gethttpqueueinfo", "getinfo", "getmempoolinfo", "getnettotals", "getnetworkinfo", "help",
+    "mnsync", "ping", "stop",
+};
+
+/**
+ * Expensive queries. They are served with low priority and only half of the HTTP
+ * workers may run any one of them at a time.
+ */
+static const char* const vRPCExpensiveCommands[] =
+{
+    "getaddressbalance", "getaddressdeltas", "getaddressmempool", "getaddresssummary",
+    "getaddresstxids", "getaddressutxos", "getblockhashes", "gettxoutsetinfo", "verifychain",
+    "masternodelist",
+#ifdef ENABLE_WALLET
+    "dumpwallet", "importaddress", "importelectrumwallet", "importprivkey", "importpubkey",
+    "importwallet",
 #endif // ENABLE_WALLET
 };
 
@@ -414,6 +458,34 @@ CRPCTable::CRPCTable()
         pcmd = &vRPCCommands[vcidx];
         mapCommands[pcmd->name] = pcmd;
     }
+    // A misspelled or removed name in these lists would silently leave a command unclassified
+    for (vcidx = 0; vcidx < (sizeof(vRPCConcurrentCommands) / sizeof(vRPCConcurrentCommands[0])); vcidx++) {
+        assert(mapCommands.count(vRPCConcurrentCommands[vcidx]));
+        setConcurrentCommands.insert(vRPCConcurrentCommands[vcidx]);
+    }
+    for (vcidx = 0; vcidx < (sizeof(vRPCCheapCommands) / sizeof(vRPCCheapCommands[0])); vcidx++) {
+        assert(mapCommands.count(vRPCCheapCommands[vcidx]));
+        setCheapCommands.insert(vRPCCheapCommands[vcidx]);
+    }
+    for (vcidx = 0; vcidx < (sizeof(vRPCExpensiveCommands) / sizeof(vRPCExpensiveCommands[0])); vcidx++) {
+        assert(mapCommands.count(vRPCExpensiveCommands[vcidx]) && !setCheapCommands.count(vRPCExpensiveCommands[vcidx]));
+        setExpensiveCommands.insert(vRPCExpensiveCommands[vcidx]);
+    }
+}
+
+bool CRPCTable::isConcurrent(const std::string &name) const
+{
+    return setConcurrentCommands.count(name) > 0;
+}
+
+bool CRPCTable::isCheap(const std::string &name) const
+{
+    return setCheapCommands.count(name) > 0;
+}
+
+bool CRPCTable::isExpensive(const std::string &name) const
+{
+    return setExpensiveCommands.count(name) > 0;
 }
 
 const CRPCCommand *CRPCTable::operator[](const std::string &name) const
@@ -526,11 +598,95 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const UniValue& vReq)
+/** Calls of a batch that may run concurrently, shared by the threads executing them */
+struct CRPCBatchRun
+{
+    const UniValue* pvReq;
+    size_t nBegin;
+    size_t nEnd;
+    size_t nNext;
+    size_t nRunning;
+    std::vector<UniValue> vResults;
+    boost::mutex mutex;
+    boost::condition_variable cond;
+
+    CRPCBatchRun(const UniValue& vReq, size_t nBeginIn, size_t nEndIn) :
+        pvReq(&vReq), nBegin(nBeginIn), nEnd(nEndIn), nNext(nBeginIn), nRunning(0), vResults(nEndIn - nBeginIn) {}
+};
+
+/**
+ * Execute calls of a batch run until none are left. Helpers may only get to run after the
+ * thread that owns the batch has executed every call itself, in which case they do nothing.
+ */
+static void ExecRPCBatchRun(boost::shared_ptr<CRPCBatchRun> run)
+{
+    while (true) {
+        size_t nIdx;
+        {
+            boost::unique_lock<boost::mutex> lock(run->mutex);
+            if (run->nNext == run->nEnd)
+                return;
+            nIdx = run->nNext++;
+            run->nRunning++;
+        }
+
+        // Every call has its own slot, the owner only reads them once nothing is running
+        run->vResults[nIdx - run->nBegin] = JSONRPCExecOne((*run->pvReq)[nIdx]);
+
+        {
+            boost::unique_lock<boost::mutex> lock(run->mutex);
+            if (--run->nRunning == 0 && run->nNext == run->nEnd)
+                run->cond.notify_all();
+        }
+    }
+}
+
+static bool IsConcurrentRPCRequest(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req.get_obj(), "method");
+    return method.isStr() && tableRPC.isConcurrent(method.get_str());
+}
+
+std::string JSONRPCExecBatch(const UniValue& vReq, const RPCWorkEnqueuer& enqueue)
 {
+    size_t nConcurrency = std::max((int64_t)1, GetArg("-rpcbatchconcurrency", DEFAULT_RPC_BATCH_CONCURRENCY));
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    unsigned int reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        // Find the run of read-only calls starting here
+        unsigned int runEnd = reqIdx;
+        while (runEnd < vReq.size() && IsConcurrentRPCRequest(vReq[runEnd]))
+            runEnd++;
+
+        if (runEnd - reqIdx < 2 || nConcurrency < 2 || enqueue.empty()) {
+            // Nothing to overlap, run the next call here
+            ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+            reqIdx++;
+            continue;
+        }
+
+        boost::shared_ptr<CRPCBatchRun> run(new CRPCBatchRun(vReq, reqIdx, runEnd));
+        size_t nHelpers = std::min(nConcurrency, (size_t)(runEnd - reqIdx)) - 1;
+        for (size_t i = 0; i < nHelpers; i++) {
+            if (!enqueue(boost::bind(&ExecRPCBatchRun, run)))
+                break;
+        }
+
+        // Take part ourselves, so the batch completes even when no helper gets to run
+        ExecRPCBatchRun(run);
+        {
+            boost::unique_lock<boost::mutex> lock(run->mutex);
+            while (run->nRunning > 0)
+                run->cond.wait(lock);
+        }
+
+        for (size_t i = 0; i < run->vResults.size(); i++)
+            ret.push_back(run->vResults[i]);
+        reqIdx = runEnd;
+    }
 
     return ret.write() + "\n";
 }
@@ -564,6 +720,35 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     g_rpcSignals.PostCommand(*pcmd);
 }
 
+bool CRPCTable::executeStream(const std::string &strMethod, const UniValue &params, CJSONStreamWriter& writer) const
+{
+    const CRPCCommand *pcmd = tableRPC[strMethod];
+    if (!pcmd || !pcmd->streamActor)
+        return false;
+
+    // Return immediately if in warmup
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try
+    {
+        // Execute
+        pcmd->streamActor(params, writer);
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    g_rpcSignals.PostCommand(*pcmd);
+    return true;
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
@@ -12,6 +12,7 @@
 
 #include <list>
 #include <map>
+#include <set>
 #include <stdint.h>
 #include <string>
 
@@ -19,6 +20,9 @@
 
 #include <univalue.h>
 
+/** Default for -rpcbatchconcurrency, the number of worker threads one batch request may use */
+static const int DEFAULT_RPC_BATCH_CONCURRENCY = 4;
+
 class CRPCCommand;
 
 namespace RPCServer
@@ -30,6 +34,7 @@ namespace RPCServer
 }
 
 class CBlockIndex;
+class CJSONStreamWriter;
 class CNetAddr;
 
 class JSONRequest
@@ -112,6 +117,7 @@ void RPCUnregisterTimerInterface(RPCTimerInterface *iface);
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
+typedef void(*rpcstreamfn_type)(const UniValue& params, CJSONStreamWriter& writer);
 
 class CRPCCommand
 {
@@ -120,6 +126,8 @@ public:
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
+    //! Optional: writes the same result as actor piece by piece, for commands with large results
+    rpcstreamfn_type streamActor;
 };
 
 /**
@@ -129,11 +137,21 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+    std::set<std::string> setConcurrentCommands;
+    std::set<std::string> setCheapCommands;
+    std::set<std::string> setExpensiveCommands;
 public:
     CRPCTable();
     const CRPCCommand* operator[](const std::string& name) const;
     std::string help(const std::string& name) const;
 
+    /** Whether calls to a method only read state and may run alongside each other in a batch */
+    bool isConcurrent(const std::string& name) const;
+    /** Whether a method is a cheap status or control call */
+    bool isCheap(const std::string& name) const;
+    /** Whether a method is an expensive query */
+    bool isExpensive(const std::string& name) const;
+
     /**
      * Execute a method.
      * @param method   Method to execute
@@ -143,6 +161,16 @@ public:
      */
     UniValue execute(const std::string &method, const UniValue &params) const;
 
+    /**
+     * Execute a method that can stream its result.
+     * @param method   Method to execute
+     * @param params   UniValue Array of arguments (JSON objects)
+     * @param writer   Receives the result
+     * @returns false, without executing anything, if the method cannot stream its result.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    bool executeStream(const std::string &method, const UniValue &params, CJSONStreamWriter& writer) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -175,8 +203,10 @@ extern UniValue getconnectioncount(const UniValue& params, bool fHelp); // in rp
 extern UniValue getaddressmempool(const UniValue& params, bool fHelp);
 extern UniValue getaddressutxos(const UniValue& params, bool fHelp);
 extern UniValue getaddressdeltas(const UniValue& params, bool fHelp);
+extern void streamaddressdeltas(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getaddresstxids(const UniValue& params, bool fHelp);
 extern UniValue getaddressbalance(const UniValue& params, bool fHelp);
+extern UniValue getaddresssummary(const UniValue& params, bool fHelp);
 
 extern UniValue getpeerinfo(const UniValue& params, bool fHelp);
 extern UniValue ping(const UniValue& params, bool fHelp);
@@ -246,6 +276,7 @@ extern UniValue encryptwallet(const UniValue& params, bool fHelp);
 extern UniValue validateaddress(const UniValue& params, bool fHelp);
 extern UniValue getinfo(const UniValue& params, bool fHelp);
 extern UniValue debug(const UniValue& params, bool fHelp);
+extern UniValue gethttpqueueinfo(const UniValue& params, bool fHelp);
 extern UniValue getwalletinfo(const UniValue& params, bool fHelp);
 extern UniValue getblockchaininfo(const UniValue& params, bool fHelp);
 extern UniValue getnetworkinfo(const UniValue& params, bool fHelp);
@@ -267,6 +298,8 @@ extern UniValue verifytxoutproof(const UniValue& params, bool fHelp);
 
 extern UniValue privatesend(const UniValue& params, bool fHelp);
 extern UniValue getpoolinfo(const UniValue& params, bool fHelp);
+extern UniValue getinstantsendlock(const UniValue& params, bool fHelp);
+extern UniValue getinstantsendstats(const UniValue& params, bool fHelp);
 extern UniValue spork(const UniValue& params, bool fHelp);
 extern UniValue masternode(const UniValue& params, bool fHelp);
 extern UniValue masternodelist(const UniValue& params, bool fHelp);
@@ -283,6 +316,7 @@ extern UniValue getdifficulty(const UniValue& params, bool fHelp);
 extern UniValue settxfee(const UniValue& params, bool fHelp);
 extern UniValue getmempoolinfo(const UniValue& params, bool fHelp);
 extern UniValue getrawmempool(const UniValue& params, bool fHelp);
+extern void streamrawmempool(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getblockhashes(const UniValue& params, bool fHelp);
 extern UniValue getblockhash(const UniValue& params, bool fHelp);
 extern UniValue getblockheader(const UniValue& params, bool fHelp);
@@ -299,6 +333,13 @@ extern UniValue getspentinfo(const UniValue& params, bool fHelp);
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const UniValue& vReq);
+/** Runs a function on another RPC worker thread, returns false if it could not be queued */
+typedef boost::function<bool(const boost::function<void(void)>&)> RPCWorkEnqueuer;
+
+/**
+ * Execute a batch of requests. With enqueue given, consecutive read-only calls are spread
+ * over up to -rpcbatchconcurrency worker threads; the replies keep the order of the requests.
+ */
+std::string JSONRPCExecBatch(const UniValue& vReq, const RPCWorkEnqueuer& enqueue = RPCWorkEnqueuer());
 
 #endif // BITCOIN_RPCSERVER_H
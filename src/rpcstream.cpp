@@ -0,0 +1,97 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpcstream.h"
+
+#include <assert.h>
+
+#include <univalue.h>
+
+CJSONStreamWriter::CJSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn) :
+    sink(sinkIn), nChunkSize(nChunkSizeIn), fAfterKey(false), fFlushed(false)
+{
+    strBuffer.reserve(nChunkSize);
+}
+
+void CJSONStreamWriter::BeginValue()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vEmpty.empty()) {
+        if (!vEmpty.back())
+            strBuffer += ',';
+        vEmpty.back() = false;
+    }
+}
+
+void CJSONStreamWriter::EndValue()
+{
+    if (strBuffer.size() >= nChunkSize)
+        Flush();
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    BeginValue();
+    strBuffer += '{';
+    vEmpty.push_back(true);
+}
+
+void CJSONStreamWriter::EndObject()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    strBuffer += '}';
+    EndValue();
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    BeginValue();
+    strBuffer += '[';
+    vEmpty.push_back(true);
+}
+
+void CJSONStreamWriter::EndArray()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    strBuffer += ']';
+    EndValue();
+}
+
+void CJSONStreamWriter::Key(const std::string& strKey)
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    BeginValue();
+    // Serializing the key as a string value takes care of escaping
+    strBuffer += UniValue(strKey).write();
+    strBuffer += ':';
+    fAfterKey = true;
+}
+
+void CJSONStreamWriter::Value(const UniValue& value)
+{
+    BeginValue();
+    strBuffer += value.write();
+    EndValue();
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (strBuffer.empty())
+        return;
+    sink(strBuffer);
+    strBuffer.clear();
+    fFlushed = true;
+}
+
+std::string CJSONStreamWriter::Release()
+{
+    std::string strRet;
+    strRet.swap(strBuffer);
+    return strRet;
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPCSTREAM_H
+#define BITCOIN_RPCSTREAM_H
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+class UniValue;
+
+/** Size of the pieces a CJSONStreamWriter hands to its sink */
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes a JSON document piece by piece, so large RPC results can be sent while they are
+ * produced instead of being built as one UniValue tree and serialized into one string.
+ * Output is buffered and passed to the sink whenever the buffer grows past the chunk size;
+ * whatever is left at the end can be taken with Release().
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef boost::function<void(const std::string&)> Sink;
+
+    CJSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn = JSON_STREAM_CHUNK_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    /** Start a member of the current object, the next value written is its value */
+    void Key(const std::string& strKey);
+    void Value(const UniValue& value);
+
+    /** Pass the buffered output to the sink */
+    void Flush();
+    /** Whether any output was passed to the sink yet */
+    bool HasFlushed() const { return fFlushed; }
+    /** Take the output that was not passed to the sink */
+    std::string Release();
+
+private:
+    void BeginValue();
+    void EndValue();
+
+    Sink sink;
+    size_t nChunkSize;
+    std::string strBuffer;
+    //! For each open object or array, whether nothing was written into it yet
+    std::vector<bool> vEmpty;
+    bool fAfterKey;
+    bool fFlushed;
+};
+
+#endif // BITCOIN_RPCSTREAM_H
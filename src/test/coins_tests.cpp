@@ -9,6 +9,7 @@
 #include "main.h"
 #include "consensus/validation.h"
 
+#include <algorithm>
 #include <vector>
 #include <map>
 
@@ -347,4 +348,46 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
     BOOST_CHECK(spent_a_duplicate_coinbase);
 }
 
+// Batch lookups must see the same coins as GetCoins, without caching what they read.
+BOOST_AUTO_TEST_CASE(coins_batch_lookup)
+{
+    std::vector<uint256> txids;
+    for (int i = 0; i < 30; i++)
+        txids.push_back(GetRandHash());
+    std::sort(txids.begin(), txids.end());
+
+    // txids 0..19 in the base view, 10..14 changed and 20..24 added in the cache on top
+    CCoinsViewTest base;
+    {
+        CCoinsViewCache flushed(&base);
+        for (int i = 0; i < 20; i++) {
+            CCoinsModifier coins = flushed.ModifyCoins(txids[i]);
+            coins->vout.resize(1);
+            coins->vout[0].nValue = 1;
+            coins->nHeight = i;
+        }
+        flushed.Flush();
+    }
+    CCoinsViewCacheTest cache(&base);
+    for (int i = 10; i < 25; i++) {
+        CCoinsModifier coins = cache.ModifyCoins(txids[i]);
+        coins->vout.resize(1);
+        coins->vout[0].nValue = 1;
+        coins->nHeight = 100 + i;
+    }
+
+    size_t nUsage = cache.DynamicMemoryUsage();
+    std::vector<CCoins> vCoins;
+    std::vector<bool> vFound;
+    cache.GetCoinsBatch(txids, vCoins, vFound);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nUsage);
+    BOOST_CHECK_EQUAL(vCoins.size(), txids.size());
+    BOOST_CHECK_EQUAL(vFound.size(), txids.size());
+    for (int i = 0; i < 30; i++) {
+        BOOST_CHECK_EQUAL(vFound[i], i < 25);
+        if (vFound[i])
+            BOOST_CHECK_EQUAL(vCoins[i].nHeight, i < 10 ? i : 100 + i);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,182 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "httpworkqueue.h"
+#include "utiltime.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include <set>
+
+BOOST_FIXTURE_TEST_SUITE(httpworkqueue_tests, BasicTestingSetup)
+
+/** Started and released by the test, so it can see which items a worker took */
+struct CWorkGate
+{
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::set<int> setStarted;
+    bool fReleased;
+
+    CWorkGate() : fReleased(false) {}
+
+    bool WaitStarted(int nItem)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(10);
+        while (!setStarted.count(nItem))
+            if (!cond.timed_wait(lock, deadline))
+                return false;
+        return true;
+    }
+
+    bool Started(int nItem)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return setStarted.count(nItem) > 0;
+    }
+
+    void Release()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fReleased = true;
+        cond.notify_all();
+    }
+};
+
+class CGatedWorkItem : public HTTPClosure
+{
+public:
+    CGatedWorkItem(CWorkGate& gateIn, int nItemIn) : gate(gateIn), nItem(nItemIn) {}
+
+    void operator()()
+    {
+        boost::unique_lock<boost::mutex> lock(gate.mutex);
+        gate.setStarted.insert(nItem);
+        gate.cond.notify_all();
+        while (!gate.fReleased)
+            gate.cond.wait(lock);
+    }
+
+private:
+    CWorkGate& gate;
+    int nItem;
+};
+
+/** Start nThreads workers and wait until all of them are counted by the queue */
+static void StartWorkers(WorkQueue<HTTPClosure>& queue, boost::thread_group& workers, int nThreads)
+{
+    for (int i = 0; i < nThreads; i++)
+        workers.create_thread(boost::bind(&WorkQueue<HTTPClosure>::Run, &queue));
+    HTTPWorkQueueStats stats;
+    for (int i = 0; i < 1000; i++) {
+        queue.GetStats(stats);
+        if (stats.nThreads == nThreads)
+            break;
+        MilliSleep(10);
+    }
+    BOOST_CHECK_EQUAL(stats.nThreads, nThreads);
+}
+
+static void StopWorkers(WorkQueue<HTTPClosure>& queue, boost::thread_group& workers, CWorkGate& gate)
+{
+    gate.Release();
+    queue.Interrupt();
+    workers.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(workqueue_high_priority_reserved)
+{
+    WorkQueue<HTTPClosure> queue(16, 16);
+    boost::thread_group workers;
+    CWorkGate gate;
+    StartWorkers(queue, workers, 2);
+
+    // Other classes may occupy all but one worker...
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 1), HTTP_PRIORITY_LOW));
+    BOOST_CHECK(gate.WaitStarted(1));
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 2), HTTP_PRIORITY_NORMAL));
+    MilliSleep(100);
+    BOOST_CHECK(!gate.Started(2));
+
+    // ...which is left for high priority work
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 3), HTTP_PRIORITY_HIGH));
+    BOOST_CHECK(gate.WaitStarted(3));
+    BOOST_CHECK(!gate.Started(2));
+
+    HTTPWorkQueueStats stats;
+    queue.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.classes[HTTP_PRIORITY_NORMAL].nDepth, 1U);
+    BOOST_CHECK_EQUAL(stats.classes[HTTP_PRIORITY_LOW].nRunning, 1);
+    BOOST_CHECK_EQUAL(stats.classes[HTTP_PRIORITY_HIGH].nRunning, 1);
+
+    StopWorkers(queue, workers, gate);
+}
+
+BOOST_AUTO_TEST_CASE(workqueue_endpoint_limit)
+{
+    WorkQueue<HTTPClosure> queue(16, 16);
+    queue.SetEndpointLimit("limited", 1);
+    boost::thread_group workers;
+    CWorkGate gate;
+    StartWorkers(queue, workers, 4);
+
+    // The second item of the endpoint waits, later items of other endpoints pass it
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 1), HTTP_PRIORITY_NORMAL, "limited"));
+    BOOST_CHECK(gate.WaitStarted(1));
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 2), HTTP_PRIORITY_NORMAL, "limited"));
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 3), HTTP_PRIORITY_NORMAL, "other"));
+    BOOST_CHECK(gate.WaitStarted(3));
+    MilliSleep(100);
+    BOOST_CHECK(!gate.Started(2));
+
+    HTTPWorkQueueStats stats;
+    queue.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.mapEndpoints["limited"].nRunning, 1);
+    BOOST_CHECK_EQUAL(stats.mapEndpoints["limited"].nQueued, 1U);
+    BOOST_CHECK_EQUAL(stats.mapEndpoints["limited"].nLimit, 1);
+
+    // Low priority endpoints default to half the workers
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 4), HTTP_PRIORITY_LOW, "expensive"));
+    BOOST_CHECK(gate.WaitStarted(4));
+    queue.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.mapEndpoints["expensive"].nLimit, 2);
+
+    StopWorkers(queue, workers, gate);
+}
+
+BOOST_AUTO_TEST_CASE(workqueue_reject_per_class)
+{
+    // Without workers nothing is taken off the queues
+    WorkQueue<HTTPClosure> queue(1, 2);
+    CWorkGate gate;
+    gate.Release();
+
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 1), HTTP_PRIORITY_LOW));
+    CGatedWorkItem* pitem = new CGatedWorkItem(gate, 2);
+    BOOST_CHECK(!queue.Enqueue(pitem, HTTP_PRIORITY_LOW));
+    delete pitem;
+
+    // A full class does not affect the others
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 3), HTTP_PRIORITY_NORMAL));
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 4), HTTP_PRIORITY_HIGH));
+    BOOST_CHECK(queue.Enqueue(new CGatedWorkItem(gate, 5), HTTP_PRIORITY_HIGH));
+    pitem = new CGatedWorkItem(gate, 6);
+    BOOST_CHECK(!queue.Enqueue(pitem, HTTP_PRIORITY_HIGH));
+    delete pitem;
+
+    HTTPWorkQueueStats stats;
+    queue.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.classes[HTTP_PRIORITY_LOW].nRejected, 1U);
+    BOOST_CHECK_EQUAL(stats.classes[HTTP_PRIORITY_NORMAL].nRejected, 0U);
+    BOOST_CHECK_EQUAL(stats.classes[HTTP_PRIORITY_HIGH].nRejected, 1U);
+    BOOST_CHECK_EQUAL(stats.classes[HTTP_PRIORITY_HIGH].nDepth, 2U);
+    BOOST_CHECK_EQUAL(queue.Depth(), 4U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,60 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "instantx.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(instantx_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(lock_latency_window)
+{
+    CLockLatencyWindow window;
+    BOOST_CHECK_EQUAL(window.GetPercentile(50), 0);
+    BOOST_CHECK_EQUAL(window.GetMax(), 0);
+
+    // add 1..100 in reverse order
+    for (int i = 100; i > 0; i--)
+        window.Add(i);
+    BOOST_CHECK_EQUAL(window.GetSize(), 100U);
+    BOOST_CHECK_EQUAL(window.GetPercentile(0), 1);
+    BOOST_CHECK_EQUAL(window.GetPercentile(50), 50);
+    BOOST_CHECK_EQUAL(window.GetPercentile(95), 95);
+    BOOST_CHECK_EQUAL(window.GetPercentile(99), 99);
+    BOOST_CHECK_EQUAL(window.GetPercentile(100), 100);
+    BOOST_CHECK_EQUAL(window.GetMax(), 100);
+
+    // only the most recent samples are kept
+    for (int i = 0; i < 1000; i++)
+        window.Add(7);
+    BOOST_CHECK_EQUAL(window.GetSize(), 1000U);
+    BOOST_CHECK_EQUAL(window.GetTotal(), 1100U);
+    BOOST_CHECK_EQUAL(window.GetPercentile(99), 7);
+    BOOST_CHECK_EQUAL(window.GetMax(), 7);
+}
+
+BOOST_AUTO_TEST_CASE(lock_times_phases)
+{
+    CTxLockTimes times;
+    times.nTimeReceived = 1000;
+    times.nTimeFirstVote = 1500;
+    times.nTimeReady = 4000;
+    times.nTimeLocked = 4200;
+    BOOST_CHECK_EQUAL(times.GetFirstVoteLatency(), 500);
+    BOOST_CHECK_EQUAL(times.GetQuorumLatency(), 2500);
+    BOOST_CHECK_EQUAL(times.GetFinalizeLatency(), 200);
+    BOOST_CHECK_EQUAL(times.GetTotalLatency(), 3200);
+
+    // votes arrived before the request, the request completed the quorum
+    times.nTimeFirstVote = 200;
+    times.nTimeReady = 1100;
+    BOOST_CHECK_EQUAL(times.GetFirstVoteLatency(), 0);
+    BOOST_CHECK_EQUAL(times.GetQuorumLatency(), 100);
+    BOOST_CHECK_EQUAL(times.GetFinalizeLatency(), 3100);
+    BOOST_CHECK_EQUAL(times.GetFirstVoteLatency() + times.GetQuorumLatency() + times.GetFinalizeLatency(), times.GetTotalLatency());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
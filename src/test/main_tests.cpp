@@ -4,7 +4,10 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "consensus/validation.h"
 #include "main.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
 
 #include "test/test_3dcoin.h"
 
@@ -78,4 +81,115 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+extern bool fAddressIndex;
+extern bool fAddressSummary;
+
+static void CheckAddressSummary(const CKeyID& keyID, bool fExists, const CAddressSummary& expected)
+{
+    CAddressSummary summary;
+    BOOST_CHECK_EQUAL(pblocktree->ReadAddressSummary(keyID, 1, summary), fExists);
+    BOOST_CHECK_EQUAL(summary.balance, expected.balance);
+    BOOST_CHECK_EQUAL(summary.received, expected.received);
+    BOOST_CHECK_EQUAL(summary.sent, expected.sent);
+    BOOST_CHECK_EQUAL(summary.txCount, expected.txCount);
+    BOOST_CHECK_EQUAL(summary.firstHeight, expected.firstHeight);
+    BOOST_CHECK_EQUAL(summary.lastHeight, expected.lastHeight);
+}
+
+static CMutableTransaction CreateSpend(const CTransaction& txPrev, const CScript& scriptPrev, const CKey& key, const std::vector<CTxOut>& vout)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(txPrev.GetHash(), 0);
+    tx.vout = vout;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPrev, tx, 0, SIGHASH_ALL);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    if (scriptPrev.IsPayToPublicKeyHash())
+        tx.vin[0].scriptSig << ToByteVector(key.GetPubKey());
+    return tx;
+}
+
+BOOST_FIXTURE_TEST_CASE(address_summary_disconnect, TestChain100Setup)
+{
+    fAddressIndex = true;
+    fAddressSummary = true;
+    const CChainParams& chainparams = Params();
+    CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    CKey keyA, keyB;
+    keyA.MakeNewKey(true);
+    keyB.MakeNewKey(true);
+    CScript scriptA = GetScriptForDestination(keyA.GetPubKey().GetID());
+    CScript scriptB = GetScriptForDestination(keyB.GetPubKey().GetID());
+
+    // block 101 pays A, block 102 spends it to B with change back to A
+    CAmount nValue = coinbaseTxns[0].vout[0].nValue - 10000;
+    std::vector<CTxOut> vout(1, CTxOut(nValue, scriptA));
+    CMutableTransaction tx1 = CreateSpend(coinbaseTxns[0], scriptCoinbase, coinbaseKey, vout);
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, tx1), scriptCoinbase);
+    BOOST_CHECK_EQUAL(chainActive.Height(), 101);
+
+    CAddressSummary summaryA;
+    BOOST_CHECK(pblocktree->ReadAddressSummary(keyA.GetPubKey().GetID(), 1, summaryA));
+    BOOST_CHECK_EQUAL(summaryA.balance, nValue);
+    BOOST_CHECK_EQUAL(summaryA.txCount, 1U);
+    BOOST_CHECK_EQUAL(summaryA.lastHeight, 101);
+
+    vout.clear();
+    vout.push_back(CTxOut(nValue / 2, scriptA));
+    vout.push_back(CTxOut(nValue / 2 - 10000, scriptB));
+    CMutableTransaction tx2 = CreateSpend(tx1, scriptA, keyA, vout);
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, tx2), scriptCoinbase);
+    BOOST_CHECK_EQUAL(chainActive.Height(), 102);
+
+    CAddressSummary summaryA2, summaryB2;
+    BOOST_CHECK(pblocktree->ReadAddressSummary(keyA.GetPubKey().GetID(), 1, summaryA2));
+    BOOST_CHECK(pblocktree->ReadAddressSummary(keyB.GetPubKey().GetID(), 1, summaryB2));
+    BOOST_CHECK_EQUAL(summaryA2.balance, nValue / 2);
+    BOOST_CHECK_EQUAL(summaryA2.sent, nValue);
+    BOOST_CHECK_EQUAL(summaryA2.txCount, 2U);
+    BOOST_CHECK_EQUAL(summaryA2.firstHeight, 101);
+    BOOST_CHECK_EQUAL(summaryA2.lastHeight, 102);
+    BOOST_CHECK_EQUAL(summaryB2.txCount, 1U);
+
+    // disconnecting 102 restores A exactly, last height included, and erases B
+    CBlockIndex* pindex101 = chainActive[101];
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, chainparams.GetConsensus(), chainActive.Tip()));
+    }
+    BOOST_CHECK(chainActive.Tip() == pindex101);
+    CheckAddressSummary(keyA.GetPubKey().GetID(), true, summaryA);
+    CheckAddressSummary(keyB.GetPubKey().GetID(), false, CAddressSummary());
+
+    // and disconnecting 101 erases A
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, chainparams.GetConsensus(), pindex101));
+    }
+    BOOST_CHECK_EQUAL(chainActive.Height(), 100);
+    CheckAddressSummary(keyA.GetPubKey().GetID(), false, CAddressSummary());
+
+    // connecting both again gives the same summaries as the first time
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(ReconsiderBlock(state, pindex101));
+    }
+    CValidationState state;
+    BOOST_CHECK(ActivateBestChain(state, chainparams));
+    BOOST_CHECK_EQUAL(chainActive.Height(), 102);
+    CheckAddressSummary(keyA.GetPubKey().GetID(), true, summaryA2);
+    CheckAddressSummary(keyB.GetPubKey().GetID(), true, summaryB2);
+
+    mempool.clear();
+    fAddressIndex = false;
+    fAddressSummary = false;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
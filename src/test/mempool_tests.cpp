@@ -2,6 +2,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "main.h"
+#include "script/interpreter.h"
 #include "txmempool.h"
 #include "util.h"
 
@@ -317,6 +321,197 @@ BOOST_AUTO_TEST_CASE(MempoolIndexingTest)
     CheckSort<3>(pool, sortedOrder);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAncestorIndexingTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    entry.hadNoDependencies = true;
+
+    /* 3rd highest fee */
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx1.GetHash(), entry.Fee(10000LL).Priority(10.0).FromTx(tx1));
+
+    /* highest fee */
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 2 * COIN;
+    pool.addUnchecked(tx2.GetHash(), entry.Fee(20000LL).Priority(9.0).FromTx(tx2));
+    uint64_t tx2Size = ::GetSerializeSize(CTransaction(tx2), SER_NETWORK, PROTOCOL_VERSION);
+
+    /* lowest fee */
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_3 << OP_EQUAL;
+    tx3.vout[0].nValue = 5 * COIN;
+    pool.addUnchecked(tx3.GetHash(), entry.Fee(0LL).Priority(100.0).FromTx(tx3));
+
+    /* 2nd highest fee */
+    CMutableTransaction tx4 = CMutableTransaction();
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = CScript() << OP_4 << OP_EQUAL;
+    tx4.vout[0].nValue = 6 * COIN;
+    pool.addUnchecked(tx4.GetHash(), entry.Fee(15000LL).Priority(1.0).FromTx(tx4));
+
+    /* equal fee rate to tx1, but newer */
+    CMutableTransaction tx5 = CMutableTransaction();
+    tx5.vout.resize(1);
+    tx5.vout[0].scriptPubKey = CScript() << OP_5 << OP_EQUAL;
+    tx5.vout[0].nValue = 11 * COIN;
+    pool.addUnchecked(tx5.GetHash(), entry.Fee(10000LL).FromTx(tx5));
+    BOOST_CHECK_EQUAL(pool.size(), 5);
+
+    std::vector<std::string> sortedOrder;
+    sortedOrder.resize(5);
+    sortedOrder[0] = tx2.GetHash().ToString(); // 20000
+    sortedOrder[1] = tx4.GetHash().ToString(); // 15000
+    // tx1 and tx5 are both 10000
+    // Ties are broken by hash, not timestamp, so determine which
+    // hash comes first.
+    if (tx1.GetHash() < tx5.GetHash()) {
+        sortedOrder[2] = tx1.GetHash().ToString();
+        sortedOrder[3] = tx5.GetHash().ToString();
+    } else {
+        sortedOrder[2] = tx5.GetHash().ToString();
+        sortedOrder[3] = tx1.GetHash().ToString();
+    }
+    sortedOrder[4] = tx3.GetHash().ToString(); // 0
+
+    CheckSort<4>(pool, sortedOrder);
+
+    /* low fee parent with high fee child */
+    /* tx6 (0) -> tx7 (high) */
+    CMutableTransaction tx6 = CMutableTransaction();
+    tx6.vout.resize(1);
+    tx6.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx6.vout[0].nValue = 20 * COIN;
+    uint64_t tx6Size = ::GetSerializeSize(CTransaction(tx6), SER_NETWORK, PROTOCOL_VERSION);
+
+    pool.addUnchecked(tx6.GetHash(), entry.Fee(0LL).FromTx(tx6));
+    BOOST_CHECK_EQUAL(pool.size(), 6);
+    // Ties are broken by hash
+    if (tx3.GetHash() < tx6.GetHash())
+        sortedOrder.push_back(tx6.GetHash().ToString());
+    else
+        sortedOrder.insert(sortedOrder.end()-1,tx6.GetHash().ToString());
+
+    CheckSort<4>(pool, sortedOrder);
+
+    CMutableTransaction tx7 = CMutableTransaction();
+    tx7.vin.resize(1);
+    tx7.vin[0].prevout = COutPoint(tx6.GetHash(), 0);
+    tx7.vin[0].scriptSig = CScript() << OP_11;
+    tx7.vout.resize(1);
+    tx7.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx7.vout[0].nValue = 10 * COIN;
+    uint64_t tx7Size = ::GetSerializeSize(CTransaction(tx7), SER_NETWORK, PROTOCOL_VERSION);
+
+    /* set the fee to just below tx2's feerate when including ancestor */
+    CAmount fee = (20000/tx2Size)*(tx7Size + tx6Size) - 1;
+
+    entry.hadNoDependencies = false;
+    pool.addUnchecked(tx7.GetHash(), entry.Fee(fee).FromTx(tx7));
+    BOOST_CHECK_EQUAL(pool.size(), 7);
+    sortedOrder.insert(sortedOrder.begin()+1, tx7.GetHash().ToString());
+    CheckSort<4>(pool, sortedOrder);
+
+    /* after tx6 is mined, tx7 should move up in the sort */
+    std::vector<CTransaction> vtx;
+    vtx.push_back(tx6);
+    std::list<CTransaction> dummy;
+    pool.removeForBlock(vtx, 1, dummy, false);
+
+    sortedOrder.erase(sortedOrder.begin()+1);
+    // Ties are broken by hash
+    if (tx3.GetHash() < tx6.GetHash())
+        sortedOrder.pop_back();
+    else
+        sortedOrder.erase(sortedOrder.end()-2);
+    sortedOrder.insert(sortedOrder.begin(), tx7.GetHash().ToString());
+    CheckSort<4>(pool, sortedOrder);
+}
+
+
+BOOST_AUTO_TEST_CASE(MempoolAddressIndexTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    pool.setSanityCheck(1.0);
+    TestMemPoolEntryHelper entry;
+    entry.hadNoDependencies = true;
+    CCoinsView dummy;
+    CCoinsViewCache view(&dummy);
+
+    uint160 addr1(std::vector<unsigned char>(20, 1));
+    uint160 addr2(std::vector<unsigned char>(20, 2));
+    CScript script1 = CScript() << OP_DUP << OP_HASH160 << ToByteVector(addr1) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CScript script2 = CScript() << OP_HASH160 << ToByteVector(addr2) << OP_EQUAL;
+
+    CMutableTransaction txFund;
+    txFund.vin.resize(1);
+    txFund.vout.resize(1);
+    txFund.vout[0].scriptPubKey = script1;
+    txFund.vout[0].nValue = 10 * COIN;
+    view.ModifyCoins(txFund.GetHash())->FromTx(txFund, 1);
+
+    // Spends from addr1 and pays to both addresses
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].prevout = COutPoint(txFund.GetHash(), 0);
+    tx1.vout.resize(2);
+    tx1.vout[0].scriptPubKey = script1;
+    tx1.vout[0].nValue = 4 * COIN;
+    tx1.vout[1].scriptPubKey = script2;
+    tx1.vout[1].nValue = 5 * COIN;
+    CTxMemPoolEntry entry1 = entry.Time(100).FromTx(tx1);
+    pool.addUnchecked(tx1.GetHash(), entry1);
+    pool.addAddressIndex(entry1, view);
+    pool.addSpentIndex(entry1, view);
+
+    std::vector<std::pair<uint160, int> > addresses;
+    addresses.push_back(std::make_pair(addr1, 1));
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > results;
+    BOOST_CHECK(pool.getAddressIndex(addresses, results));
+    BOOST_CHECK_EQUAL(results.size(), 2);
+    // Ordered by (txid, index, spending): output 0 comes before input 0
+    BOOST_CHECK(results[0].first.txhash == tx1.GetHash());
+    BOOST_CHECK_EQUAL(results[0].first.spending, 0);
+    BOOST_CHECK_EQUAL(results[0].second.amount, 4 * COIN);
+    BOOST_CHECK_EQUAL(results[1].first.spending, 1);
+    BOOST_CHECK_EQUAL(results[1].second.amount, -10 * COIN);
+    BOOST_CHECK_EQUAL(results[1].second.time, 100);
+    BOOST_CHECK(results[1].second.prevhash == txFund.GetHash());
+
+    addresses.clear();
+    addresses.push_back(std::make_pair(addr2, 2));
+    results.clear();
+    BOOST_CHECK(pool.getAddressIndex(addresses, results));
+    BOOST_CHECK_EQUAL(results.size(), 1);
+    BOOST_CHECK_EQUAL(results[0].first.index, 1);
+
+    CSpentIndexKey key(txFund.GetHash(), 0);
+    CSpentIndexValue value;
+    BOOST_CHECK(pool.getSpentIndex(key, value));
+    BOOST_CHECK(value.txid == tx1.GetHash());
+    BOOST_CHECK_EQUAL(value.inputIndex, 0);
+    BOOST_CHECK_EQUAL(value.satoshis, 10 * COIN);
+    BOOST_CHECK_EQUAL(value.addressType, 1);
+    BOOST_CHECK(value.addressHash == addr1);
+
+    pool.check(&view);
+    size_t usage = pool.DynamicMemoryUsage();
+
+    std::list<CTransaction> removed;
+    pool.remove(tx1, removed, true);
+    BOOST_CHECK(pool.DynamicMemoryUsage() < usage);
+    results.clear();
+    BOOST_CHECK(pool.getAddressIndex(addresses, results));
+    BOOST_CHECK_EQUAL(results.size(), 0);
+    BOOST_CHECK(!pool.getSpentIndex(key, value));
+    pool.check(&view);
+}
 
 BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
 {
@@ -473,4 +668,58 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_FIXTURE_TEST_CASE(MempoolResurrectDisconnectedTest, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // A chain of three spends of a mature coinbase, each mined in its own block
+    std::vector<CMutableTransaction> spends(3);
+    uint256 hashPrev = coinbaseTxns[0].GetHash();
+    CAmount nValue = coinbaseTxns[0].vout[0].nValue;
+    for (unsigned int i = 0; i < spends.size(); i++)
+    {
+        nValue -= 10000;
+        spends[i].vin.resize(1);
+        spends[i].vin[0].prevout.hash = hashPrev;
+        spends[i].vin[0].prevout.n = 0;
+        spends[i].vout.resize(1);
+        spends[i].vout[0].nValue = nValue;
+        spends[i].vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, spends[i], 0, SIGHASH_ALL);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        spends[i].vin[0].scriptSig << vchSig;
+        hashPrev = spends[i].GetHash();
+
+        std::vector<CMutableTransaction> txns(1, spends[i]);
+        CBlock block = CreateAndProcessBlock(txns, scriptPubKey);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    }
+    BOOST_CHECK_EQUAL(mempool.size(), 0U);
+
+    // Disconnect all three blocks at once; a child re-added before its parent
+    // would be missing inputs and not make it back into the mempool
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params().GetConsensus(), chainActive[chainActive.Height() - 2]));
+        BOOST_CHECK(state.IsValid());
+    }
+    BOOST_CHECK_EQUAL(chainActive.Height(), 100);
+    BOOST_CHECK_EQUAL(mempool.size(), spends.size());
+
+    // and the in-mempool parents and children are linked up again
+    LOCK(mempool.cs);
+    for (unsigned int i = 0; i < spends.size(); i++)
+    {
+        CTxMemPool::txiter it = mempool.mapTx.find(spends[i].GetHash());
+        BOOST_REQUIRE(it != mempool.mapTx.end());
+        BOOST_CHECK_EQUAL(it->GetCountWithAncestors(), i + 1);
+        BOOST_CHECK_EQUAL(it->GetCountWithDescendants(), spends.size() - i);
+    }
+    mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
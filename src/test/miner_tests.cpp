@@ -390,4 +390,60 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_AUTO_TEST_CASE(BlockTemplateCache_invalidation)
+{
+    const CChainParams& chainparams = Params(CBaseChainParams::MAIN);
+    CBlockTemplateCache cache;
+    CBlockTemplate *pblocktemplate;
+    unsigned int nTransactionsUpdated;
+    uint64_t nSequence;
+
+    LOCK(cs_main);
+    fCheckpointsEnabled = false;
+
+    // force UpdatedBlockTip to initialize pCurrentBlockIndex
+    mnpayments.UpdatedBlockTip(chainActive.Tip());
+
+    CBlockIndex* pindexTip = chainActive.Tip();
+    int64_t nNow = GetTime();
+
+    // nothing precomputed yet
+    BOOST_CHECK(cache.IsStale(pindexTip, nNow));
+    BOOST_CHECK(!cache.GetTemplate(pindexTip, nTransactionsUpdated, nSequence));
+
+    BOOST_CHECK(cache.Build(chainparams, true));
+    BOOST_CHECK(!cache.IsStale(pindexTip, nNow));
+    BOOST_CHECK(pblocktemplate = cache.GetTemplate(pindexTip, nTransactionsUpdated, nSequence));
+    BOOST_CHECK(pblocktemplate->block.hashPrevBlock == pindexTip->GetBlockHash());
+    BOOST_CHECK_EQUAL(nTransactionsUpdated, mempool.GetTransactionsUpdated());
+    BOOST_CHECK_EQUAL(nSequence, cache.GetSequence());
+    delete pblocktemplate;
+
+    // a mempool change outdates the template once it is old enough to be refreshed
+    mempool.AddTransactionsUpdated(1);
+    BOOST_CHECK(!cache.IsStale(pindexTip, nNow));
+    BOOST_CHECK(cache.IsStale(pindexTip, nNow + PRECOMPUTE_TEMPLATE_REFRESH_SECONDS + 1));
+    uint64_t nSequenceBefore = cache.GetSequence();
+    BOOST_CHECK(cache.Build(chainparams, true));
+    BOOST_CHECK(cache.GetSequence() > nSequenceBefore);
+    BOOST_CHECK(!cache.IsStale(pindexTip, nNow + PRECOMPUTE_TEMPLATE_REFRESH_SECONDS + 1));
+    BOOST_CHECK(pblocktemplate = cache.GetTemplate(pindexTip, nTransactionsUpdated, nSequence));
+    BOOST_CHECK_EQUAL(nTransactionsUpdated, mempool.GetTransactionsUpdated());
+    delete pblocktemplate;
+
+    // a new tip invalidates the template built on the old one right away
+    uint256 hashNext = uint256S("01");
+    CBlockIndex indexNext;
+    indexNext.phashBlock = &hashNext;
+    indexNext.pprev = pindexTip;
+    indexNext.nHeight = pindexTip->nHeight + 1;
+    BOOST_CHECK(cache.IsStale(&indexNext, nNow));
+    BOOST_CHECK(!cache.GetTemplate(&indexNext, nTransactionsUpdated, nSequence));
+    // the old tip still gets its template, e.g. for a long-poll racing the new block
+    BOOST_CHECK(pblocktemplate = cache.GetTemplate(pindexTip, nTransactionsUpdated, nSequence));
+    delete pblocktemplate;
+
+    fCheckpointsEnabled = true;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
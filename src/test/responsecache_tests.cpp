@@ -0,0 +1,79 @@
+// Copyright (c) 2017 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "httpserver.h"
+#include "responsecache.h"
+#include "test/test_3dcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(responsecache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(responsecache_lru)
+{
+    const uint256 hashBlock = uint256S("01");
+    const std::string strKey1 = CResponseCache::MakeKey("block", "bin", uint256S("a1"));
+    const std::string strKey2 = CResponseCache::MakeKey("block", "bin", uint256S("a2"));
+    const std::string strKey3 = CResponseCache::MakeKey("block", "bin", uint256S("a3"));
+    const std::string strBody(1000, 'x');
+
+    // room for two entries but not three
+    CResponseCache cache(0);
+    cache.Put(strKey1, strBody, hashBlock);
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    cache.SetMaxBytes(2 * 1000 + 1000);
+    cache.Put(strKey1, strBody, hashBlock);
+    cache.Put(strKey2, strBody, hashBlock);
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+
+    std::string strOut;
+    uint256 hashOut;
+    BOOST_CHECK(cache.Get(strKey1, strOut, hashOut));
+    BOOST_CHECK(strOut == strBody);
+    BOOST_CHECK(hashOut == hashBlock);
+
+    // key1 was used last, so adding key3 evicts key2
+    cache.Put(strKey3, strBody, hashBlock);
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+    BOOST_CHECK(cache.Get(strKey1, strOut, hashOut));
+    BOOST_CHECK(!cache.Get(strKey2, strOut, hashOut));
+    BOOST_CHECK(cache.Get(strKey3, strOut, hashOut));
+    BOOST_CHECK(cache.BytesUsed() <= cache.GetMaxBytes());
+
+    // replacing an entry keeps the accounting straight
+    size_t nBytesUsed = cache.BytesUsed();
+    cache.Put(strKey3, strBody, hashBlock);
+    BOOST_CHECK_EQUAL(cache.BytesUsed(), nBytesUsed);
+
+    // bodies larger than the budget are not cached
+    cache.Put(strKey2, std::string(4000, 'y'), hashBlock);
+    BOOST_CHECK(!cache.Get(strKey2, strOut, hashOut));
+
+    cache.Erase(strKey1);
+    BOOST_CHECK(!cache.Get(strKey1, strOut, hashOut));
+    cache.SetMaxBytes(0);
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    BOOST_CHECK_EQUAL(cache.BytesUsed(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(responsecache_etag)
+{
+    const std::string strKey = CResponseCache::MakeKey("tx", "hex", uint256S("a1"));
+    const std::string strETag = CResponseCache::MakeETag(strKey);
+    const std::string strWeakETag = CResponseCache::MakeETag(strKey, uint256S("b1"));
+    BOOST_CHECK(strETag != strWeakETag);
+    BOOST_CHECK(strWeakETag.compare(0, 2, "W/") == 0);
+
+    BOOST_CHECK(HTTPETagMatches(strETag, strETag));
+    BOOST_CHECK(HTTPETagMatches("\"other\", " + strETag, strETag));
+    BOOST_CHECK(HTTPETagMatches("W/" + strETag, strETag));
+    BOOST_CHECK(HTTPETagMatches(strWeakETag, strWeakETag));
+    BOOST_CHECK(HTTPETagMatches(strWeakETag.substr(2), strWeakETag));
+    BOOST_CHECK(HTTPETagMatches("*", strETag));
+    BOOST_CHECK(!HTTPETagMatches("\"other\"", strETag));
+    BOOST_CHECK(!HTTPETagMatches(strWeakETag, strETag));
+    BOOST_CHECK(!HTTPETagMatches("", strETag));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,17 +4,28 @@
 
 #include "rpcserver.h"
 #include "rpcclient.h"
+#include "rpcstream.h"
+
+#include "binaryrpc.h"
 
 #include "base58.h"
+#include "main.h"
 #include "netbase.h"
+#include "streams.h"
+#include "txdb.h"
 
 #include "test/test_3dcoin.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include <univalue.h>
 
+#ifndef WIN32
+#include <sys/socket.h>
+#endif
+
 using namespace std;
 
 UniValue createArgs(int nRequired, const char* address1=NULL, const char* address2=NULL)
@@ -307,4 +318,311 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+static void AppendChunk(std::string* pstr, std::vector<size_t>* pvSizes, const std::string& strChunk)
+{
+    *pstr += strChunk;
+    pvSizes->push_back(strChunk.size());
+}
+
+BOOST_AUTO_TEST_CASE(rpc_stream_writer)
+{
+    UniValue inner(UniValue::VARR);
+    inner.push_back(1);
+    inner.push_back("two");
+    inner.push_back(NullUniValue);
+    UniValue expected(UniValue::VOBJ);
+    expected.push_back(Pair("empty", UniValue(UniValue::VOBJ)));
+    expected.push_back(Pair("list", inner));
+    expected.push_back(Pair("quote\"d", true));
+    UniValue nested(UniValue::VARR);
+    nested.push_back(UniValue(UniValue::VARR));
+    nested.push_back(inner);
+    expected.push_back(Pair("nested", nested));
+
+    std::string strOut;
+    std::vector<size_t> vSizes;
+    CJSONStreamWriter writer(boost::bind(AppendChunk, &strOut, &vSizes, _1), 8);
+    writer.BeginObject();
+    writer.Key("empty");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.Key("list");
+    writer.Value(inner);
+    writer.Key("quote\"d");
+    writer.Value(true);
+    writer.Key("nested");
+    writer.BeginArray();
+    writer.BeginArray();
+    writer.EndArray();
+    writer.BeginArray();
+    writer.Value(1);
+    writer.Value("two");
+    writer.Value(NullUniValue);
+    writer.EndArray();
+    writer.EndArray();
+    writer.EndObject();
+
+    BOOST_CHECK(writer.HasFlushed());
+    BOOST_CHECK(vSizes.size() > 1);
+    strOut += writer.Release();
+    BOOST_CHECK_EQUAL(strOut, expected.write());
+
+    // Nothing reaches the sink until a chunk is full
+    std::string strSmall;
+    vSizes.clear();
+    CJSONStreamWriter small(boost::bind(AppendChunk, &strSmall, &vSizes, _1));
+    small.BeginArray();
+    small.Value("x");
+    small.EndArray();
+    BOOST_CHECK(!small.HasFlushed());
+    BOOST_CHECK(strSmall.empty());
+    BOOST_CHECK_EQUAL(small.Release(), "[\"x\"]");
+}
+
+static bool EnqueueOnThread(boost::thread_group* pthreads, const boost::function<void(void)>& func)
+{
+    pthreads->create_thread(func);
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(rpc_batch_concurrent)
+{
+    if (RPCIsInWarmup(NULL))
+        SetRPCWarmupFinished();
+
+    // Read-only calls around one that is not, and one that fails
+    UniValue vReq(UniValue::VARR);
+    const char* scripts[] = {"00", "51", "52", "53", "", "54", "55"};
+    for (int i = 0; i < 7; i++) {
+        UniValue params(UniValue::VARR);
+        params.push_back(scripts[i]);
+        UniValue req(UniValue::VOBJ);
+        req.push_back(Pair("method", i == 4 ? "nosuchmethod" : (i == 2 ? "createmultisig" : "decodescript")));
+        req.push_back(Pair("params", params));
+        req.push_back(Pair("id", i));
+        vReq.push_back(req);
+    }
+
+    UniValue sequential;
+    BOOST_CHECK(sequential.read(JSONRPCExecBatch(vReq)));
+
+    boost::thread_group threads;
+    UniValue concurrent;
+    BOOST_CHECK(concurrent.read(JSONRPCExecBatch(vReq, boost::bind(EnqueueOnThread, &threads, _1))));
+    threads.join_all();
+
+    BOOST_CHECK_EQUAL(concurrent.write(), sequential.write());
+    BOOST_CHECK_EQUAL(concurrent.size(), 7);
+    for (int i = 0; i < 7; i++)
+        BOOST_CHECK_EQUAL(find_value(concurrent[i], "id").get_int(), i);
+    BOOST_CHECK(find_value(concurrent[1], "error").isNull());
+    BOOST_CHECK_EQUAL(find_value(find_value(concurrent[1], "result"), "asm").get_str(), "1");
+    BOOST_CHECK(!find_value(concurrent[4], "error").isNull());
+}
+
+static CDataStream ExecBinary(const CDataStream& ssRequest)
+{
+    std::string strReply = ExecBinaryRPCRequest(ssRequest.str());
+    return CDataStream(strReply.data(), strReply.data() + strReply.size(), SER_NETWORK, PROTOCOL_VERSION);
+}
+
+static int BinaryErrorCode(CDataStream ssReply)
+{
+    unsigned char nStatus;
+    int nCode;
+    std::string strMessage;
+    ssReply >> nStatus;
+    BOOST_CHECK_EQUAL(nStatus, BINARY_RPC_ERROR);
+    ssReply >> nCode >> strMessage;
+    return nCode;
+}
+
+BOOST_AUTO_TEST_CASE(rpc_binary_requests)
+{
+    if (RPCIsInWarmup(NULL))
+        SetRPCWarmupFinished();
+    const uint256 hashGenesis = chainActive.Genesis()->GetBlockHash();
+    unsigned char nStatus;
+
+    CDataStream ssBest(SER_NETWORK, PROTOCOL_VERSION);
+    ssBest << (unsigned char)BINARY_RPC_GETBESTBLOCK;
+    CDataStream ssReply = ExecBinary(ssBest);
+    int nHeight;
+    uint256 hash;
+    ssReply >> nStatus >> nHeight >> hash;
+    BOOST_CHECK_EQUAL(nStatus, BINARY_RPC_OK);
+    BOOST_CHECK_EQUAL(nHeight, chainActive.Height());
+    BOOST_CHECK(hash == chainActive.Tip()->GetBlockHash());
+
+    CDataStream ssHash(SER_NETWORK, PROTOCOL_VERSION);
+    ssHash << (unsigned char)BINARY_RPC_GETBLOCKHASH << 0;
+    ssReply = ExecBinary(ssHash);
+    ssReply >> nStatus >> hash;
+    BOOST_CHECK_EQUAL(nStatus, BINARY_RPC_OK);
+    BOOST_CHECK(hash == hashGenesis);
+
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << (unsigned char)BINARY_RPC_GETBLOCK << hashGenesis;
+    ssReply = ExecBinary(ssBlock);
+    CBlock block;
+    ssReply >> nStatus >> block;
+    BOOST_CHECK_EQUAL(nStatus, BINARY_RPC_OK);
+    BOOST_CHECK(block.GetHash() == hashGenesis);
+    BOOST_CHECK(ssReply.empty());
+
+    // JSON-RPC requests are answered with the JSON-RPC reply text
+    const std::string strJSON = JSONRPCRequest("getblockcount", UniValue(UniValue::VARR), 1);
+    std::string strReply = ExecBinaryRPCRequest(std::string(1, (char)BINARY_RPC_JSON) + strJSON);
+    BOOST_CHECK_EQUAL((unsigned char)strReply[0], BINARY_RPC_OK);
+    UniValue valReply;
+    BOOST_CHECK(valReply.read(strReply.substr(1)));
+    BOOST_CHECK_EQUAL(find_value(valReply, "result").get_int(), chainActive.Height());
+
+    // errors
+    CDataStream ssOutOfRange(SER_NETWORK, PROTOCOL_VERSION);
+    ssOutOfRange << (unsigned char)BINARY_RPC_GETBLOCKHASH << chainActive.Height() + 1;
+    BOOST_CHECK_EQUAL(BinaryErrorCode(ExecBinary(ssOutOfRange)), RPC_INVALID_PARAMETER);
+    CDataStream ssUnknown(SER_NETWORK, PROTOCOL_VERSION);
+    ssUnknown << (unsigned char)BINARY_RPC_GETBLOCK << uint256S("ff");
+    BOOST_CHECK_EQUAL(BinaryErrorCode(ExecBinary(ssUnknown)), RPC_INVALID_ADDRESS_OR_KEY);
+    CDataStream ssTruncated(SER_NETWORK, PROTOCOL_VERSION);
+    ssTruncated << (unsigned char)BINARY_RPC_GETBLOCK;
+    BOOST_CHECK_EQUAL(BinaryErrorCode(ExecBinary(ssTruncated)), RPC_DESERIALIZATION_ERROR);
+    CDataStream ssBadType(SER_NETWORK, PROTOCOL_VERSION);
+    ssBadType << (unsigned char)200;
+    BOOST_CHECK_EQUAL(BinaryErrorCode(ExecBinary(ssBadType)), RPC_METHOD_NOT_FOUND);
+}
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(rpc_binary_frames)
+{
+    int fds[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    const std::string strPayload(1000, 'x');
+    BOOST_CHECK(WriteBinaryRPCFrame(fds[0], ""));
+    BOOST_CHECK(WriteBinaryRPCFrame(fds[0], strPayload));
+    std::string strFrame;
+    BOOST_CHECK(ReadBinaryRPCFrame(fds[1], strFrame, 1000));
+    BOOST_CHECK(strFrame.empty());
+    BOOST_CHECK(ReadBinaryRPCFrame(fds[1], strFrame, 1000));
+    BOOST_CHECK(strFrame == strPayload);
+
+    // frames over the limit are refused
+    BOOST_CHECK(WriteBinaryRPCFrame(fds[0], strPayload + "y"));
+    BOOST_CHECK(!ReadBinaryRPCFrame(fds[1], strFrame, 1000));
+
+    // so is a stream that ends
+    close(fds[0]);
+    BOOST_CHECK(!ReadBinaryRPCFrame(fds[1], strFrame, 1000));
+    close(fds[1]);
+}
+#endif
+
+extern bool fAddressIndex;
+
+/** Walk all pages of an address index RPC, returning the entries and checking each page size */
+static std::vector<UniValue> CallRPCPages(const std::string& strMethod, const std::string& strAddresses,
+                                         const std::string& strField, int nLimit, std::vector<std::string>& vCursors)
+{
+    std::vector<UniValue> vEntries;
+    std::string strCursor;
+    do {
+        std::string strParams = "{\"addresses\":[" + strAddresses + "],\"limit\":" + itostr(nLimit);
+        if (!strCursor.empty())
+            strParams += ",\"cursor\":\"" + strCursor + "\"";
+        UniValue page = CallRPC(strMethod + " " + strParams + "}");
+        const UniValue& entries = find_value(page.get_obj(), strField);
+        BOOST_CHECK(entries.size() <= (size_t)nLimit);
+        for (size_t i = 0; i < entries.size(); i++)
+            vEntries.push_back(entries[i]);
+        const UniValue& cursor = find_value(page.get_obj(), "cursor");
+        strCursor = cursor.isNull() ? "" : cursor.get_str();
+        if (!strCursor.empty()) {
+            BOOST_CHECK_EQUAL(entries.size(), (size_t)nLimit);
+            vCursors.push_back(strCursor);
+        }
+    } while (!strCursor.empty() && vEntries.size() < 100);
+    return vEntries;
+}
+
+BOOST_AUTO_TEST_CASE(rpc_addressindex_paging)
+{
+    CKey keyA, keyB;
+    keyA.MakeNewKey(true);
+    keyB.MakeNewKey(true);
+    uint160 hashA = keyA.GetPubKey().GetID();
+    uint160 hashB = keyB.GetPubKey().GetID();
+    std::string strA = "\"" + CBitcoinAddress(keyA.GetPubKey().GetID()).ToString() + "\"";
+    std::string strB = "\"" + CBitcoinAddress(keyB.GetPubKey().GetID()).ToString() + "\"";
+
+    // block order and txid order differ at height 5
+    uint256 txA = uint256S(std::string(64, 'a'));
+    uint256 txB = uint256S(std::string(64, 'b'));
+    uint256 txC = uint256S(std::string(64, 'c'));
+    uint256 txD = uint256S(std::string(64, 'd'));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vIndex;
+    vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashA, 5, 1, txC, 1, false), 100));
+    vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashA, 5, 1, txC, 256, false), 200));
+    vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashB, 5, 2, txB, 0, false), 300));
+    vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashA, 5, 3, txA, 0, true), -100));
+    vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashB, 5, 3, txA, 1, false), 50));
+    vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashB, 6, 1, txD, 0, false), 400));
+    BOOST_CHECK(pblocktree->WriteAddressIndex(vIndex));
+    fAddressIndex = true;
+
+    // database order: height and position in the block big endian, the index
+    // little endian, so output 256 of txC comes before output 1
+    const char* expected[][2] = {
+        {"c", "256"}, {"c", "1"}, {"b", "0"}, {"a", "0"}, {"a", "1"}, {"d", "0"}
+    };
+    std::vector<std::string> vCursors;
+    std::vector<UniValue> vDeltas = CallRPCPages("getaddressdeltas", strA + "," + strB, "deltas", 2, vCursors);
+    BOOST_CHECK_EQUAL(vDeltas.size(), 6U);
+    for (unsigned int i = 0; i < vDeltas.size() && i < 6; i++) {
+        BOOST_CHECK_EQUAL(find_value(vDeltas[i].get_obj(), "txid").get_str(), std::string(64, expected[i][0][0]));
+        BOOST_CHECK_EQUAL(find_value(vDeltas[i].get_obj(), "index").get_int(), atoi(expected[i][1]));
+    }
+    // the first page ends inside txC, and the last full page has no cursor
+    BOOST_CHECK_EQUAL(vCursors.size(), 2U);
+    if (!vCursors.empty())
+        BOOST_CHECK_EQUAL(vCursors[0], "5:1:" + txC.GetHex() + ":256:0");
+
+    // a single address pages through its own history only
+    vCursors.clear();
+    vDeltas = CallRPCPages("getaddressdeltas", strA, "deltas", 1, vCursors);
+    BOOST_CHECK_EQUAL(vDeltas.size(), 3U);
+    BOOST_CHECK_EQUAL(vCursors.size(), 2U);
+
+    // a cursor at the last entry gives an empty last page
+    UniValue page = CallRPC("getaddressdeltas {\"addresses\":[" + strA + "," + strB + "],\"limit\":2,\"cursor\":\"6:1:" + txD.GetHex() + ":0:0\"}");
+    BOOST_CHECK(find_value(page.get_obj(), "deltas").empty());
+    BOOST_CHECK(find_value(page.get_obj(), "cursor").isNull());
+
+    // txids are not repeated when their entries span pages or addresses
+    vCursors.clear();
+    std::vector<UniValue> vTxids = CallRPCPages("getaddresstxids", strA + "," + strB, "txids", 1, vCursors);
+    BOOST_CHECK_EQUAL(vTxids.size(), 4U);
+    const char order[] = "cbad";
+    for (unsigned int i = 0; i < vTxids.size() && i < 4; i++)
+        BOOST_CHECK_EQUAL(vTxids[i].get_str(), std::string(64, order[i]));
+    BOOST_CHECK_EQUAL(vCursors.size(), 3U);
+
+    // without a limit several addresses keep the (height, txid) order
+    UniValue txids = CallRPC("getaddresstxids {\"addresses\":[" + strA + "," + strB + "]}");
+    BOOST_CHECK_EQUAL(txids.size(), 4U);
+    const char orderUnpaged[] = "abcd";
+    for (unsigned int i = 0; i < txids.size() && i < 4; i++)
+        BOOST_CHECK_EQUAL(txids[i].get_str(), std::string(64, orderUnpaged[i]));
+    txids = CallRPC("getaddresstxids {\"addresses\":[" + strA + "]}");
+    BOOST_CHECK_EQUAL(txids.size(), 2U);
+    if (txids.size() == 2) {
+        BOOST_CHECK_EQUAL(txids[0].get_str(), txC.GetHex());
+        BOOST_CHECK_EQUAL(txids[1].get_str(), txA.GetHex());
+    }
+
+    fAddressIndex = false;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -25,6 +25,7 @@ static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
+static const char DB_ADDRESSSUMMARY = 'S';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
@@ -45,6 +46,22 @@ bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
     return db.Exists(make_pair(DB_COINS, txid));
 }
 
+void CCoinsViewDB::GetCoinsBatch(const std::vector<uint256> &vTxid, std::vector<CCoins> &vCoins, std::vector<bool> &vFound) const {
+    vCoins.assign(vTxid.size(), CCoins());
+    vFound.assign(vTxid.size(), false);
+
+    // One iterator is seeked to every txid in turn. With sorted txids the seeks go in key
+    // order, so neighbouring keys are found in table blocks the previous seek already read.
+    boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
+    for (size_t i = 0; i < vTxid.size(); i++) {
+        std::pair<char, uint256> key = make_pair(DB_COINS, vTxid[i]);
+        pcursor->Seek(key);
+        std::pair<char, uint256> keyFound;
+        if (pcursor->Valid() && pcursor->GetKey(keyFound) && keyFound == key)
+            vFound[i] = pcursor->GetValue(vCoins[i]);
+    }
+}
+
 uint256 CCoinsViewDB::GetBestBlock() const {
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
@@ -160,6 +177,20 @@ bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
     return Read(make_pair(DB_TXINDEX, txid), pos);
 }
 
+void CBlockTreeDB::ReadTxIndexBatch(const std::vector<uint256> &vTxid, std::vector<CDiskTxPos> &vPos, std::vector<bool> &vFound) {
+    vPos.assign(vTxid.size(), CDiskTxPos());
+    vFound.assign(vTxid.size(), false);
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    for (size_t i = 0; i < vTxid.size(); i++) {
+        std::pair<char, uint256> key = make_pair(DB_TXINDEX, vTxid[i]);
+        pcursor->Seek(key);
+        std::pair<char, uint256> keyFound;
+        if (pcursor->Valid() && pcursor->GetKey(keyFound) && keyFound == key)
+            vFound[i] = pcursor->GetValue(vPos[i]);
+    }
+}
+
 bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
     CDBBatch batch(&GetObfuscateKey());
     for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
@@ -196,19 +227,32 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           const CAddressUnspentKey* pkeyAfter, size_t nLimit) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    if (pkeyAfter) {
+        // Seek to the continuation point; the entry at the cursor itself was already returned
+        CAddressUnspentKey keyAfter(type, addressHash, pkeyAfter->txhash, pkeyAfter->index);
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, keyAfter));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
 
-    while (pcursor->Valid()) {
+    size_t nCount = 0;
+    while (pcursor->Valid() && (nLimit == 0 || nCount < nLimit)) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            if (pkeyAfter && nCount == 0 && key.second.txhash == pkeyAfter->txhash && key.second.index == pkeyAfter->index) {
+                pcursor->Next();
+                continue;
+            }
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
                 unspentOutputs.push_back(make_pair(key.second, nValue));
+                nCount++;
                 pcursor->Next();
             } else {
                 return error("failed to get address unspent value");
@@ -237,26 +281,40 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end,
+                                    const CAddressIndexKey* pkeyAfter, size_t nLimit) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
+    if (pkeyAfter) {
+        // Seek to the continuation point; the entry at the cursor itself was already returned
+        CAddressIndexKey keyAfter(type, addressHash, pkeyAfter->blockHeight, pkeyAfter->txindex,
+                                  pkeyAfter->txhash, pkeyAfter->index, pkeyAfter->spending);
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, keyAfter));
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
     }
 
-    while (pcursor->Valid()) {
+    size_t nCount = 0;
+    while (pcursor->Valid() && (nLimit == 0 || nCount < nLimit)) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
             if (end > 0 && key.second.blockHeight > end) {
                 break;
             }
+            if (pkeyAfter && nCount == 0 && key.second.blockHeight == pkeyAfter->blockHeight &&
+                key.second.txindex == pkeyAfter->txindex && key.second.txhash == pkeyAfter->txhash &&
+                key.second.index == pkeyAfter->index && key.second.spending == pkeyAfter->spending) {
+                pcursor->Next();
+                continue;
+            }
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
                 addressIndex.push_back(make_pair(key.second, nValue));
+                nCount++;
                 pcursor->Next();
             } else {
                 return error("failed to get address index value");
@@ -269,6 +327,43 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::ReadAddressSummary(uint160 addressHash, int type, CAddressSummary &summary) {
+    return Read(make_pair(DB_ADDRESSSUMMARY, CAddressIndexIteratorKey(type, addressHash)), summary);
+}
+
+bool CBlockTreeDB::UpdateAddressSummaries(const std::vector<std::pair<std::pair<uint160, int>, CAddressSummary> > &vect) {
+    CDBBatch batch(&GetObfuscateKey());
+    for (std::vector<std::pair<std::pair<uint160, int>, CAddressSummary> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        CAddressIndexIteratorKey key(it->first.second, it->first.first);
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSSUMMARY, key));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSSUMMARY, key), it->second);
+        }
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressLastHeight(uint160 addressHash, int type, int nBeforeHeight, int &nHeight) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    // The entry right before the first possible key at nBeforeHeight
+    pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, nBeforeHeight)));
+    if (!pcursor->Valid())
+        return false;
+    pcursor->Prev();
+
+    std::pair<char,CAddressIndexKey> key;
+    if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX &&
+        key.second.type == (unsigned int)type && key.second.hashBytes == addressHash) {
+        nHeight = key.second.blockHeight;
+        return true;
+    }
+
+    return false;
+}
+
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(&GetObfuscateKey());
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
@@ -22,6 +22,7 @@ struct CAddressUnspentValue;
 struct CAddressIndexKey;
 struct CAddressIndexIteratorKey;
 struct CAddressIndexIteratorHeightKey;
+struct CAddressSummary;
 struct CTimestampIndexKey;
 struct CTimestampIndexIteratorKey;
 struct CSpentIndexKey;
@@ -45,6 +46,7 @@ public:
 
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
     bool HaveCoins(const uint256 &txid) const;
+    void GetCoinsBatch(const std::vector<uint256> &vTxid, std::vector<CCoins> &vCoins, std::vector<bool> &vFound) const;
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     bool GetStats(CCoinsStats &stats) const;
@@ -65,17 +67,30 @@ public:
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
+    /** Look up many transactions at once, vTxid must be sorted */
+    void ReadTxIndexBatch(const std::vector<uint256> &vTxid, std::vector<CDiskTxPos> &vPos, std::vector<bool> &vFound);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
+    //! Append the unspent outputs of an address, in key order, starting right after
+    //! pkeyAfter (if given) and stopping after nLimit entries (if non-zero)
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 const CAddressUnspentKey* pkeyAfter = NULL, size_t nLimit = 0);
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    //! Append the history of an address, in key order, starting right after
+    //! pkeyAfter (if given) and stopping after nLimit entries (if non-zero)
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
+                          int start = 0, int end = 0,
+                          const CAddressIndexKey* pkeyAfter = NULL, size_t nLimit = 0);
+    bool ReadAddressSummary(uint160 addressHash, int type, CAddressSummary &summary);
+    //! Write the summaries of addresses, erasing the null ones
+    bool UpdateAddressSummaries(const std::vector<std::pair<std::pair<uint160, int>, CAddressSummary> > &vect);
+    //! Find the highest block below nBeforeHeight with address index entries for an address
+    bool ReadAddressLastHeight(uint160 addressHash, int type, int nBeforeHeight, int &nHeight);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool WriteFlag(const std::string &name, bool fValue);
@@ -34,6 +34,10 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
     nCountWithDescendants = 1;
     nSizeWithDescendants = nTxSize;
     nModFeesWithDescendants = nFee;
+    nCountWithAncestors = 1;
+    nSizeWithAncestors = nTxSize;
+    nModFeesWithAncestors = nFee;
+    nSigOpCountWithAncestors = sigOpCount;
     CAmount nValueIn = tx.GetValueOut()+nFee;
     assert(inChainInputValue <= nValueIn);
 
@@ -58,6 +62,7 @@ CTxMemPoolEntry::GetPriority(unsigned int currentHeight) const
 void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
 {
     nModFeesWithDescendants += newFeeDelta - feeDelta;
+    nModFeesWithAncestors += newFeeDelta - feeDelta;
     feeDelta = newFeeDelta;
 }
 
@@ -123,6 +128,7 @@ bool CTxMemPool::UpdateForDescendants(txiter updateIt, int maxDescendantsToVisit
             modifyFee += cit->GetModifiedFee();
             modifyCount++;
             cachedDescendants[updateIt].insert(cit);
+            mapTx.modify(cit, update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCount()));
         }
     }
     mapTx.modify(updateIt, update_descendant_state(modifySize, modifyFee, modifyCount));
@@ -175,11 +181,21 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
         if (!UpdateForDescendants(it, 100, mapMemPoolDescendantsToUpdate, setAlreadyIncluded)) {
             // Mark as dirty if we can't do the calculation.
             mapTx.modify(it, set_dirty());
+            // Ancestor state has no dirty fallback (mining relies on it), so the
+            // descendants still have to learn about their new ancestor.
+            setEntries setDescendants;
+            CalculateDescendants(it, setDescendants);
+            setDescendants.erase(it);
+            BOOST_FOREACH(txiter descendantIt, setDescendants) {
+                if (!setAlreadyIncluded.count(descendantIt->GetTx().GetHash())) {
+                    mapTx.modify(descendantIt, update_ancestor_state(it->GetTxSize(), it->GetModifiedFee(), 1, it->GetSigOpCount()));
+                }
+            }
         }
     }
 }
 
-bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents /* = true */)
+bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents /* = true */) const
 {
     setEntries parentHashes;
     const CTransaction &tx = entry.GetTx();
@@ -256,6 +272,20 @@ void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors
     }
 }
 
+void CTxMemPool::UpdateEntryForAncestors(txiter it, const setEntries &setAncestors)
+{
+    int64_t updateCount = setAncestors.size();
+    int64_t updateSize = 0;
+    CAmount updateFee = 0;
+    int updateSigOps = 0;
+    BOOST_FOREACH(txiter ancestorIt, setAncestors) {
+        updateSize += ancestorIt->GetTxSize();
+        updateFee += ancestorIt->GetModifiedFee();
+        updateSigOps += ancestorIt->GetSigOpCount();
+    }
+    mapTx.modify(it, update_ancestor_state(updateSize, updateFee, updateCount, updateSigOps));
+}
+
 void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 {
     const setEntries &setMemPoolChildren = GetMemPoolChildren(it);
@@ -264,11 +294,30 @@ void CTxMemPool::UpdateChildrenForRemoval(txiter it)
     }
 }
 
-void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove)
+void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants)
 {
     // For each entry, walk back all ancestors and decrement size associated with this
     // transaction
     const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    if (updateDescendants) {
+        // updateDescendants should be true whenever we're not recursively
+        // removing a tx and all its descendants, eg when a transaction is
+        // confirmed in a block.
+        // Here we only update statistics and not data in mapLinks (which
+        // we need to preserve until we're finished with all operations that
+        // need to traverse the mempool).
+        BOOST_FOREACH(txiter removeIt, entriesToRemove) {
+            setEntries setDescendants;
+            CalculateDescendants(removeIt, setDescendants);
+            setDescendants.erase(removeIt); // don't update state for self
+            int64_t modifySize = -((int64_t)removeIt->GetTxSize());
+            CAmount modifyFee = -removeIt->GetModifiedFee();
+            int modifySigOps = -removeIt->GetSigOpCount();
+            BOOST_FOREACH(txiter dit, setDescendants) {
+                mapTx.modify(dit, update_ancestor_state(modifySize, modifyFee, -1, modifySigOps));
+            }
+        }
+    }
     BOOST_FOREACH(txiter removeIt, entriesToRemove) {
         setEntries setAncestors;
         const CTxMemPoolEntry &entry = *removeIt;
@@ -324,6 +373,17 @@ void CTxMemPoolEntry::UpdateState(int64_t modifySize, CAmount modifyFee, int64_t
     }
 }
 
+void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount, int modifySigOps)
+{
+    nSizeWithAncestors += modifySize;
+    assert(int64_t(nSizeWithAncestors) > 0);
+    nModFeesWithAncestors += modifyFee;
+    nCountWithAncestors += modifyCount;
+    assert(int64_t(nCountWithAncestors) > 0);
+    nSigOpCountWithAncestors += modifySigOps;
+    assert(int(nSigOpCountWithAncestors) >= 0);
+}
+
 CTxMemPool::CTxMemPool(const CFeeRate& _minReasonableRelayFee) :
     nTransactionsUpdated(0)
 {
@@ -414,6 +474,7 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
         }
     }
     UpdateAncestorsOf(true, newit, setAncestors);
+    UpdateEntryForAncestors(newit, setAncestors);
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
@@ -426,24 +487,22 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
 {
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    txiter it = mapTx.find(tx.GetHash());
+    if (it == mapTx.end() || mapAddressInserted.count(it))
+        return;
 
-    uint256 txhash = tx.GetHash();
+    // Collect (address, position, amount) for every input and output paying
+    // to a P2SH or P2PKH script
+    std::vector<std::pair<std::pair<int, uint160>, std::pair<addressDeltaPos, CAmount> > > deltas;
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
         const CTxIn input = tx.vin[j];
         const CTxOut &prevout = view.GetOutputFor(input);
         if (prevout.scriptPubKey.IsPayToScriptHash()) {
             vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
-            CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(make_pair(key, delta));
-            inserted.push_back(key);
+            deltas.push_back(make_pair(make_pair(2, uint160(hashBytes)), make_pair(addressDeltaPos(it, j, 1), prevout.nValue * -1)));
         } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
             vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
-            CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(make_pair(key, delta));
-            inserted.push_back(key);
+            deltas.push_back(make_pair(make_pair(1, uint160(hashBytes)), make_pair(addressDeltaPos(it, j, 1), prevout.nValue * -1)));
         }
     }
 
@@ -451,19 +510,32 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
         const CTxOut &out = tx.vout[k];
         if (out.scriptPubKey.IsPayToScriptHash()) {
             vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-            CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            deltas.push_back(make_pair(make_pair(2, uint160(hashBytes)), make_pair(addressDeltaPos(it, k, 0), out.nValue)));
         } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
             vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-            std::pair<addressDeltaMap::iterator,bool> ret;
-            CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            deltas.push_back(make_pair(make_pair(1, uint160(hashBytes)), make_pair(addressDeltaPos(it, k, 0), out.nValue)));
+        }
+    }
+
+    if (deltas.empty())
+        return;
+
+    std::vector<addressBucketMap::iterator> buckets;
+    for (unsigned int i = 0; i < deltas.size(); i++) {
+        addressBucketMap::iterator bit = mapAddress.find(deltas[i].first);
+        if (bit == mapAddress.end()) {
+            bit = mapAddress.insert(make_pair(deltas[i].first, addressBucket())).first;
+            cachedIndexUsage += memusage::IncrementalDynamicUsage(mapAddress);
         }
+        if (bit->second.insert(deltas[i].second).second)
+            cachedIndexUsage += memusage::IncrementalDynamicUsage(bit->second);
+        if (std::find(buckets.begin(), buckets.end(), bit) == buckets.end())
+            buckets.push_back(bit);
     }
 
-    mapAddressInserted.insert(make_pair(txhash, inserted));
+    addressBucketsByEntry::iterator iit = mapAddressInserted.insert(make_pair(it, std::vector<addressBucketMap::iterator>())).first;
+    iit->second.swap(buckets);
+    cachedIndexUsage += memusage::IncrementalDynamicUsage(mapAddressInserted) + memusage::DynamicUsage(iit->second);
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
@@ -471,10 +543,19 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 {
     LOCK(cs);
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
+        addressBucketMap::const_iterator bit = mapAddress.find(std::make_pair((*it).second, (*it).first));
+        if (bit == mapAddress.end())
+            continue;
+        for (addressBucket::const_iterator dit = bit->second.begin(); dit != bit->second.end(); dit++) {
+            const addressDeltaPos &pos = dit->first;
+            const CTransaction &tx = pos.entry->GetTx();
+            CMempoolAddressDeltaKey key((*it).second, (*it).first, tx.GetHash(), pos.index, pos.spending);
+            if (pos.spending) {
+                const COutPoint &prevout = tx.vin[pos.index].prevout;
+                results.push_back(std::make_pair(key, CMempoolAddressDelta(pos.entry->GetTime(), dit->second, prevout.hash, prevout.n)));
+            } else {
+                results.push_back(std::make_pair(key, CMempoolAddressDelta(pos.entry->GetTime(), dit->second)));
+            }
         }
     }
     return true;
@@ -483,14 +564,27 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 bool CTxMemPool::removeAddressIndex(const uint256 txhash)
 {
     LOCK(cs);
-    addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
-
-    if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
+    txiter it = mapTx.find(txhash);
+    if (it == mapTx.end())
+        return true;
+    addressBucketsByEntry::iterator iit = mapAddressInserted.find(it);
+
+    if (iit != mapAddressInserted.end()) {
+        const std::vector<addressBucketMap::iterator> &buckets = iit->second;
+        for (unsigned int i = 0; i < buckets.size(); i++) {
+            addressBucket &bucket = buckets[i]->second;
+            addressBucket::iterator dit = bucket.lower_bound(addressDeltaPos(it, 0, 0));
+            while (dit != bucket.end() && dit->first.entry == it) {
+                bucket.erase(dit++);
+                cachedIndexUsage -= memusage::IncrementalDynamicUsage(bucket);
+            }
+            if (bucket.empty()) {
+                mapAddress.erase(buckets[i]);
+                cachedIndexUsage -= memusage::IncrementalDynamicUsage(mapAddress);
+            }
         }
-        mapAddressInserted.erase(it);
+        cachedIndexUsage -= memusage::IncrementalDynamicUsage(mapAddressInserted) + memusage::DynamicUsage(iit->second);
+        mapAddressInserted.erase(iit);
     }
 
     return true;
@@ -501,61 +595,58 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
     LOCK(cs);
 
     const CTransaction& tx = entry.GetTx();
-    std::vector<CSpentIndexKey> inserted;
 
-    uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
         const CTxIn input = tx.vin[j];
         const CTxOut &prevout = view.GetOutputFor(input);
-        uint160 addressHash;
-        int addressType;
+        spentOutput value;
+        value.satoshis = prevout.nValue;
 
         if (prevout.scriptPubKey.IsPayToScriptHash()) {
-            addressHash = uint160(vector<unsigned char> (prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-            addressType = 2;
+            value.addressHash = uint160(vector<unsigned char> (prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
+            value.addressType = 2;
         } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-            addressHash = uint160(vector<unsigned char> (prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-            addressType = 1;
+            value.addressHash = uint160(vector<unsigned char> (prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
+            value.addressType = 1;
         } else {
-            addressHash.SetNull();
-            addressType = 0;
+            value.addressHash.SetNull();
+            value.addressType = 0;
         }
 
-        CSpentIndexKey key = CSpentIndexKey(input.prevout.hash, input.prevout.n);
-        CSpentIndexValue value = CSpentIndexValue(txhash, j, -1, prevout.nValue, addressType, addressHash);
-
-        mapSpent.insert(make_pair(key, value));
-        inserted.push_back(key);
-
+        if (mapSpent.insert(make_pair(input.prevout, value)).second)
+            cachedIndexUsage += memusage::IncrementalDynamicUsage(mapSpent);
     }
-
-    mapSpentInserted.insert(make_pair(txhash, inserted));
 }
 
 bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 {
     LOCK(cs);
-    mapSpentIndex::iterator it;
+    COutPoint outpoint(key.txid, key.outputIndex);
 
-    it = mapSpent.find(key);
-    if (it != mapSpent.end()) {
-        value = it->second;
-        return true;
-    }
-    return false;
+    mapSpentIndex::iterator it = mapSpent.find(outpoint);
+    if (it == mapSpent.end())
+        return false;
+    std::map<COutPoint, CInPoint>::iterator nit = mapNextTx.find(outpoint);
+    if (nit == mapNextTx.end())
+        return false;
+
+    value = CSpentIndexValue(nit->second.ptx->GetHash(), nit->second.n, -1, it->second.satoshis, it->second.addressType, it->second.addressHash);
+    return true;
 }
 
 bool CTxMemPool::removeSpentIndex(const uint256 txhash)
 {
     LOCK(cs);
-    mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
+    txiter it = mapTx.find(txhash);
+    if (it == mapTx.end())
+        return true;
 
-    if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapSpent.erase(*mit);
+    BOOST_FOREACH(const CTxIn& txin, it->GetTx().vin) {
+        mapSpentIndex::iterator sit = mapSpent.find(txin.prevout);
+        if (sit != mapSpent.end()) {
+            mapSpent.erase(sit);
+            cachedIndexUsage -= memusage::IncrementalDynamicUsage(mapSpent);
         }
-        mapSpentInserted.erase(it);
     }
 
     return true;
@@ -564,6 +655,9 @@ bool CTxMemPool::removeSpentIndex(const uint256 txhash)
 void CTxMemPool::removeUnchecked(txiter it)
 {
     const uint256 hash = it->GetTx().GetHash();
+    // The indexes refer to the entry and to mapNextTx, drop them first
+    removeAddressIndex(hash);
+    removeSpentIndex(hash);
     BOOST_FOREACH(const CTxIn& txin, it->GetTx().vin)
         mapNextTx.erase(txin.prevout);
 
@@ -574,8 +668,6 @@ void CTxMemPool::removeUnchecked(txiter it)
     mapTx.erase(it);
     nTransactionsUpdated++;
     minerPolicyEstimator->removeTx(hash);
-    removeAddressIndex(hash);
-    removeSpentIndex(hash);
 }
 
 // Calculates descendants of entry that are not already in setDescendants, and adds to
@@ -641,7 +733,7 @@ void CTxMemPool::remove(const CTransaction &origTx, std::list<CTransaction>& rem
         BOOST_FOREACH(txiter it, setAllRemoves) {
             removed.push_back(it->GetTx());
         }
-        RemoveStaged(setAllRemoves);
+        RemoveStaged(setAllRemoves, !fRecursive);
     }
 }
 
@@ -731,10 +823,14 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
 void CTxMemPool::_clear()
 {
     mapLinks.clear();
+    mapAddressInserted.clear();
+    mapAddress.clear();
+    mapSpent.clear();
     mapTx.clear();
     mapNextTx.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
+    cachedIndexUsage = 0;
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
@@ -795,6 +891,27 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             i++;
         }
         assert(setParentCheck == GetMemPoolParents(it));
+        // Verify ancestor state is correct.
+        setEntries setAncestors;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        CalculateMemPoolAncestors(*it, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy);
+        uint64_t nCountCheck = setAncestors.size() + 1;
+        uint64_t nSizeCheck = it->GetTxSize();
+        CAmount nFeesCheck = it->GetModifiedFee();
+        unsigned int nSigOpCheck = it->GetSigOpCount();
+
+        BOOST_FOREACH(txiter ancestorIt, setAncestors) {
+            nSizeCheck += ancestorIt->GetTxSize();
+            nFeesCheck += ancestorIt->GetModifiedFee();
+            nSigOpCheck += ancestorIt->GetSigOpCount();
+        }
+
+        assert(it->GetCountWithAncestors() == nCountCheck);
+        assert(it->GetSizeWithAncestors() == nSizeCheck);
+        assert(it->GetSigOpCountWithAncestors() == nSigOpCheck);
+        assert(it->GetModFeesWithAncestors() == nFeesCheck);
+
         // Check children against mapNextTx
         CTxMemPool::setEntries setChildrenCheck;
         std::map<COutPoint, CInPoint>::const_iterator iter = mapNextTx.lower_bound(COutPoint(it->GetTx().GetHash(), 0));
@@ -851,8 +968,21 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         assert(it->first == it->second.ptx->vin[it->second.n].prevout);
     }
 
+    uint64_t indexUsage = memusage::DynamicUsage(mapAddress) + memusage::DynamicUsage(mapAddressInserted) + memusage::DynamicUsage(mapSpent);
+    for (addressBucketMap::const_iterator it = mapAddress.begin(); it != mapAddress.end(); it++) {
+        assert(!it->second.empty());
+        indexUsage += memusage::DynamicUsage(it->second);
+    }
+    for (addressBucketsByEntry::const_iterator it = mapAddressInserted.begin(); it != mapAddressInserted.end(); it++) {
+        indexUsage += memusage::DynamicUsage(it->second);
+    }
+    for (mapSpentIndex::const_iterator it = mapSpent.begin(); it != mapSpent.end(); it++) {
+        assert(mapNextTx.count(it->first));
+    }
+
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
+    assert(indexUsage == cachedIndexUsage);
 }
 
 void CTxMemPool::queryHashes(vector<uint256>& vtxid)
@@ -948,6 +1078,13 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const string strHash,
             BOOST_FOREACH(txiter ancestorIt, setAncestors) {
                 mapTx.modify(ancestorIt, update_descendant_state(0, nFeeDelta, 0));
             }
+            // Now update all descendants' modified fees with ancestors
+            setEntries setDescendants;
+            CalculateDescendants(it, setDescendants);
+            setDescendants.erase(it);
+            BOOST_FOREACH(txiter descendantIt, setDescendants) {
+                mapTx.modify(descendantIt, update_ancestor_state(0, nFeeDelta, 0, 0));
+            }
         }
     }
     LogPrintf("PrioritiseTransaction: %s priority += %f, fee += %d\n", strHash, dPriorityDelta, FormatMoney(nFeeDelta));
@@ -996,15 +1133,46 @@ bool CCoinsViewMemPool::HaveCoins(const uint256 &txid) const {
     return mempool.exists(txid) || base->HaveCoins(txid);
 }
 
+void CCoinsViewMemPool::GetCoinsBatch(const std::vector<uint256> &vTxid, std::vector<CCoins> &vCoins, std::vector<bool> &vFound) const {
+    vCoins.assign(vTxid.size(), CCoins());
+    vFound.assign(vTxid.size(), false);
+
+    // Mempool entries win for the same reason as in GetCoins, only the rest go to the base view
+    std::vector<uint256> vBase;
+    std::vector<size_t> vBasePos;
+    for (size_t i = 0; i < vTxid.size(); i++) {
+        CTransaction tx;
+        if (mempool.lookup(vTxid[i], tx)) {
+            vCoins[i] = CCoins(tx, MEMPOOL_HEIGHT);
+            vFound[i] = true;
+        } else {
+            vBase.push_back(vTxid[i]);
+            vBasePos.push_back(i);
+        }
+    }
+    if (vBase.empty())
+        return;
+
+    std::vector<CCoins> vBaseCoins;
+    std::vector<bool> vBaseFound;
+    base->GetCoinsBatch(vBase, vBaseCoins, vBaseFound);
+    for (size_t i = 0; i < vBase.size(); i++) {
+        if (vBaseFound[i] && !vBaseCoins[i].IsPruned()) {
+            vCoins[vBasePos[i]].swap(vBaseCoins[i]);
+            vFound[vBasePos[i]] = true;
+        }
+    }
+}
+
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
-    // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + cachedInnerUsage;
+    // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + cachedInnerUsage + cachedIndexUsage;
 }
 
-void CTxMemPool::RemoveStaged(setEntries &stage) {
+void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants) {
     AssertLockHeld(cs);
-    UpdateForRemoveFromMempool(stage);
+    UpdateForRemoveFromMempool(stage, updateDescendants);
     BOOST_FOREACH(const txiter& it, stage) {
         removeUnchecked(it);
     }
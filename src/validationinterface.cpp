@@ -23,9 +23,19 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+    g_signals.UpdatedBlockTemplate.connect(boost::bind(&CValidationInterface::UpdatedBlockTemplate, pwalletIn, _1));
+    g_signals.NotifyMasternodeState.connect(boost::bind(&CValidationInterface::NotifyMasternodeState, pwalletIn, _1, _2));
+    g_signals.NotifyGovernanceObject.connect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
+    g_signals.NotifyGovernanceVote.connect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
+    g_signals.NotifyPaymentVote.connect(boost::bind(&CValidationInterface::NotifyPaymentVote, pwalletIn, _1));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    g_signals.NotifyPaymentVote.disconnect(boost::bind(&CValidationInterface::NotifyPaymentVote, pwalletIn, _1));
+    g_signals.NotifyGovernanceVote.disconnect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
+    g_signals.NotifyGovernanceObject.disconnect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
+    g_signals.NotifyMasternodeState.disconnect(boost::bind(&CValidationInterface::NotifyMasternodeState, pwalletIn, _1, _2));
+    g_signals.UpdatedBlockTemplate.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTemplate, pwalletIn, _1));
     g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
@@ -39,6 +49,11 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
 }
 
 void UnregisterAllValidationInterfaces() {
+    g_signals.NotifyPaymentVote.disconnect_all_slots();
+    g_signals.NotifyGovernanceVote.disconnect_all_slots();
+    g_signals.NotifyGovernanceObject.disconnect_all_slots();
+    g_signals.NotifyMasternodeState.disconnect_all_slots();
+    g_signals.UpdatedBlockTemplate.disconnect_all_slots();
     g_signals.BlockFound.disconnect_all_slots();
     g_signals.ScriptForMining.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
@@ -12,6 +12,10 @@
 class CBlock;
 struct CBlockLocator;
 class CBlockIndex;
+class CGovernanceObject;
+class CGovernanceVote;
+class CMasternodePaymentVote;
+class COutPoint;
 class CReserveScript;
 class CTransaction;
 class CValidationInterface;
@@ -41,6 +45,11 @@ protected:
     virtual void BlockChecked(const CBlock&, const CValidationState&) {}
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {};
     virtual void ResetRequestCount(const uint256 &hash) {};
+    virtual void UpdatedBlockTemplate(const CBlock &block) {}
+    virtual void NotifyMasternodeState(const COutPoint &outpoint, int nState) {}
+    virtual void NotifyGovernanceObject(const CGovernanceObject &govobj) {}
+    virtual void NotifyGovernanceVote(const CGovernanceVote &vote) {}
+    virtual void NotifyPaymentVote(const CMasternodePaymentVote &vote) {}
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -67,6 +76,16 @@ struct CMainSignals {
     boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
     /** Notifies listeners that a block has been successfully mined */
     boost::signals2::signal<void (const uint256 &)> BlockFound;
+    /** Notifies listeners that a precomputed block template was published (-precomputetemplate) */
+    boost::signals2::signal<void (const CBlock &)> UpdatedBlockTemplate;
+    /** Notifies listeners of a masternode joining the list or changing its state (nState -1: removed from the list) */
+    boost::signals2::signal<void (const COutPoint &, int nState)> NotifyMasternodeState;
+    /** Notifies listeners of a governance object accepted into the governance manager */
+    boost::signals2::signal<void (const CGovernanceObject &)> NotifyGovernanceObject;
+    /** Notifies listeners of an accepted governance vote */
+    boost::signals2::signal<void (const CGovernanceVote &)> NotifyGovernanceVote;
+    /** Notifies listeners of an accepted masternode payment vote */
+    boost::signals2::signal<void (const CMasternodePaymentVote &)> NotifyPaymentVote;
 };
 
 CMainSignals& GetMainSignals();
@@ -306,6 +306,28 @@ bool CCryptoKeyStore::AddKeyPubKey(const CKey& key, const CPubKey &pubkey)
 }
 
 
+bool CCryptoKeyStore::EncryptKey(const CKey& key, const CPubKey &pubkey, std::vector<unsigned char> &vchCryptedSecret) const
+{
+    // encrypt on a copy of the master key, callers run this on many threads at once
+    CKeyingMaterial vMasterKeyCopy;
+    {
+        LOCK(cs_KeyStore);
+        if (!IsCrypted() || IsLocked(true))
+            return false;
+        vMasterKeyCopy = vMasterKey;
+    }
+
+    CKeyingMaterial vchSecret(key.begin(), key.end());
+    return EncryptSecret(vMasterKeyCopy, vchSecret, pubkey.GetHash(), vchCryptedSecret);
+}
+
+void CCryptoKeyStore::EraseKey(const CKeyID &address)
+{
+    LOCK(cs_KeyStore);
+    mapKeys.erase(address);
+    mapCryptedKeys.erase(address);
+}
+
 bool CCryptoKeyStore::AddCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret)
 {
     {
@@ -139,6 +139,9 @@ protected:
 
     bool Unlock(const CKeyingMaterial& vMasterKeyIn, bool fForMixingOnly = false);
 
+    //! Forget a key whose database write failed, plain or encrypted
+    void EraseKey(const CKeyID &address);
+
 public:
     CCryptoKeyStore() : fUseCrypto(false), fDecryptionThoroughlyChecked(false), fOnlyMixingAllowed(false)
     {
@@ -182,6 +185,8 @@ public:
 
     virtual bool AddCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret);
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey);
+    //! Encrypt key with the master key as AddKeyPubKey does, without adding it to the store
+    bool EncryptKey(const CKey& key, const CPubKey &pubkey, std::vector<unsigned char> &vchCryptedSecret) const;
     bool HaveKey(const CKeyID &address) const
     {
         {
@@ -4,6 +4,10 @@
 
 #include "wallet/wallet.h"
 
+#include "consensus/validation.h"
+#include "main.h"
+#include "script/interpreter.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -23,6 +27,8 @@
 
 using namespace std;
 
+extern CWallet* pwalletMain;
+
 typedef set<pair<const CWalletTx*,unsigned int> > CoinSet;
 
 BOOST_FIXTURE_TEST_SUITE(wallet_tests, TestingSetup)
@@ -361,4 +367,190 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 101);
 }
 
+BOOST_AUTO_TEST_CASE(script_prefilter)
+{
+    CWallet keystore;
+    LOCK(keystore.cs_wallet);
+
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    CScript scriptKey = GetScriptForDestination(key.GetPubKey().GetID());
+    CScript scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+    CScript scriptRedeem = GetScriptForRawPubKey(key.GetPubKey());
+    CScript scriptP2SH = GetScriptForDestination(CScriptID(scriptRedeem));
+    CScript scriptWatch = GetScriptForDestination(CScriptID(GetScriptForRawPubKey(keyOther.GetPubKey())));
+
+    // standard outputs are rejected by an empty filter, anything else passes through
+    CScriptPrefilter prefilter = keystore.GetScriptPrefilter();
+    BOOST_CHECK(!prefilter.MaybeMine(scriptKey));
+    BOOST_CHECK(!prefilter.MaybeMine(scriptP2SH));
+    BOOST_CHECK(prefilter.MaybeMine(scriptRedeem));
+
+    // keys, redeem scripts and watch-only scripts are picked up as they are added
+    BOOST_CHECK(keystore.AddKeyPubKey(key, key.GetPubKey()));
+    BOOST_CHECK_EQUAL(keystore.IsMine(CTxOut(1, scriptKey)), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(keystore.IsMine(CTxOut(1, scriptRedeem)), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(keystore.IsMine(CTxOut(1, scriptP2SH)), ISMINE_NO);
+    BOOST_CHECK(keystore.AddCScript(scriptRedeem));
+    BOOST_CHECK_EQUAL(keystore.IsMine(CTxOut(1, scriptP2SH)), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(keystore.IsMine(CTxOut(1, scriptWatch)), ISMINE_NO);
+    BOOST_CHECK(keystore.AddWatchOnly(scriptWatch));
+    BOOST_CHECK(keystore.IsMine(CTxOut(1, scriptWatch)) & ISMINE_WATCH_ONLY);
+    BOOST_CHECK_EQUAL(keystore.IsMine(CTxOut(1, scriptOther)), ISMINE_NO);
+
+    prefilter = keystore.GetScriptPrefilter();
+    BOOST_CHECK_EQUAL(prefilter.Size(), 3U);
+    BOOST_CHECK(prefilter.MaybeMine(scriptKey));
+    BOOST_CHECK(prefilter.MaybeMine(scriptP2SH));
+    BOOST_CHECK(prefilter.MaybeMine(scriptWatch));
+    BOOST_CHECK(!prefilter.MaybeMine(scriptOther));
+}
+
+BOOST_AUTO_TEST_CASE(keypool_topup)
+{
+    unsigned int nTarget;
+    {
+        LOCK(pwalletMain->cs_wallet);
+        // more than one batch
+        nTarget = pwalletMain->GetKeyPoolSize() + KEYPOOL_TOPUP_BATCH_SIZE + 10;
+        BOOST_CHECK(pwalletMain->TopUpKeyPool(nTarget));
+        BOOST_CHECK_EQUAL(pwalletMain->GetKeyPoolSize(), nTarget + 1);
+    }
+
+    // every pool entry was written and refers to a distinct key we hold
+    set<CKeyID> setReserveKeys;
+    BOOST_CHECK_NO_THROW(pwalletMain->GetAllReserveKeys(setReserveKeys));
+    BOOST_CHECK_EQUAL(setReserveKeys.size(), nTarget + 1);
+}
+
+static void CheckCachedBalances(const CWallet* pwallet)
+{
+    CWalletBalances cached = pwallet->GetBalances();
+    CWalletBalances fresh;
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
+        fresh = pwallet->ComputeBalances();
+    }
+    BOOST_CHECK_EQUAL(cached.nBalance, fresh.nBalance);
+    BOOST_CHECK_EQUAL(cached.nUnconfirmed, fresh.nUnconfirmed);
+    BOOST_CHECK_EQUAL(cached.nImmature, fresh.nImmature);
+    BOOST_CHECK_EQUAL(cached.nWatchOnly, fresh.nWatchOnly);
+    BOOST_CHECK_EQUAL(cached.nUnconfirmedWatchOnly, fresh.nUnconfirmedWatchOnly);
+    BOOST_CHECK_EQUAL(cached.nImmatureWatchOnly, fresh.nImmatureWatchOnly);
+    BOOST_CHECK_EQUAL(cached.nAnonymized, fresh.nAnonymized);
+    BOOST_CHECK_EQUAL(cached.nNormalizedAnonymized, fresh.nNormalizedAnonymized);
+    BOOST_CHECK_EQUAL(cached.nDenominatedConfirmed, fresh.nDenominatedConfirmed);
+    BOOST_CHECK_EQUAL(cached.nDenominatedUnconfirmed, fresh.nDenominatedUnconfirmed);
+    BOOST_CHECK_EQUAL(cached.nTotalRounds, fresh.nTotalRounds);
+    BOOST_CHECK_EQUAL(cached.nCountRounds, fresh.nCountRounds);
+}
+
+BOOST_FIXTURE_TEST_CASE(cached_balances, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    // at 100 blocks every coinbase is immature, one more block matures the first
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptPubKey);
+    {
+        LOCK(pwalletMain->cs_wallet);
+        BOOST_CHECK(pwalletMain->AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey()));
+    }
+    pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+    CheckCachedBalances(pwalletMain);
+    CAmount nBalance = pwalletMain->GetBalance();
+    BOOST_CHECK(nBalance > 0);
+    BOOST_CHECK(pwalletMain->GetImmatureBalance() > 0);
+
+    // a spend back to ourselves only updates the spent and the new transaction
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(2);
+    spend.vout[0].nValue = coinbaseTxns[0].vout[0].nValue / 2;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    spend.vout[1].nValue = coinbaseTxns[0].vout[0].nValue / 2 - 10000;
+    spend.vout[1].scriptPubKey = scriptPubKey;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, spend, false, NULL));
+    }
+    CheckCachedBalances(pwalletMain);
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalance(), nBalance - 10000);
+
+    // locking a coin
+    COutPoint outpoint(spend.GetHash(), 1);
+    {
+        LOCK(pwalletMain->cs_wallet);
+        pwalletMain->LockCoin(outpoint);
+    }
+    CheckCachedBalances(pwalletMain);
+    {
+        LOCK(pwalletMain->cs_wallet);
+        pwalletMain->UnlockCoin(outpoint);
+    }
+    CheckCachedBalances(pwalletMain);
+
+    // and a new tip, which mines the spend and matures another coinbase
+    std::vector<CMutableTransaction> txns(1, spend);
+    CreateAndProcessBlock(txns, scriptPubKey);
+    CheckCachedBalances(pwalletMain);
+    BOOST_CHECK(pwalletMain->GetBalance() > nBalance);
+    mempool.clear();
+}
+
+/** Outputs of a wallet transaction that AvailableCoins returns */
+static unsigned int CountAvailableOutputs(const uint256& hash)
+{
+    std::vector<COutput> vCoins;
+    pwalletMain->AvailableCoins(vCoins);
+    unsigned int nCount = 0;
+    BOOST_FOREACH(const COutput& out, vCoins)
+        if (out.tx->GetHash() == hash)
+            nCount++;
+    return nCount;
+}
+
+BOOST_FIXTURE_TEST_CASE(import_without_rescan, TestChain100Setup)
+{
+    // a transaction paying a wallet key and the coinbase key, which the wallet doesn't have yet
+    CKey key;
+    key.MakeNewKey(true);
+    {
+        LOCK(pwalletMain->cs_wallet);
+        BOOST_CHECK(pwalletMain->AddKeyPubKey(key, key.GetPubKey()));
+    }
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(2);
+    spend.vout[0].nValue = coinbaseTxns[0].vout[0].nValue / 2;
+    spend.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    spend.vout[1].nValue = coinbaseTxns[0].vout[0].nValue / 2 - 10000;
+    spend.vout[1].scriptPubKey = scriptPubKey;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), scriptPubKey);
+    BOOST_CHECK_EQUAL(CountAvailableOutputs(spend.GetHash()), 1U);
+    CAmount nBalance = pwalletMain->GetBalance();
+
+    // what importprivkey does without a rescan
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        pwalletMain->MarkDirty();
+        BOOST_CHECK(pwalletMain->AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey()));
+    }
+    BOOST_CHECK_EQUAL(CountAvailableOutputs(spend.GetHash()), 2U);
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalance(), nBalance + spend.vout[1].nValue);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
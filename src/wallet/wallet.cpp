@@ -35,7 +35,9 @@
 #include <assert.h>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 
@@ -131,6 +133,7 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     AssertLockHeld(cs_wallet); // mapKeyMetadata
     if (!CCryptoKeyStore::AddKeyPubKey(secret, pubkey))
         return false;
+    MarkScriptPrefilterDirty();
 
     // check if we need to remove from watch-only
     CScript script;
@@ -141,6 +144,9 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     if (HaveWatchOnly(script))
         RemoveWatchOnly(script);
 
+    // outputs of transactions already in the wallet may be ours now
+    RebuildWalletUTXO();
+
     if (!fFileBacked)
         return true;
     if (!IsCrypted()) {
@@ -156,6 +162,7 @@ bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
 {
     if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
         return false;
+    MarkScriptPrefilterDirty();
     if (!fFileBacked)
         return true;
     {
@@ -184,13 +191,26 @@ bool CWallet::LoadKeyMetadata(const CPubKey &pubkey, const CKeyMetadata &meta)
 
 bool CWallet::LoadCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret)
 {
-    return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
+    if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
+        return false;
+    MarkScriptPrefilterDirty();
+    return true;
+}
+
+bool CWallet::LoadKey(const CKey& key, const CPubKey &pubkey)
+{
+    if (!CCryptoKeyStore::AddKeyPubKey(key, pubkey))
+        return false;
+    MarkScriptPrefilterDirty();
+    return true;
 }
 
 bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    MarkScriptPrefilterDirty();
+    RebuildWalletUTXO();
     if (!fFileBacked)
         return true;
     return CWalletDB(strWalletFile).WriteCScript(Hash160(redeemScript), redeemScript);
@@ -209,13 +229,18 @@ bool CWallet::LoadCScript(const CScript& redeemScript)
         return true;
     }
 
-    return CCryptoKeyStore::AddCScript(redeemScript);
+    if (!CCryptoKeyStore::AddCScript(redeemScript))
+        return false;
+    MarkScriptPrefilterDirty();
+    return true;
 }
 
 bool CWallet::AddWatchOnly(const CScript &dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    MarkScriptPrefilterDirty();
+    RebuildWalletUTXO();
     nTimeFirstKey = 1; // No birthday information for watch-only keys.
     NotifyWatchonlyChanged(true);
     if (!fFileBacked)
@@ -228,6 +253,7 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
     AssertLockHeld(cs_wallet);
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
         return false;
+    MarkScriptPrefilterDirty();
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
     if (fFileBacked)
@@ -239,7 +265,49 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
 
 bool CWallet::LoadWatchOnly(const CScript &dest)
 {
-    return CCryptoKeyStore::AddWatchOnly(dest);
+    if (!CCryptoKeyStore::AddWatchOnly(dest))
+        return false;
+    MarkScriptPrefilterDirty();
+    return true;
+}
+
+void CWallet::MarkScriptPrefilterDirty()
+{
+    LOCK(cs_KeyStore);
+    fScriptPrefilterDirty = true;
+    nScriptPrefilterVersion++;
+}
+
+void CWallet::UpdateScriptPrefilter() const
+{
+    AssertLockHeld(cs_KeyStore);
+    if (!fScriptPrefilterDirty)
+        return;
+
+    scriptPrefilter.Clear();
+    std::set<CKeyID> setKeys;
+    GetKeys(setKeys);
+    BOOST_FOREACH(const CKeyID& keyid, setKeys)
+        scriptPrefilter.AddKeyID(keyid);
+    for (ScriptMap::const_iterator it = mapScripts.begin(); it != mapScripts.end(); ++it)
+        scriptPrefilter.AddScriptID(it->first);
+    BOOST_FOREACH(const CScript& script, setWatchOnly)
+        scriptPrefilter.AddWatchOnly(script);
+    scriptPrefilter.Finalize();
+    fScriptPrefilterDirty = false;
+}
+
+CScriptPrefilter CWallet::GetScriptPrefilter() const
+{
+    LOCK(cs_KeyStore);
+    UpdateScriptPrefilter();
+    return scriptPrefilter;
+}
+
+unsigned int CWallet::GetScriptPrefilterVersion() const
+{
+    LOCK(cs_KeyStore);
+    return nScriptPrefilterVersion;
 }
 
 bool CWallet::Unlock(const SecureString& strWalletPassphrase, bool fForMixingOnly)
@@ -361,6 +429,8 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
 
 void CWallet::SetBestChain(const CBlockLocator& loc)
 {
+    // the locator must never get ahead of the transactions found up to it
+    FlushPendingWrites();
     CWalletDB walletdb(strWalletFile);
     walletdb.WriteBestBlock(loc);
 }
@@ -429,9 +499,50 @@ set<uint256> CWallet::GetConflicts(const uint256& txid) const
 
 void CWallet::Flush(bool shutdown)
 {
+    FlushPendingWrites();
     bitdb.Flush(shutdown);
 }
 
+bool CWallet::FlushPendingWrites() const
+{
+    LOCK(cs_wallet);
+    nLastPendingWritesFlush = GetTimeMillis();
+    if (setPendingWalletTxWrites.empty() && !fPendingOrderPosNext)
+        return true;
+    if (!fFileBacked) {
+        setPendingWalletTxWrites.clear();
+        fPendingOrderPosNext = false;
+        return true;
+    }
+
+    CWalletDB walletdb(strWalletFile, "r+", false);
+    if (!walletdb.TxnBegin())
+        return error("%s: failed to begin database transaction", __func__);
+    bool fOk = true;
+    BOOST_FOREACH(const uint256& hash, setPendingWalletTxWrites) {
+        // erased in the meantime
+        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+        if (it != mapWallet.end() && !walletdb.WriteTx(hash, it->second)) {
+            fOk = false;
+            break;
+        }
+    }
+    if (fOk && fPendingOrderPosNext)
+        fOk = walletdb.WriteOrderPosNext(nOrderPosNext);
+    if (!fOk) {
+        // keep everything queued, the next flush retries
+        walletdb.TxnAbort();
+        return error("%s: failed to write %u wallet transactions", __func__, setPendingWalletTxWrites.size());
+    }
+    if (!walletdb.TxnCommit())
+        return error("%s: failed to commit %u wallet transactions", __func__, setPendingWalletTxWrites.size());
+
+    LogPrint("db", "%s: wrote %u wallet transactions\n", __func__, setPendingWalletTxWrites.size());
+    setPendingWalletTxWrites.clear();
+    fPendingOrderPosNext = false;
+    return true;
+}
+
 bool CWallet::Verify(const string& walletFile, string& warningString, string& errorString)
 {
     if (!bitdb.Open(GetDataDir()))
@@ -560,6 +671,62 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+/**
+ * Unlike IsSpent this doesn't depend on the chain: abandoned and
+ * conflicted transactions don't count as spending the outpoint.
+ */
+bool CWallet::IsSpentByActiveTx(const COutPoint& outpoint) const
+{
+    pair<TxSpends::const_iterator, TxSpends::const_iterator> range;
+    range = mapTxSpends.equal_range(outpoint);
+
+    for (TxSpends::const_iterator it = range.first; it != range.second; ++it)
+    {
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+        if (mit == mapWallet.end())
+            continue;
+        const CWalletTx& wtx = mit->second;
+        bool fConflicted = wtx.nIndex == -1 && !wtx.hashUnset();
+        if (!wtx.isAbandoned() && !fConflicted)
+            return true;
+    }
+    return false;
+}
+
+void CWallet::UpdateWalletUTXO(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_wallet);
+
+    std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(outpoint.hash);
+    if (mit != mapWallet.end() && outpoint.n < mit->second.vout.size() &&
+            IsMine(mit->second.vout[outpoint.n]) != ISMINE_NO && !IsSpentByActiveTx(outpoint))
+        setWalletUTXO.insert(outpoint);
+    else
+        setWalletUTXO.erase(outpoint);
+}
+
+void CWallet::UpdateWalletUTXO(const CWalletTx& wtx)
+{
+    // outputs it spends and its own outputs
+    if (!wtx.IsCoinBase()) {
+        BOOST_FOREACH(const CTxIn& txin, wtx.vin)
+            UpdateWalletUTXO(txin.prevout);
+    }
+    uint256 hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.vout.size(); i++)
+        UpdateWalletUTXO(COutPoint(hash, i));
+}
+
+void CWallet::RebuildWalletUTXO()
+{
+    LOCK(cs_wallet);
+    setWalletUTXO.clear();
+    BOOST_FOREACH(const PAIRTYPE(const uint256, CWalletTx)& item, mapWallet) {
+        for (unsigned int i = 0; i < item.second.vout.size(); i++)
+            UpdateWalletUTXO(COutPoint(item.first, i));
+    }
+}
+
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
     if (IsCrypted())
@@ -683,8 +850,12 @@ void CWallet::MarkDirty()
             item.second.MarkDirty();
     }
 
+    RebuildWalletUTXO();
+    ClearPrivateSendRoundsCache();
+
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb)
@@ -718,7 +889,12 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         if (fInsertedNew)
         {
             wtx.nTimeReceived = GetAdjustedTime();
-            wtx.nOrderPos = IncOrderPosNext(pwalletdb);
+            if (pwalletdb) {
+                wtx.nOrderPos = IncOrderPosNext(pwalletdb);
+            } else {
+                wtx.nOrderPos = nOrderPosNext++;
+                fPendingOrderPosNext = true;
+            }
             wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
 
             wtx.nTimeSmart = wtx.nTimeReceived;
@@ -766,6 +942,13 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                              wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
+
+            // rounds of already known descendants were calculated without this transaction
+            TxSpends::const_iterator itSpends = mapTxSpends.lower_bound(COutPoint(hash, 0));
+            if (itSpends != mapTxSpends.end() && itSpends->first.hash == hash) {
+                mapOutpointRoundsCache.clear();
+                fBalancesCached = false;
+            }
         }
 
         bool fUpdated = false;
@@ -798,14 +981,21 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         //// debug print
         LogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
-        // Write to disk
-        if (fInsertedNew || fUpdated)
-            if (!wtx.WriteToDisk(pwalletdb))
-                return false;
+        // Write to disk, or queue the write if no database was given
+        if (fInsertedNew || fUpdated) {
+            if (pwalletdb) {
+                if (!wtx.WriteToDisk(pwalletdb))
+                    return false;
+            } else {
+                setPendingWalletTxWrites.insert(hash);
+            }
+        }
 
         // Break debit/credit balance caches:
         wtx.MarkDirty();
 
+        UpdateWalletUTXO(wtx);
+
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
 
@@ -820,6 +1010,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
 
         fAnonymizableTallyCached = false;
         fAnonymizableTallyCachedNonDenom = false;
+        MarkBalancesDirty(wtx);
 
     }
     return true;
@@ -830,7 +1021,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
  * pblock is optional, but should be provided if the transaction is known to be in a block.
  * If fUpdate is true, existing transactions will be updated.
  */
-bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate)
+bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate, bool fCheckIsMine)
 {
     {
         AssertLockHeld(cs_wallet);
@@ -850,7 +1041,7 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pbl
 
         bool fExisted = mapWallet.count(tx.GetHash()) != 0;
         if (fExisted && !fUpdate) return false;
-        if (fExisted || IsMine(tx) || IsFromMe(tx))
+        if (fExisted || (fCheckIsMine && IsMine(tx)) || IsFromMe(tx))
         {
             CWalletTx wtx(this,tx);
 
@@ -858,11 +1049,14 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pbl
             if (pblock)
                 wtx.SetMerkleBranch(*pblock);
 
-            // Do not flush the wallet here for performance reasons
-            // this is safe, as in case of a crash, we rescan the necessary blocks on startup through our SetBestChain-mechanism
-            CWalletDB walletdb(strWalletFile, "r+", false);
-
-            return AddToWallet(wtx, false, &walletdb);
+            // Do not write the wallet here for performance reasons, the record is batched
+            // with others by FlushPendingWrites. This is safe, as pending writes are flushed
+            // before SetBestChain, so in case of a crash we rescan the necessary blocks on startup.
+            bool fRet = AddToWallet(wtx, false, NULL);
+            if (setPendingWalletTxWrites.size() >= MAX_WALLET_PENDING_WRITES ||
+                GetTimeMillis() - nLastPendingWritesFlush >= WALLET_WRITE_BEHIND_INTERVAL)
+                FlushPendingWrites();
+            return fRet;
         }
     }
     return false;
@@ -920,11 +1114,13 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
             }
+            UpdateWalletUTXO(wtx);
         }
     }
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 
     return true;
 }
@@ -984,11 +1180,13 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
             }
+            UpdateWalletUTXO(wtx);
         }
     }
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
@@ -1009,6 +1207,7 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty(tx);
 }
 
 
@@ -1046,27 +1245,22 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
 int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
-
     if(nRounds >= 16) return 15; // 16 rounds max
 
     uint256 hash = txin.prevout.hash;
     unsigned int nout = txin.prevout.n;
 
+    LOCK(cs_wallet);
+
     const CWalletTx* wtx = GetWalletTx(hash);
     if(wtx != NULL)
     {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        if (mdwi == mDenomWtxes.end()) {
-            // not known yet, let's add it
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx);
-        } else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            // found and it's not an initial value, just return it
-            return mDenomWtxes[hash].vout[nout].nRounds;
+        std::map<COutPoint, int>::const_iterator itRounds = mapOutpointRoundsCache.find(txin.prevout);
+        if(itRounds != mapOutpointRoundsCache.end()) {
+            // already calculated, just return it
+            return itRounds->second;
         }
 
-
         // bounds check
         if (nout >= wtx->vout.size()) {
             // should never actually hit this
@@ -1074,49 +1268,44 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
             return -4;
         }
 
+        int nRoundsRet;
         if (IsCollateralAmount(wtx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
-        //make sure the final output is non-denominate
-        if (!IsDenominatedAmount(wtx->vout[nout].nValue)) { //NOT DENOM
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
-        bool fAllDenoms = true;
-        BOOST_FOREACH(CTxOut out, wtx->vout) {
-            fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
-        }
-
-        // this one is denominated but there is another non-denominated output found in the same tx
-        if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+            nRoundsRet = -3;
+        } else if (!IsDenominatedAmount(wtx->vout[nout].nValue)) {
+            //make sure the final output is non-denominate
+            nRoundsRet = -2;
+        } else {
+            bool fAllDenoms = true;
+            BOOST_FOREACH(const CTxOut& out, wtx->vout) {
+                fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
+            }
 
-        int nShortest = -10; // an initial value, should be no way to get this by calculations
-        bool fDenomFound = false;
-        // only denoms here so let's look up
-        BOOST_FOREACH(CTxIn txinNext, wtx->vin) {
-            if (IsMine(txinNext)) {
-                int n = GetRealInputPrivateSendRounds(txinNext, nRounds + 1);
-                // denom found, find the shortest chain or initially assign nShortest with the first found value
-                if(n >= 0 && (n < nShortest || nShortest == -10)) {
-                    nShortest = n;
-                    fDenomFound = true;
+            if (!fAllDenoms) {
+                // this one is denominated but there is another non-denominated output found in the same tx
+                nRoundsRet = 0;
+            } else {
+                int nShortest = -10; // an initial value, should be no way to get this by calculations
+                bool fDenomFound = false;
+                // only denoms here so let's look up
+                BOOST_FOREACH(const CTxIn& txinNext, wtx->vin) {
+                    if (IsMine(txinNext)) {
+                        int n = GetRealInputPrivateSendRounds(txinNext, nRounds + 1);
+                        // denom found, find the shortest chain or initially assign nShortest with the first found value
+                        if(n >= 0 && (n < nShortest || nShortest == -10)) {
+                            nShortest = n;
+                            fDenomFound = true;
+                        }
+                    }
                 }
+                nRoundsRet = fDenomFound
+                        ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
+                        : 0;            // too bad, we are the fist one in that chain
             }
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
-                ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
-                : 0;            // too bad, we are the fist one in that chain
-        LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
+
+        mapOutpointRoundsCache[txin.prevout] = nRoundsRet;
+        LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, nRoundsRet);
+        return nRoundsRet;
     }
 
     return nRounds - 1;
@@ -1130,6 +1319,12 @@ int CWallet::GetInputPrivateSendRounds(CTxIn txin) const
     return realPrivateSendRounds > nPrivateSendRounds ? nPrivateSendRounds : realPrivateSendRounds;
 }
 
+void CWallet::ClearPrivateSendRoundsCache()
+{
+    LOCK(cs_wallet);
+    mapOutpointRoundsCache.clear();
+}
+
 bool CWallet::IsDenominated(const CTxIn &txin) const
 {
     LOCK(cs_wallet);
@@ -1155,6 +1350,12 @@ bool CWallet::IsDenominatedAmount(CAmount nInputAmount) const
 
 isminetype CWallet::IsMine(const CTxOut& txout) const
 {
+    {
+        LOCK(cs_KeyStore);
+        UpdateScriptPrefilter();
+        if (!scriptPrefilter.MaybeMine(txout.scriptPubKey))
+            return ISMINE_NO;
+    }
     return ::IsMine(*this, txout.scriptPubKey);
 }
 
@@ -1385,10 +1586,95 @@ bool CWalletTx::WriteToDisk(CWalletDB *pwalletdb)
     return pwalletdb->WriteTx(GetHash(), *this);
 }
 
+namespace {
+
+/** A run of consecutive blocks that is read and matched without holding any locks */
+struct CRescanChunk
+{
+    std::vector<CBlockIndex*> vIndex;
+    std::vector<CDiskBlockPos> vPos;
+    std::vector<CBlock> vBlocks;
+    std::vector<char> vRead;
+    //! Per block and transaction: whether any of its outputs is ours
+    std::vector<std::vector<char> > vIsMine;
+    //! What vIsMine was matched against, taken when the chunk was collected
+    CScriptPrefilter prefilter;
+    unsigned int nPrefilterVersion;
+};
+
+/** Queue up to WALLET_RESCAN_CHUNK_SIZE blocks of the active chain starting at pindex */
+void CollectRescanChunk(CRescanChunk& chunk, CBlockIndex* pindex, const CWallet& wallet)
+{
+    AssertLockHeld(cs_main);
+    chunk.vIndex.clear();
+    chunk.vPos.clear();
+    while (pindex && chunk.vIndex.size() < (unsigned int)WALLET_RESCAN_CHUNK_SIZE) {
+        chunk.vIndex.push_back(pindex);
+        chunk.vPos.push_back(pindex->GetBlockPos());
+        pindex = chainActive.Next(pindex);
+    }
+    chunk.vBlocks.assign(chunk.vIndex.size(), CBlock());
+    chunk.vRead.assign(chunk.vIndex.size(), 0);
+    chunk.vIsMine.assign(chunk.vIndex.size(), std::vector<char>());
+    // version first: a key added in between leaves the version behind the
+    // snapshot, which only costs a recheck at commit
+    chunk.nPrefilterVersion = wallet.GetScriptPrefilterVersion();
+    chunk.prefilter = wallet.GetScriptPrefilter();
+}
+
+/** The block following pindexLast, resuming from the fork point if pindexLast was disconnected */
+CBlockIndex* NextRescanBlock(const CBlockIndex* pindexLast)
+{
+    AssertLockHeld(cs_main);
+    if (!chainActive.Contains(pindexLast))
+        pindexLast = chainActive.FindFork(pindexLast);
+    return pindexLast ? chainActive.Next(pindexLast) : NULL;
+}
+
+/** Worker nWorker of nWorkers: read, hash-check and match every nWorkers-th block of the chunk */
+void ReadRescanChunk(CRescanChunk* pchunk, const CKeyStore* pkeystore, unsigned int nWorker, unsigned int nWorkers)
+{
+    RenameThread("3dcoin-rescan");
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    for (unsigned int i = nWorker; i < pchunk->vIndex.size(); i += nWorkers) {
+        CBlock& block = pchunk->vBlocks[i];
+        if (!ReadBlockFromDisk(block, pchunk->vPos[i], consensusParams) || block.GetHash() != pchunk->vIndex[i]->GetBlockHash()) {
+            // left for the committing thread to retry under cs_main
+            block.SetNull();
+            continue;
+        }
+        std::vector<char>& vIsMine = pchunk->vIsMine[i];
+        vIsMine.assign(block.vtx.size(), 0);
+        for (unsigned int j = 0; j < block.vtx.size(); j++) {
+            BOOST_FOREACH(const CTxOut& txout, block.vtx[j].vout) {
+                if (pchunk->prefilter.MaybeMine(txout.scriptPubKey) && ::IsMine(*pkeystore, txout.scriptPubKey) != ISMINE_NO) {
+                    vIsMine[j] = 1;
+                    break;
+                }
+            }
+        }
+        pchunk->vRead[i] = 1;
+    }
+}
+
+void StartRescanReaders(boost::thread_group& readers, CRescanChunk& chunk, const CKeyStore& keystore, unsigned int nThreads)
+{
+    unsigned int nWorkers = std::min(nThreads, (unsigned int)chunk.vIndex.size());
+    for (unsigned int i = 0; i < nWorkers; i++)
+        readers.create_thread(boost::bind(&ReadRescanChunk, &chunk, &keystore, i, nWorkers));
+}
+
+} // anon namespace
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * The scan is pipelined in chunks of WALLET_RESCAN_CHUNK_SIZE blocks:
+ * while one chunk is committed to the wallet in block order under
+ * cs_main and cs_wallet, reader threads load and match the next one.
+ * Both locks are released between chunks so the node keeps validating.
  */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
@@ -1397,6 +1683,8 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
     const CChainParams& chainParams = Params();
 
     CBlockIndex* pindex = pindexStart;
+    CRescanChunk chunks[2];
+    double dProgressStart, dProgressTip;
     {
         LOCK2(cs_main, cs_wallet);
 
@@ -1406,28 +1694,69 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
             pindex = chainActive.Next(pindex);
 
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
-        while (pindex)
+        dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
+        CollectRescanChunk(chunks[0], pindex, *this);
+    }
+
+    unsigned int nThreads = std::max(1, std::min(GetNumCores(), MAX_WALLET_RESCAN_THREADS));
+    // join_all() keeps finished threads in their group, so every chunk gets a fresh one
+    boost::scoped_ptr<boost::thread_group> readers(new boost::thread_group());
+    try {
+        StartRescanReaders(*readers, chunks[0], *this, nThreads);
+        for (int nCurrent = 0; !chunks[nCurrent].vIndex.empty(); nCurrent = 1 - nCurrent)
         {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+            readers->join_all();
+            CRescanChunk& chunk = chunks[nCurrent];
+            CRescanChunk& chunkNext = chunks[1 - nCurrent];
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex, Params().GetConsensus());
-            BOOST_FOREACH(CTransaction& tx, block.vtx)
+            // start reading the following blocks before committing this chunk
             {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
+                LOCK(cs_main);
+                CollectRescanChunk(chunkNext, NextRescanBlock(chunk.vIndex.back()), *this);
             }
-            pindex = chainActive.Next(pindex);
+            readers.reset(new boost::thread_group());
+            StartRescanReaders(*readers, chunkNext, *this, nThreads);
+
+            LOCK2(cs_main, cs_wallet);
+            // keys added since the chunk was collected are missing from its
+            // prefilter, let IsMine() see every transaction again then
+            bool fPrefilterCurrent = chunk.nPrefilterVersion == GetScriptPrefilterVersion();
+            for (unsigned int i = 0; i < chunk.vIndex.size(); i++)
+            {
+                pindex = chunk.vIndex[i];
+                // disconnected while we were reading it, the next chunk resumes from the fork
+                if (!chainActive.Contains(pindex))
+                    continue;
+
+                if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+
+                CBlock& block = chunk.vBlocks[i];
+                bool fMatched = chunk.vRead[i] && fPrefilterCurrent;
+                if (!chunk.vRead[i] && !ReadBlockFromDisk(block, pindex, chainParams.GetConsensus())) {
+                    LogPrintf("%s: failed to read block %s at height %d, skipping it\n", __func__, pindex->GetBlockHash().ToString(), pindex->nHeight);
+                    continue;
+                }
+                for (unsigned int j = 0; j < block.vtx.size(); j++)
+                {
+                    if (AddToWalletIfInvolvingMe(block.vtx[j], &block, fUpdate, !fMatched || chunk.vIsMine[i][j]))
+                        ret++;
+                }
+            }
+            FlushPendingWrites();
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
             }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+    } catch (...) {
+        // the readers reference chunks on this stack frame
+        readers->join_all();
+        throw;
     }
+    readers->join_all();
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     return ret;
 }
 
@@ -1840,20 +2169,170 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime)
  */
 
 
-CAmount CWallet::GetBalance() const
+CWalletBalances& CWalletBalances::operator+=(const CWalletBalances& b)
+{
+    nBalance += b.nBalance;
+    nUnconfirmed += b.nUnconfirmed;
+    nImmature += b.nImmature;
+    nWatchOnly += b.nWatchOnly;
+    nUnconfirmedWatchOnly += b.nUnconfirmedWatchOnly;
+    nImmatureWatchOnly += b.nImmatureWatchOnly;
+    nAnonymized += b.nAnonymized;
+    nNormalizedAnonymized += b.nNormalizedAnonymized;
+    nDenominatedConfirmed += b.nDenominatedConfirmed;
+    nDenominatedUnconfirmed += b.nDenominatedUnconfirmed;
+    nTotalRounds += b.nTotalRounds;
+    nCountRounds += b.nCountRounds;
+    dAverageAnonymizedRounds = nCountRounds > 0 ? (double)nTotalRounds / nCountRounds : 0;
+    return *this;
+}
+
+CWalletBalances& CWalletBalances::operator-=(const CWalletBalances& b)
+{
+    nBalance -= b.nBalance;
+    nUnconfirmed -= b.nUnconfirmed;
+    nImmature -= b.nImmature;
+    nWatchOnly -= b.nWatchOnly;
+    nUnconfirmedWatchOnly -= b.nUnconfirmedWatchOnly;
+    nImmatureWatchOnly -= b.nImmatureWatchOnly;
+    nAnonymized -= b.nAnonymized;
+    nNormalizedAnonymized -= b.nNormalizedAnonymized;
+    nDenominatedConfirmed -= b.nDenominatedConfirmed;
+    nDenominatedUnconfirmed -= b.nDenominatedUnconfirmed;
+    nTotalRounds -= b.nTotalRounds;
+    nCountRounds -= b.nCountRounds;
+    dAverageAnonymizedRounds = nCountRounds > 0 ? (double)nTotalRounds / nCountRounds : 0;
+    return *this;
+}
+
+bool CWallet::ComputeTxBalances(const uint256& hash, CWalletBalances& balances) const
 {
-    CAmount nTotal = 0;
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    balances = CWalletBalances();
+
+    // Only transactions with unspent outputs of ours can have any credit,
+    // setWalletUTXO is ordered by tx hash so they are adjacent.
+    std::set<COutPoint>::const_iterator itTxBegin = setWalletUTXO.lower_bound(COutPoint(hash, 0));
+    if (itTxBegin == setWalletUTXO.end() || itTxBegin->hash != hash)
+        return false;
+
+    map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+    if (it == mapWallet.end())
+        return false;
+    const CWalletTx* pcoin = &(*it).second;
+
+    bool fTrusted = pcoin->IsTrusted();
+    int nDepth = pcoin->GetDepthInMainChain();
+    if (fTrusted) {
+        balances.nBalance += pcoin->GetAvailableCredit();
+        balances.nWatchOnly += pcoin->GetAvailableWatchOnlyCredit();
+    } else if (nDepth == 0 && pcoin->InMempool()) {
+        balances.nUnconfirmed += pcoin->GetAvailableCredit();
+        balances.nUnconfirmedWatchOnly += pcoin->GetAvailableWatchOnlyCredit();
+    }
+    balances.nImmature += pcoin->GetImmatureCredit();
+    balances.nImmatureWatchOnly += pcoin->GetImmatureWatchOnlyCredit();
+
+    if (fLiteMode)
+        return true;
+
+    if (fTrusted)
+        balances.nAnonymized += pcoin->GetAnonymizedCredit();
+    balances.nDenominatedConfirmed += pcoin->GetDenominatedCredit(false);
+    balances.nDenominatedUnconfirmed += pcoin->GetDenominatedCredit(true);
+
+    // Note: rounds are calculated including unconfirmed,
+    // that's ok as long as we use them for informational purposes only.
+    // GetInputPrivateSendRounds answers from mapOutpointRoundsCache, which
+    // outlives the cached balances, so only outpoints we haven't seen yet
+    // walk their PrivateSend chain here.
+    for (std::set<COutPoint>::const_iterator itOut = itTxBegin; itOut != setWalletUTXO.end() && itOut->hash == hash; ++itOut) {
+        const CTxOut& txout = pcoin->vout[itOut->n];
+        if (!IsDenominatedAmount(txout.nValue) || IsSpent(hash, itOut->n) || IsMine(txout) != ISMINE_SPENDABLE) continue;
+
+        int nRounds = GetInputPrivateSendRounds(CTxIn(*itOut));
+        balances.nTotalRounds += nRounds;
+        balances.nCountRounds++;
+        if (nDepth >= 0)
+            balances.nNormalizedAnonymized += txout.nValue * nRounds / nPrivateSendRounds;
+    }
+
+    return true;
+}
+
+CWalletBalances CWallet::ComputeBalances() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    CWalletBalances balances;
+    mapTxBalances.clear();
+    setBalancesDirtyTxs.clear();
+
+    std::set<COutPoint>::const_iterator itUTXO = setWalletUTXO.begin();
+    while (itUTXO != setWalletUTXO.end())
     {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+        const uint256 hash = itUTXO->hash;
+        while (itUTXO != setWalletUTXO.end() && itUTXO->hash == hash)
+            ++itUTXO;
+
+        CWalletBalances txBalances;
+        if (ComputeTxBalances(hash, txBalances)) {
+            balances += txBalances;
+            mapTxBalances[hash] = txBalances;
         }
     }
 
-    return nTotal;
+    return balances;
+}
+
+void CWallet::MarkBalancesDirty(const CTransaction& tx)
+{
+    AssertLockHeld(cs_wallet);
+
+    // A transaction changes its own credit and, by spending them, the
+    // credit of the wallet transactions it has inputs from.
+    setBalancesDirtyTxs.insert(tx.GetHash());
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+        setBalancesDirtyTxs.insert(txin.prevout.hash);
+}
+
+CWalletBalances CWallet::GetBalances() const
+{
+    {
+        LOCK(cs_wallet);
+        if (fBalancesCached && setBalancesDirtyTxs.empty())
+            return cachedBalances;
+    }
+
+    LOCK2(cs_main, cs_wallet);
+    if (!fBalancesCached) {
+        cachedBalances = ComputeBalances();
+        fBalancesCached = true;
+        return cachedBalances;
+    }
+
+    BOOST_FOREACH(const uint256& hash, setBalancesDirtyTxs) {
+        std::map<uint256, CWalletBalances>::iterator it = mapTxBalances.find(hash);
+        if (it != mapTxBalances.end()) {
+            cachedBalances -= it->second;
+            mapTxBalances.erase(it);
+        }
+        CWalletBalances txBalances;
+        if (ComputeTxBalances(hash, txBalances)) {
+            cachedBalances += txBalances;
+            mapTxBalances[hash] = txBalances;
+        }
+    }
+    setBalancesDirtyTxs.clear();
+    return cachedBalances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nBalance;
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated) const
@@ -1880,19 +2359,7 @@ CAmount CWallet::GetAnonymizedBalance() const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAnonymizedCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nAnonymized;
 }
 
 // Note: calculated including unconfirmed,
@@ -1901,33 +2368,7 @@ double CWallet::GetAverageAnonymizedRounds() const
 {
     if(fLiteMode) return 0;
 
-    double fTotal = 0;
-    double fCount = 0;
-
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-
-            uint256 hash = (*it).first;
-
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-
-                CTxIn vin = CTxIn(hash, i);
-
-                if(IsSpent(hash, i) || IsMine(pcoin->vout[i]) != ISMINE_SPENDABLE || !IsDenominated(vin)) continue;
-
-                int rounds = GetInputPrivateSendRounds(vin);
-                fTotal += (float)rounds;
-                fCount += 1;
-            }
-        }
-    }
-
-    if(fCount == 0) return 0;
-
-    return fTotal/fCount;
+    return GetBalances().dAverageAnonymizedRounds;
 }
 
 // Note: calculated including unconfirmed,
@@ -1936,30 +2377,7 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-
-            uint256 hash = (*it).first;
-
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-
-                CTxIn txin = CTxIn(hash, i);
-
-                if(IsSpent(hash, i) || IsMine(pcoin->vout[i]) != ISMINE_SPENDABLE || !IsDenominated(txin)) continue;
-                if (pcoin->GetDepthInMainChain() < 0) continue;
-
-                int nRounds = GetInputPrivateSendRounds(txin);
-                nTotal += pcoin->vout[i].nValue * nRounds / nPrivateSendRounds;
-            }
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nNormalizedAnonymized;
 }
 
 CAmount CWallet::GetNeedsToBeAnonymizedBalance(CAmount nMinBalance) const
@@ -1990,92 +2408,33 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-
-            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-        }
-    }
-
-    return nTotal;
+    CWalletBalances balances = GetBalances();
+    return unconfirmed ? balances.nDenominatedUnconfirmed : balances.nDenominatedConfirmed;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnly;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmedWatchOnly;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmatureWatchOnly;
 }
 
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
@@ -2084,9 +2443,18 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        std::set<COutPoint>::const_iterator itUTXO = setWalletUTXO.begin();
+        while (itUTXO != setWalletUTXO.end())
         {
-            const uint256& wtxid = it->first;
+            // candidate outputs of this transaction are [itTxBegin, itUTXO)
+            const uint256 wtxid = itUTXO->hash;
+            std::set<COutPoint>::const_iterator itTxBegin = itUTXO;
+            while (itUTXO != setWalletUTXO.end() && itUTXO->hash == wtxid)
+                ++itUTXO;
+
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+            if (it == mapWallet.end())
+                continue;
             const CWalletTx* pcoin = &(*it).second;
 
             if (!CheckFinalTx(*pcoin))
@@ -2108,7 +2476,8 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
             if (nDepth == 0 && !pcoin->InMempool())
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
+            for (std::set<COutPoint>::const_iterator itOut = itTxBegin; itOut != itUTXO; ++itOut) {
+                unsigned int i = itOut->n;
                 bool found = false;
                 if(nCoinType == ONLY_DENOMINATED) {
                     found = IsDenominatedAmount(pcoin->vout[i].nValue);
@@ -3347,6 +3716,9 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         return nLoadWalletRet;
     fFirstRunRet = !vchDefaultKey.IsValid();
 
+    // transactions are loaded in no particular order, spends are only known now
+    RebuildWalletUTXO();
+
     uiInterface.LoadWallet(this);
 
     return DB_LOAD_OK;
@@ -3464,6 +3836,37 @@ bool CWallet::NewKeyPool()
     return true;
 }
 
+namespace {
+
+/** A key generated for the keypool off the wallet lock */
+struct CGeneratedKey
+{
+    CKey key;
+    CPubKey pubkey;
+    std::vector<unsigned char> vchCryptedSecret;
+    bool fOk;
+};
+
+/** Worker nWorker of nWorkers: generate, check and (if pkeystore is set) encrypt every nWorkers-th key */
+void GenerateKeyBatch(std::vector<CGeneratedKey>* pvKeys, const CCryptoKeyStore* pkeystore, bool fCompressed, unsigned int nWorker, unsigned int nWorkers)
+{
+    for (unsigned int i = nWorker; i < pvKeys->size(); i += nWorkers) {
+        CGeneratedKey& generated = (*pvKeys)[i];
+        generated.key.MakeNewKey(fCompressed);
+        generated.pubkey = generated.key.GetPubKey();
+        generated.fOk = generated.key.VerifyPubKey(generated.pubkey);
+        if (generated.fOk && pkeystore)
+            generated.fOk = pkeystore->EncryptKey(generated.key, generated.pubkey, generated.vchCryptedSecret);
+    }
+}
+
+} // anon namespace
+
+/**
+ * Keys are generated and encrypted in batches of KEYPOOL_TOPUP_BATCH_SIZE on
+ * all cores, then added to the keystore and written together with their pool
+ * entries in one database transaction per batch.
+ */
 bool CWallet::TopUpKeyPool(unsigned int kpSize)
 {
     {
@@ -3472,25 +3875,81 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         if (IsLocked(true))
             return false;
 
-        CWalletDB walletdb(strWalletFile);
-
         // Top up key pool
         unsigned int nTargetSize;
         if (kpSize > 0)
             nTargetSize = kpSize;
         else
             nTargetSize = max(GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 0);
+        if (setKeyPool.size() >= nTargetSize + 1)
+            return true;
+
+        bool fCompressed = CanSupportFeature(FEATURE_COMPRPUBKEY); // default to compressed public keys if we want 0.6.0 wallets
+        // Compressed public keys were introduced in version 0.6.0
+        if (fCompressed)
+            SetMinVersion(FEATURE_COMPRPUBKEY);
+
+        unsigned int nThreads = std::max(1, GetNumCores());
+        CWalletDB walletdb(strWalletFile);
 
         while (setKeyPool.size() < (nTargetSize + 1))
         {
-            int64_t nEnd = 1;
-            if (!setKeyPool.empty())
-                nEnd = *(--setKeyPool.end()) + 1;
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey())))
-                throw runtime_error("TopUpKeyPool(): writing generated key failed");
-            setKeyPool.insert(nEnd);
-            LogPrintf("keypool added key %d, size=%u\n", nEnd, setKeyPool.size());
-            double dProgress = 100.f * nEnd / (nTargetSize + 1);
+            std::vector<CGeneratedKey> vKeys(std::min((unsigned int)(nTargetSize + 1 - setKeyPool.size()), KEYPOOL_TOPUP_BATCH_SIZE));
+            {
+                boost::thread_group workers;
+                unsigned int nWorkers = std::min(nThreads, (unsigned int)vKeys.size());
+                for (unsigned int i = 0; i < nWorkers; i++)
+                    workers.create_thread(boost::bind(&GenerateKeyBatch, &vKeys, IsCrypted() ? this : NULL, fCompressed, i, nWorkers));
+                workers.join_all();
+            }
+
+            int64_t nBegin = setKeyPool.empty() ? 1 : *(--setKeyPool.end()) + 1;
+            int64_t nEnd = nBegin;
+            int64_t nCreationTime = GetTime();
+            if (!walletdb.TxnBegin())
+                throw runtime_error("TopUpKeyPool(): could not begin database transaction");
+            std::string strError;
+            BOOST_FOREACH(const CGeneratedKey& generated, vKeys)
+            {
+                if (!generated.fOk) {
+                    strError = "generating key failed";
+                    break;
+                }
+                const CKeyMetadata& metadata = mapKeyMetadata[generated.pubkey.GetID()] = CKeyMetadata(nCreationTime);
+                bool fAdded;
+                if (IsCrypted()) {
+                    fAdded = CCryptoKeyStore::AddCryptedKey(generated.pubkey, generated.vchCryptedSecret) &&
+                             walletdb.WriteCryptedKey(generated.pubkey, generated.vchCryptedSecret, metadata);
+                } else {
+                    fAdded = CCryptoKeyStore::AddKeyPubKey(generated.key, generated.pubkey) &&
+                             walletdb.WriteKey(generated.pubkey, generated.key.GetPrivKey(), metadata);
+                }
+                nEnd++;
+                if (!fAdded || !walletdb.WritePool(nEnd - 1, CKeyPool(generated.pubkey))) {
+                    strError = "writing generated key failed";
+                    break;
+                }
+            }
+            if (strError.empty() && !walletdb.TxnCommit())
+                strError = "writing generated keys failed";
+            if (!strError.empty()) {
+                // nothing of the batch made it to disk, don't keep it in memory either
+                walletdb.TxnAbort();
+                for (int64_t nIndex = nBegin; nIndex < nEnd; nIndex++) {
+                    CKeyID keyID = vKeys[nIndex - nBegin].pubkey.GetID();
+                    EraseKey(keyID);
+                    mapKeyMetadata.erase(keyID);
+                }
+                throw runtime_error("TopUpKeyPool(): " + strError);
+            }
+
+            for (int64_t nIndex = nBegin; nIndex < nEnd; nIndex++)
+                setKeyPool.insert(nIndex);
+            if (!nTimeFirstKey || nCreationTime < nTimeFirstKey)
+                nTimeFirstKey = nCreationTime;
+            MarkScriptPrefilterDirty();
+            LogPrintf("keypool added keys %d-%d, size=%u\n", nBegin, nEnd - 1, setKeyPool.size());
+            double dProgress = 100.f * (nEnd - 1) / (nTargetSize + 1);
             std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
             uiInterface.InitMessage(strMsg);
         }
@@ -3784,6 +4243,8 @@ bool CWallet::UpdatedTransaction(const uint256 &hashTx)
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()){
+            // e.g. got locked via InstantSend, which changes its depth
+            fBalancesCached = false;
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
@@ -3791,6 +4252,23 @@ bool CWallet::UpdatedTransaction(const uint256 &hashTx)
     return false;
 }
 
+void CWallet::UpdatedBlockTip(const CBlockIndex *pindex)
+{
+    // depth and maturity of every transaction changed
+    LOCK(cs_wallet);
+    fBalancesCached = false;
+
+    // transactions might have been replaced by conflicting ones, recalculate rounds from scratch
+    if (pindexLastTip && pindex->GetAncestor(pindexLastTip->nHeight) != pindexLastTip) {
+        LogPrint("privatesend", "CWallet::UpdatedBlockTip -- reorganization detected, clearing PrivateSend rounds cache\n");
+        mapOutpointRoundsCache.clear();
+    }
+    pindexLastTip = pindex;
+
+    // one database transaction for everything the block brought in
+    FlushPendingWrites();
+}
+
 void CWallet::GetScriptForMining(boost::shared_ptr<CReserveScript> &script)
 {
     boost::shared_ptr<CReserveKey> rKey(new CReserveKey(this));
@@ -3811,6 +4289,7 @@ void CWallet::LockCoin(COutPoint& output)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    setBalancesDirtyTxs.insert(output.hash);
 }
 
 void CWallet::UnlockCoin(COutPoint& output)
@@ -3822,6 +4301,7 @@ void CWallet::UnlockCoin(COutPoint& output)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    setBalancesDirtyTxs.insert(output.hash);
 }
 
 void CWallet::UnlockAllCoins()
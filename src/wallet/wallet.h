@@ -43,6 +43,8 @@ extern bool fLargeWorkForkFound;
 extern bool fLargeWorkInvalidChainFound;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+//! Number of keys TopUpKeyPool generates in parallel and writes in one database transaction
+static const unsigned int KEYPOOL_TOPUP_BATCH_SIZE = 1000;
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = 0;
 //! -paytxfee will warn if called with a higher fee than this amount (in satoshis) per KB
@@ -70,6 +72,14 @@ static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWa
 //! Largest (in bytes) free transaction we're willing to create
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
 static const bool DEFAULT_WALLETBROADCAST = true;
+//! Number of blocks a wallet rescan reads ahead and commits at a time
+static const int WALLET_RESCAN_CHUNK_SIZE = 64;
+//! Maximum number of threads used to read and match blocks during a wallet rescan
+static const int MAX_WALLET_RESCAN_THREADS = 8;
+//! Milliseconds transaction records found by SyncTransaction and rescans may wait before being written
+static const int64_t WALLET_WRITE_BEHIND_INTERVAL = 1000;
+//! Number of pending transaction records that triggers a write regardless of their age
+static const unsigned int MAX_WALLET_PENDING_WRITES = 1000;
 
 class CAccountingEntry;
 class CBlockIndex;
@@ -112,6 +122,45 @@ struct CompactTallyItem
     }
 };
 
+/** All wallet balances, computed together in one pass over the wallet */
+struct CWalletBalances
+{
+    CAmount nBalance;
+    CAmount nUnconfirmed;
+    CAmount nImmature;
+    CAmount nWatchOnly;
+    CAmount nUnconfirmedWatchOnly;
+    CAmount nImmatureWatchOnly;
+    CAmount nAnonymized;
+    CAmount nNormalizedAnonymized;
+    CAmount nDenominatedConfirmed;
+    CAmount nDenominatedUnconfirmed;
+    double dAverageAnonymizedRounds;
+    // sum and count of the rounds behind dAverageAnonymizedRounds
+    int64_t nTotalRounds;
+    int64_t nCountRounds;
+
+    CWalletBalances()
+    {
+        nBalance = 0;
+        nUnconfirmed = 0;
+        nImmature = 0;
+        nWatchOnly = 0;
+        nUnconfirmedWatchOnly = 0;
+        nImmatureWatchOnly = 0;
+        nAnonymized = 0;
+        nNormalizedAnonymized = 0;
+        nDenominatedConfirmed = 0;
+        nDenominatedUnconfirmed = 0;
+        dAverageAnonymizedRounds = 0;
+        nTotalRounds = 0;
+        nCountRounds = 0;
+    }
+
+    CWalletBalances& operator+=(const CWalletBalances& b);
+    CWalletBalances& operator-=(const CWalletBalances& b);
+};
+
 /** A key pool entry */
 class CKeyPool
 {
@@ -539,6 +588,31 @@ private:
     mutable bool fAnonymizableTallyCachedNonDenom;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    /**
+     * Balances are recomputed only after something they depend on changed:
+     * a wallet transaction, the chain tip (depth, maturity) or an InstantSend lock.
+     * They are kept per transaction as well, so a new or updated transaction
+     * only recomputes itself and the transactions it spends from
+     * (setBalancesDirtyTxs); chain and key changes recompute everything.
+     * Protected by cs_wallet.
+     */
+    mutable bool fBalancesCached;
+    mutable CWalletBalances cachedBalances;
+    mutable std::map<uint256, CWalletBalances> mapTxBalances;
+    mutable std::set<uint256> setBalancesDirtyTxs;
+    bool ComputeTxBalances(const uint256& hash, CWalletBalances& balances) const;
+    void MarkBalancesDirty(const CTransaction& tx);
+
+    /**
+     * Memoized PrivateSend rounds of our outputs, see GetRealInputPrivateSendRounds.
+     * Rounds only depend on the wallet's transaction graph, so entries stay valid
+     * until an ancestor is added after its descendants, keys get imported or the
+     * chain reorganizes. Protected by cs_wallet.
+     */
+    mutable std::map<COutPoint, int> mapOutpointRoundsCache;
+    // the tip seen by the last UpdatedBlockTip, to detect reorganizations
+    const CBlockIndex* pindexLastTip;
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -554,6 +628,40 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Our outputs which are not spent by an active (neither abandoned nor
+     * conflicted) wallet transaction, i.e. a superset of the coins AvailableCoins
+     * can return. Ordered by tx hash, so per-transaction checks run once per
+     * transaction instead of for every transaction in mapWallet.
+     */
+    std::set<COutPoint> setWalletUTXO;
+    bool IsSpentByActiveTx(const COutPoint& outpoint) const;
+    void UpdateWalletUTXO(const COutPoint& outpoint);
+    void UpdateWalletUTXO(const CWalletTx& wtx);
+    void RebuildWalletUTXO();
+
+    /**
+     * Rejects P2PKH/P2SH outputs to ids we don't know before IsMine() runs the
+     * solver. Rebuilt lazily after keys, scripts or watch-only addresses change.
+     * Protected by cs_KeyStore.
+     */
+    mutable CScriptPrefilter scriptPrefilter;
+    mutable bool fScriptPrefilterDirty;
+    //! Bumped on every change, lets holders of a snapshot tell that it went stale
+    unsigned int nScriptPrefilterVersion;
+    void MarkScriptPrefilterDirty();
+    void UpdateScriptPrefilter() const;
+
+    /**
+     * Write-behind queue for transactions added without a database handle, i.e.
+     * by SyncTransaction and rescans: hashes whose wallet record still has to be
+     * written and whether nOrderPosNext changed. See FlushPendingWrites.
+     * Protected by cs_wallet.
+     */
+    mutable std::set<uint256> setPendingWalletTxWrites;
+    mutable bool fPendingOrderPosNext;
+    mutable int64_t nLastPendingWritesFlush;
+
 public:
     /*
      * Main wallet lock.
@@ -607,6 +715,12 @@ public:
         fBroadcastTransactions = false;
         fAnonymizableTallyCached = false;
         fAnonymizableTallyCachedNonDenom = false;
+        fBalancesCached = false;
+        pindexLastTip = NULL;
+        fScriptPrefilterDirty = true;
+        nScriptPrefilterVersion = 0;
+        fPendingOrderPosNext = false;
+        nLastPendingWritesFlush = 0;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
     }
@@ -666,6 +780,7 @@ public:
     int GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const;
     // respect current settings
     int GetInputPrivateSendRounds(CTxIn txin) const;
+    void ClearPrivateSendRoundsCache();
 
     bool IsDenominated(const CTxIn &txin) const;
     bool IsDenominatedAmount(CAmount nInputAmount) const;
@@ -686,7 +801,7 @@ public:
     //! Adds a key to the store, and saves it to disk.
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey);
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
-    bool LoadKey(const CKey& key, const CPubKey &pubkey) { return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
+    bool LoadKey(const CKey& key, const CPubKey &pubkey);
     //! Load metadata (used by LoadWallet)
     bool LoadKeyMetadata(const CPubKey &pubkey, const CKeyMetadata &metadata);
 
@@ -714,6 +829,11 @@ public:
     //! Adds a watch-only address to the store, without saving it to disk (used by LoadWallet)
     bool LoadWatchOnly(const CScript &dest);
 
+    //! Snapshot of the IsMine() prefilter for matching outside of the wallet locks
+    CScriptPrefilter GetScriptPrefilter() const;
+    //! Changes whenever keys, scripts or watch-only addresses are added or removed
+    unsigned int GetScriptPrefilterVersion() const;
+
     bool Unlock(const SecureString& strWalletPassphrase, bool fForMixingOnly = false);
     bool ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase, const SecureString& strNewWalletPassphrase);
     bool EncryptWallet(const SecureString& strWalletPassphrase);
@@ -729,11 +849,20 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
-    bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
+    /** fCheckIsMine may be false when the caller already knows that none of tx's outputs are ours */
+    bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate, bool fCheckIsMine = true);
+    /**
+     * Scan the active chain from pindexStart for wallet transactions. Blocks are
+     * read and matched on worker threads and cs_main/cs_wallet are only taken
+     * briefly per chunk, so callers should not hold them across this call.
+     */
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime);
+    CWalletBalances GetBalances() const;
+    /** Balances computed from scratch, bypassing the cache */
+    CWalletBalances ComputeBalances() const;
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -819,6 +948,7 @@ public:
     bool DelAddressBook(const CTxDestination& address);
 
     bool UpdatedTransaction(const uint256 &hashTx);
+    void UpdatedBlockTip(const CBlockIndex *pindex);
 
     void Inventory(const uint256 &hash)
     {
@@ -859,6 +989,12 @@ public:
 
     //! Flush wallet (bitdb flush)
     void Flush(bool shutdown=false);
+    /**
+     * Write all queued transaction records in one database transaction. Called once
+     * per block, per rescan chunk and every WALLET_WRITE_BEHIND_INTERVAL, and before
+     * SetBestChain, Flush and backups so that the file on disk is complete.
+     */
+    bool FlushPendingWrites() const;
 
     //! Verify the wallet database and perform salvage if required
     static bool Verify(const std::string& walletFile, std::string& warningString, std::string& errorString);
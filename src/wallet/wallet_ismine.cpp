@@ -5,12 +5,15 @@
 
 #include "wallet_ismine.h"
 
+#include "crypto/common.h"
 #include "key.h"
 #include "keystore.h"
 #include "script/script.h"
 #include "script/standard.h"
 #include "script/sign.h"
 
+#include <algorithm>
+
 #include <boost/foreach.hpp>
 
 using namespace std;
@@ -93,3 +96,48 @@ isminetype IsMine(const CKeyStore &keystore, const CScript& scriptPubKey)
     }
     return ISMINE_NO;
 }
+
+void CScriptPrefilter::Clear()
+{
+    vKeyHashes.clear();
+    vScriptHashes.clear();
+}
+
+void CScriptPrefilter::AddKeyID(const CKeyID& keyID)
+{
+    vKeyHashes.push_back(ReadLE64(keyID.begin()));
+}
+
+void CScriptPrefilter::AddScriptID(const CScriptID& scriptID)
+{
+    vScriptHashes.push_back(ReadLE64(scriptID.begin()));
+}
+
+void CScriptPrefilter::AddWatchOnly(const CScript& script)
+{
+    if (script.IsPayToPublicKeyHash())
+        vKeyHashes.push_back(ReadLE64(&script[3]));
+    else if (script.IsPayToScriptHash())
+        vScriptHashes.push_back(ReadLE64(&script[2]));
+}
+
+static void SortUnique(vector<uint64_t>& v)
+{
+    sort(v.begin(), v.end());
+    v.erase(unique(v.begin(), v.end()), v.end());
+}
+
+void CScriptPrefilter::Finalize()
+{
+    SortUnique(vKeyHashes);
+    SortUnique(vScriptHashes);
+}
+
+bool CScriptPrefilter::MaybeMine(const CScript& scriptPubKey) const
+{
+    if (scriptPubKey.IsPayToPublicKeyHash())
+        return binary_search(vKeyHashes.begin(), vKeyHashes.end(), ReadLE64(&scriptPubKey[3]));
+    if (scriptPubKey.IsPayToScriptHash())
+        return binary_search(vScriptHashes.begin(), vScriptHashes.end(), ReadLE64(&scriptPubKey[2]));
+    return true;
+}
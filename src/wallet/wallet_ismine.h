@@ -9,6 +9,7 @@
 #include "script/standard.h"
 
 #include <stdint.h>
+#include <vector>
 
 class CKeyStore;
 class CScript;
@@ -31,4 +32,31 @@ typedef uint8_t isminefilter;
 isminetype IsMine(const CKeyStore& keystore, const CScript& scriptPubKey);
 isminetype IsMine(const CKeyStore& keystore, const CTxDestination& dest);
 
+/**
+ * Compact prefilter over the key and script ids of a keystore, kept as sorted
+ * vectors of their first 64 bits. A pay-to-pubkey-hash or pay-to-script-hash
+ * output whose hash is not in the filter can't be ours, so it can be rejected
+ * without running the solver. Any other script, and the rare false positive,
+ * has to go through IsMine().
+ */
+class CScriptPrefilter
+{
+private:
+    std::vector<uint64_t> vKeyHashes;
+    std::vector<uint64_t> vScriptHashes;
+
+public:
+    void Clear();
+    void AddKeyID(const CKeyID& keyID);
+    void AddScriptID(const CScriptID& scriptID);
+    //! Index the destination of a watch-only script, if it is P2PKH or P2SH
+    void AddWatchOnly(const CScript& script);
+    //! Sort and deduplicate, must be called after adding and before MaybeMine()
+    void Finalize();
+
+    //! False only if scriptPubKey is a P2PKH or P2SH output to an id that is not in the filter
+    bool MaybeMine(const CScript& scriptPubKey) const;
+    size_t Size() const { return vKeyHashes.size() + vScriptHashes.size(); }
+};
+
 #endif // BITCOIN_WALLET_WALLET_ISMINE_H
@@ -25,6 +25,8 @@ using namespace std;
 
 static uint64_t nAccountingEntryNumber = 0;
 
+extern CWallet* pwalletMain;
+
 //
 // CWalletDB
 //
@@ -825,6 +827,10 @@ void ThreadFlushWalletDB(const string& strFile)
     {
         MilliSleep(500);
 
+        // write out transactions queued since the last block
+        if (pwalletMain)
+            pwalletMain->FlushPendingWrites();
+
         if (nLastSeen != nWalletDBUpdated)
         {
             nLastSeen = nWalletDBUpdated;
@@ -872,6 +878,7 @@ bool BackupWallet(const CWallet& wallet, const string& strDest)
 {
     if (!wallet.fFileBacked)
         return false;
+    wallet.FlushPendingWrites();
     while (true)
     {
         {
@@ -25,3 +25,28 @@ bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transacti
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyBlockTemplate(const CBlock &/*block*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyMasternodeState(const COutPoint &/*outpoint*/, int /*nState*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyGovernanceObject(const CGovernanceObject &/*govobj*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyGovernanceVote(const CGovernanceVote &/*vote*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyPaymentVote(const CMasternodePaymentVote &/*vote*/)
+{
+    return true;
+}
@@ -7,7 +7,11 @@
 
 #include "zmqconfig.h"
 
+class CBlock;
 class CBlockIndex;
+class CGovernanceObject;
+class CGovernanceVote;
+class CMasternodePaymentVote;
 class CZMQAbstractNotifier;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
@@ -35,6 +39,11 @@ public:
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyBlockTemplate(const CBlock &block);
+    virtual bool NotifyMasternodeState(const COutPoint &outpoint, int nState);
+    virtual bool NotifyGovernanceObject(const CGovernanceObject &govobj);
+    virtual bool NotifyGovernanceVote(const CGovernanceVote &vote);
+    virtual bool NotifyPaymentVote(const CMasternodePaymentVote &vote);
 
 protected:
     void *psocket;
@@ -27,6 +27,11 @@ protected:
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
     void UpdatedBlockTip(const CBlockIndex *pindex);
     void NotifyTransactionLock(const CTransaction &tx);
+    void UpdatedBlockTemplate(const CBlock &block);
+    void NotifyMasternodeState(const COutPoint &outpoint, int nState);
+    void NotifyGovernanceObject(const CGovernanceObject &govobj);
+    void NotifyGovernanceVote(const CGovernanceVote &vote);
+    void NotifyPaymentVote(const CMasternodePaymentVote &vote);
 
 private:
     CZMQNotificationInterface();
@@ -4,17 +4,180 @@
 
 #include "chainparams.h"
 #include "zmqpublishnotifier.h"
+#include "governance-object.h"
+#include "governance-vote.h"
+#include "instantx.h"
 #include "main.h"
+#include "masternode-payments.h"
 #include "util.h"
 
+#include <deque>
+
+#include <boost/thread.hpp>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
+static const char *MSG_BLOCKTEMPLATERAW = "blocktemplateraw";
 static const char *MSG_HASHBLOCK  = "hashblock";
+static const char *MSG_HASHGOVERNANCEOBJECT = "hashgovernanceobject";
+static const char *MSG_HASHGOVERNANCEVOTE = "hashgovernancevote";
+static const char *MSG_HASHPAYMENTVOTE = "hashpaymentvote";
 static const char *MSG_HASHTX     = "hashtx";
 static const char *MSG_HASHTXLOCK = "hashtxlock";
+static const char *MSG_MASTERNODESTATE = "masternodestate";
 static const char *MSG_RAWBLOCK   = "rawblock";
+static const char *MSG_RAWGOVERNANCEOBJECT = "rawgovernanceobject";
+static const char *MSG_RAWGOVERNANCEVOTE = "rawgovernancevote";
+static const char *MSG_RAWPAYMENTVOTE = "rawpaymentvote";
 static const char *MSG_RAWTX      = "rawtx";
 static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_TXLOCKTIMING = "txlocktiming";
+
+/**
+ * Messages of all publish notifiers are sent by one publisher thread, so the
+ * threads raising notifications never wait for ZMQ or for a block to be read
+ * from disk. The queue is bounded: a message which doesn't fit is dropped and
+ * subscribers see a gap in the sequence numbers of its topic.
+ */
+class CZMQPublishQueue
+{
+private:
+    struct Message
+    {
+        CZMQAbstractPublishNotifier *notifier;
+        const char *command;
+        std::string strData;
+        const CBlockIndex *pindexBlock;
+        uint32_t nSequence;
+    };
+
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<Message> queue;
+    size_t nMaxQueued;
+    bool fRunning;
+    uint64_t nDropped;
+    boost::thread thread;
+
+    void Run();
+    void Publish(Message &msg);
+
+public:
+    CZMQPublishQueue() : nMaxQueued(0), fRunning(false), nDropped(0) { }
+
+    void Start(size_t nMaxQueuedIn);
+    void Stop();
+    bool Push(CZMQAbstractPublishNotifier *notifier, const char *command, const std::string &strData, const CBlockIndex *pindexBlock);
+};
+
+static CZMQPublishQueue publishQueue;
+
+void CZMQPublishQueue::Start(size_t nMaxQueuedIn)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (fRunning)
+        return;
+    nMaxQueued = nMaxQueuedIn;
+    nDropped = 0;
+    fRunning = true;
+    thread = boost::thread(boost::bind(&CZMQPublishQueue::Run, this));
+}
+
+void CZMQPublishQueue::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (!fRunning)
+            return;
+        fRunning = false;
+    }
+    cond.notify_all();
+    thread.join();
+    if (nDropped)
+        LogPrint("zmq", "zmq: %u messages were dropped because the publish queue was full\n", nDropped);
+}
+
+bool CZMQPublishQueue::Push(CZMQAbstractPublishNotifier *notifier, const char *command, const std::string &strData, const CBlockIndex *pindexBlock)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        // numbered under the queue lock, so each topic is published in sequence order
+        uint32_t nSequence = notifier->nSequence++;
+        if (!fRunning || queue.size() >= nMaxQueued)
+        {
+            nDropped++;
+            LogPrint("zmq", "zmq: Publish queue full, dropping %s message %u\n", command, nSequence);
+            return false;
+        }
+        queue.push_back(Message());
+        Message &msg = queue.back();
+        msg.notifier = notifier;
+        msg.command = command;
+        msg.strData = strData;
+        msg.pindexBlock = pindexBlock;
+        msg.nSequence = nSequence;
+    }
+    cond.notify_one();
+    return true;
+}
+
+void CZMQPublishQueue::Run()
+{
+    RenameThread("3dcoin-zmqpub");
+    while (true)
+    {
+        Message msg;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            while (fRunning && queue.empty())
+                cond.wait(lock);
+            // keep going until the queue is drained, even when stopping
+            if (queue.empty())
+                return;
+            Message &front = queue.front();
+            msg.notifier = front.notifier;
+            msg.command = front.command;
+            msg.strData.swap(front.strData);
+            msg.pindexBlock = front.pindexBlock;
+            msg.nSequence = front.nSequence;
+            queue.pop_front();
+        }
+        Publish(msg);
+    }
+}
+
+void CZMQPublishQueue::Publish(Message &msg)
+{
+    if (msg.pindexBlock)
+    {
+        const Consensus::Params& consensusParams = Params().GetConsensus();
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        {
+            LOCK(cs_main);
+            CBlock block;
+            if(!ReadBlockFromDisk(block, msg.pindexBlock, consensusParams))
+            {
+                zmqError("Can't read block from disk");
+                return;
+            }
+
+            ss << block;
+        }
+        msg.strData.assign(ss.begin(), ss.end());
+    }
+
+    msg.notifier->SendMultipart(msg.command, msg.strData, msg.nSequence);
+}
+
+void StartZMQPublisher(size_t nMaxQueued)
+{
+    publishQueue.Start(nMaxQueued);
+}
+
+void StopZMQPublisher()
+{
+    publishQueue.Stop();
+}
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -126,20 +289,30 @@ void CZMQAbstractPublishNotifier::Shutdown()
 }
 
 bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+{
+    return QueueMessage(command, std::string((const char*)data, size));
+}
+
+bool CZMQAbstractPublishNotifier::QueueMessage(const char *command, const std::string &strData, const CBlockIndex *pindexBlock)
 {
     assert(psocket);
 
-    /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
-    if (rc == -1)
-        return false;
+    /* a dropped message is not a failure of this notifier, it only shows up
+       as a gap in the sequence numbers */
+    publishQueue.Push(this, command, strData, pindexBlock);
+    return true;
+}
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
+// Called from the publisher thread only, which is the only user of the sockets while it runs
+bool CZMQAbstractPublishNotifier::SendMultipart(const char *command, const std::string &strData, uint32_t nSequenceIn)
+{
+    assert(psocket);
 
-    return true;
+    /* send three parts, command & data & a LE 4byte sequence number */
+    unsigned char msgseq[sizeof(uint32_t)];
+    WriteLE32(&msgseq[0], nSequenceIn);
+    int rc = zmq_send_multipart(psocket, command, strlen(command), strData.data(), strData.size(), msgseq, (size_t)sizeof(uint32_t), (void*)0);
+    return rc != -1;
 }
 
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
@@ -152,6 +325,36 @@ bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
     return SendMessage(MSG_HASHBLOCK, data, 32);
 }
 
+bool CZMQPublishHashGovernanceObjectNotifier::NotifyGovernanceObject(const CGovernanceObject &govobj)
+{
+    uint256 hash = govobj.GetHash();
+    LogPrint("zmq", "zmq: Publish hashgovernanceobject %s\n", hash.GetHex());
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    return SendMessage(MSG_HASHGOVERNANCEOBJECT, data, 32);
+}
+
+bool CZMQPublishHashGovernanceVoteNotifier::NotifyGovernanceVote(const CGovernanceVote &vote)
+{
+    uint256 hash = vote.GetHash();
+    LogPrint("zmq", "zmq: Publish hashgovernancevote %s\n", hash.GetHex());
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    return SendMessage(MSG_HASHGOVERNANCEVOTE, data, 32);
+}
+
+bool CZMQPublishHashPaymentVoteNotifier::NotifyPaymentVote(const CMasternodePaymentVote &vote)
+{
+    uint256 hash = vote.GetHash();
+    LogPrint("zmq", "zmq: Publish hashpaymentvote %s\n", hash.GetHex());
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    return SendMessage(MSG_HASHPAYMENTVOTE, data, 32);
+}
+
 bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
@@ -172,25 +375,76 @@ bool CZMQPublishHashTransactionLockNotifier::NotifyTransactionLock(const CTransa
     return SendMessage(MSG_HASHTXLOCK, data, 32);
 }
 
+bool CZMQPublishTransactionLockTimingNotifier::NotifyTransactionLock(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    CTxLockTimes times;
+    if (!instantsend.GetTxLockTimes(hash, times))
+        return true;
+    LogPrint("zmq", "zmq: Publish txlocktiming %s\n", hash.GetHex());
+    /* hash followed by LE 4byte phase latencies in milliseconds and vote counts */
+    unsigned char data[32 + 6 * sizeof(uint32_t)];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    WriteLE32(&data[32], times.GetTotalLatency() / 1000);
+    WriteLE32(&data[36], times.GetFirstVoteLatency() / 1000);
+    WriteLE32(&data[40], times.GetQuorumLatency() / 1000);
+    WriteLE32(&data[44], times.GetFinalizeLatency() / 1000);
+    WriteLE32(&data[48], times.nVotes);
+    WriteLE32(&data[52], times.nOrphanVotes);
+    return SendMessage(MSG_TXLOCKTIMING, data, sizeof(data));
+}
+
+bool CZMQPublishMasternodeStateNotifier::NotifyMasternodeState(const COutPoint &outpoint, int nState)
+{
+    LogPrint("zmq", "zmq: Publish masternodestate %s %d\n", outpoint.ToStringShort(), nState);
+    /* collateral txid and LE 4byte output index followed by the LE 4byte state, -1 when removed */
+    unsigned char data[32 + 2 * sizeof(uint32_t)];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = outpoint.hash.begin()[i];
+    WriteLE32(&data[32], outpoint.n);
+    WriteLE32(&data[36], (uint32_t)nState);
+    return SendMessage(MSG_MASTERNODESTATE, data, sizeof(data));
+}
+
 bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
+    // the block is read from disk by the publisher thread
+    return QueueMessage(MSG_RAWBLOCK, std::string(), pindex);
+}
+
+bool CZMQPublishRawBlockTemplateNotifier::NotifyBlockTemplate(const CBlock &block)
+{
+    LogPrint("zmq", "zmq: Publish blocktemplateraw on top of %s\n", block.hashPrevBlock.GetHex());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
+    ss << block;
+    return SendMessage(MSG_BLOCKTEMPLATERAW, &(*ss.begin()), ss.size());
+}
 
-        ss << block;
-    }
+bool CZMQPublishRawGovernanceObjectNotifier::NotifyGovernanceObject(const CGovernanceObject &govobj)
+{
+    LogPrint("zmq", "zmq: Publish rawgovernanceobject %s\n", govobj.GetHash().GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << govobj;
+    return SendMessage(MSG_RAWGOVERNANCEOBJECT, &(*ss.begin()), ss.size());
+}
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+bool CZMQPublishRawGovernanceVoteNotifier::NotifyGovernanceVote(const CGovernanceVote &vote)
+{
+    LogPrint("zmq", "zmq: Publish rawgovernancevote %s\n", vote.GetHash().GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << vote;
+    return SendMessage(MSG_RAWGOVERNANCEVOTE, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishRawPaymentVoteNotifier::NotifyPaymentVote(const CMasternodePaymentVote &vote)
+{
+    LogPrint("zmq", "zmq: Publish rawpaymentvote %s\n", vote.GetHash().GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << vote;
+    return SendMessage(MSG_RAWPAYMENTVOTE, &(*ss.begin()), ss.size());
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -8,19 +8,39 @@
 #include "zmqabstractnotifier.h"
 
 class CBlockIndex;
+class CZMQPublishQueue;
+
+/** Default for -zmqpubqueuesize, messages waiting for the publisher thread */
+static const int64_t DEFAULT_ZMQ_PUB_QUEUE_SIZE = 10000;
+
+/** Start the thread which sends the queued messages of all publish notifiers */
+void StartZMQPublisher(size_t nMaxQueued);
+/** Send the messages still queued and stop the publisher thread */
+void StopZMQPublisher();
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
-    uint32_t nSequence; // upcounting per message sequence number
+    uint32_t nSequence; // upcounting per message sequence number, guarded by the publish queue
+
+    friend class CZMQPublishQueue;
+
+    bool SendMultipart(const char *command, const std::string &strData, uint32_t nSequenceIn);
+
+protected:
+    /* queue a message for the publisher thread, pindexBlock set means the
+       block is read from disk there and published as data */
+    bool QueueMessage(const char *command, const std::string &strData, const CBlockIndex *pindexBlock = NULL);
 
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0) { }
 
-    /* send zmq multipart message
+    /* queue zmq multipart message
        parts:
           * command
           * data
-          * message sequence number
+          * message sequence number, which also counts the messages dropped
+            because the queue was full
     */
     bool SendMessage(const char *command, const void* data, size_t size);
 
@@ -34,6 +54,24 @@ public:
     bool NotifyBlock(const CBlockIndex *pindex);
 };
 
+class CZMQPublishHashGovernanceObjectNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyGovernanceObject(const CGovernanceObject &govobj);
+};
+
+class CZMQPublishHashGovernanceVoteNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyGovernanceVote(const CGovernanceVote &vote);
+};
+
+class CZMQPublishHashPaymentVoteNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyPaymentVote(const CMasternodePaymentVote &vote);
+};
+
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
@@ -46,12 +84,48 @@ public:
     bool NotifyTransactionLock(const CTransaction &transaction);
 };
 
+class CZMQPublishTransactionLockTimingNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionLock(const CTransaction &transaction);
+};
+
+class CZMQPublishMasternodeStateNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyMasternodeState(const COutPoint &outpoint, int nState);
+};
+
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
     bool NotifyBlock(const CBlockIndex *pindex);
 };
 
+class CZMQPublishRawBlockTemplateNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockTemplate(const CBlock &block);
+};
+
+class CZMQPublishRawGovernanceObjectNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyGovernanceObject(const CGovernanceObject &govobj);
+};
+
+class CZMQPublishRawGovernanceVoteNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyGovernanceVote(const CGovernanceVote &vote);
+};
+
+class CZMQPublishRawPaymentVoteNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyPaymentVote(const CMasternodePaymentVote &vote);
+};
+
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public: